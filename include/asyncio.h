@@ -0,0 +1,193 @@
+#ifndef _ASYNCIO_H
+#define _ASYNCIO_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "minirel.h"
+#include "latency.h"
+#include "threadpool.h"
+
+//
+// Asynchronous page I/O for DB.  A request is submitted and completes
+// later on an I/O thread, which runs the request's callback and then
+// wakes anyone in Wait().  Two backends implement it: io_uring, used
+// when the kernel supports it, and a pool of threads doing pread and
+// pwrite otherwise.
+//
+
+const int ASYNC_IO_DEPTH = 64;		// requests in flight at most
+const int ASYNC_IO_MAX_IOV = 256;	// buffers in one vectored request
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+class IORequest
+{
+	friend class AsyncIO;
+	friend class URingIO;
+	friend class ThreadPoolIO;
+
+	private :
+
+		bool   write;
+		int    fd;
+		size_t len;			// total over the buffers
+		off_t  offset;
+		std::vector<struct iovec> iov;
+
+		std::mutex latch;
+		std::condition_variable finished;
+		std::atomic<bool> done;
+		Status status;
+
+		LatencyHistogram *timing;	// where to record the latency, or NULL
+		long started;				// ns, when submitted
+
+		// Run on the I/O thread once the transfer is done, before the
+		// callback, with whether it was whole; the request fails if it
+		// returns false.  Cleared once run.
+		std::function<bool(bool)> finish;
+
+		void Complete(ssize_t result);
+
+	public :
+
+		// Run on the I/O thread once the request completes, before any
+		// waiter wakes.  It must not wait for other I/O.
+		std::function<void(IORequest*)> callback;
+
+		IORequest();
+
+		// Mark the request in flight ahead of submitting it, so that
+		// whoever finds it meanwhile waits in Wait().  An earlier use
+		// still completing is waited for first.
+		void Start();
+
+		// Complete a started request that could not be submitted, with
+		// status FAIL and without running the callback.
+		void Abort();
+
+		// Wait for an earlier use to complete and clear its status.
+		void Reset();
+
+		// Block until the request completes; a request never
+		// submitted counts as complete.
+		Status Wait();
+		bool   IsDone() { return done; }
+		Status GetStatus() { return status; }
+};
+
+
+class AsyncIO
+{
+	public :
+
+		virtual ~AsyncIO() {}
+
+		// Start a transfer on req, which is either idle or marked with
+		// Start().  On FAIL req is already complete, with status FAIL,
+		// and neither its callback nor finish has run.  If timing is
+		// given the time from submission to completion is recorded
+		// there.  finish, if given, completes the transfer on the I/O
+		// thread, as a compressed database unpacks a page it has read.
+		Status Read(int fd, char* buf, size_t len, off_t offset, IORequest& req,
+		            LatencyHistogram* timing = NULL,
+		            const std::function<bool(bool)>& finish = nullptr);
+		Status Write(int fd, const char* buf, size_t len, off_t offset, IORequest& req,
+		             LatencyHistogram* timing = NULL,
+		             const std::function<bool(bool)>& finish = nullptr);
+
+		// Write n buffers, at most ASYNC_IO_MAX_IOV, to consecutive
+		// bytes from offset, as pwritev does.
+		Status WriteV(int fd, const struct iovec* bufs, int n, off_t offset, IORequest& req,
+		              LatencyHistogram* timing = NULL);
+
+		virtual const char* GetName() = 0;
+
+		// io_uring if the kernel allows it and useURing is set, else a
+		// thread pool.
+		static AsyncIO* Create(bool useURing = true);
+
+	protected :
+
+		virtual Status Submit(IORequest& req) = 0;
+};
+
+
+class ThreadPoolIO : public AsyncIO
+{
+	private :
+
+		ThreadPool pool;
+
+	protected :
+
+		Status Submit(IORequest& req);
+
+	public :
+
+		ThreadPoolIO(int numThreads);
+		const char* GetName() { return "threads"; }
+};
+
+
+//
+// io_uring through the raw system calls.  Submissions go straight into
+// the submission ring; a reaper thread waits for completions and
+// finishes the requests.  At most ASYNC_IO_DEPTH are in flight, and
+// submitters wait for room beyond that.
+//
+
+class URingIO : public AsyncIO
+{
+	private :
+
+		int ringFd;
+		unsigned entries;
+
+		void*  sqRing;
+		size_t sqRingSize;
+		void*  cqRing;
+		size_t cqRingSize;
+		struct io_uring_sqe* sqes;
+		size_t sqesSize;
+
+		unsigned* sqHead;
+		unsigned* sqTail;
+		unsigned* sqMask;
+		unsigned* sqArray;
+		unsigned* cqHead;
+		unsigned* cqTail;
+		unsigned* cqMask;
+		struct io_uring_cqe* cqes;
+
+		std::mutex latch;					// guards submission
+		std::condition_variable roomFree;
+		int inFlight;
+		std::thread reaper;
+
+		URingIO();
+		Status Push(IORequest* req, int opcode);
+		void ReaperLoop();
+
+	protected :
+
+		Status Submit(IORequest& req);
+
+	public :
+
+		~URingIO();
+		const char* GetName() { return "io_uring"; }
+
+		// NULL if io_uring cannot be set up here.
+		static URingIO* Open();
+};
+
+#endif // _ASYNCIO_H
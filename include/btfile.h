@@ -1,6 +1,9 @@
 #ifndef _BTFILE_H
 #define _BTFILE_H
 
+#include <mutex>
+#include <vector>
+
 #include "btindex.h"
 #include "btleaf.h"
 #include "index.h"
@@ -12,6 +15,13 @@ enum SplitStatus {
 	CLEAN_INSERT
 };
 
+// Pages reserved at once for a file's leaves, or for its index nodes;
+// fewer than the bits of an unsigned, one per page.
+const int BT_EXTENT_PAGES = 16;
+
+// Optimistic reads of a node tried before a search pins it instead.
+const int BT_OPTIMISTIC_TRIES = 3;
+
 class BTreeFile: public IndexFile {
 	
 public:
@@ -30,9 +40,14 @@ public:
     
     
 	IndexFileScan* OpenScan(const int* lowKey, const int* highKey);
+	IndexFileScan* OpenParallelScan(const int* lowKey, const int* highKey,
+	                                int nThreads, bool ordered = true);
 	
 	Status Print();
 	Status DumpStatistics();
+	Status TagPages();
+	Status GetUpperPages(std::vector<PageID>& pages);
+	Status Verify();
 	Status Search(const int* key,  PageID& foundPid);
 
 private:
@@ -44,27 +59,38 @@ private:
 
 	Status PrintTree(PageID pid);
 	Status PrintNode(PageID pid);
-	Status DestoryHelper(PageID pid);
 	Status _searchTree( const int* key,  PageID currentID, PageID& lowIndex);
 	PageID GetLeftLeaf();
 	Status _Search( const int* key,  PageID, PageID&);
-	Status _SearchIndex (const int* key,  PageID currIndexID, BTIndexPage *currIndex, PageID& foundID);
+	Status GetSplitKeys(const int* lowKey, const int* highKey, int numParts, std::vector<int>& splitKeys);
+	Status _SearchNode (const int* key,  PageID currID, NodeType& type, PageID& childID);
 	Status SplitLeafNode(const int key, const RecordID rid, BTLeafPage *fullPage, PageID &newPageID, int &newPageFirstKey);
 	Status SplitIndexNode(const int key, const PageID pid, BTIndexPage *fullPage, PageID &newPageID, int &newPageFirstKey);
 	int GetKeyDataLength(const int key, const NodeType nodeType);
 	int KeyCmp(const int key1, const int key2);
-	Status _DumpStatistics(PageID pageID);
-	Status DumpHelper (PageID pageID);
 	Status PrintTree2( PageID pageID, int option);
 	Status _PrintTree ( PageID pageID);
 	Status _Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid, PageID& oldPid, bool& rightSibling);
+	Status NewNode(NodeType type, PageID& pid, Page*& page, PageID after = INVALID_PAGE);
+	Status FreeExtents();
 
 	struct BTreeHeaderPage : HeapPage {
 	public:
+		// The extent new nodes of one type come from.
+		struct Extent {
+			PageID   start;	// its first page, or INVALID_PAGE
+			unsigned used;	// bit i is set once page start + i is taken
+		};
+
 		// Initializes the header page and sets the root to be invalid.
 		void Init(PageID hpid) {
 			HeapPage::Init(hpid);
-			SetRootPageID(INVALID_PAGE);
+			*((PageID *) HeapPage::data) = INVALID_PAGE;
+			for (int type = INDEX_NODE; type <= LEAF_NODE; type++) {
+				GetExtent((NodeType)type)->start = INVALID_PAGE;
+				GetExtent((NodeType)type)->used = 0;
+			}
+			Logged(this, Size());
 		}
 		PageID GetRootPageID() {
 			return *((PageID *) HeapPage::data);
@@ -73,10 +99,29 @@ private:
 		void SetRootPageID(PageID pid) {
 			PageID *ptr = (PageID *)(HeapPage::data);
 			*ptr = pid;
+			Logged(ptr, sizeof(PageID));
+		}
+		// Logs the whole header again if it has been dirty since before
+		// the log's last checkpoint: it stays pinned while the file is
+		// open, so the pool never writes it.
+		void Refresh() {
+			if (MINIBASE_LOG != NULL)
+				MINIBASE_LOG->Refresh(HeapPage::pid, (Page *)this, Size());
+		}
+		// The bytes of the page in use, up to the last extent.
+		int Size() {
+			return (char *)(GetExtent(LEAF_NODE) + 1) - (char *)this;
+		}
+		// The extent for nodes of the type, stored after the root.
+		Extent *GetExtent(NodeType type) {
+			return (Extent *)(HeapPage::data + sizeof(PageID)) + type;
 		}
     };
 	BTreeHeaderPage *header;
 	PageID headerID;
+	// Held by each change to the tree until its log group is committed,
+	// so that checkpoints refresh the header only while the file is idle.
+	std::mutex headerLatch;
 	int				totalDataPages;
 	int				totalIndexPages;
 	float				maxDataFillFactor;
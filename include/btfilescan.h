@@ -2,6 +2,7 @@
 #define _BTREE_FILESCAN_H
 
 #include "btfile.h"
+#include "bufmgr.h"
 
 class BTreeFile;
 
@@ -28,6 +29,7 @@ private:
 	RecordID curRid;
 	bool scanStarted;
 	bool scanFinished;
+	BufferStrategy strategy;	// the leaves are read through a ring
 };
 
 #endif
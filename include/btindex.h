@@ -28,16 +28,21 @@ public:
 	PageID GetLeftLink(void);
 	void SetLeftLink(PageID left);
 	    
-	IndexEntry* GetEntry(int slotNo) 
+	IndexEntry GetEntry(int slotNo) 
 	{
-		return (IndexEntry *)(data + slots[slotNo].offset);
+		IndexEntry entry;
+		entry.key = KeyAt(slotNo);
+		memcpy(&entry.pid, PayloadAt(slotNo), sizeof(PageID));
+		return entry;
 	}
 
 	bool IsAtLeastHalfFull()
 	{
-		return (AvailableSpace() <= (HEAPPAGE_DATA_SIZE) / 2);
+		return (AvailableSpace() <= DataSize() / 2);
 	}
 	Status GetPageID (const int *key, PageID& pid);
+	Status GetFirstPageID (const int *key, PageID& pid);
+	Status GetFirstPageIDOptimistic (const int *key, PageID& pid);
 	int KeyCmp(const int* key1, const int* key2);
 	Status GetKeyData(int& key, PageID& pid, RecordID& rid);
 	Status DeletePage (PageID pid, bool rightSibling);
@@ -24,19 +24,22 @@ public:
 	Status GetCurrent(int& key, RecordID& dataRid, RecordID rid);
 	Status GetLast (RecordID& rid, int& key, RecordID & pageNo);
 	
-	LeafEntry* GetEntry(int slotNo)
+	LeafEntry GetEntry(int slotNo)
 	{
-		return (LeafEntry *)(data + slots[slotNo].offset);
+		LeafEntry entry;
+		entry.key = KeyAt(slotNo);
+		memcpy(&entry.rid, PayloadAt(slotNo), sizeof(RecordID));
+		return entry;
 	}
 
 	bool IsAtLeastHalfFull()
 	{
-		return (AvailableSpace() <= (HEAPPAGE_DATA_SIZE) / 2);
+		return (AvailableSpace() <= DataSize() / 2);
 	}
 
 	bool CanBorrow()
 	{
-		return (AvailableSpace() <= ((HEAPPAGE_DATA_SIZE) / 2)-1);
+		return (AvailableSpace() <= (DataSize() / 2)-1);
 	}
 
 };
@@ -0,0 +1,72 @@
+#ifndef _BTREE_PARALLELSCAN_H
+#define _BTREE_PARALLELSCAN_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "btfile.h"
+#include "btfilescan.h"
+
+// Entries a worker may run ahead of the consumer, per partition.
+const int PARALLEL_SCAN_BUFFER = 1024;
+
+class BTreeFile;
+
+//
+// A range scan split into key sub-ranges.  Every sub-range is read by
+// its own BTreeFileScan on its own thread; GetNext hands the entries
+// back either in key order (partition by partition) or in whatever
+// order the workers produce them.
+//
+
+class BTreeParallelScan : public IndexFileScan {
+
+public:
+
+	friend class BTreeFile;
+
+	BTreeParallelScan(bool ordered);
+	~BTreeParallelScan();
+
+	Status GetNext(RecordID& rid, int& key);
+	Status DeleteCurrent();
+
+	int GetNumOfPartitions() { return (int)partitions.size(); }
+
+private:
+
+	struct ScanEntry {
+		int      key;
+		RecordID rid;
+	};
+
+	struct Partition {
+		bool   hasLowKey;
+		bool   hasHighKey;
+		int    lowKey;
+		int    highKey;
+		BTreeFileScan *cursor;
+		std::deque<ScanEntry> entries;
+		bool   finished;
+		Status status;          // DONE or FAIL once finished
+		std::thread worker;
+	};
+
+	std::vector<Partition *> partitions;
+	bool ordered;
+	bool cancelled;
+	int  current;               // partition being drained (ordered mode)
+
+	std::mutex latch;
+	std::condition_variable dataReady;
+	std::condition_variable spaceReady;
+
+	Status AddPartition(BTreeFile* tree, const int* lowKey, const int* highKey);
+	void   Start();
+	void   RunPartition(Partition* part);
+};
+
+#endif // _BTREE_PARALLELSCAN_H
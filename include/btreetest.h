@@ -4,12 +4,19 @@
 class BTreeTest {
 public:
 
-	Status RunTests(istream& in);
+	Status RunTests(istream& in, unsigned pageSize = MINIBASE_PAGESIZE,
+	                const char* policy = "Clock", double dirtyTarget = -1,
+	                DBIOMode iomode = DB_BUFFERED, bool trackHeat = false);
 	BTreeFile* createIndex(const char* name);
 	void destroyIndex(BTreeFile* btf, const char* name);
+	BTreeFile* crashAndRestart(BTreeFile* btf, const char* dbname, const char* logname,
+	                           const char* btfname, const char* policy, DBIOMode iomode);
 	void insertHighLow(BTreeFile* btf, int low, int high);
 	void scanHighLow(BTreeFile* btf, int low, int high);
+	void parallelScanHighLow(BTreeFile* btf, int low, int high, int threads);
 	void deleteScanHighLow(BTreeFile* btf, int low, int high);
 	void deleteHighLow(BTreeFile* btf, int low, int high);
+	Status heapTest(const char* name, int n);
+	Status heapCheck(const char* name, int n);
 
 };
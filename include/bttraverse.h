@@ -0,0 +1,82 @@
+#ifndef _BTREE_TRAVERSE_H
+#define _BTREE_TRAVERSE_H
+
+#include "minirel.h"
+#include "bufmgr.h"
+#include "sortedpage.h"
+#include "threadpool.h"
+
+// Number of pages of one level pinned ahead of the workers.
+const int TRAVERSE_BATCH_SIZE = 32;
+
+// Guard against cycles in a damaged tree.
+const int TRAVERSE_MAX_LEVELS = 32;
+
+//
+// Where a node sits in the tree, as seen from its parent.  The key bounds
+// come from the separator keys of the parent: every key stored under this
+// node should lie in [lowKey, highKey].  A missing bound is open.
+//
+
+struct BTNodeInfo {
+	PageID pid;
+	int    level;          // 0 for the root
+	int    position;       // left-to-right position within its level
+	bool   hasLowKey;
+	bool   hasHighKey;
+	int    lowKey;
+	int    highKey;
+};
+
+//
+// Callback invoked once per node.  Visit() runs on a worker thread while
+// the page is pinned, possibly concurrently with other calls, so it must
+// only read the page and must synchronize any state it shares.
+//
+
+class BTreeVisitor {
+
+public:
+
+	virtual ~BTreeVisitor() {}
+
+	virtual Status Visit(const BTNodeInfo& node, SortedPage* page) = 0;
+};
+
+//
+// Level-order walk over a B+ tree.  Each level is processed in batches:
+// the coordinating thread pins (and so reads in) the next batch while the
+// thread pool visits the current one, and the child pointers collected by
+// the visits, in left-to-right order, form the next level.
+//
+// All buffer manager calls are made by the coordinating thread; workers
+// only read pinned pages.  The pages are read through a ring of frames
+// (see BufferStrategy) a little larger than the two batches, so walking
+// a large tree does not flush the buffer pool.
+//
+
+class BTreeTraversal {
+
+public:
+
+	BTreeTraversal(int numThreads = 0, int batchSize = TRAVERSE_BATCH_SIZE);
+	~BTreeTraversal();
+
+	// Visit every node reachable from rootPid.  If freePages is set, each
+	// page is freed instead of unpinned once it has been visited.
+	Status Run(PageID rootPid, BTreeVisitor* visitor, bool freePages = false);
+
+private:
+
+	ThreadPool *pool;
+	int batchSize;
+
+	Status PinBatch(const BTNodeInfo* nodes, int n, SortedPage** pages,
+			BufferStrategy* strategy);
+	Status ReleaseBatch(const BTNodeInfo* nodes, int n, bool freePages);
+	void   VisitSlice(BTreeVisitor* visitor, const BTNodeInfo* nodes,
+			SortedPage** pages, int n, std::vector<BTNodeInfo>* children,
+			Status* results);
+};
+
+#endif // _BTREE_TRAVERSE_H
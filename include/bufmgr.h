@@ -2,6 +2,18 @@
 #ifndef _BUF_H
 #define _BUF_H
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "db.h"
 #include "page.h"
 #include "frame.h"
@@ -9,43 +21,335 @@
 #include "hash.h"
 
 
+/*
+ * The buffer manager may be used by several threads at once.  Each page
+ * table partition has its own latch, held while a page of the partition
+ * is looked up and pinned or brought in, frames are pinned and unpinned
+ * with atomic operations, and the statistics are counted in per-thread
+ * shards.  Pages are read through DB's asynchronous I/O, so a miss does
+ * not hold its partition latched for the read, and Prefetch can keep
+ * many reads in flight.
+ *
+ * The frames' pages are allocated together, in one arena aligned for
+ * direct I/O and backed by huge pages where the system allows, and the
+ * frames themselves, which hold only the pages' metadata, in an array
+ * of their own.
+ *
+ * A background writer cleans the frames the replacer will evict next,
+ * so a miss seldom has to write its victim first, and keeps the share
+ * of dirty frames under a target.  Threads dirtying pages are slowed
+ * down only while the pool is over that target.  FlushAllPages and
+ * the destructor must not run concurrently with anything else.
+ *
+ * In mapped mode the pool has no frames: the database is mapped into
+ * memory (see DB::IsMapped), PinPage returns the page in the mapping and
+ * the system's page cache is the only cache.  Pins are not counted, so
+ * UnpinPage only notes dirty pages.  Changed pages stay private to the
+ * process until FlushPage or FlushAllPages writes them.
+ *
+ * Optionally, TrackHeat has the pool count the pins, misses, evictions
+ * and writes of each page as well.  The files owning pages say so with
+ * SetPageOwner, and PrintHotPages reports the hottest pages and the
+ * totals of each file and tree level.
+ *
+ * A page in the pool can also be read without pinning it: ReadOptimistic
+ * finds the page without latching its partition and notes its frame's
+ * version, and Validate tells whether the frame changed since.  A reader
+ * copies what it needs from the page in between and starts over, or
+ * pins the page, if the copy is not valid.  Nothing is written on the
+ * way but the reader's own statistics, so threads descending the same
+ * index pages do not bounce their lines between cores.
+ *
+ * Pages are written back under the write-ahead log's rule: the log is
+ * made durable up to a page's LSN before the page is written, and a
+ * page held by an open log group is not written at all (see log.h).
+ * FlushAllPages, having written every page, empties the log.  The
+ * log's checkpoints take the dirty pages' recovery LSNs from the pool,
+ * and have it write those that have stayed dirty a whole checkpoint,
+ * so that the log behind them can be dropped.  A mapped pool has no
+ * writer and writes only when flushed, so it takes checkpoints only
+ * when asked to, and they do not move on past the oldest unflushed
+ * change.
+ *
+ * So that a restarted pool need not refill through random misses, the
+ * pages it holds can be listed in a file with SaveWarmList, at shutdown
+ * or from time to time, and read back in with WarmUp before the pool
+ * is put to use.
+ */
+
+const int BUF_STAT_SHARDS = 16;
+const size_t BUF_HUGE_PAGE = 2 << 20;	// arenas this big get huge pages
+
+const double BUF_DIRTY_TARGET = 0.5; 	// default share of dirty frames
+const int BUF_WRITER_INTERVAL = 10;		// ms between background sweeps
+
+const int BUF_HOT_PAGES = 10;			// pages in the default heat report
+
+const int BUF_RING_FRAMES = 16;			// default BufferStrategy ring
+
+/*
+ * A buffer access strategy: a small private ring of frames for one large
+ * sequential operation, such as a scan or a walk over a whole tree.  The
+ * pages the operation misses are read into the ring's frames in turn,
+ * each evicting the page read into it a lap before, so the operation
+ * uses a few frames of the pool instead of sweeping every other page out
+ * of it.  A frame that is pinned when its turn comes round, or whose
+ * page has gone, is left to the pool and another takes its place.  The
+ * ring is at most half the pool.  A strategy is for one thread at a
+ * time; pages that hit in the pool are not affected.
+ */
+
+class BufferStrategy
+{
+	friend class BufMgr;
+
+	private :
+
+		struct Slot {
+			int frame;				// INVALID_FRAME until first used
+			PageID pid;				// the page read into it
+		};
+		std::vector<Slot> ring;
+		int next;
+
+	public :
+
+		BufferStrategy( int numOfFrames = BUF_RING_FRAMES )
+			: ring(numOfFrames > 0 ? numOfFrames : 1), next(0)
+		{
+			for (size_t i = 0; i < ring.size(); i++)
+			{
+				ring[i].frame = INVALID_FRAME;
+				ring[i].pid = INVALID_PAGE;
+			}
+		}
+};
+
+// An optimistic read of a page, from BufMgr::ReadOptimistic.
+struct PageVersion
+{
+	Frame *frame;				// NULL in a mapped pool
+	unsigned int version;
+};
+
 class BufMgr 
 {
 	private:
 
 		/*
-		 * hashTable to give hash access to frames
+		 * pageTable maps the pages in the pool to their frames
 		 */
-		HashTable *hashTable;
+		PageTable *pageTable;
 		Frame **frames; 			// pool of frames
+
+		/*
+		 * What the frames are made of: the frames themselves, packed,
+		 * their read requests, and the arena holding their pages.
+		 */
+		Frame *frameStore;
+		IORequest *reads;
+		char *arena;
+		size_t arenaSize;
+		bool arenaMapped;			// from mmap rather than the heap
+
+		void AllocateArena();
+		void FreeArena();
 		
 		/*
 		 * Component responsible of implementing the buffer replacement policy 
 		 */
 		Replacer *replacer;
 		unsigned int numOfFrames;			// number of frames
+		int pageSize;						// bytes in each frame
 
-		int FindFrame( PageID pid );
-		long totalCall;				// number of times upper layers try to pin a page
-		long totalHit;		     	// number of times upper layers try to pin a page and the page is already in the buffer
+		/*
+		 * Pin counts, one shard per group of threads, each on its own
+		 * cache line so counting does not bounce a line between cores.
+		 */
+		struct StatShard {
+			std::atomic<long> totalCall;	// number of times upper layers try to pin a page
+			std::atomic<long> totalHit;		// number of times upper layers try to pin a page and the page is already in the buffer
+			std::atomic<long> optimistic;	// optimistic reads started
+			std::atomic<long> invalid;		// of those, found changed by Validate
+			char pad[64 - 4 * sizeof(std::atomic<long>)];
+		};
+		StatShard stats[BUF_STAT_SHARDS];
+
+		/*
+		 * How long pins take, those that hit and those that miss.  A
+		 * miss's victim search is timed by the replacer, and its read
+		 * by DB.
+		 */
+		LatencyHistogram pinHitLatency;
+		LatencyHistogram pinMissLatency;
+
+		std::atomic<int> prefetching;		// prefetch reads in flight
+
+		/*
+		 * Per-page heat, counted only while trackHeat is set, in shards
+		 * by page.  Owner names are kept once in owners, and pages point
+		 * at them.
+		 */
+		struct PageHeat {
+			long pins;
+			long misses;
+			long evictions;
+			long writes;			// dirty page written back
+			const std::string *owner;	// NULL if nobody claimed the page
+			int level;				// in the owner's tree, or -1
+		};
+		struct HeatShard {
+			std::mutex latch;
+			std::unordered_map<PageID, PageHeat> pages;
+		};
+		std::atomic<bool> trackHeat;
+		HeatShard heat[BUF_STAT_SHARDS];
+		std::mutex ownersLatch;
+		std::set<std::string> owners;
+
+		static PageHeat& HeatOf( HeatShard& shard, PageID pid );
+		void CountHeat( PageID pid, long PageHeat::*counter );
+		void CountEviction( PageID evicted, bool written );
+
+		/*
+		 * The background writer.  It wakes every BUF_WRITER_INTERVAL ms,
+		 * when misses have used up half the frames it last cleaned
+		 * ahead, or when a thread is throttled.  A sweep holds
+		 * sweepLatch; FlushAllPages takes it to keep the writer out.
+		 * The writer also takes the log's checkpoints, when the log
+		 * asks for one.
+		 */
+		std::atomic<int> numOfDirty;		// kept by the frames
+		std::atomic<int> dirtyLimit;		// the target, in frames
+		int lookahead;						// frames cleaned ahead of the replacer
+		std::atomic<int> missesSinceSweep;
+		std::atomic<bool> stalled;			// over target with nothing to write
+		std::atomic<long> backgroundWrites;
+		std::atomic<long> throttled;
+		bool stopWriter;
+		bool checkpointWanted;
+		std::mutex writerLatch;				// guards stopWriter and the waits
+		std::condition_variable writerWake;
+		std::condition_variable cleanedUp;
+		std::mutex sweepLatch;
+		std::thread writer;
+
+		/*
+		 * Mapped mode.  mappedDirty is the set of pages changed in the
+		 * mapping and not yet written, with their recovery LSNs (see
+		 * frame.h), 0 for pages with no logged change.
+		 */
+		bool mapped;
+		std::mutex mapLatch;				// guards mappedDirty
+		std::map<PageID, LSN> mappedDirty;
+
+		Status FlushMapped();
+
+		void WriterLoop();
+		void Sweep();
+		int  CleanFrames( const std::vector<int>& candidates, bool toTarget );
+		void WriteSorted( std::vector<int>& toWrite, std::vector<bool>& written );
+		void Throttle();
+
+		static int StatShardOf();
+
+		int RingVictim( BufferStrategy* strategy, PageID pid, PageID* evicted, bool* written );
+
+		Status WaitForRead( int f, PageID pid, Page*& page );
+		void ReadFailed( int f, PageID pid );
+
+		Frame* FrameOf( Page* page );
 
 	public:
 
-		BufMgr( unsigned int bufSize );
+		// In mapped mode bufSize and replacementPolicy are ignored, and
+		// the database must be opened mapped.
+		BufMgr( unsigned int bufSize, int pageSize = MINIBASE_PAGESIZE,
+		        const char* replacementPolicy = "Clock", bool mapped = false );
 		~BufMgr();      
-		Status PinPage( PageID pid, Page*& page, bool emptyPage = false );
+		// With a strategy, misses are read into its ring of frames.
+		Status PinPage( PageID pid, Page*& page, bool emptyPage = false,
+		                BufferStrategy* strategy = NULL );
 		Status UnpinPage( PageID pid, bool dirty = false );
+		Status Prefetch( PageID* pids, int n, BufferStrategy* strategy = NULL );
+
+		// Read page pid without a pin, if it is in the pool.  The page
+		// is good to read until Validate(version) says otherwise.
+		Status ReadOptimistic( PageID pid, const Page*& page, PageVersion& version );
+		bool Validate( const PageVersion& version );
 		Status NewPage( PageID& pid, Page*& firstPage, int howMany = 1 ); 
 		Status FreePage( PageID pid ); 
 		Status FlushPage( PageID pid );
 		Status FlushAllPages();
-		Status GetStat(long& pinNo, long& missNo) { pinNo = totalCall; missNo = totalCall-totalHit; return OK; }
+
+		// Write the pages in the pool to the file path, ranked: the
+		// pages in first, such as the roots and upper levels of indexes,
+		// then those the replacer found referenced, then the rest.  A
+		// mapped pool lists only first.
+		Status SaveWarmList( const char* path, const std::vector<PageID>* first = NULL );
+
+		// Read the pages listed in path back in, as many as there are
+		// free frames for, rank by rank and in PageID order within a
+		// rank, with asynchronous reads, and wait for them.  numOfPages
+		// is set to how many were read.
+		Status WarmUp( const char* path, int* numOfPages = NULL );
+
+		// For LogMgr: hold a pinned page in the pool while a log group
+		// changes it, then, once the group is appended at lsn, stamp it
+		// with lsn, in its frame and at stamp if given, mark it dirty and
+		// let it go.  The stamps are skipped if lsn is 0 or the frame no
+		// longer holds page pid.  from is where the log was when the
+		// group began, the page's recovery LSN unless it has an older.
+		void HoldForLog( Page* page, PageID pid, LSN from );
+		void ReleaseForLog( Page* page, PageID pid, LSN lsn, LSN* stamp );
+
+		// For LogMgr's checkpoints: list the pages with logged changes
+		// not yet written, with their recovery LSNs; write those changed
+		// first before lsn that nobody is using, as the background
+		// writer would; and have the background writer call
+		// LogMgr::Checkpoint.
+		void GetDirtyPages( std::vector< std::pair<PageID, LSN> >& dirty );
+		int  WriteOlderThan( LSN lsn );
+		void RequestCheckpoint();
+
+		// If pinned page pid has had logged changes unwritten since
+		// before lsn, make lsn its recovery LSN instead and return true;
+		// its caller logs it whole.
+		bool RenewRecLSN( Page* page, PageID pid, LSN lsn );
+
+		Status GetStat(long& pinNo, long& missNo);
+		Status GetStat(long& pinNo, long& missNo, double& hitRatio);
+		void GetOptimisticStat(long& reads, long& invalid);
+		const char* GetReplacementPolicy() { return mapped ? "none (mapped)" : replacer->GetName(); }
+		bool IsMapped() { return mapped; }
+
+		// The share of the pool's frames that may be dirty, 0 to 1.
+		void SetDirtyTarget( double ratio );
+		double GetDirtyRatio() { return numOfFrames ? (double)numOfDirty / numOfFrames : 0; }
 
 		unsigned int GetNumOfFrames();
+		int GetPageSize() { return pageSize; }
 		unsigned int GetNumOfUnpinnedFrames();
 
 		void PrintStat();
-		void ResetStat() { totalHit = 0; totalCall = 0; }
+		void ResetStat();
+
+		// Write the statistics, counters and latency histograms of the
+		// pool, its replacer and the database as one JSON object.
+		void WriteMetrics( std::ostream& os );
+
+		// Count each page's accesses, or stop; the counts so far stay
+		// until ResetStat.
+		void TrackHeat( bool on ) { trackHeat = on; }
+		bool IsTrackingHeat() { return trackHeat; }
+
+		// Attribute page pid to a file and, for a tree, a level, in the
+		// heat report.
+		void SetPageOwner( PageID pid, const char* file, int level = -1 );
+
+		// Print the n pages pinned most, then the counts of each owner
+		// and level.
+		void PrintHotPages( int n = BUF_HOT_PAGES );
 };
 
 #endif // _BUF_H
@@ -0,0 +1,32 @@
+#ifndef _CODECTEST_H
+#define _CODECTEST_H
+
+#include <random>
+
+#include "minirel.h"
+
+//
+// A test of the page codec of compressed databases, run from the driver.
+// Pages of every size, of kinds a database holds and of random bytes,
+// are compressed and decompressed again, and must come back exactly; a
+// page that does not shrink must be reported so.  A compressed page cut
+// short must be turned down, or come back whole, and one with a byte
+// changed must not be decompressed past the page.
+//
+
+class CodecTest {
+
+public:
+
+	// Return OK if every page came back.
+	Status Run(int pages);
+
+private:
+
+	std::mt19937 rng;
+
+	void Fill(char* page, int pageSize, int kind);
+	bool RoundTrip(const char* page, int pageSize, bool& shrank);
+};
+
+#endif // _CODECTEST_H
@@ -0,0 +1,39 @@
+#ifndef _CONCURRENCYTEST_H
+#define _CONCURRENCYTEST_H
+
+#include <atomic>
+
+#include "btfile.h"
+
+//
+// A test of the buffer pool, the log and B+ trees under concurrent use,
+// run from the driver in its open database.  Each of nThreads threads
+// inserts keys keys, in a shuffled order, into a B+ tree of its own and
+// scans it every so often; then it deletes every other key and scans it
+// again, in parallel.  While they insert, another thread flushes the leaf
+// each has just changed, so that writes race with its next pins, and the
+// background writer cleans the pool.  A scan checks that it finds exactly
+// the keys its thread has in the tree, in order.
+//
+
+class ConcurrencyTest {
+
+public:
+
+	// Return OK if no thread found an error.
+	Status Run(int nThreads, int keys);
+
+private:
+
+	std::atomic<int>  errors;
+	std::atomic<int>  inserting;				// workers still inserting
+	std::atomic<bool> done;						// the flusher has stopped
+	std::vector< std::atomic<PageID> > leaves;	// for the flusher, by thread
+
+	void Worker(int t, int keys, BTreeFile* btf);
+	void Flusher();
+	bool Check(BTreeFile* btf, int t, const std::vector<bool>& present,
+	           int count, int scanThreads);
+};
+
+#endif // _CONCURRENCYTEST_H
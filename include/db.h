@@ -8,8 +8,17 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "page.h"
+#include "asyncio.h"
+#include "latency.h"
 
 // Each database is basically a UNIX file and consists of several relations
 // (viewed as heapfiles and their indexes) within it.
@@ -19,6 +28,9 @@
 
   // This is the maximum length of the name of a "file" within a database.
 const int MAX_NAME = 50;
+
+  // A compressed database's pages take slots of whole units this long.
+const unsigned PACK_UNIT = 64;
   
 
 enum dbErrCodes {
@@ -30,6 +42,8 @@ enum dbErrCodes {
     FILE_NOT_FOUND,
     FILE_NAME_TOO_LONG,
     NEG_RUN_SIZE,
+    BAD_PAGE_SIZE,
+    BAD_IO_MODE,
 };
 
 // oooooooooooooooooooooooooooooooooooooo
@@ -38,12 +52,55 @@ class DB {
 
   public:
     // Constructors
-    // Create a database with the specified number of pages where the page
-    // size is the default page size.
-    DB( const char* name, unsigned num_pages, Status& status );
-
-    // Open the database with the given name.
-    DB( const char* name, Status& status );
+    // Create a database with the specified number of pages.  The page
+    // size must be a power of two between MINIBASE_MIN_PAGESIZE and
+    // MINIBASE_MAX_PAGESIZE; it is stored on the first page and fixed
+    // for the life of the database.  The file is accessed as mode
+    // says (see DBIOMode in system_defs.h).
+    DB( const char* name, unsigned num_pages, Status& status,
+        unsigned page_size = MINIBASE_PAGESIZE, DBIOMode mode = DB_BUFFERED );
+
+    // Open the database with the given name.  A database created
+    // compressed stays so, and is opened buffered whatever mode says,
+    // except that it cannot be mapped.
+    DB( const char* name, Status& status, DBIOMode mode = DB_BUFFERED );
+
+    // A direct database is read and written with O_DIRECT, so the pages
+    // are not cached by the system as well as by the buffer pool.  The
+    // buffers passed to it must be aligned for O_DIRECT, as the pool's
+    // frames are; 4 KB always does.  If the file system or the page size
+    // does not allow direct I/O the database falls back to buffered I/O.
+    bool IsDirect() const;
+
+    // A mapped database also maps its file into memory, copy-on-write,
+    // for a buffer manager in mapped mode to serve pages from.  Changes
+    // to the mapping stay private to the process until they are written
+    // with WritePage(s), and RemapPages then drops the private copies.
+    bool IsMapped() const;
+
+    // The page in the mapping, or NULL if the database is not mapped or
+    // there is no such page.
+    Page* GetMappedPage(PageID pageno);
+
+    // Ask the system to read n mapped pages from start ahead.
+    void PrefetchMapped(PageID start, int n);
+
+    // Drop the private copies of n mapped pages from start, which must
+    // have been written, so that they share the file's pages again.
+    // Neighbouring pages in the same memory page are dropped too.
+    Status RemapPages(PageID start, int n);
+
+    // A compressed database keeps its pages, after the first,
+    // compressed in slots of whole PACK_UNITs that are only as long as
+    // they need to be, packed one after another, and a page map saying
+    // where each page's slot is.  A page is written to a new slot, and
+    // the map then pointed at it, so a page on disk is never half old
+    // and half new.
+    bool IsCompressed() const;
+
+    // How many pages a compressed database has written, and how many
+    // bytes of slots they take.
+    void GetCompressedSize( unsigned& pages, size_t& bytes );
 
     // Destructor: closes the database
    ~DB();
@@ -57,6 +114,35 @@ class DB {
     // Write the contents of the specified page.
     Status WritePage(PageID pageno, Page* pageptr);
 
+    // Write n pages to the consecutive page numbers from start, with
+    // as few vectored writes as it takes.
+    Status WritePages(PageID start, Page** pages, int n);
+
+    // Start reading or writing the specified page without waiting for
+    // it; req completes later on an I/O thread (see asyncio.h).  Up to
+    // ASYNC_IO_DEPTH requests can be in flight at once.  On an error req
+    // is complete already, with status FAIL.
+    Status ReadPageAsync(PageID pageno, Page* pageptr, IORequest& req);
+    Status WritePageAsync(PageID pageno, Page* pageptr, IORequest& req);
+
+    // WritePages as one asynchronous request; n is at most
+    // ASYNC_IO_MAX_IOV.
+    Status WritePagesAsync(PageID start, Page** pages, int n, IORequest& req);
+
+    // Make the pages written so far durable, and in a compressed
+    // database the page map too, which the writes only hand to the
+    // system.  A checkpoint does so before giving up the log for them.
+    Status Sync();
+
+    // The asynchronous I/O backend in use: "io_uring" or "threads".
+    const char* GetIOBackend();
+
+    // How long reads and writes take, synchronous and asynchronous
+    // alike, one count per call or request.
+    const LatencyHistogram& GetReadLatency() const { return read_latency; }
+    const LatencyHistogram& GetWriteLatency() const { return write_latency; }
+    void ResetLatency();
+
     // Allocate a set of pages where the run size is taken to be 1 by default.
     // Gives back the page number of the first page of the allocated run.
     Status AllocatePage(PageID& start_page_num, int run_size = 1);
@@ -65,6 +151,11 @@ class DB {
     // a run size can be specified.
     Status DeallocatePage(PageID start_page_num, int run_size = 1);
 
+    // Catch up with the pages after restart has redone the log on them:
+    // what the database keeps of them in memory, its free runs and file
+    // directory, was read before.
+    Status Recovered();
+
 
     // oooooooooooooooooooooooooooooooooooooo
 
@@ -82,6 +173,14 @@ class DB {
     int GetNumOfPages() const;
     int GetPageSize() const;
 
+    // Read the page size of an existing database from its first page,
+    // without opening it.  The buffer manager must be sized before the
+    // database is opened through it.
+    static Status ReadPageSize(const char* name, unsigned& page_size);
+
+    // True if page_size is a page size a database can be created with.
+    static bool ValidPageSize(unsigned page_size);
+
     // Print out the space map of the database.
     // The space map is a bitmap showing which
     // pages of the db are currently allocated.
@@ -90,23 +189,83 @@ class DB {
   private:
     int fd;
     unsigned num_pages;
+    unsigned page_size;
+    unsigned bits_per_page;     // Space map bits held by one map page.
     char* name;
+    AsyncIO* aio;
+    char* map;                  // The mapped file, or NULL.
+    size_t map_size;
+    bool direct;                // O_DIRECT is set on fd.
+    bool packed;                // The pages are compressed.
+    LatencyHistogram read_latency;
+    LatencyHistogram write_latency;
+
+      // Serializes space map and directory updates between threads.
+      // Recursive, as adding a directory page allocates one.  Each
+      // update is a log group of its own, committed before the latch
+      // is let go, so the log has the updates in the order they were
+      // made; the bytes they log would not replay right otherwise.
+    std::recursive_mutex latch;
+
+      // The free runs of pages in the space map, by first page, and by
+      // length and then first page, so that the shortest run that fits
+      // an allocation is found without scanning the map.  Built from the
+      // map when the database is opened and kept in step by set_bits.
+    std::map<PageID, unsigned> free_runs;
+    std::set< std::pair<unsigned, PageID> > free_by_size;
+
+      // Where a compressed page's slot is: its first unit in the data
+      // area, and its length in bytes, 0 if the page was never written
+      // and page_size if it did not compress and is kept as it is.
+    struct pack_entry {
+        unsigned unit;
+        unsigned len;
+    };
+
+      // The page map, as on disk, and the free units of the data area,
+      // by first unit and by length and then first unit, as for
+      // free_runs.  pack_end is the unit past the last slot, where the
+      // area grows when no free run fits.  Built from the page map when
+      // the database is opened; the latch guards them all.
+    std::vector<pack_entry> pack_map;
+    std::map<unsigned, unsigned> pack_free;
+    std::set< std::pair<unsigned, unsigned> > pack_free_by_size;
+    unsigned pack_end;
+    off_t pack_base;            // Where the data area starts in the file.
+    std::mutex pack_latch;
 
     struct file_entry {
         PageID pagenum;         // INVALID_PAGE if no entry.
         char   fname[MAX_NAME];
     };
 
+      // Where a file's entry is in the directory, and the page it names.
+    struct dir_slot {
+        unsigned index;         // Of its page in dir_pages.
+        int      slot;
+        PageID   start_page;
+    };
+
+      // The directory's files by name, its pages in chain order and its
+      // free slots, by page in that order and then slot, so that a file
+      // is found, added or deleted without walking the directory pages.
+      // Built from the pages when the database is opened and kept in
+      // step with them by AddFileEntry and DeleteFileEntry.
+    std::unordered_map<std::string, dir_slot> dir_index;
+    std::vector<PageID> dir_pages;
+    std::set< std::pair<unsigned, int> > dir_free;
+
     struct directory_page {
         PageID     next_page;
         unsigned   num_entries;
-        file_entry *entries;  // Variable-sized struct
-//      file_entry entries[0];  // Variable-sized struct
+        file_entry entries[1];  // Variable-sized struct; fills the page.
     };
 
       // A first_page structure appears on the first page of the database.
     struct first_page {
         unsigned int   num_db_pages; // How big the database is.
+        unsigned int   page_size;    // Size of every page, in bytes.
+        unsigned int   compressed;   // Nonzero if the pages are packed.
         directory_page dir;          // The first directory page.
     };               
 
@@ -118,21 +277,82 @@ class DB {
 
          Page 0 of the database is reserved for a special structure
          that holds global information about the database, like the
-         number of pages in the database.  Following this information is
-         the first "directory page".  A directory page is where the DB
-         keeps track of the files created within the database.
+         number and size of the pages in the database.  Following this
+         information is the first "directory page".  A directory page is
+         where the DB keeps track of the files created within the database.
 
          Page 1 of the database, and as many subsequent pages as needed,
          holds the "space map," which is a bitmap representing pages
          allocated in the database.
+
+         A compressed database keeps page 0 where it is, and follows it
+         with the page map, one pack_entry per page, and then the data
+         area, where the other pages' slots are.
      */
 
 
+      // Map the whole file, as it is now.
+    Status map_file();
+
+      // Switch fd to O_DIRECT, if a direct read of the first page works.
+    void set_direct();
+
+      // Set up the access mode once the file is open and sized.
+    Status set_mode( DBIOMode mode );
+
+      // Read the page map and rebuild the free units from it.
+    Status load_pack_map();
+
+      // Take units units of the data area, or give them back; the
+      // latch must be held.
+    unsigned pack_take( unsigned units );
+    void pack_release( unsigned unit, unsigned units );
+
+      // Compress n pages into buf, each in a slot of its own after the
+      // last, their lengths in lens.  Returns the units they take.
+    unsigned pack_pages( Page** pages, int n, char* buf, unsigned* lens );
+
+      // Point the map at the slots of n pages from start, packed from
+      // unit by pack_pages, and free their old ones; or, if whole is
+      // false, the write failed, give the new slots back.
+    bool pack_commit( PageID start, int n, unsigned unit, const unsigned* lens,
+                      bool whole );
+
+      // ReadPage, WritePages, ReadPageAsync and WritePagesAsync for a
+      // compressed database.
+    Status pack_read( PageID pageno, Page* pageptr );
+    Status pack_write( PageID start, Page** pages, int n );
+    Status pack_read_async( PageID pageno, Page* pageptr, IORequest& req );
+    Status pack_write_async( PageID start, Page** pages, int n, IORequest& req );
+
       // Set runsize bits starting from start to value specified
     Status set_bits( PageID start, unsigned runsize, int bit );
 
+      // Rebuild free_runs and free_by_size from the space map.
+    Status load_free_runs();
+
+      // Take a run of pages out of the free runs, or put it back in,
+      // merging it with its neighbours.
+    void mark_used( PageID start, unsigned runsize );
+    void mark_free( PageID start, unsigned runsize );
+
       // Initializes the given directory page to contain no entries.
     void init_dir_page( directory_page* dp, unsigned used_bytes );
+
+      // The directory page pgid, pinned at pg.
+    directory_page* dir_page( PageID pgid, Page* pg );
+
+      // Rebuild dir_index, dir_pages and dir_free from the directory.
+    Status load_directory();
+
+      // Add an empty directory page at the end of the chain.
+    Status add_dir_page();
+
+      // Log len bytes at at, on page pgid pinned at pg, as changed.
+    void log_change( PageID pgid, Page* pg, const void* at, unsigned len );
+
+      // Find the entry of file fname, or NULL if there is no such file.
+    const dir_slot* find_file_entry( const char* fname );
 };
 
 // oooooooooooooooooooooooooooooooooooooo
@@ -1,42 +1,129 @@
 #ifndef FRAME_H
 #define FRAME_H
 
+#include <atomic>
+#include <functional>
+
 #include "page.h"
+#include "asyncio.h"
+#include "log.h"
 
 #define INVALID_FRAME -1
 
-class Frame 
+//
+// A buffer pool frame.  The pin count, reference bit and dirty flag are
+// atomic so pins and unpins from different threads need no latch.
+//
+// A replacer that wants a frame first claims it by moving its pin count
+// from 0 to CLAIMED; a claimed frame cannot be claimed again, and a pin
+// taken while it is claimed shows up as a count above CLAIMED, so the
+// replacer can tell that the page is in use after all and back off.
+//
+// A frame holds only the page's metadata, packed into one cache line
+// so that a clock sweep touches one line per frame and pins of
+// different frames never share a line.  The page itself lives in the
+// pool's arena, and the frame's read request alongside it.
+//
+// A page is read in asynchronously.  The frame is entered in the page
+// table as soon as the read is marked, and whoever pins it meanwhile
+// waits in WaitRead() for the read to complete.
+//
+// The background writer writes a claimed frame back while it stays in
+// the pool.  It marks the frame as being written and then checks that
+// nobody pinned it first; whoever pins it afterwards sees the mark and
+// waits in WaitWritten(), so the page is not changed under the write.
+//
+// A page can also be read optimistically, without a pin.  The frame's
+// version changes whenever its pin count leaves 0, as it must before
+// the page is changed, evicted or replaced, and whenever the frame
+// takes or loses a page.  A reader notes the version while the frame is
+// unpinned, copies what it needs from the page and keeps the copy only
+// if the version is still the same.
+//
+// A page changed by an open log group is held: it cannot be claimed,
+// and so is neither evicted nor written, until the group is appended
+// to the log.  Replacers pass it over as they do a pinned one.  The
+// frame's LSN is then that of the last group to change the page, and
+// the log must be durable up to it before the page is written (see
+// log.h).
+//
+// The frame also keeps the page's recovery LSN: where the log was when
+// a group first changed the page since it was last written.  Restart
+// needs the log from there on to bring the page back.
+//
+
+const int FRAME_ALIGN = 64;		// a cache line
+
+class alignas(FRAME_ALIGN) Frame 
 {
 	private :
 	
-		PageID pid;
-		Page   *data;
-		int    pinCount;
-		int    dirty;
-		bool   referenced;
+		std::atomic<PageID> pid;
+		std::atomic<int>  pinCount;
+		std::atomic<bool> dirty;
+		std::atomic<bool> referenced;
+		std::atomic<bool> writing;		// being written back by its claimer
+		Page   *data;		// pageSize bytes, not a whole Page
+		IORequest *io;		// the read bringing the page in
+		std::atomic<int> *dirtyCount;	// the pool's count of dirty frames
+		std::atomic<unsigned int> version;
+		std::atomic<int> holds;			// log groups holding the page
+		std::atomic<LSN> lsn;			// 0 if the page was not logged
+		std::atomic<LSN> recLSN;		// 0 if no logged change is unwritten
+
+		void Changed();
 
 	public :
+
+		static const int CLAIMED = 1 << 24;
 		
-		Frame();
-		~Frame();
+		Frame(Page *data, IORequest *io, std::atomic<int> *dirtyCount = NULL);
 		void Pin();
 		void Unpin();
 		void EmptyIt();
 		void DirtyIt();
+		bool Clean();
 		void SetPageID(PageID pid);
 		bool IsDirty();
 		bool IsValid();
 		Status Write();
-		Status Read(PageID pid);
-		Status Free();
+		void MarkRead(PageID pid, std::function<void(IORequest*)> callback = nullptr);
+		Status StartRead();
+		Status WaitRead() { return io->Wait(); }
+		bool ReadDone() { return io->IsDone(); }
+		bool StartWriting();
+		void EndWriting() { writing = false; }
+		void WaitWritten();
+		void Free();
 		bool NotPinned();
+		bool Evictable() { return pinCount == 0 && holds == 0; }
+		int  GetPinCount() { return pinCount; }
 		bool HasPageID(PageID pid);
 		PageID GetPageID();
 		Page *GetPage();
 
+		bool TryClaim();
+		void Release() { pinCount -= CLAIMED; }
+		void ClaimToPin() { pinCount = 1; }
+		void DropPins() { pinCount = 0; }
+
+		void Hold() { holds++; }
+		void Unhold() { holds--; }
+		bool IsHeld() { return holds != 0; }
+		void SetLSN(LSN lsn);
+		LSN  GetLSN() { return lsn; }
+		void SetRecLSN(LSN lsn);
+		bool RenewRecLSN(LSN lsn);
+		void ForgetRecLSN() { recLSN = 0; }
+		LSN  GetRecLSN() { return recLSN; }
+
+		bool StartOptimistic(PageID pid, unsigned int& version);
+		bool Validate(unsigned int version);
+
 		void UnsetReferenced();
 		bool IsReferenced();
+		bool ClearReferenced() { return referenced.exchange(false); }
 		bool IsVictim();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,79 +1,95 @@
 #ifndef _HASH_H
 #define _HASH_H
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 #include "minirel.h"
 #include "frame.h"
 
-#define NUM_OF_BUCKETS 21
-#define HASH(k)  k % NUM_OF_BUCKETS
 
-	
-class Map
+/**
+ * A map from page ids to frames: an open-addressing table of (page,
+ * frame) pairs with linear probing, kept at most half full so a lookup
+ * usually reads one cache line.  It starts with room for the number of
+ * pages it is expected to hold and doubles if it ever needs more, so
+ * inserts do not allocate.  Deletion shifts later entries of the probe
+ * run back instead of leaving tombstones.  Not thread-safe; see
+ * PageTable.  The one exception is LookUpUnlatched, which is safe
+ * against writers but may be wrong: the slots are atomic, and arrays
+ * outgrown are kept until the table goes, for readers still in them.
+ */
+class HashTable
 {
-	friend class MapIterator;
-
-private :
-
-	int pid;
-	int frameNo;
-	class Map *next;
-	class Map *prev;
-
-public :
-	
-	Map(PageID p, int f);
-	~Map();
-	void AddBehind(Map *m);
-	void DeleteMe();
-	bool HasPageID(PageID p);
-	int FrameNo();
+private:
 
-};
+	struct Entry {
+		std::atomic<PageID> pid;		// INVALID_PAGE if the slot is empty
+		std::atomic<int>    frameNo;
+	};
 
+	std::atomic<Entry*> slots;
+	std::atomic<unsigned int> mask;		// number of slots - 1, a power of two minus one
+	unsigned int count;		// entries in use
+	std::vector<Entry*> outgrown;
 
-class MapIterator
-{
-	Map *head;		// not used?
-	Map *current;
+	static unsigned int Home(PageID pid, unsigned int m);
+	void Grow();
 
 public :
 
-	MapIterator(Map *maps);
-	Map* operator() ();
+	HashTable(int capacity);
+	~HashTable();
+
+	void Insert(PageID pid, int frameNo);
+	Status Delete(PageID pid);
+	int LookUp(PageID pid);
+	void EmptyIt();
 
+	// LookUp without the partition latch.  A page being inserted or
+	// moved may be missed, and the frame returned may no longer hold
+	// the page; the caller checks the frame.
+	int LookUpUnlatched(PageID pid);
 };
 
 
-class Bucket
-{
-private:
+/**
+ * The buffer pool's page table, mapping the id of each page in the pool
+ * to its frame.  Pages are spread over PAGE_TABLE_PARTITIONS HashTables
+ * by a hash of their id, each guarded by its own latch, so threads
+ * working on different pages rarely wait for each other.  Callers lock
+ * a page's partition around any use of its table.
+ */
 
-	Map *maps;
+const int PAGE_TABLE_PARTITIONS = 16;	// a power of two
 
+class PageTable
+{
 public :
 
-	Bucket();
-	~Bucket();
-	void Insert(PageID pid, int frameNo);
-	Status Delete(PageID pid);
-	int Find(PageID pid);
-	void EmptyIt();
-};
+	struct Partition {
+		std::mutex latch;
+		HashTable *table;
+	};
 
+	PageTable(int numOfFrames);
+	~PageTable();
 
-class HashTable
-{
-private:
+	Partition& Of(PageID pid) { return partitions[PartitionOf(pid)]; }
+	Partition& Get(int i) { return partitions[i]; }
 
-	Bucket buckets[NUM_OF_BUCKETS];
+private :
 
-public :
+	Partition partitions[PAGE_TABLE_PARTITIONS];
 
-	void Insert(PageID pid, int frameNo);
-	Status Delete(PageID pid);
-	int LookUp(PageID pid);
-	void EmptyIt();
+	// Top bits of a multiplicative hash, independent of the low bits
+	// HashTable probes with.
+	static int PartitionOf(PageID pid)
+	{
+		return ((unsigned int)pid * 2654435769u) >> 28;
+	}
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,113 @@
+#ifndef _HEAPFILE_H
+#define _HEAPFILE_H
+
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+#include "heappage.h"
+
+class HeapFileScan;
+
+//
+// A file of variable-length records stored in HeapPages.  The data pages
+// form a doubly linked list, which scans follow.  The file also keeps a
+// free-space map: the header page points to a chain of map pages that
+// record how many bytes each data page has free.  Opening the file loads
+// the map into FSM_BINS bins by free space, so an insert picks a page
+// from the first bin whose pages all have room and never reads a data
+// page to find one.  Deleted slots are reused by later inserts on the
+// same page, and a data page that becomes empty is freed.
+//
+// Every change is logged as the bytes changed, one group per operation,
+// so the file comes back whole on restart like the B+ tree files do.
+//
+
+const int FSM_BINS = 16;
+const int HEAPFILE_SCAN_BATCH = 8;	// data pages a scan pins at a time
+
+class HeapFile {
+
+public:
+
+	friend class HeapFileScan;
+
+	HeapFile(Status& status, const char* filename);
+	~HeapFile();
+
+	Status DestroyFile();
+
+	Status InsertRecord(char* recPtr, int recLen, RecordID& rid);
+	Status DeleteRecord(const RecordID& rid);
+	Status UpdateRecord(const RecordID& rid, char* recPtr, int recLen);
+	Status GetRecord(const RecordID& rid, char* recPtr, int& recLen);
+
+	HeapFileScan* OpenScan(int batchSize = HEAPFILE_SCAN_BATCH);
+
+	int GetNumOfRecords();
+	int GetNumOfPages();
+
+private:
+
+	// One free-space map entry per data page; pid is INVALID_PAGE if
+	// the entry is unused.
+	struct FSMEntry {
+		PageID pid;
+		int    freeSpace;	// HeapPage::AvailableSpace() of the page
+	};
+
+	struct HeapFileHeaderPage {
+		PageID firstPage;		// first data page, or INVALID_PAGE
+		PageID lastPage;		// last data page, or INVALID_PAGE
+		PageID fsmPage;			// first free-space map page
+		int    numOfRecords;
+	};
+
+	struct FreeSpaceMapPage {
+		PageID   nextPage;		// next map page, or INVALID_PAGE
+		int      numOfEntries;	// entries handed out so far
+		FSMEntry entries[1];	// Variable-sized; fills the page.
+	};
+
+	// Where a data page's map entry lives, and which bin it is in.
+	struct PageInfo {
+		PageID fsmPage;
+		int    entry;
+		int    freeSpace;
+		int    bin;
+		int    binPos;			// index of the page in bins[bin]
+	};
+
+	struct FSMSlot {
+		PageID fsmPage;
+		int    entry;
+	};
+
+	char* fileName;
+	PageID headerID;
+	HeapFileHeaderPage* header;
+	std::mutex headerLatch;		// held by changes to the header, see LogMgr::Keep
+
+	std::unordered_map<PageID, PageInfo> pageInfo;
+	std::vector<PageID> bins[FSM_BINS];
+	std::vector<FSMSlot> unusedEntries;
+	PageID lastFSMPage;
+
+	static int FSMCapacity();
+	static int BinOf(int freeSpace);
+	static void Logged(PageID pid, void* page, const void* p, int len);
+
+	void   RefreshHeader();
+	void   KeepHeader();
+
+	Status LoadFreeSpaceMap();
+	Status FindPage(int recLen, PageID& pid);
+	Status AddDataPage(PageID& pid);
+	Status RemoveDataPage(PageID pid, HeapPage* page);
+	Status SetFreeSpace(PageID pid, int freeSpace);
+	Status SetFSMEntry(const FSMSlot& slot, PageID pid, int freeSpace);
+	void   BinInsert(PageID pid, PageInfo& info);
+	void   BinRemove(PageInfo& info);
+};
+
+#endif // _HEAPFILE_H
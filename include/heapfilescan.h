@@ -0,0 +1,46 @@
+#ifndef _HEAPFILE_SCAN_H
+#define _HEAPFILE_SCAN_H
+
+#include <vector>
+
+#include "heapfile.h"
+#include "bufmgr.h"
+
+//
+// A sequential scan of a HeapFile.  Rather than pinning and unpinning a
+// page for every record, the scan pins the next batch of data pages in
+// list order, returns every record on them, and then releases the whole
+// batch.  The pages are read through a ring of two batches' frames, so
+// a scan of a large file does not flush the buffer pool.  Records must
+// not be deleted from the file while it is open.
+//
+
+class HeapFileScan {
+
+public:
+
+	friend class HeapFile;
+
+	~HeapFileScan();
+
+	Status GetNext(RecordID& rid, char* recPtr, int& recLen);
+
+private:
+
+	HeapFileScan(HeapFile* file, int batchSize);
+
+	Status PinBatch(PageID first);
+	Status UnpinBatch();
+
+	HeapFile* file;
+	int batchSize;
+	std::vector<PageID> batchIDs;		// pinned pages, in list order
+	std::vector<HeapPage*> batchPages;
+	int curPage;						// index into the batch
+	RecordID curRid;
+	bool scanStarted;
+	bool scanFinished;
+	BufferStrategy strategy;
+};
+
+#endif // _HEAPFILE_SCAN_H
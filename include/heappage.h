@@ -1,6 +1,8 @@
 #ifndef HFPAGE_H
 #define HFPAGE_H
 
+#include <cstddef>
+
 #include "minirel.h"
 #include "page.h"
 
@@ -8,8 +10,10 @@ const int INVALID_SLOT =  -1;
 
 //
 // CHANGE this constant whenever you update the structure of HeapPage class.
+// It is the data area of the largest page; HeapPage::DataSize() is the
+// data area of a page of the open database.
 //
-const int HEAPPAGE_DATA_SIZE = (MAX_SPACE - 3 * sizeof(PageID) - 6 * sizeof(short));
+const int HEAPPAGE_DATA_SIZE = (MAX_SPACE - 3 * sizeof(PageID) - 5 * sizeof(int) - 2 * sizeof(short));
 
 class HeapPage {
 
@@ -17,16 +21,16 @@ protected :
 
 	struct Slot 
 	{
-		short offset;    // offset of record from the start of dataarea.
-		short length;    // length of the record.
+		int offset;      // offset of record from the start of dataarea.
+		int length;      // length of the record.
 	};
 
 
-	short   numOfSlots;  // Number of slots available (maybe filled or
+	int     numOfSlots;  // Number of slots available (maybe filled or
 	                     // empty).
-	short   fillPtr;     // Offset from start of data area, where 
+	int     fillPtr;     // Offset from start of data area, where 
 	                     // the records resides.
-	short   freeSpace;   // Amount of free space in bytes in this page.
+	int     freeSpace;   // Amount of free space in bytes in this page.
 	
 	short   type;        // Not used for HeapFile assignment, but will 
 	                     // be used in B+-tree assignment.
@@ -35,9 +39,9 @@ protected :
 	PageID  nextPage;    // Page ID of the next page in a link list.
 	PageID  prevPage;    // Page ID of the prev page in a link list.
 
-	Slot    slots[1];    // Slots for the page.  May grow towards
-						 // the end of a page.  (May overflow into
-						 // the data area.)
+	Slot    firstSlot;   // First slot for the page.  The slots grow
+						 // towards the end of a page, overflowing
+						 // into the data area; see Slots().
 
 	char data[HEAPPAGE_DATA_SIZE];
 
@@ -47,10 +51,20 @@ protected :
 
 	void CompactSlotDir();
 
+	// The slot directory, from firstSlot on.  Its address is taken from
+	// the page's bytes, as it runs past the one slot declared for it.
+	Slot* Slots() { return (Slot *)((char *)this + offsetof(HeapPage, firstSlot)); }
+
 public:
 
 	void Init(PageID pageNo);
 
+	// Logs a change to the len bytes at p, if there is a log.  The
+	// page's own methods log what they change.
+	void Logged(const void* p, int len);
+
+	static int DataSize();
+
 	PageID GetNextPage();
 	PageID GetPrevPage();
 	PageID PageNo() { return pid; }
@@ -74,6 +88,8 @@ public:
 
 #define PIN(a, b)   if (MINIBASE_BM->PinPage((a), (Page *&)(b)) != OK) {\
 						cerr << "Unable to pin page " << a << endl; return FAIL; }
+#define PIN_USING(a, b, s) if (MINIBASE_BM->PinPage((a), (Page *&)(b), false, (s)) != OK) {\
+						cerr << "Unable to pin page " << a << endl; return FAIL; }
 #define UNPIN(a, b) if (MINIBASE_BM->UnpinPage((a), (b)) != OK) {\
 						cerr << "Unable to unpin page " << a << endl; return FAIL; }
 #define FREEPAGE(a) if (MINIBASE_BM->FreePage((a)) != OK) {\
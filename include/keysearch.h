@@ -0,0 +1,32 @@
+#ifndef KEY_SEARCH_H
+#define KEY_SEARCH_H
+
+//
+// Search kernels for a sorted array of int keys, as kept at the start
+// of a B+ tree node.  Each call narrows the range by binary search and
+// then finishes with a vector compare-and-count, which takes 4 (SSE2)
+// or 8 (AVX2) keys per instruction.  The kernel is picked at start-up
+// from the CPU features; KeySearchSetKernel can force one.
+//
+
+enum KeySearchKernel {
+	KEYSEARCH_SCALAR,
+	KEYSEARCH_SSE2,
+	KEYSEARCH_AVX2
+};
+
+// Index of the first key >= key (LowerBound) or > key (UpperBound)
+// in keys[0..n), or n if there is none.
+
+int KeySearchLowerBound(const int* keys, int n, int key);
+int KeySearchUpperBound(const int* keys, int n, int key);
+
+KeySearchKernel KeySearchGetKernel();
+const char* KeySearchKernelName(KeySearchKernel kernel);
+
+// Use the given kernel from now on.  Returns false, and leaves the
+// kernel unchanged, if this CPU does not support it.
+
+bool KeySearchSetKernel(KeySearchKernel kernel);
+
+#endif
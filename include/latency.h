@@ -0,0 +1,60 @@
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <atomic>
+#include <ostream>
+
+//
+// A histogram of latencies with power-of-two buckets: bucket i counts
+// the times from 2^i up to 2^(i+1) nanoseconds, the first also those
+// shorter.  Recording is a few relaxed atomic adds on one of several
+// shards, picked by thread, so threads timing the same operation do not
+// bounce one cache line between them.  Percentiles are read back to
+// within a factor of two, which is what tail latency needs.
+//
+
+const int LATENCY_BUCKETS = 40;		// up to 2^40 ns, about 18 minutes
+const int LATENCY_SHARDS = 8;
+
+class LatencyHistogram
+{
+	private :
+
+		// Padded to whole cache lines, as BufMgr's StatShards are.
+		struct Shard {
+			std::atomic<long> buckets[LATENCY_BUCKETS];
+			std::atomic<long> count;
+			std::atomic<long> total;		// ns
+			std::atomic<long> max;			// ns
+			char pad[64 - (LATENCY_BUCKETS + 3) * sizeof(long) % 64];
+		};
+		Shard shards[LATENCY_SHARDS];
+
+	public :
+
+		LatencyHistogram();
+
+		// The current time, in ns, to be passed to Record.
+		static long Now();
+
+		// Count an operation that took ns nanoseconds.
+		void Record( long ns );
+		void RecordSince( long start ) { Record(Now() - start); }
+
+		void Reset();
+
+		long GetCount() const;
+		double GetMean() const;		// ns, 0 if none
+		long GetMax() const;
+
+		// The latency, in ns, that the fraction p of the operations did
+		// not exceed: the upper bound of the bucket holding it.
+		long GetPercentile( double p ) const;
+
+		// {"count":..,"mean_ns":..,"p50_ns":..,"p90_ns":..,"p99_ns":..,
+		//  "p999_ns":..,"max_ns":..,"buckets":[..]}, with the buckets
+		// trimmed after the last one in use.
+		void WriteJSON( std::ostream& os ) const;
+};
+
+#endif // _LATENCY_H
@@ -0,0 +1,279 @@
+#ifndef _LOG_H
+#define _LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "minirel.h"
+#include "page.h"
+#include "latency.h"
+
+//
+// The write-ahead log.  Changes to B+ tree nodes are logged as compact
+// records of what was done to the node, such as "entry inserted" or
+// "next page set", and changes to other pages (the space map, the file
+// directory, B+ tree header pages and heap files) as the bytes changed.
+//
+// Records are collected in groups, one per thread, opened and closed
+// with BeginGroup and EndGroup or a LogGroup; a group normally covers
+// one B+ tree operation.  A group is appended to the log in one piece,
+// followed by a LOG_END record carrying its checksum, so it is either
+// all there after a crash or not at all.  The pages a group changes are
+// held in the pool until it is appended, and then stamped with the LSN
+// past its end.  No page is written back before the log is durable up
+// to its LSN (the WAL rule), so pages are written lazily, by the pool,
+// while a commit needs only the log written.
+//
+// Committing waits for the log to be durable.  Threads committing
+// together share one write and fdatasync: the first to find the log
+// idle writes everything appended so far, and the others wait for it
+// and find their groups written too (group commit).
+//
+// An LSN is the position of a byte in the log since it was created;
+// the file holds the log from its header's start LSN on, and
+// Truncate drops what is no longer needed without reusing LSNs.
+//
+// Checkpoints are fuzzy: nobody stops while one is taken.  Every
+// maxSize / LOG_CHECKPOINTS bytes the buffer manager's writer writes
+// the pages that have stayed dirty since the last checkpoint, then
+// logs the pages still dirty with their recovery LSNs (see frame.h).
+// The oldest of those, or where the checkpoint began, is the redo
+// point: once the database file is synced, so that the pages written
+// are not just in the system's cache, the log before it is not
+// needed, and its space is given back to the file system.  The file header says where the last checkpoint
+// and its redo point are.
+//
+// Restart, on opening a database, replays the log from the redo point
+// to the last whole group.  A change is redone only if its page was
+// dirty when it was made, by the checkpoint's table or by the log
+// since, and a node's change only if the node's LSN is older than the
+// group's; changed bytes are rewritten in order.  So restart takes time
+// in proportion to the log since the redo point, not to the database.
+//
+
+typedef long LSN;
+
+const int LOG_HEADER_SIZE = 512;			// bytes before the first record
+const int LOG_BUFFER_SIZE = 1 << 20;		// appended bytes that force a write
+const int LOG_MAX_BYTES = 32768;			// changed bytes in one record
+const int LOG_CHECKPOINTS = 4;				// checkpoints per maxSize of log
+
+enum LogRecordType {
+	LOG_END = 1,			// {LSN groupStart, length, checksum}, closes a group
+	LOG_BYTES,				// {int offset, bytes}, bytes at offset changed
+	LOG_NODE_INIT,			// SortedPage::Init
+	LOG_NODE_TYPE,			// {short type}, SortedPage::SetType
+	LOG_NODE_NEXT,			// {PageID}, SortedPage::SetNextPage
+	LOG_NODE_PREV,			// {PageID}, SortedPage::SetPrevPage
+	LOG_NODE_INSERT,		// {entry}, SortedPage::InsertRecord
+	LOG_NODE_DELETE,		// {int slot}, SortedPage::DeleteRecord
+	LOG_CHECKPOINT			// {LSN begin, LogDirtyPage...}, part of the
+							// dirty page table of a checkpoint begun at begin
+};
+
+struct LogRecordHeader {
+	unsigned short length;		// of the whole record, header included
+	unsigned char  type;		// a LogRecordType
+	unsigned char  unused;
+	PageID         pid;			// the page changed, INVALID_PAGE for LOG_END
+};
+
+struct LogEnd {
+	LSN      groupStart;		// LSN of the group's first record
+	unsigned length;			// bytes of the group before this record
+	unsigned checksum;			// of those bytes
+};
+
+struct LogDirtyPage {
+	PageID pid;
+	LSN    recLSN;				// the log is needed from here for the page
+};
+
+class LogMgr
+{
+	private :
+
+		// A page changed by an open group, held in the pool until the
+		// group is appended.
+		struct Held {
+			Page  *page;
+			PageID pid;
+			LSN   *stamp;			// the page's own LSN, or NULL
+		};
+
+		// An open group of the calling thread.
+		struct Group {
+			int depth;				// nested BeginGroups
+			int count;				// records
+			LSN from;				// the log's end when it first held a page
+			std::string records;
+			std::vector<Held> held;
+		};
+		static thread_local std::vector<Group> groups;	// innermost last
+
+		// A page its file keeps pinned while it is open, see Keep.
+		struct Kept {
+			Page       *page;
+			int         len;
+			std::mutex *latch;		// taken by the file while changing it
+		};
+
+		int   fd;
+		char *name;
+		long  maxSize;				// bytes; checkpoints keep the log within it
+
+		std::mutex latch;			// guards all below but synchronous
+		std::condition_variable written;
+		std::string buffer;			// appended from flushed on, not yet written
+		LSN   start;				// LSN of the first byte past the header
+		LSN   redo;					// the log is needed from here on
+		LSN   checkpoint;			// the last checkpoint's group, or 0
+		std::atomic<LSN> checkpointBegin;	// where the last checkpoint began
+		bool  checkpointing;		// one is asked for or under way
+		LSN   flushed;				// buffer starts here
+		LSN   durable;				// the log is on disk up to here
+		LSN   end;					// past the last group appended
+		bool  writing;				// a thread is writing the buffer
+		bool  failed;				// a write failed; the log is unusable
+		std::atomic<bool> synchronous;
+
+		std::mutex checkpointLatch;	// one checkpoint or Truncate at a time
+
+		std::mutex keptLatch;		// guards kept
+		std::map<PageID, Kept> kept;
+
+		std::atomic<long> numOfGroups;
+		std::atomic<long> numOfRecords;
+		std::atomic<long> numOfBytes;
+		std::atomic<long> numOfWrites;
+		LatencyHistogram writeLatency;
+		std::atomic<long> numOfCheckpoints;
+		std::atomic<long> checkpointWrites;	// pages written for them
+		long  redoRecords;			// read by the last restart
+		long  redoApplied;			// of those, redone
+		long  redoTime;				// ns
+
+		Status Open( bool create );
+		Status WriteHeader();
+		Status Recover( LSN& tail );
+		void   RefreshKept();
+		LSN    Commit( Group& group, bool wait );
+
+		static void AddRecord( Group& group, LogRecordType type, PageID pid,
+		                       const void* body, int length );
+
+		off_t  Offset( LSN lsn ) { return LOG_HEADER_SIZE + (lsn - start); }
+
+	public :
+
+		// Open the log file name, or create it afresh if create is set
+		// or it does not exist.  An open log is checked up to its last
+		// whole group and cut there.
+		LogMgr( const char* name, long maxSize, bool create, Status& status );
+		~LogMgr();
+
+		// Open a group, or with separate one of its own inside any open
+		// one, committed at its EndGroup.  Only the outermost group
+		// waits for the log to be durable, and only if the log is
+		// synchronous.
+		void BeginGroup( bool separate = false );
+		void EndGroup();
+
+		// Log a change to page pid, which is page in the pool; stamp is
+		// where the page keeps its LSN, if it does.  Outside any group
+		// the record is a group of its own.
+		void Log( LogRecordType type, PageID pid, Page* page, LSN* stamp,
+		          const void* body = NULL, int length = 0 );
+
+		// Log len bytes at at, within page pid, as changed.
+		void LogBytes( PageID pid, Page* page, const void* at, int len );
+
+		// Log the first len bytes of page pid whole, if it has been dirty
+		// since before the last checkpoint.  For pages kept pinned, which
+		// the pool cannot write, so that they do not hold the redo point
+		// back; only one group at a time may be changing the page.
+		void Refresh( PageID pid, Page* page, int len );
+
+		// Have checkpoints Refresh the first len bytes of page pid, which
+		// its file keeps pinned while it is open, so that a file left
+		// idle does not hold the redo point back either.  The file holds
+		// latch from before it changes the page until the group that
+		// does is committed, and a checkpoint passes the page over while
+		// latch is taken.  Unkeep the page before letting it go.
+		void Keep( PageID pid, Page* page, int len, std::mutex* latch );
+		void Unkeep( PageID pid );
+
+		// Forget that the calling thread's groups changed page pid, which
+		// is being deallocated, so that its frame is not held or stamped.
+		// What was logged for it stays in the groups.
+		void Forget( PageID pid );
+
+		// Make the log durable up to lsn, or all that is appended.
+		Status Flush( LSN lsn );
+		Status FlushAll();
+
+		// Drop the whole log, once every page it covers has been written.
+		// Nothing else may be using the log.
+		Status Truncate();
+
+		// Take a checkpoint, see above.  The buffer manager's writer
+		// takes them as the log grows.
+		Status Checkpoint();
+
+		// Redo the log from the redo point, on a database just opened,
+		// before anything else uses it.
+		Status Restart();
+
+		// Whether committing waits for the log to be durable.
+		void SetSynchronous( bool on );
+		bool IsSynchronous() { return synchronous; }
+
+		LSN GetEndLSN();
+		LSN GetDurableLSN();
+		LSN GetRedoLSN();
+		long GetSize();				// bytes from the redo point on
+		long GetMaxSize() { return maxSize; }
+		const LatencyHistogram& GetWriteLatency() { return writeLatency; }
+
+		void PrintStat();
+		void ResetStat();
+
+		// {"synchronous":..,"groups":..,"records":..,"bytes":..,"writes":..,
+		//  "size":..,"checkpoints":..,"checkpoint_writes":..,
+		//  "restart":{"records":..,"redone":..,"ns":..},"write":{histogram}}
+		void WriteJSON( std::ostream& os );
+
+		static unsigned Checksum( const char* data, size_t len );
+};
+
+
+//
+// A log group for the lifetime of the object, if there is a log.
+//
+
+class LogGroup
+{
+	private :
+
+		LogMgr *log;
+
+	public :
+
+		LogGroup( bool separate = false ) : log(MINIBASE_LOG)
+		{
+			if (log != NULL)
+				log->BeginGroup(separate);
+		}
+		~LogGroup()
+		{
+			if (log != NULL)
+				log->EndGroup();
+		}
+};
+
+#endif // _LOG_H
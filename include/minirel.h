@@ -84,7 +84,11 @@ struct RecordID {
 
 // typedef struct RecordID RecordID;
 
-const int MINIBASE_PAGESIZE = 1024;           // in bytes
+const int MINIBASE_PAGESIZE = 1024;           // in bytes; default page size
+                                              // of a new database.
+const int MINIBASE_MIN_PAGESIZE = 1024;       // A database's page size is a
+const int MINIBASE_MAX_PAGESIZE = 65536;      // power of two in this range,
+                                              // chosen when it is created.
 
 const int MINIBASE_BUFFER_POOL_SIZE = 1024;   // in Frames
 
@@ -5,7 +5,12 @@
 
 
 const PageID INVALID_PAGE = -1;
-const int MAX_SPACE = MINIBASE_PAGESIZE;
+
+// The largest page any database can have.  The pages of the open
+// database are DB::GetPageSize() bytes; a Page (and the page layouts
+// built on it) describes the largest case, and only the first
+// GetPageSize() bytes of it exist in a buffer frame.
+const int MAX_SPACE = MINIBASE_MAX_PAGESIZE;
 
 
 class Page
@@ -0,0 +1,24 @@
+#ifndef PAGE_CODEC_H
+#define PAGE_CODEC_H
+
+//
+// The page codec of a compressed database (see DB_COMPRESSED).  A page
+// is taken as 32-bit words, each replaced by its difference from the
+// one before, so that the sorted keys and clustered record IDs of a B+
+// tree node turn into runs of small repeating values; the result is
+// then compressed LZ77 style, in sequences of literal bytes followed
+// by a copy of earlier output, as LZ4 does.
+//
+
+// Compress a page of pageSize bytes, a multiple of 4, into out, which
+// has room for pageSize bytes.  Returns the compressed length, or 0 if
+// that would not be smaller than the page.
+
+int PageCompress(const char* page, int pageSize, char* out);
+
+// Decompress len bytes at in into page.  Returns false if they are not
+// a page of pageSize bytes compressed by PageCompress.
+
+bool PageDecompress(const char* in, int len, char* page, int pageSize);
+
+#endif
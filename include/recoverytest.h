@@ -0,0 +1,62 @@
+#ifndef _RECOVERYTEST_H
+#define _RECOVERYTEST_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btfile.h"
+
+//
+// A test of restart after real crashes, run from the driver on a database
+// of its own.  Each round forks a child that opens the database, which
+// redoes the log, checks it and then has nThreads threads insert and
+// delete keys at random, each in a B+ tree of its own, until the parent
+// kills it.  The child tells the parent over a pipe what it is about to
+// do and what it has done, so the parent knows which keys each tree must
+// have, give or take the operation in flight.  A last child only checks.
+// Children are used so that the crash, and the fresh process, are real.
+//
+// WarmUp tests the buffer pool's warm list the same way: a child builds
+// a tree of keys keys, saves the pool's warm list and closes the
+// database, then opens it again, warms the pool up from the list and
+// scans the tree, which must not miss the pool.  Damaged lists must be
+// turned down, and pages past the end of the database skipped.
+//
+
+class RecoveryTest {
+
+public:
+
+	RecoveryTest(unsigned pageSize, const char* policy, DBIOMode iomode);
+
+	// Return OK if no child found an error.
+	Status Run(int rounds, int nThreads);
+	Status WarmUp(int keys);
+
+private:
+
+	// What a child tells the parent about key in tree t.
+	struct Message {
+		int t;
+		int key;
+		int kind;				// one of the below
+		int insert;				// 1 for an insert, 0 for a delete
+	};
+	enum { INTENT, DONE, READY };
+
+	unsigned pageSize;
+	const char* policy;
+	DBIOMode iomode;
+
+	std::vector< std::set<int> > model;		// keys each tree has
+	std::vector<Message> pending;			// last message about each tree
+
+	int  Child(int round, bool last, int fd);
+	int  Check(std::vector<BTreeFile*>& files, std::vector< std::set<int> >& keys, int fd);
+	void Work(int t, BTreeFile* btf, std::set<int> keys, int round, int fd);
+	int  WarmChild(int keys);
+	int  WarmDamaged(const std::string& list, unsigned count, bool pastEnd);
+};
+
+#endif // _RECOVERYTEST_H
@@ -1,31 +1,313 @@
+#ifndef _REPLACER_H
+#define _REPLACER_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+
 #include "frame.h"
+#include "latency.h"
 #include "hash.h"
 
+
+/**
+ * A list of frame numbers, linked through arrays indexed by frame so that
+ * adding, removing and moving a frame take O(1) without allocating.  The
+ * replacers use it to keep frames in FIFO or LRU order, front first.
+ */
+class FrameList
+{
+	private :
+
+		std::vector<int> prev;
+		std::vector<int> next;
+		std::vector<bool> member;
+		int head;
+		int tail;
+		int size;
+
+	public :
+
+		FrameList(int numOfFrames);
+		void PushBack(int frameNo);
+		void Remove(int frameNo);
+		void MoveToBack(int frameNo) { Remove(frameNo); PushBack(frameNo); }
+		bool Contains(int frameNo) { return member[frameNo]; }
+		int  Front() { return head; }
+		int  Next(int frameNo) { return next[frameNo]; }
+		int  Size() { return size; }
+};
+
+
+/**
+ * A FIFO of page ids of pages that have left the pool, with O(1) lookup.
+ * 2Q and ARC use these "ghost" lists to recognise pages that come back.
+ */
+class GhostList
+{
+	private :
+
+		std::list<PageID> order;
+		std::unordered_map<PageID, std::list<PageID>::iterator> where;
+
+	public :
+
+		void PushBack(PageID pid);
+		bool Remove(PageID pid);
+		void PopFront();
+		bool Contains(PageID pid) { return where.count(pid) != 0; }
+		int  Size() { return where.size(); }
+};
+
+
 /**
  * Class defining the buffer replacement policy.
+ *
+ * The buffer manager tells the replacer about every access: PickVictim
+ * when a page must be brought in, PageLoaded once it is in a frame,
+ * PageHit when a pinned page was already in the pool, and PageRemoved
+ * when a frame is emptied without eviction (the page was freed or
+ * flushed).  PickVictim hands out empty frames first; when there are
+ * none it asks the policy for an unpinned frame, claims it, writes the
+ * page in it back, and tells the policy through Evicted.
+ *
+ * The replacer may be called from several threads at once.  The free
+ * frame list and the policy's own state are guarded by latch; a policy
+ * that keeps no state of its own (Clock) is lockFree, and its hits and
+ * victim choices take no latch at all.  The latch is never held while
+ * a page table partition is locked, only the other way round.
+ *
+ * NextVictims lets the buffer manager's background writer see which
+ * frames the policy will evict soon, so their pages can be cleaned
+ * before a miss has to write them.
  */
-class Replacer 
+class Replacer
 {
+	protected :
+
+		int numOfFrames;
+		Frame **frames;
+		PageTable *pageTable;
+		FrameList freeFrames;		// frames holding no page
+		std::atomic<int> numOfFree;	// freeFrames.Size(), read without the latch
+		std::mutex latch;
+		bool lockFree;
+		std::atomic<long> dirtyVictims;	// victims that had to be written
+		std::atomic<long> evictions;		// victims that held a page
+		std::atomic<long> pinnedSkips;		// pinned frames passed over
+		LatencyHistogram victimLatency;		// finding a victim, not writing it
+
+		// The policy's hooks, called under latch unless lockFree.
+		// ChooseVictim only suggests a frame; PickVictim claims it.
+		virtual int  ChooseVictim(PageID pid) = 0;
+		virtual void Miss(PageID pid) {}
+		virtual void Loaded(int frameNo, PageID pid) {}
+		virtual void Hit(int frameNo) {}
+		virtual void Evicted(int frameNo, PageID pid) {}
+		virtual void Forget(int frameNo, PageID pid) {}
+		virtual void Upcoming(std::vector<int>& victims, int n) = 0;
+
+		int TakeFreeFrame();
+		void Unpinned(FrameList& list, std::vector<int>& victims, int n);
+
+		enum { EVICTED, EVICT_LOST, EVICT_FAILED };
+		int Evict(int f, PageID expected, long start, PageID* evicted, bool* written);
+
 	public :
 
-		Replacer();
+		Replacer(int bufSize, Frame **frames, PageTable *pageTable,
+		         bool lockFree = false);
 		virtual ~Replacer();
 
-		virtual int PickVictim() = 0;
+		int PickVictim(PageID pid, PageID* evicted = NULL, bool* written = NULL);
+		int Reuse(int f, PageID old, PageID pid, PageID* evicted = NULL, bool* written = NULL);
+		void NextVictims(std::vector<int>& victims, int n);
+		long GetDirtyVictims() { return dirtyVictims; }
+		long GetEvictions() { return evictions; }
+		long GetPinnedSkips() { return pinnedSkips; }
+		const LatencyHistogram& GetVictimLatency() { return victimLatency; }
+		void ResetStat();
+
+		void PageLoaded(int frameNo, PageID pid);
+		void PageHit(int frameNo);
+		void PageRemoved(int frameNo, PageID pid);
+
+		virtual const char* GetName() = 0;
+
+		// Make the replacer for a replacement_policy string: "Clock",
+		// "LRU", "LRU-K" (K = 2) or "LRU-<k>", "2Q" or "ARC", in any
+		// case.  Unknown names get Clock.
+		static Replacer* Create(const char* policy, int bufSize,
+		                        Frame **frames, PageTable *pageTable);
 };
 
+
+/**
+ * Second chance: a frame is referenced when its last pin is dropped, and
+ * the clock hand clears reference bits until it finds an unpinned frame
+ * without one.  The hand is an atomic counter, so threads looking for
+ * victims at the same time sweep different frames.
+ */
 class Clock : public Replacer
 {
 	private :
-		
-		int current;
-		int numOfFrames;
-		Frame **frames;
-		HashTable *hashTable;
+
+		std::atomic<unsigned int> hand;
+
+	protected :
+
+		int ChooseVictim(PageID pid);
+		void Upcoming(std::vector<int>& victims, int n);
 
 	public :
-		
-		Clock( int bufSize, Frame **frames, HashTable *hashTable );
+
+		Clock( int bufSize, Frame **frames, PageTable *pageTable );
 		~Clock();
-		int PickVictim();
-};
\ No newline at end of file
+		const char* GetName() { return "Clock"; }
+};
+
+
+/**
+ * Evict the unpinned page whose last access is oldest.
+ */
+class LRU : public Replacer
+{
+	private :
+
+		FrameList lru;
+
+	protected :
+
+		int  ChooseVictim(PageID pid);
+		void Loaded(int frameNo, PageID pid) { lru.PushBack(frameNo); }
+		void Hit(int frameNo) { lru.MoveToBack(frameNo); }
+		void Evicted(int frameNo, PageID pid) { lru.Remove(frameNo); }
+		void Forget(int frameNo, PageID pid);
+		void Upcoming(std::vector<int>& victims, int n) { Unpinned(lru, victims, n); }
+
+	public :
+
+		LRU( int bufSize, Frame **frames, PageTable *pageTable );
+		const char* GetName() { return "LRU"; }
+};
+
+
+/**
+ * LRU-K (O'Neil, O'Neil and Weikum): evict the unpinned page whose K-th
+ * most recent access is oldest.  Pages with fewer than K accesses count
+ * as infinitely old and go first, oldest last access first, so a scan
+ * does not push out pages that are used repeatedly.  Access history
+ * outlives eviction, for two to three times as many pages as there are
+ * frames, so a page that comes back soon keeps its record.
+ */
+class LRUK : public Replacer
+{
+	private :
+
+		struct History {
+			std::vector<long> times;	// last K accesses, ring buffer
+			int  count;					// accesses seen, up to K
+			int  next;					// ring position of the next one
+			bool resident;
+		};
+
+		int k;
+		long now;
+		char name[16];
+		std::unordered_map<PageID, History> history;
+
+		History& Touch(PageID pid);
+		void Prune();
+		bool Age(int frameNo, bool& isShort, long& time);
+
+	protected :
+
+		int  ChooseVictim(PageID pid);
+		void Loaded(int frameNo, PageID pid);
+		void Hit(int frameNo);
+		void Evicted(int frameNo, PageID pid);
+		void Forget(int frameNo, PageID pid);
+		void Upcoming(std::vector<int>& victims, int n);
+
+	public :
+
+		LRUK( int bufSize, Frame **frames, PageTable *pageTable, int k );
+		const char* GetName() { return name; }
+};
+
+
+/**
+ * 2Q (Johnson and Shasha), full version.  A page seen once sits in A1in,
+ * a FIFO of a quarter of the pool; when it leaves, its id is remembered
+ * in A1out for half a pool's worth of evictions.  A page that is missed
+ * while in A1out has been reused and joins Am, an LRU list for the rest
+ * of the pool.  Scans only churn A1in.
+ */
+class TwoQ : public Replacer
+{
+	private :
+
+		FrameList a1in;
+		FrameList am;
+		GhostList a1out;
+		int kin;
+		int kout;
+
+		int FirstUnpinned(FrameList& list);
+
+	protected :
+
+		int  ChooseVictim(PageID pid);
+		void Loaded(int frameNo, PageID pid);
+		void Hit(int frameNo);
+		void Evicted(int frameNo, PageID pid);
+		void Forget(int frameNo, PageID pid);
+		void Upcoming(std::vector<int>& victims, int n);
+
+	public :
+
+		TwoQ( int bufSize, Frame **frames, PageTable *pageTable );
+		const char* GetName() { return "2Q"; }
+};
+
+
+/**
+ * ARC (Megiddo and Modha).  T1 holds pages seen once recently and T2
+ * pages seen at least twice, both in LRU order; B1 and B2 remember the
+ * ids of pages evicted from each.  A miss on a page in B1 means T1 was
+ * too small, one in B2 that T2 was, and the target size p of T1 moves
+ * accordingly, so the split between recency and frequency adapts to
+ * the workload.
+ */
+class ARC : public Replacer
+{
+	private :
+
+		FrameList t1;
+		FrameList t2;
+		GhostList b1;
+		GhostList b2;
+		int p;						// target size of T1
+		bool missInB2;				// the current miss was a B2 ghost
+
+		int FirstUnpinned(FrameList& list);
+
+	protected :
+
+		int  ChooseVictim(PageID pid);
+		void Miss(PageID pid);
+		void Loaded(int frameNo, PageID pid);
+		void Hit(int frameNo);
+		void Evicted(int frameNo, PageID pid);
+		void Forget(int frameNo, PageID pid);
+		void Upcoming(std::vector<int>& victims, int n);
+
+	public :
+
+		ARC( int bufSize, Frame **frames, PageTable *pageTable );
+		const char* GetName() { return "ARC"; }
+};
+
+#endif // _REPLACER_H
@@ -2,26 +2,101 @@
 #define SORTED_PAGE_H
 
 
+#include <string.h>
+
 #include "minirel.h"
 #include "page.h"
 #include "heappage.h"
 #include "bt.h"
+#include "keysearch.h"
+#include "log.h"
+
+//
+// CHANGE this constant whenever you update the structure of SortedPage class.
+// It is the data area of the largest page; SortedPage::DataSize() is the
+// data area of a page of the open database.
+//
+const int SORTEDPAGE_DATA_SIZE = (MAX_SPACE - sizeof(LSN) - 3 * sizeof(PageID) - 2 * sizeof(short) - sizeof(int));
+
+//
+// A B+ tree node.  Unlike HeapPage there is no slot directory: the
+// entries are fixed-size (LeafEntry or IndexEntry, chosen by the node
+// type) and sorted by key, and the slot number of a RecordID is simply
+// the entry's index.  The data area is split struct-of-arrays style
+// into all the keys, packed at the start so they can be searched with
+// vector compares, followed by the payloads (RecordID or PageID) in
+// the same order:
+//
+//     | key 0 | key 1 | ... | key cap-1 | payload 0 | payload 1 | ... |
+//
+// where cap is the number of entries of this type that fit in the page
+// size of the database; it is worked out when the type is set and kept
+// in the header.
+//
+// Every change to a node is logged, as what was done rather than the
+// bytes changed, and the header keeps the LSN of the last log group to
+// change the node, so that restart can tell which changes it has.
+// Restart makes them again with Redo, which logs nothing.
+//
+
+class SortedPage {
+
+protected:
+
+	LSN     lsn;            // Past the last log group to change the node.
+	short   numOfRecords;   // Number of entries in the data area.
+	short   type;           // INDEX_NODE or LEAF_NODE; fixes the entry size.
+	int     capacity;       // Number of entries the data area can hold.
+
+	PageID  pid;            // Page ID of this page
+	PageID  nextPage;       // Page ID of the next page in a link list.
+	PageID  prevPage;       // Page ID of the prev page in a link list.
+
+	char data[SORTEDPAGE_DATA_SIZE];
+
+	int   PayloadSize()      { return (type == INDEX_NODE) ? sizeof(PageID) : sizeof(RecordID); }
+	int   EntrySize()        { return sizeof(int) + PayloadSize(); }
+	int   Capacity()         { return capacity; }
+	int*  Keys()             { return (int *)data; }
+	int   KeyAt(int slot)    { return Keys()[slot]; }
+	char* PayloadAt(int slot) { return data + Capacity() * sizeof(int) + slot * PayloadSize(); }
 
+	int   LowerBound(int key) { return KeySearchLowerBound(Keys(), numOfRecords, key); }
+	int   UpperBound(int key) { return KeySearchUpperBound(Keys(), numOfRecords, key); }
+
+	void  Logged(LogRecordType type, const void* body = NULL, int length = 0);
+
+	// The changes themselves, unlogged.
+	void  Reset(PageID pageNo);
+	void  Retype(short t);
+	int   Put(const char* recPtr);
+	void  Remove(int slot);
+	bool  IsSane();
 
-class SortedPage : public HeapPage {
-	
-private:
-	
-	// No private variables should be declared.
-	
 public:
-		
-	Status InsertRecord(char * recPtr, int recLen, RecordID& rid);	
+
+	void Init(PageID pageNo);
+
+	static int DataSize();
+
+	PageID GetNextPage()             { return nextPage; }
+	PageID GetPrevPage()             { return prevPage; }
+	PageID PageNo()                  { return pid; }
+	void   SetNextPage(PageID pageNo);
+	void   SetPrevPage(PageID pageNo);
+
+	Status InsertRecord(char * recPtr, int recLen, RecordID& rid);
 	Status DeleteRecord(const RecordID& rid);
-	
-	void  SetType(short t)  { type = t; }
+
+	int   AvailableSpace()  { return (Capacity() - numOfRecords) * EntrySize(); }
+	bool  IsEmpty()         { return (numOfRecords == 0); }
+
+	void  SetType(short t);
 	short GetType()         { return type; }
-	int   GetNumOfRecords() { return numOfSlots; }
+	int   GetNumOfRecords() { return numOfRecords; }
+
+	// Redo a logged change on this page, for restart.
+	bool  Redo(const LogRecordHeader& record, const char* body, LSN commit, LSN*& stamp);
 };
 
 #endif
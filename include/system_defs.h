@@ -14,8 +14,17 @@
 
 class BufMgr;
 class DB;
+class LogMgr;
 class Catalog;
 
+  // How the database file is accessed.
+enum DBIOMode {
+    DB_BUFFERED,        // through the system's page cache
+    DB_MAPPED,          // mapped into memory, served without a buffer pool
+    DB_DIRECT,          // bypassing the page cache with O_DIRECT
+    DB_COMPRESSED       // buffered, with the pages compressed on disk
+};
+
 #define MINIBASE_MAXARRSIZE 50
 
 class SystemDefs
@@ -23,16 +32,24 @@ class SystemDefs
 
 public:
     SystemDefs( Status& status, const char* dbname, unsigned dbpages = 0,
-                unsigned bufpoolsize = 0, const char* replacement_policy = 0 );
+                unsigned bufpoolsize = 0, const char* replacement_policy = 0,
+                unsigned pagesize = 0, DBIOMode iomode = DB_BUFFERED );
       /* This constructor uses a default log name and size, for multi-user
          Minibase.  For single-user Minibase, this is the designated
          constructor.  If "dbpages" is 0, the database is opened; if it is
-         greater than 0, the database is created with that number of pages. */
+         greater than 0, the database is created with that number of pages.
+         "pagesize" is the page size of a new database (0 means
+         MINIBASE_PAGESIZE); an existing database keeps the page size it
+         was created with.  "iomode" is how the database is read and
+         written; a mapped database is served from the mapping, with no
+         buffer pool of its own, and a compressed one stays compressed
+         however it is opened later. */
 
 
     SystemDefs( Status& status, const char* dbname, const char* logname,
                 unsigned dbpages, unsigned maxlogsize,
-                unsigned bufpoolsize = 0, const char* replacement_policy = 0 );
+                unsigned bufpoolsize = 0, const char* replacement_policy = 0,
+                unsigned pagesize = 0, DBIOMode iomode = DB_BUFFERED );
       /* This constructor lets you specify all aspects of the system. */
 
 
@@ -54,19 +71,26 @@ public:
          SystemDefs constructor.  If you need to use the catalog, use the
          ExtendedSystemDefs constructor, declared in ext_sys_defs.h. */
 
+    LogMgr*             GlobalLogMgr;
+      /* The write-ahead log of the database, see log.h.  It is opened
+         once the database is, so the database's own creation is not
+         logged, and "maxlogsize" is in pages. */
+
     char*               GlobalDBName;
     char*               GlobalLogName;
 
 protected:
     void init( Status& status, const char* dbname, const char* logname,
                unsigned dbpages, unsigned maxlogsize,
-               unsigned bufpoolsize, const char* replacement_policy );
+               unsigned bufpoolsize, const char* replacement_policy,
+               unsigned pagesize, DBIOMode iomode );
 };
 
 extern SystemDefs* minibase_globals;
 
 #define  MINIBASE_DB                    (minibase_globals->GlobalDB)
 #define  MINIBASE_BM                    (minibase_globals->GlobalBufMgr)
+#define  MINIBASE_LOG                   (minibase_globals->GlobalLogMgr)
 
 
 #define  MINIBASE_DBNAME                (minibase_globals->GlobalDBName)
@@ -0,0 +1,42 @@
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+//
+// A fixed-size pool of worker threads.  Tasks are run in submission
+// order by whichever worker is free; Wait() blocks until every task
+// submitted so far has finished.
+//
+
+class ThreadPool
+{
+	private :
+
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()> > tasks;
+		std::mutex latch;
+		std::condition_variable taskReady;
+		std::condition_variable allDone;
+		int numOfPending;			// tasks queued or running
+		bool stopping;
+
+		void WorkerLoop();
+
+	public :
+
+		// numThreads <= 0 means one thread per hardware thread.
+		ThreadPool( int numThreads = 0 );
+		~ThreadPool();
+
+		void Submit( const std::function<void()>& task );
+		void Wait();
+		int  GetNumOfThreads() { return (int)workers.size(); }
+};
+
+#endif // _THREADPOOL_H
@@ -0,0 +1,478 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "asyncio.h"
+
+
+IORequest::IORequest()
+{
+	write = false;
+	fd = -1;
+	len = 0;
+	offset = 0;
+	done = true;
+	status = OK;
+	timing = NULL;
+	started = 0;
+}
+
+
+//-------------------------------------------------------------------
+// IORequest::Start
+//
+// Purpose : Mark the request in flight.  The request may still be
+//           finishing an earlier use, whose callback has run but whose
+//           waiters have not been woken; wait for that first.
+//-------------------------------------------------------------------
+
+void IORequest::Start()
+{
+	std::unique_lock<std::mutex> lock(latch);
+	while (!done)
+	{
+		finished.wait(lock);
+	}
+	done = false;
+}
+
+
+void IORequest::Abort()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	status = FAIL;
+	done = true;
+	finished.notify_all();
+}
+
+
+void IORequest::Reset()
+{
+	std::unique_lock<std::mutex> lock(latch);
+	while (!done)
+	{
+		finished.wait(lock);
+	}
+	status = OK;
+}
+
+
+//-------------------------------------------------------------------
+// IORequest::Complete
+//
+// Input   : result - bytes transferred, or a negative error
+// Purpose : Finish the request on the I/O thread: run finish, record
+//           the status, run the callback and wake the waiters.  The request may be
+//           reused as soon as the latch is dropped.
+//-------------------------------------------------------------------
+
+void IORequest::Complete(ssize_t result)
+{
+	if (timing != NULL)
+	{
+		timing->RecordSince(started);
+	}
+	bool whole = (result == (ssize_t)len);
+	if (finish)
+	{
+		whole = finish(whole);
+		finish = nullptr;
+	}
+	status = whole ? OK : FAIL;
+	if (callback)
+	{
+		callback(this);
+	}
+
+	std::lock_guard<std::mutex> guard(latch);
+	done = true;
+	finished.notify_all();
+}
+
+
+//-------------------------------------------------------------------
+// IORequest::Wait
+//
+// Purpose : Wait for the request to complete.  The latch is taken even
+//           when it already has, so that a request is never destroyed
+//           while Complete still holds the latch.
+// Return  : The request's status.
+//-------------------------------------------------------------------
+
+Status IORequest::Wait()
+{
+	std::unique_lock<std::mutex> lock(latch);
+	while (!done)
+	{
+		finished.wait(lock);
+	}
+	return status;
+}
+
+
+//-------------------------------------------------------------------
+// AsyncIO::Read
+//
+// Input   : fd, buf, len, offset - as for pread
+//           req - a request that is idle or marked with Start()
+//           timing - where to record the read's latency, or NULL
+//           finish - run once the read is done, or empty
+// Purpose : Start reading len bytes at offset into buf.
+// Return  : OK if the read was started, in which case req completes
+//           later; FAIL if not, in which case req is already complete,
+//           with status FAIL, and neither its callback nor finish has
+//           been run.
+//-------------------------------------------------------------------
+
+Status AsyncIO::Read(int fd, char* buf, size_t len, off_t offset, IORequest& req,
+                     LatencyHistogram* timing, const std::function<bool(bool)>& finish)
+{
+	req.write = false;
+	req.fd = fd;
+	req.len = len;
+	req.offset = offset;
+	req.iov.resize(1);
+	req.iov[0].iov_base = buf;
+	req.iov[0].iov_len = len;
+	req.done = false;
+	req.timing = timing;
+	req.started = (timing != NULL) ? LatencyHistogram::Now() : 0;
+	req.finish = finish;
+
+	if (Submit(req) != OK)
+	{
+		req.finish = nullptr;
+		req.Abort();
+		return FAIL;
+	}
+	return OK;
+}
+
+
+Status AsyncIO::Write(int fd, const char* buf, size_t len, off_t offset, IORequest& req,
+                      LatencyHistogram* timing, const std::function<bool(bool)>& finish)
+{
+	req.write = true;
+	req.fd = fd;
+	req.len = len;
+	req.offset = offset;
+	req.iov.resize(1);
+	req.iov[0].iov_base = (char*)buf;
+	req.iov[0].iov_len = len;
+	req.done = false;
+	req.timing = timing;
+	req.started = (timing != NULL) ? LatencyHistogram::Now() : 0;
+	req.finish = finish;
+
+	if (Submit(req) != OK)
+	{
+		req.finish = nullptr;
+		req.Abort();
+		return FAIL;
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// AsyncIO::WriteV
+//
+// Input   : fd, bufs, n, offset - as for pwritev, n at most
+//                                 ASYNC_IO_MAX_IOV
+//           req, timing - as for Read
+// Purpose : Start writing the n buffers, one after the other, from
+//           offset.  The buffer list is copied; the buffers are not.
+// Return  : As for Read.
+//-------------------------------------------------------------------
+
+Status AsyncIO::WriteV(int fd, const struct iovec* bufs, int n, off_t offset, IORequest& req,
+                       LatencyHistogram* timing)
+{
+	req.write = true;
+	req.fd = fd;
+	req.offset = offset;
+	req.iov.assign(bufs, bufs + n);
+	req.len = 0;
+	for (int i = 0; i < n; i++)
+	{
+		req.len += bufs[i].iov_len;
+	}
+	req.done = false;
+	req.timing = timing;
+	req.started = (timing != NULL) ? LatencyHistogram::Now() : 0;
+	req.finish = nullptr;
+
+	if (n > ASYNC_IO_MAX_IOV || Submit(req) != OK)
+	{
+		req.Abort();
+		return FAIL;
+	}
+	return OK;
+}
+
+
+AsyncIO* AsyncIO::Create(bool useURing)
+{
+	if (useURing)
+	{
+		URingIO* uring = URingIO::Open();
+		if (uring != NULL)
+		{
+			return uring;
+		}
+	}
+	return new ThreadPoolIO(ASYNC_IO_DEPTH / 4);
+}
+
+
+ThreadPoolIO::ThreadPoolIO(int numThreads)
+	: pool(numThreads)
+{
+}
+
+
+Status ThreadPoolIO::Submit(IORequest& req)
+{
+	IORequest* r = &req;
+	pool.Submit([r]() {
+		ssize_t n = r->write ? ::pwritev(r->fd, &r->iov[0], r->iov.size(), r->offset)
+		                     : ::preadv(r->fd, &r->iov[0], r->iov.size(), r->offset);
+		r->Complete(n);
+	});
+	return OK;
+}
+
+
+URingIO::URingIO()
+{
+	ringFd = -1;
+	entries = 0;
+	sqRing = cqRing = MAP_FAILED;
+	sqRingSize = cqRingSize = 0;
+	sqes = (struct io_uring_sqe*)MAP_FAILED;
+	sqesSize = 0;
+	inFlight = 0;
+}
+
+
+//-------------------------------------------------------------------
+// URingIO::Open
+//
+// Purpose : Set up a ring of ASYNC_IO_DEPTH entries, map its queues and
+//           start the reaper.
+// Return  : The backend, or NULL if the kernel refuses io_uring or a
+//           queue cannot be mapped.
+//-------------------------------------------------------------------
+
+URingIO* URingIO::Open()
+{
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int fd = (int)syscall(__NR_io_uring_setup, ASYNC_IO_DEPTH, &p);
+	if (fd < 0)
+	{
+		return NULL;
+	}
+
+	URingIO* u = new URingIO();
+	u->ringFd = fd;
+	u->entries = p.sq_entries;
+
+	u->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	u->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (u->cqRingSize > u->sqRingSize)
+			u->sqRingSize = u->cqRingSize;
+		u->cqRingSize = 0;
+	}
+
+	u->sqRing = mmap(NULL, u->sqRingSize, PROT_READ | PROT_WRITE,
+	                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (u->sqRing == MAP_FAILED)
+	{
+		delete u;
+		return NULL;
+	}
+	if (u->cqRingSize == 0)
+	{
+		u->cqRing = u->sqRing;
+	}
+	else
+	{
+		u->cqRing = mmap(NULL, u->cqRingSize, PROT_READ | PROT_WRITE,
+		                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (u->cqRing == MAP_FAILED)
+		{
+			delete u;
+			return NULL;
+		}
+	}
+
+	u->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = (struct io_uring_sqe*)mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE,
+	                                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED)
+	{
+		delete u;
+		return NULL;
+	}
+
+	char* sq = (char*)u->sqRing;
+	u->sqHead = (unsigned*)(sq + p.sq_off.head);
+	u->sqTail = (unsigned*)(sq + p.sq_off.tail);
+	u->sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+	u->sqArray = (unsigned*)(sq + p.sq_off.array);
+
+	char* cq = (char*)u->cqRing;
+	u->cqHead = (unsigned*)(cq + p.cq_off.head);
+	u->cqTail = (unsigned*)(cq + p.cq_off.tail);
+	u->cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+	u->reaper = std::thread(&URingIO::ReaperLoop, u);
+	return u;
+}
+
+
+//-------------------------------------------------------------------
+// URingIO::~URingIO
+//
+// Purpose : Wait for the requests in flight, stop the reaper with a
+//           no-op marker and release the ring.
+//-------------------------------------------------------------------
+
+URingIO::~URingIO()
+{
+	if (reaper.joinable())
+	{
+		Push(NULL, IORING_OP_NOP);
+		reaper.join();
+	}
+
+	if (sqes != MAP_FAILED)
+		munmap(sqes, sqesSize);
+	if (cqRing != MAP_FAILED && cqRing != sqRing)
+		munmap(cqRing, cqRingSize);
+	if (sqRing != MAP_FAILED)
+		munmap(sqRing, sqRingSize);
+	if (ringFd >= 0)
+		close(ringFd);
+}
+
+
+Status URingIO::Submit(IORequest& req)
+{
+	return Push(&req, req.write ? IORING_OP_WRITEV : IORING_OP_READV);
+}
+
+
+//-------------------------------------------------------------------
+// URingIO::Push
+//
+// Input   : req - the request, NULL for the reaper's stop marker
+//           opcode - the io_uring operation
+// Purpose : Put one entry on the submission queue and hand it to the
+//           kernel, first waiting for room if ASYNC_IO_DEPTH requests
+//           are in flight.
+// Return  : OK, or FAIL if the kernel rejected the submission.
+//-------------------------------------------------------------------
+
+Status URingIO::Push(IORequest* req, int opcode)
+{
+	std::unique_lock<std::mutex> lock(latch);
+	while (inFlight >= (int)entries)
+	{
+		roomFree.wait(lock);
+	}
+
+	unsigned tail = *sqTail;
+	unsigned index = tail & *sqMask;
+	struct io_uring_sqe* sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->user_data = (unsigned long long)(uintptr_t)req;
+	if (req != NULL)
+	{
+		sqe->fd = req->fd;
+		sqe->off = req->offset;
+		sqe->addr = (unsigned long long)(uintptr_t)&req->iov[0];
+		sqe->len = req->iov.size();
+	}
+	sqArray[index] = index;
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	int n;
+	do
+	{
+		n = (int)syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0);
+	} while (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+
+	if (n < 0)
+	{
+		// The entry was not consumed; take it back.
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+		return FAIL;
+	}
+	inFlight++;
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// URingIO::ReaperLoop
+//
+// Purpose : Reaper thread body.  Wait for completions and finish their
+//           requests, until the stop marker has completed and nothing
+//           else is in flight.
+//-------------------------------------------------------------------
+
+void URingIO::ReaperLoop()
+{
+	bool sawStop = false;
+
+	while (true)
+	{
+		unsigned head = *cqHead;
+		unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+		if (head == tail)
+		{
+			{
+				std::lock_guard<std::mutex> guard(latch);
+				if (sawStop && inFlight == 0)
+				{
+					break;
+				}
+			}
+			syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+			continue;
+		}
+
+		struct io_uring_cqe* cqe = &cqes[head & *cqMask];
+		IORequest* req = (IORequest*)(uintptr_t)cqe->user_data;
+		int result = cqe->res;
+		__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+		{
+			// Taking the latch also orders the submitter's writes to the
+			// request before the completion.
+			std::lock_guard<std::mutex> guard(latch);
+			inFlight--;
+			roomFree.notify_one();
+		}
+
+		if (req == NULL)
+		{
+			sawStop = true;
+		}
+		else
+		{
+			req->Complete(result);
+		}
+	}
+}
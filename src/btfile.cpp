@@ -4,6 +4,12 @@
 #include "new_error.h"
 #include "btfile.h"
 #include "btfilescan.h"
+#include "btparallelscan.h"
+#include "bttraverse.h"
+#include "log.h"
+#include <climits>
+#include <map>
+#include <mutex>
 #include <stack>
 
 
@@ -22,6 +28,8 @@ BTreeFile::BTreeFile (Status& returnStatus, const char* filename)
     // TODO: add your code here
 	this->fileName = strcpy(new char[strlen(filename) + 1], filename);
 
+	std::lock_guard<std::mutex> idle(headerLatch);
+	LogGroup group;
 	Status stat = MINIBASE_DB->GetFileEntry(filename, headerID);
 	Page *_headerPage;
 	returnStatus = OK;
@@ -62,6 +70,10 @@ BTreeFile::BTreeFile (Status& returnStatus, const char* filename)
 
 		header = (BTreeHeaderPage *) _headerPage;
 	}
+
+	if (returnStatus == OK && MINIBASE_LOG != NULL) {
+		MINIBASE_LOG->Keep(headerID, (Page *)header, header->Size(), &headerLatch);
+	}
 }
 
 
@@ -80,7 +92,11 @@ BTreeFile::~BTreeFile()
 	
     if (headerID != INVALID_PAGE) 
 	{
-		Status st = MINIBASE_BM->UnpinPage (headerID, CLEAN);
+		if (MINIBASE_LOG != NULL)
+			MINIBASE_LOG->Unkeep(headerID);
+		// The header holds the root and the extents, which may have
+		// changed since the file was opened.
+		Status st = MINIBASE_BM->UnpinPage (headerID, DIRTY);
 		if (st != OK)
 		{
 			cout<<"Deconstruction: Fail to unpin the page"<<endl;
@@ -103,7 +119,18 @@ Status
 BTreeFile::DestroyFile()
 {
     // TODO: add your code here
-	if (header->GetRootPageID() != INVALID_PAGE && DestoryHelper(header->GetRootPageID()) != OK) {
+	if (MINIBASE_LOG != NULL)
+		MINIBASE_LOG->Unkeep(headerID);
+	LogGroup group;
+
+	// Free every node of the tree, one level at a time.
+	BTreeTraversal traversal;
+	if (traversal.Run(header->GetRootPageID(), NULL, true) != OK) {
+		cout<<"Fail to destory file"<<endl;
+		return FAIL;
+	}
+	if (FreeExtents() != OK) {
+		cout<<"Fail to free the unused extents"<<endl;
 		return FAIL;
 	}
 	FREEPAGE(headerID);
@@ -119,57 +146,6 @@ BTreeFile::DestroyFile()
 }
 
 
-Status
-BTreeFile::DestoryHelper(PageID pageID)
-{
-	SortedPage *page;
-	BTIndexPage *index;
-
-	Status s;
-	PageID curPageID;
-
-	RecordID curRid;
-	int key;
-
-	PIN(pageID, page);
-	NodeType type = (NodeType)page->GetType();
-
-	switch (type) {
-	case INDEX_NODE:
-		index = (BTIndexPage *)page;
-		curPageID = index->GetLeftLink();
-		if (DestoryHelper(curPageID) != OK) {
-			cout<<"Fail to destory file at destoryhelper"<<endl;
-			return FAIL;
-		}
-		s=index->GetFirst(key,curPageID,curRid);
-		if ( s == OK) {	
-			if (DestoryHelper(curPageID) != OK) {
-				cout<<"Fail to destory file at destoryhelper"<<endl;
-				return FAIL;
-			}
-			s = index->GetNext(key,curPageID,curRid);
-			while ( s != DONE) {	
-				if (DestoryHelper(curPageID) != OK) {
-					cout<<"Fail to destory file at destoryhelper"<<endl;
-					return FAIL;
-				}
-				s = index->GetNext(key,curPageID,curRid);
-			}
-		}
-
-		FREEPAGE(pageID);
-		break;
-
-	case LEAF_NODE:
-		FREEPAGE(pageID);
-		break;
-	}
-
-	return OK;
-}
-
-
 //-------------------------------------------------------------------
 // BTreeFile::Insert
 //
@@ -186,6 +162,9 @@ Status
 BTreeFile::Insert(const int key, const RecordID rid)
 {
     // TODO: add your code here
+	std::lock_guard<std::mutex> idle(headerLatch);
+	LogGroup group;
+	header->Refresh();
 	RecordID newRecordID;
 	//Two cases: (1) Null of root (2)root is a node 2.1 leaf 2.2 index node root node is a special case
 	if (header->GetRootPageID() == INVALID_PAGE) {
@@ -193,7 +172,9 @@ BTreeFile::Insert(const int key, const RecordID rid)
 		PageID newPageID;
 		Page *newPage;
 
-		NEWPAGE(newPageID, newPage);
+		if (NewNode(LEAF_NODE, newPageID, newPage) != OK) {
+			return FAIL;
+		}
 
 		BTLeafPage *newLeafPage = (BTLeafPage *) newPage;
 		newLeafPage->Init(newPageID);
@@ -242,7 +223,10 @@ BTreeFile::Insert(const int key, const RecordID rid)
 				PageID newIndexPageID;
 				Page *newIndexPage;
                 
-				NEWPAGE(newIndexPageID, newIndexPage);
+				if (NewNode(INDEX_NODE, newIndexPageID, newIndexPage) != OK) {
+					UNPIN(rootID, DIRTY);
+					return FAIL;
+				}
 				
 				// Create the new root index node and copy up key value into it
 				BTIndexPage *rootindex = (BTIndexPage *) newIndexPage;
@@ -281,14 +265,9 @@ BTreeFile::Insert(const int key, const RecordID rid)
 				indexIDStack.push(curIndexID);
 
 				
-				// While our key to insert is greater than the key of the record we are current on,
-				// continue searching the index for the right path to take (get the next record)
-				nextPageID = curIndexPage->GetLeftLink();
-				s = curIndexPage->GetFirst(curKey,curPageID,curRecordID);
-				while(s != DONE && KeyCmp(key, curKey) >= 0) {
-					nextPageID = curPageID;
-					s = curIndexPage->GetNext(curKey,curPageID,curRecordID);
-				}
+				// Follow the child of the last entry whose key is <= our key to insert
+				// (the left link if there is none), found by binary search
+				curIndexPage->GetPageID(&key, nextPageID);
 
 				UNPIN(curIndexID, CLEAN);
 
@@ -365,7 +344,9 @@ BTreeFile::Insert(const int key, const RecordID rid)
 							PageID newIndexPageID;
 							Page *newPage;
                 
-							NEWPAGE(newIndexPageID, newPage);
+							if (NewNode(INDEX_NODE, newIndexPageID, newPage) != OK) {
+								return FAIL;
+							}
 				
 							BTIndexPage *newIndexPage = (BTIndexPage *) newPage;
 							newIndexPage->Init(newIndexPageID);
@@ -394,7 +375,9 @@ Status
 BTreeFile::SplitLeafNode(const int key, const RecordID rid, BTLeafPage *fullPage, PageID &newPageID, int &newPageFirstKey)
 {
 	Page *newPage;
-	NEWPAGE(newPageID, newPage);
+	if (NewNode(LEAF_NODE, newPageID, newPage, fullPage->PageNo()) != OK) {
+		return FAIL;
+	}
 	BTLeafPage *newLeafPage = (BTLeafPage *) newPage;
 	newLeafPage->Init(newPageID);
 	newLeafPage->SetType(LEAF_NODE);
@@ -483,7 +466,9 @@ Status
 BTreeFile::SplitIndexNode(const int key, const PageID pid, BTIndexPage *fullPage, PageID &newPageID, int &newPageFirstKey)
 {
 	Page *newPage;
-	NEWPAGE(newPageID, newPage);
+	if (NewNode(INDEX_NODE, newPageID, newPage) != OK) {
+		return FAIL;
+	}
 	BTIndexPage *newIndexPage = (BTIndexPage *) newPage;
 	newIndexPage->Init(newPageID);
 	newIndexPage->SetType(INDEX_NODE);
@@ -559,6 +544,94 @@ BTreeFile::SplitIndexNode(const int key, const PageID pid, BTIndexPage *fullPage
 	return OK;
 }
 
+
+//-------------------------------------------------------------------
+// BTreeFile::NewNode
+//
+// Input   : type - the type of node the page is for
+//           after - the node the new one is split off, if any
+// Output  : pid - the new page's id
+//           page - the new page, pinned
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Allocate a page for a node from the file's extent for nodes
+//           of that type, reserving a new extent of BT_EXTENT_PAGES
+//           pages once it is used up.  Leaves and index nodes have
+//           extents of their own.  A node split off another takes the
+//           page right after it if that page is in the extent and
+//           free, and any node otherwise takes the extent's first free
+//           page.  So leaves split off in key order lie one after the
+//           other, while under random inserts a split leaf lies next
+//           to its sibling only if the sibling is in the current
+//           extent and its neighbour is still free.  If no run of
+//           free pages BT_EXTENT_PAGES long is left, a single page is
+//           allocated.
+//-------------------------------------------------------------------
+
+Status
+BTreeFile::NewNode(NodeType type, PageID& pid, Page*& page, PageID after)
+{
+	BTreeHeaderPage::Extent *extent = header->GetExtent(type);
+	const unsigned full = (1u << BT_EXTENT_PAGES) - 1;
+	if (extent->start != INVALID_PAGE && extent->used != full) {
+		int i = (after == INVALID_PAGE) ? -1 : after + 1 - extent->start;
+		if (i < 0 || i >= BT_EXTENT_PAGES || (extent->used & (1u << i))) {
+			for (i = 0; extent->used & (1u << i); i++)
+				;
+		}
+		pid = extent->start + i;
+		if (MINIBASE_BM->PinPage(pid, page, true) != OK) {
+			cerr << "Unable to pin new page " << pid << endl;
+			return FAIL;
+		}
+		extent->used |= 1u << i;
+		header->Logged(extent, sizeof(*extent));
+		return OK;
+	}
+
+	if (MINIBASE_BM->NewPage(pid, page, BT_EXTENT_PAGES) == OK) {
+		extent->start = pid;
+		extent->used = 1;
+		header->Logged(extent, sizeof(*extent));
+		return OK;
+	}
+	NEWPAGE(pid, page);
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BTreeFile::FreeExtents
+//
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Give back the unused pages of the file's extents.
+//-------------------------------------------------------------------
+
+Status
+BTreeFile::FreeExtents()
+{
+	for (int type = INDEX_NODE; type <= LEAF_NODE; type++) {
+		BTreeHeaderPage::Extent *extent = header->GetExtent((NodeType)type);
+		if (extent->start != INVALID_PAGE) {
+			// Each run of free pages, and the taken page ending it.
+			for (int i = 0; i < BT_EXTENT_PAGES; ) {
+				int run = 0;
+				while (i + run < BT_EXTENT_PAGES && !(extent->used & (1u << (i + run)))) {
+					run++;
+				}
+				if (run > 0 && MINIBASE_DB->DeallocatePage(extent->start + i, run) != OK) {
+					return FAIL;
+				}
+				i += run + 1;
+			}
+		}
+		extent->start = INVALID_PAGE;
+		extent->used = 0;
+		header->Logged(extent, sizeof(*extent));
+	}
+	return OK;
+}
+
+
 //-------------------------------------------------------------------
 // BTreeFile::Delete
 //
@@ -574,6 +647,9 @@ Status
 BTreeFile::Delete(const int key, const RecordID rid)
 {
     // TODO: add your code here
+	std::lock_guard<std::mutex> idle(headerLatch);
+	LogGroup group;
+	header->Refresh();
     if (header->GetRootPageID() == INVALID_PAGE) return FAIL;
 		
 	// A root page exists
@@ -618,15 +694,8 @@ BTreeFile::Delete(const int key, const RecordID rid)
 
 			indexIDStack.push(curIndexID);
 
-			nextPageID = curIndexPage->GetLeftLink();
-			s = curIndexPage->GetFirst(curKey, curPageID, curRecordID);
-
-			// While our key is greater than the key of the current record, continue searching the index for the right path to take
-			// by getting the next record on the page
-			while(s != DONE && KeyCmp(key, curKey) >= 0) {
-				nextPageID = curPageID;
-				s = curIndexPage->GetNext(curKey, curPageID, curRecordID);
-			}
+			// Follow the child of the last entry whose key is <= our key, found by binary search
+			curIndexPage->GetPageID(&key, nextPageID);
 			
 			UNPIN(curIndexID, CLEAN);
 
@@ -712,15 +781,10 @@ BTreeFile::OpenScan(const int* lowKey, const int* highKey)
     // TODO: add your code here
 	BTreeFileScan *newScan = new BTreeFileScan();
 
-	const  int* searchKey = NULL;
-	if (lowKey != NULL) {
-		searchKey = lowKey;
-	}
-	else
-	{
-		int nagtive = -1;
-		searchKey = &nagtive;
-	}
+	// With no low key, search for the smallest possible key to land on
+	// the leftmost leaf.
+	int minKey = INT_MIN;
+	const  int* searchKey = (lowKey != NULL) ? lowKey : &minKey;
 	
 	PageID leftmostPageID;
 	if (Search(searchKey,leftmostPageID) != OK) {
@@ -732,6 +796,141 @@ BTreeFile::OpenScan(const int* lowKey, const int* highKey)
 }
 
 
+//-------------------------------------------------------------------
+// BTreeFile::OpenParallelScan
+//
+// Input   : lowKey, highKey - range to scan, as for OpenScan.
+//           nThreads - number of sub-ranges (and worker threads)
+//           ordered - return entries in key order if true
+// Output  : None
+// Return  : A pointer to IndexFileScan class, NULL on failure.
+// Purpose : Cut [lowKey, highKey] into up to nThreads sub-ranges at
+//           separator keys of the upper index levels and scan each
+//           sub-range on its own thread.  The tree must not be
+//           modified while the scan is open.
+//-------------------------------------------------------------------
+
+IndexFileScan*
+BTreeFile::OpenParallelScan(const int* lowKey, const int* highKey, int nThreads, bool ordered)
+{
+	std::vector<int> splitKeys;
+	if (GetSplitKeys(lowKey, highKey, nThreads, splitKeys) != OK) {
+		return NULL;
+	}
+
+	// Sub-range i is [splitKeys[i-1], splitKeys[i] - 1]; the first and
+	// last keep the caller's bounds.
+	BTreeParallelScan *scan = new BTreeParallelScan(ordered);
+	for (size_t i = 0; i <= splitKeys.size(); i++) {
+		const int *partLow = (i == 0) ? lowKey : &splitKeys[i - 1];
+		int partHighKey = 0;
+		const int *partHigh = highKey;
+		if (i < splitKeys.size()) {
+			partHighKey = splitKeys[i] - 1;
+			partHigh = &partHighKey;
+		}
+		if (scan->AddPartition(this, partLow, partHigh) != OK) {
+			delete scan;
+			return NULL;
+		}
+	}
+	scan->Start();
+
+	return scan;
+}
+
+
+//-------------------------------------------------------------------
+// BTreeFile::GetSplitKeys
+//
+// Input   : lowKey, highKey - range to be split, NULL for open
+//           numParts - number of sub-ranges wanted
+// Output  : splitKeys - up to numParts-1 increasing keys, each in
+//                       (lowKey, highKey]
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Walk down the index levels that overlap the range until
+//           one level has at least numParts-1 separator keys inside
+//           it, then pick evenly spaced ones.  Subtrees of a level
+//           hold about the same number of entries, so the sub-ranges
+//           come out roughly equal.
+//-------------------------------------------------------------------
+
+Status
+BTreeFile::GetSplitKeys(const int* lowKey, const int* highKey, int numParts, std::vector<int>& splitKeys)
+{
+	splitKeys.clear();
+	if (numParts <= 1 || header->GetRootPageID() == INVALID_PAGE) {
+		return OK;
+	}
+
+	std::vector<int> keys;
+	std::vector<PageID> level(1, header->GetRootPageID());
+
+	while (!level.empty()) {
+		std::vector<int> levelKeys;
+		std::vector<PageID> children;
+
+		for (size_t i = 0; i < level.size(); i++) {
+			SortedPage *page;
+			PIN(level[i], page);
+			if (page->GetType() != INDEX_NODE) {
+				UNPIN(level[i], CLEAN);
+				continue;
+			}
+
+			// Child j covers [key j, key j+1); the left link covers
+			// everything below the first key.
+			BTIndexPage *index = (BTIndexPage *)page;
+			PageID childPid = index->GetLeftLink();
+			bool hasChildLow = false;
+			int childLow = 0;
+			RecordID curRid;
+			int key;
+			PageID curPageID;
+			Status s = index->GetFirst(key, curPageID, curRid);
+			while (true) {
+				bool overlaps = (highKey == NULL || !hasChildLow || KeyCmp(childLow, *highKey) <= 0)
+				             && (lowKey == NULL || s != OK || KeyCmp(*lowKey, key) < 0);
+				if (overlaps) {
+					children.push_back(childPid);
+				}
+				if (s != OK) {
+					break;
+				}
+				if ((lowKey == NULL || KeyCmp(key, *lowKey) > 0)
+				 && (highKey == NULL || KeyCmp(key, *highKey) <= 0)
+				 && (levelKeys.empty() || levelKeys.back() != key)) {
+					levelKeys.push_back(key);
+				}
+				hasChildLow = true;
+				childLow = key;
+				childPid = curPageID;
+				s = index->GetNext(key, curPageID, curRid);
+			}
+			UNPIN(level[i], CLEAN);
+		}
+
+		if (children.empty()) {
+			break;        // reached the leaves
+		}
+		keys.swap(levelKeys);
+		if ((int)keys.size() >= numParts - 1) {
+			break;
+		}
+		level.swap(children);
+	}
+
+	if ((int)keys.size() < numParts - 1) {
+		splitKeys = keys;
+		return OK;
+	}
+	for (int i = 1; i < numParts; i++) {
+		splitKeys.push_back(keys[(size_t)i * keys.size() / numParts]);
+	}
+	return OK;
+}
+
+
 //-------------------------------------------------------------------
 // BTreeFile::PrintTree
 //
@@ -858,6 +1057,183 @@ BTreeFile::Print()
 	return FAIL;
 }
 
+//-------------------------------------------------------------------
+// StatsVisitor
+//
+// Purpose : Traversal callback that gathers the figures printed by
+//           DumpStatistics.  Visits run concurrently, so each one
+//           computes its node's figures first and then merges them
+//           under the latch.
+//-------------------------------------------------------------------
+
+class StatsVisitor : public BTreeVisitor {
+
+public:
+
+	int   totalDataPages, totalIndexPages;
+	int   totalNumData, totalNumIndex;
+	float maxDataFillFactor, minDataFillFactor, totalFillData;
+	float maxIndexFillFactor, minIndexFillFactor, totalFillIndex;
+	int   leafLevel;
+
+	StatsVisitor()
+	{
+		totalDataPages = totalIndexPages = totalNumData = totalNumIndex = 0;
+		maxDataFillFactor = maxIndexFillFactor = 0;
+		minDataFillFactor = minIndexFillFactor = 1;
+		totalFillData = totalFillIndex = 0;
+		leafLevel = 0;
+	}
+
+	Status Visit(const BTNodeInfo& node, SortedPage* page)
+	{
+		int numOfEntries = page->GetNumOfRecords();
+		float curFillFactor = (float)(1.0 - 1.0*page->AvailableSpace()/SortedPage::DataSize());
+
+		std::lock_guard<std::mutex> guard(latch);
+		if (page->GetType() == INDEX_NODE) {
+			totalIndexPages++;
+			totalNumIndex += numOfEntries;
+			if (maxIndexFillFactor < curFillFactor)
+				maxIndexFillFactor = curFillFactor;
+			if (minIndexFillFactor > curFillFactor)
+				minIndexFillFactor = curFillFactor;
+			totalFillIndex += curFillFactor;
+		} else {
+			totalDataPages++;
+			totalNumData += numOfEntries;
+			if (maxDataFillFactor < curFillFactor)
+				maxDataFillFactor = curFillFactor;
+			if (minDataFillFactor > curFillFactor)
+				minDataFillFactor = curFillFactor;
+			totalFillData += curFillFactor;
+			leafLevel = node.level;
+		}
+		return OK;
+	}
+
+private:
+
+	std::mutex latch;
+};
+
+
+//-------------------------------------------------------------------
+// VerifyVisitor
+//
+// Purpose : Traversal callback that checks each node on its own:
+//           node type, key order, keys within the bounds set by the
+//           parent's separators, valid child pointers, and all
+//           leaves on the same level.  The leaves are remembered so
+//           that Verify can check the sibling links afterwards.
+//-------------------------------------------------------------------
+
+class VerifyVisitor : public BTreeVisitor {
+
+public:
+
+	struct LeafLinks {
+		PageID pid;
+		PageID prevPage;
+		PageID nextPage;
+	};
+
+	int numOfNodes;
+	int numOfErrors;
+	int leafLevel;                          // -1 until a leaf is seen
+	std::map<int, LeafLinks> leaves;        // keyed by position in level
+
+	VerifyVisitor()
+	{
+		numOfNodes = numOfErrors = 0;
+		leafLevel = -1;
+	}
+
+	void Report(PageID pid, const char* problem, int key)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		cerr << "Verify: page " << pid << ": " << problem << " (key " << key << ")" << endl;
+		numOfErrors++;
+	}
+
+	void CheckKey(const BTNodeInfo& node, int key, int prevKey, bool first)
+	{
+		if (!first && key < prevKey)
+			Report(node.pid, "keys out of order", key);
+		if (node.hasLowKey && key < node.lowKey)
+			Report(node.pid, "key below parent separator", key);
+		if (node.hasHighKey && key > node.highKey)
+			Report(node.pid, "key above parent separator", key);
+	}
+
+	Status Visit(const BTNodeInfo& node, SortedPage* page)
+	{
+		RecordID curRid;
+		int key, prevKey = 0;
+		bool first = true;
+		Status s;
+
+		switch (page->GetType()) {
+		case INDEX_NODE:
+		{
+			BTIndexPage *index = (BTIndexPage *)page;
+			PageID childPid;
+			if (index->GetLeftLink() == INVALID_PAGE)
+				Report(node.pid, "invalid left link", 0);
+			for (s = index->GetFirst(key, childPid, curRid); s == OK;
+			     s = index->GetNext(key, childPid, curRid)) {
+				CheckKey(node, key, prevKey, first);
+				if (childPid == INVALID_PAGE)
+					Report(node.pid, "invalid child pointer", key);
+				prevKey = key;
+				first = false;
+			}
+			break;
+		}
+
+		case LEAF_NODE:
+		{
+			BTLeafPage *leaf = (BTLeafPage *)page;
+			RecordID dataRid;
+			for (s = leaf->GetFirst(key, dataRid, curRid); s == OK;
+			     s = leaf->GetNext(key, dataRid, curRid)) {
+				CheckKey(node, key, prevKey, first);
+				prevKey = key;
+				first = false;
+			}
+
+			std::lock_guard<std::mutex> guard(latch);
+			if (leafLevel == -1)
+				leafLevel = node.level;
+			if (leafLevel != node.level) {
+				cerr << "Verify: page " << node.pid << ": leaf on level " << node.level
+				     << ", expected level " << leafLevel << endl;
+				numOfErrors++;
+			}
+			LeafLinks links;
+			links.pid = node.pid;
+			links.prevPage = leaf->GetPrevPage();
+			links.nextPage = leaf->GetNextPage();
+			leaves[node.position] = links;
+			break;
+		}
+
+		default:
+			Report(node.pid, "unknown node type", page->GetType());
+			break;
+		}
+
+		std::lock_guard<std::mutex> guard(latch);
+		numOfNodes++;
+		return OK;
+	}
+
+private:
+
+	std::mutex latch;
+};
+
+
 //-------------------------------------------------------------------
 // BTreeFile::DumpStatistics
 //
@@ -884,8 +1260,23 @@ BTreeFile::DumpStatistics()
 	maxDataFillFactor = maxIndexFillFactor = 0; minDataFillFactor = minIndexFillFactor =1;
 	totalFillData = totalFillIndex = 0;
 
-	if(_DumpStatistics(header->GetRootPageID())== OK)
-	{		// output result
+	StatsVisitor stats;
+	BTreeTraversal traversal;
+	if(traversal.Run(header->GetRootPageID(), &stats)== OK)
+	{
+		totalDataPages = stats.totalDataPages;
+		totalIndexPages = stats.totalIndexPages;
+		totalNumData = stats.totalNumData;
+		totalNumIndex = stats.totalNumIndex;
+		maxDataFillFactor = stats.maxDataFillFactor;
+		minDataFillFactor = stats.minDataFillFactor;
+		maxIndexFillFactor = stats.maxIndexFillFactor;
+		minIndexFillFactor = stats.minIndexFillFactor;
+		totalFillData = stats.totalFillData;
+		totalFillIndex = stats.totalFillIndex;
+		hight = stats.leafLevel;
+
+		// output result
 		if (totalNumData == 0)
 			maxDataFillFactor = minDataFillFactor = avgDataFillFactor = 0;
 		else
@@ -913,125 +1304,145 @@ BTreeFile::DumpStatistics()
 	return FAIL;
 }
 
-Status
-BTreeFile::_DumpStatistics(PageID pageID)
-{
-	DumpHelper(pageID);
 
-	SortedPage *page;
-	BTIndexPage *index;
+//-------------------------------------------------------------------
+// OwnerVisitor
+//
+// Purpose : Traversal callback that tells the buffer manager which file
+//           and level each node belongs to.
+//-------------------------------------------------------------------
 
-	Status s;
-	PageID curPageID;
+class OwnerVisitor : public BTreeVisitor {
 
-	RecordID curRid;
-	int key;
+public:
 
-	PIN (pageID, page);
-	NodeType type = (NodeType)page->GetType();
+	const char* fileName;
 
-	switch (type) {
-	case INDEX_NODE:
-		index = (BTIndexPage *)page;
-		curPageID = index->GetLeftLink();
-		_DumpStatistics(curPageID);
-		s=index->GetFirst(key, curPageID,curRid);
-		if ( s == OK) {	
-			_DumpStatistics(curPageID);
-			s = index->GetNext(key, curPageID,curRid);
-			while ( s != DONE) {	
-				_DumpStatistics(curPageID);
-				s = index->GetNext(key, curPageID,curRid);
-			}
-		}
-		UNPIN(pageID, CLEAN);
-		break;
+	OwnerVisitor(const char* fileName) : fileName(fileName) {}
 
-	case LEAF_NODE:
-		UNPIN(pageID, CLEAN);
-		break;
-	default:		
-		assert (0);
+	Status Visit(const BTNodeInfo& node, SortedPage* page)
+	{
+		MINIBASE_BM->SetPageOwner(node.pid, fileName, node.level);
+		return OK;
 	}
+};
 
-	return OK;
-}
 
+//-------------------------------------------------------------------
+// BTreeFile::TagPages
+//
+// Input   : None
+// Output  : None
+// Return  : OK, or FAIL if the tree cannot be walked.
+// Purpose : Attribute the file's pages, by level, in the buffer
+//           manager's heat report.  The walk's own pins are not
+//           counted.
+//-------------------------------------------------------------------
 Status
-BTreeFile::DumpHelper (PageID pageID)
+BTreeFile::TagPages()
 {
-	SortedPage *page;
-	BTIndexPage *index;
-	BTLeafPage *leaf;
-	int i;
-	Status s;
-	PageID curPageID;
-	float	curFillFactor;
-	RecordID curRid;
+	bool tracking = MINIBASE_BM->IsTrackingHeat();
+	MINIBASE_BM->TrackHeat(false);
 
-	int  key;
-	RecordID dataRid;
+	MINIBASE_BM->SetPageOwner(headerID, fileName);
+	OwnerVisitor owners(fileName);
+	BTreeTraversal traversal;
+	Status s = traversal.Run(header->GetRootPageID(), &owners);
 
-	PIN (pageID, page);
-	NodeType type = (NodeType)page->GetType ();
-	i = 0;
-	switch (type) {
-	case INDEX_NODE:
-		// add totalIndexPages
-		totalIndexPages++;
-		if ( hight <= 0) // still not reach the bottom
-			hight--;
-		index = (BTIndexPage *)page;
-		curPageID = index->GetLeftLink();
-		s=index->GetFirst (key, curPageID, curRid); 
-		if ( s == OK) {	
-			i++;
-			s = index->GetNext(key, curPageID, curRid);
-			while (s != DONE) {	
-				i++;
-				s = index->GetNext(key, curPageID, curRid);
+	MINIBASE_BM->TrackHeat(tracking);
+	return s;
+}
+
+//-------------------------------------------------------------------
+// BTreeFile::GetUpperPages
+//
+// Input   : None
+// Output  : pages - the header, then the index nodes, level by level
+//                   from the root
+// Return  : OK, or FAIL if a node cannot be pinned.
+// Purpose : List the pages every search goes through, for the buffer
+//           manager's warm list.  The leaves are not visited but for
+//           the first, which shows the level above was the last; the
+//           nodes are read through a ring, so the walk does not upset
+//           the pool it is listing.
+//-------------------------------------------------------------------
+
+Status
+BTreeFile::GetUpperPages(std::vector<PageID>& pages)
+{
+	pages.push_back(headerID);
+
+	BufferStrategy ring;
+	std::vector<PageID> level;
+	if (header->GetRootPageID() != INVALID_PAGE)
+		level.push_back(header->GetRootPageID());
+
+	for (int depth = 0; !level.empty() && depth < TRAVERSE_MAX_LEVELS; depth++) {
+		std::vector<PageID> next;
+		for (size_t i = 0; i < level.size(); i++) {
+			SortedPage* page = nullptr;
+			PIN_USING(level[i], page, &ring);
+			if (page->GetType() != INDEX_NODE) {
+				UNPIN(level[i], CLEAN);
+				return OK;
 			}
+			pages.push_back(level[i]);
+
+			BTIndexPage* index = (BTIndexPage *) page;
+			next.push_back(index->GetLeftLink());
+			for (int slot = 0; slot < index->GetNumOfRecords(); slot++)
+				next.push_back(index->GetEntry(slot).pid);
+			UNPIN(level[i], CLEAN);
 		}
-		totalNumIndex  += i;
-		curFillFactor = (float)(1.0 - 1.0*(index->AvailableSpace())/MAX_SPACE);
-		if ( maxIndexFillFactor < curFillFactor)
-			maxIndexFillFactor = curFillFactor;
-		if ( minIndexFillFactor > curFillFactor)
-			minIndexFillFactor = curFillFactor;
-		totalFillIndex += curFillFactor;
-		UNPIN(pageID, CLEAN);
-		break;
+		level.swap(next);
+	}
+	return OK;
+}
 
-	case LEAF_NODE:
-		// when the first time reach a leaf, set hight
-		if ( hight < 0)
-			hight = -hight;
-		totalDataPages++;
+//-------------------------------------------------------------------
+// BTreeFile::Verify
+//
+// Input   : None
+// Output  : None
+// Return  : OK if the tree is structurally sound, FAIL otherwise.
+// Purpose : Check every node (see VerifyVisitor), then check that the
+//           leaves, taken left to right, form the doubly linked leaf
+//           chain.  Problems are reported on cerr.
+//-------------------------------------------------------------------
 
-		leaf = (BTLeafPage *)page;
-		s = leaf->GetFirst (key, dataRid, curRid);
-		if (s == OK) {	
-			s = leaf->GetNext(key, dataRid, curRid);
-			i++;
-			while ( s != DONE) {	
-				i++;	
-				s = leaf->GetNext(key, dataRid, curRid);
-			}
+Status
+BTreeFile::Verify()
+{
+	VerifyVisitor verify;
+	BTreeTraversal traversal;
+	if (traversal.Run(header->GetRootPageID(), &verify) != OK) {
+		cout << "  Verify: unable to walk the tree." << endl;
+		return FAIL;
+	}
+
+	PageID prevPid = INVALID_PAGE;
+	std::map<int, VerifyVisitor::LeafLinks>::iterator it;
+	for (it = verify.leaves.begin(); it != verify.leaves.end(); ++it) {
+		if (it->second.prevPage != prevPid) {
+			cerr << "Verify: page " << it->second.pid << ": prev link is " << it->second.prevPage
+			     << ", expected " << prevPid << endl;
+			verify.numOfErrors++;
 		}
-		totalNumData += i;
-		curFillFactor = (float)(1.0 - 1.0*leaf->AvailableSpace()/MAX_SPACE);
-		if ( maxDataFillFactor < curFillFactor)
-			maxDataFillFactor = curFillFactor;
-		if ( minDataFillFactor > curFillFactor)
-			minDataFillFactor = curFillFactor;
-		totalFillData += curFillFactor;
-		UNPIN(pageID, CLEAN);
-		break;
-	default:		
-		assert (0);
+		std::map<int, VerifyVisitor::LeafLinks>::iterator next = it;
+		++next;
+		PageID expected = (next == verify.leaves.end()) ? INVALID_PAGE : next->second.pid;
+		if (it->second.nextPage != expected) {
+			cerr << "Verify: page " << it->second.pid << ": next link is " << it->second.nextPage
+			     << ", expected " << expected << endl;
+			verify.numOfErrors++;
+		}
+		prevPid = it->second.pid;
 	}
 
-	return OK;
+	cout << "  Verify: " << verify.numOfNodes << " nodes checked, "
+	     << verify.numOfErrors << " errors." << endl;
+
+	return (verify.numOfErrors == 0) ? OK : FAIL;
 }
 
 int
@@ -1086,54 +1497,86 @@ Status BTreeFile:: Search(const int *key,  PageID& foundPid)
 	return OK;
 }
 
+//-------------------------------------------------------------------
+// BTreeFile::_Search
+//
+// Input   : key - the key to look for
+//           currID - the node to start from
+// Output  : foundID - the leaf GetFirstPageID leads to from currID
+// Return  : OK, or FAIL if a node cannot be read.
+//-------------------------------------------------------------------
+
 Status
 BTreeFile::_Search( const int *key,  PageID currID, PageID& foundID)
 {
-	
-    SortedPage *page;
-	Status s;
-	
-    PIN (currID, page);
-    NodeType type = (NodeType)page->GetType ();
-	cout<<"_Search:finish pin"<<endl;
-	
-    switch (type) 
+	for (;;)
 	{
-	case INDEX_NODE:
-		cout<<"_Search:it is an index node"<<endl;
-		s =	_SearchIndex(key,  currID, (BTIndexPage*)page, foundID);
-		break;
-		
-	case LEAF_NODE:
-		cout<<"_Search:it is a leaf node"<<endl;
-		foundID =  page->PageNo();
-		UNPIN(currID,CLEAN);
-		break;
-	default:		
-		assert (0);
+		NodeType type;
+		PageID childID;
+		if (_SearchNode(key, currID, type, childID) != OK)
+		{
+			return FAIL;
+		}
+		if (type == LEAF_NODE)
+		{
+			foundID = currID;
+			return OK;
+		}
+		currID = childID;
 	}
-	return OK;
 }
 
 
-Status BTreeFile::_SearchIndex (const int *key,  PageID currIndexID, BTIndexPage *currIndex, PageID& foundID)
+//-------------------------------------------------------------------
+// BTreeFile::_SearchNode
+//
+// Input   : key - the key to look for
+//           currID - the node to read
+// Output  : type - the node's type
+//           childID - for an index node, the child to follow for key
+// Purpose : Read a node of a search.  While the node is in the pool it
+//           is read optimistically, without a pin, so searches running
+//           together through the upper levels write nothing to the
+//           pages they share; if it keeps changing under the read, or
+//           is not in the pool, it is pinned as usual.
+// Return  : OK, or FAIL if the node cannot be pinned.
+//-------------------------------------------------------------------
+
+Status
+BTreeFile::_SearchNode( const int *key,  PageID currID, NodeType& type, PageID& childID)
 {
-	PageID nextPageID;
-	cout<<"try to get pageID"<<endl;
-	Status s = currIndex->GetPageID(key, nextPageID);
-	cout<<"nextPageID:"<<nextPageID<<endl;
-	if (s != OK)
+	for (int tries = 0; tries < BT_OPTIMISTIC_TRIES; tries++)
 	{
-		return FAIL;
+		const Page *page;
+		PageVersion version;
+		if (MINIBASE_BM->ReadOptimistic(currID, page, version) != OK)
+		{
+			break;
+		}
+		Status s = ((BTIndexPage *)page)->GetFirstPageIDOptimistic(key, childID);
+		if (MINIBASE_BM->Validate(version) && s != FAIL)
+		{
+			type = (s == DONE) ? LEAF_NODE : INDEX_NODE;
+			return OK;
+		}
 	}
-		
-	// Now unpin the page, recurse and then pin it again
-	cout<<"_SearchIndex:start unpin the page"<<endl;
-	UNPIN (currIndexID, CLEAN);
-	cout<<"_SearchIndex:finish unpin"<<endl;
-	s = _Search (key, nextPageID, foundID);
-	if (s != OK)
-		return FAIL;
+
+	SortedPage *page;
+	PIN (currID, page);
+	type = (NodeType)page->GetType();
+	switch (type)
+	{
+	case INDEX_NODE:
+		((BTIndexPage *)page)->GetFirstPageID(key, childID);
+		break;
+
+	case LEAF_NODE:
+		break;
+
+	default:
+		assert (0);
+	}
+	UNPIN (currID, CLEAN);
 	return OK;
 }
 
@@ -1262,6 +1705,9 @@ BTreeFile::_PrintTree ( PageID pageID)
 Status
 BTreeFile::Delete1(const int key, const RecordID rid)
 {
+	std::lock_guard<std::mutex> idle(headerLatch);
+	LogGroup group;
+	header->Refresh();
 	SortedPage* rootPage; 
 	PageID rootPid;
 	Status s = OK;
@@ -1334,7 +1780,7 @@ BTreeFile::_Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid
 		RecordID deletedRID;
 		res = nodePageL->Delete(key, rid,deletedRID);
 
-		if (res == FAIL || nodePageL->AvailableSpace() <= HEAPPAGE_DATA_SIZE/2) {
+		if (res == FAIL || nodePageL->AvailableSpace() <= SortedPage::DataSize()/2) {
 			oldPid = INVALID_PAGE;
 			UNPIN(parentPid, DIRTY);
 			UNPIN(nodePid, DIRTY);
@@ -1358,7 +1804,7 @@ BTreeFile::_Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid
 		}
 
 		// redistribute
-		while(nodePageL->AvailableSpace() > HEAPPAGE_DATA_SIZE/2) {
+		while(nodePageL->AvailableSpace() > SortedPage::DataSize()/2) {
 			if (rightSibling) {
 				s = siblingPage->GetFirst(tempKey, tempDrid, tempRid);
 				s = nodePageL->Insert(tempKey, tempDrid, tempRid);
@@ -1375,7 +1821,7 @@ BTreeFile::_Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid
 		}
 
 		// redistribution successful
-		if (siblingPage->AvailableSpace() <= HEAPPAGE_DATA_SIZE/2) {
+		if (siblingPage->AvailableSpace() <= SortedPage::DataSize()/2) {
 			if (rightSibling) {
 				s = siblingPage->GetFirst(tempKey, tempDrid,tempRid);
 			} else {
@@ -1388,7 +1834,7 @@ BTreeFile::_Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid
 			UNPIN(siblingPid, DIRTY);
 			return res;
 		} else {
-			if (siblingPage->AvailableSpace() + nodePageL->AvailableSpace() >= HEAPPAGE_DATA_SIZE) {
+			if (siblingPage->AvailableSpace() + nodePageL->AvailableSpace() >= SortedPage::DataSize()) {
 				// merge
 				while (true) {
 					s = siblingPage->GetFirst(tempKey, tempDrid, tempRid);
@@ -1454,7 +1900,7 @@ BTreeFile::_Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid
 
 		nodePageI->DeletePage(tempOldPid, tempRightSibling);
 
-		if (nodePageI->AvailableSpace() <= HEAPPAGE_DATA_SIZE/2) {
+		if (nodePageI->AvailableSpace() <= SortedPage::DataSize()/2) {
 			oldPid = INVALID_PAGE;
 			UNPIN(parentPid, CLEAN);
 			UNPIN(nodePid, DIRTY);
@@ -1477,7 +1923,7 @@ BTreeFile::_Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid
 
 		// redistribute
 		PageID tempPid;
-		while(nodePageI->AvailableSpace() > HEAPPAGE_DATA_SIZE/2) {
+		while(nodePageI->AvailableSpace() > SortedPage::DataSize()/2) {
 			if (rightSibling) {
 				siblingPage->GetFirst(tempKey, tempPid, tempRid);
 				nodePageI->Insert(keyToAdjust, siblingPage->GetLeftLink(), tempRid);
@@ -1496,14 +1942,14 @@ BTreeFile::_Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid
 		}
 
 		// redistribution successful
-		if (siblingPage->AvailableSpace() <= HEAPPAGE_DATA_SIZE/2) {
+		if (siblingPage->AvailableSpace() <= SortedPage::DataSize()/2) {
 			oldPid = INVALID_PAGE;
 			UNPIN(parentPid, DIRTY);
 			UNPIN(nodePid, DIRTY);
 			UNPIN(siblingPid, DIRTY);
 			return res;
 		} else {
-			if (siblingPage->AvailableSpace() + nodePageI->AvailableSpace() >= HEAPPAGE_DATA_SIZE) {
+			if (siblingPage->AvailableSpace() + nodePageI->AvailableSpace() >= SortedPage::DataSize()) {
 				// merge
 				while (true) {
 					if (rightSibling) {
@@ -1560,6 +2006,9 @@ BTreeFile::_Delete(PageID parentPid, PageID nodePid, int key, const RecordID rid
 Status
 BTreeFile::Delete2(const int key, const RecordID rid)
 {
+	std::lock_guard<std::mutex> idle(headerLatch);
+	LogGroup group;
+	header->Refresh();
 	if (header->GetRootPageID() == INVALID_PAGE) return FAIL;
 		
 	// A root page exists
@@ -1624,15 +2073,8 @@ BTreeFile::Delete2(const int key, const RecordID rid)
 
 			indexIDStack.push(curIndexID);
 
-			nextPageID = curIndexPage->GetLeftLink();
-			s = curIndexPage->GetFirst(curKey, curPageID, curRecordID);
-
-			// While our key is greater than the key of the current record, continue searching the index for the right path to take
-			// by getting the next record on the page
-			while(s != DONE && KeyCmp(key, curKey) >= 0) {
-				nextPageID = curPageID;
-				s = curIndexPage->GetNext(curKey, curPageID, curRecordID);
-			}
+			// Follow the child of the last entry whose key is <= our key, found by binary search
+			curIndexPage->GetPageID(&key, nextPageID);
 			
 			UNPIN(curIndexID, CLEAN);
 
@@ -33,7 +33,6 @@ Status
 BTreeFileScan::GetNext(RecordID& rid, int& keyPtr)
 {
     // TODO: add your code here 
-	cout<<"is scan finished :"<<scanFinished<<endl;
     if (scanFinished) return DONE;
 
 	RecordID dataRid;
@@ -41,11 +40,8 @@ BTreeFileScan::GetNext(RecordID& rid, int& keyPtr)
 
 	if(!scanStarted) {
 		// Find the record on the leftmost leaf page where we are supposed to start
-		cout<<"if not started"<<endl;
 		curPageID = leftmostLeafID;
-		cout<<"leftmostLeafID:"<<leftmostLeafID<<endl;
-		PIN(curPageID, curPage);
-		cout<<"Finish PIN"<<endl;
+		PIN_USING(curPageID, curPage, &strategy);
 		// Find the first non-empty page
 		while (curPage->GetFirst(keyPtr,dataRid,curRid) != OK) {
 			PageID nextPageID = curPage->GetNextPage();
@@ -57,7 +53,7 @@ BTreeFileScan::GetNext(RecordID& rid, int& keyPtr)
 			}
 			
 			curPageID = nextPageID;
-			PIN(curPageID, curPage);
+			PIN_USING(curPageID, curPage, &strategy);
 		}
 		
 
@@ -91,9 +87,19 @@ BTreeFileScan::GetNext(RecordID& rid, int& keyPtr)
 				}
 			}
 			else{
-				// Get the next record and try again
-				cout<<*lowKey<<endl;
-				while (curPage->GetNext(keyPtr,dataRid,curRid) != DONE){
+				// Get the next record and try again.  The first page may hold
+				// only smaller keys, so carry on along the leaf chain.
+				while (true) {
+					Status s = curPage->GetNext(keyPtr,dataRid,curRid);
+					while (s == DONE && curPage->GetNextPage() != INVALID_PAGE) {
+						PageID nextPageID = curPage->GetNextPage();
+						UNPIN(curPageID, CLEAN);
+						curPageID = nextPageID;
+						PIN_USING(curPageID, curPage, &strategy);
+						s = curPage->GetFirst(keyPtr, dataRid, curRid);
+					}
+					if (s == DONE) break;
+
 					if (KeyCmp(lowKey,&keyPtr) <= 0) {
 						if (highKey == NULL || KeyCmp(&keyPtr,highKey) <= 0) {
 							rid = dataRid;
@@ -117,7 +123,7 @@ BTreeFileScan::GetNext(RecordID& rid, int& keyPtr)
 	// The scan has allready been initialized
 	else {
 		// PIN our current page
-		PIN(curPageID, curPage);
+		PIN_USING(curPageID, curPage, &strategy);
 		Status s = curPage->GetNext(keyPtr, dataRid, curRid);
 
 		// See if we have more records on that page, if not we need to get the next page
@@ -126,7 +132,7 @@ BTreeFileScan::GetNext(RecordID& rid, int& keyPtr)
 			UNPIN(curPageID, CLEAN);
 			curPageID = nextPageID;
 
-			PIN(curPageID, curPage);
+			PIN_USING(curPageID, curPage, &strategy);
 			s = curPage->GetFirst(keyPtr, dataRid, curRid);
 		}
 
@@ -43,20 +43,16 @@ BTIndexPage::Insert(const int key, const PageID pageID, RecordID& rid)
 Status 
 BTIndexPage::Delete (const int key, RecordID& rid)
 {
-	// Scan through all the records in this page and find the
-	// matching pair (key, dataRid).
+	// Binary search for the last record with this key.
 
-	for (int i = numOfSlots - 1; i >= 0; i--)
+	int i = UpperBound(key) - 1;
+	if (i >= 0 && KeyAt(i) == key)
 	{
-		IndexEntry* entry = (IndexEntry *)(data + slots[i].offset);
-		if (entry->key == key)
-		{
-			// We delete it here.
-			rid.pageNo = PageNo();
-			rid.slotNo = i;
-			Status s = SortedPage::DeleteRecord(rid);
-			return s;
-		}
+		// We delete it here.
+		rid.pageNo = PageNo();
+		rid.slotNo = i;
+		Status s = SortedPage::DeleteRecord(rid);
+		return s;
 	}
 	
 	return FAIL;
@@ -80,16 +76,15 @@ Status
 BTIndexPage::GetFirst(int& firstKey, PageID& firstPid, RecordID& rid)
 {
 	// Initialize the record id of the first (key, dataRid) pair.  The
-	// first record is always at slot position 0, since SortedPage always
-	// compact it's records.  We can also use HeapPage::FirstRecord here
-	// but it is not neccessary.
+	// first record is always at slot position 0, since SortedPage keeps
+	// its records in a dense array.
 
 	rid.pageNo = pid;
 	rid.slotNo = 0;
 
 	// If there are no record in this page, just return DONE.
 	
-	if (numOfSlots == 0)
+	if (numOfRecords == 0)
 	{
 		rid.pageNo = INVALID_PAGE;
 		rid.slotNo = INVALID_SLOT;
@@ -97,12 +92,11 @@ BTIndexPage::GetFirst(int& firstKey, PageID& firstPid, RecordID& rid)
 	}
 	
 	// Otherwise, we just copy the record into key and dataRid,
-	// and returned.  The record is located at offset slots[0].offset
-	// from the beginning of data area (pointed to by member data in 
-	// HeapPage)
+	// and returned.  The record is the first entry of the data area
+	// (pointed to by member data in SortedPage)
 
 	IndexEntry entry;
-	memcpy(&entry, (IndexEntry *)(data + slots[0].offset), sizeof(IndexEntry));
+	entry = GetEntry(0);
 	firstKey = entry.key;
 	firstPid = entry.pid;
 	
@@ -128,7 +122,7 @@ BTIndexPage::GetNext(int& nextKey, PageID& nextPid, RecordID& rid)
 {
 	// If we are at the end of records, return DONE.
 
-	if (rid.slotNo + 1 >= numOfSlots)
+	if (rid.slotNo + 1 >= numOfRecords)
 	{
 		rid.pageNo = INVALID_PAGE;
 		rid.slotNo = INVALID_SLOT;
@@ -137,17 +131,16 @@ BTIndexPage::GetNext(int& nextKey, PageID& nextPid, RecordID& rid)
 
 	// Increment the slotNo in rid to point to the next record in this
 	// page.  We can do this for subclass of SorterPage since the records
-	// in a sorted page is always compact.  
+	// in a sorted page are always dense.
 	
 	rid.slotNo++;
 
 	// Otherwise, we just copy the record into key and dataRid,
-	// and returned.  The record is located at offset 
-	// slots[rid.slotNo].offset from the beginning of data area 
-	// (pointed to by member data in HeapPage)
+	// and returned.  The record is entry rid.slotNo of the data area
+	// (pointed to by member data in SortedPage)
 
 	IndexEntry entry;
-	memcpy(&entry, (IndexEntry *)(data + slots[rid.slotNo].offset), sizeof(IndexEntry));
+	entry = GetEntry(rid.slotNo);
 	nextKey = entry.key;
 	nextPid = entry.pid;
 	
@@ -186,22 +179,13 @@ void BTIndexPage::SetLeftLink(PageID pageID)
 
 Status BTIndexPage::GetPageID (const int *key, PageID& pid)
 {
-	// IndexEntry *currKey;
-	IndexEntry entry;
-	// A sequential search is implemented here.  You can modify it
-	// to a binary search if you like.
-	
-	for (int i = numOfSlots - 1; i >= 0; i--)
+	// Binary search for the last entry whose key is <= *key; its
+	// child is the one to follow.
+	int i = UpperBound(*key) - 1;
+	if (i >= 0)
 	{
-		// currKey = (IndexEntry*)(data + slots[i].offset);
-		memcpy(&entry, (IndexEntry *)(data + slots[i].offset), sizeof(IndexEntry));
-		
-		if (KeyCmp(key, &(entry.key)) >= 0)
-		{
-			key = &(entry.key);
-			pid = entry.pid;
-			return OK;
-		}
+		pid = GetEntry(i).pid;
+		return OK;
 	}
 	
 	// If we reach this point, then the page we should follow in our 
@@ -211,6 +195,67 @@ Status BTIndexPage::GetPageID (const int *key, PageID& pid)
 	return OK;
 }
 
+//-------------------------------------------------------------------
+// BTIndexPage::GetFirstPageID
+//
+// Input   : key - the key to look for
+// Output  : pid - the child to follow
+// Purpose : Like GetPageID, but follow the child of the last entry
+//           whose key is < *key.  Entries equal to a separator can sit
+//           in the leaf left of it, so this is the child that holds the
+//           first entry >= *key.  Used to start range scans.
+// Return  : OK
+//-------------------------------------------------------------------
+
+Status BTIndexPage::GetFirstPageID (const int *key, PageID& pid)
+{
+	int i = LowerBound(*key) - 1;
+	pid = (i >= 0) ? GetEntry(i).pid : GetLeftLink();
+	return OK;
+}
+
+//-------------------------------------------------------------------
+// BTIndexPage::GetFirstPageIDOptimistic
+//
+// Input   : key - the key to look for
+// Output  : pid - the child to follow
+// Purpose : GetFirstPageID for a page read without a pin, which may be
+//           changing underneath (see BufMgr::ReadOptimistic).  The
+//           header is read once and checked before the entries are
+//           searched, so the search stays within the page whatever it
+//           holds; the caller validates the result.
+// Return  : OK; DONE if the page is a leaf; FAIL if it makes no sense
+//           as a node.
+//-------------------------------------------------------------------
+
+Status BTIndexPage::GetFirstPageIDOptimistic (const int *key, PageID& pid)
+{
+	short t = __atomic_load_n(&type, __ATOMIC_RELAXED);
+	if (t == LEAF_NODE)
+	{
+		return DONE;
+	}
+	int n = __atomic_load_n(&numOfRecords, __ATOMIC_RELAXED);
+	int cap = __atomic_load_n(&capacity, __ATOMIC_RELAXED);
+	if (t != INDEX_NODE || cap != DataSize() / (int)(sizeof(int) + sizeof(PageID)) ||
+	    n < 0 || n > cap)
+	{
+		return FAIL;
+	}
+
+	int i = KeySearchLowerBound(Keys(), n, *key) - 1;
+	if (i >= 0)
+	{
+		memcpy(&pid, data + cap * sizeof(int) + i * sizeof(PageID), sizeof(PageID));
+	}
+	else
+	{
+		pid = __atomic_load_n(&prevPage, __ATOMIC_RELAXED);
+	}
+	return OK;
+}
+
+
 int BTIndexPage::KeyCmp(const int* key1, const int* key2)
 {
 	if (*key1 < *key2)
@@ -229,14 +274,14 @@ int BTIndexPage::KeyCmp(const int* key1, const int* key2)
 
 Status BTIndexPage::GetKeyData(int& key, PageID& pid, RecordID& rid)
 {
-	if (rid.slotNo >= numOfSlots)
+	if (rid.slotNo >= numOfRecords)
 	{
 		rid.pageNo = INVALID_PAGE;
 		rid.slotNo = INVALID_SLOT;
 		return DONE;
 	}
 	IndexEntry entry;
-	memcpy(&entry, (IndexEntry *)(data + slots[rid.slotNo].offset), sizeof(IndexEntry));
+	entry = GetEntry(rid.slotNo);
 	key = entry.key;
 	pid = entry.pid;
 	
@@ -245,7 +290,7 @@ Status BTIndexPage::GetKeyData(int& key, PageID& pid, RecordID& rid)
 
 Status BTIndexPage::DeletePage (PageID pid, bool rightSibling)
 {
-	PageID pageNo;
+	PageID pageNo = INVALID_PAGE;
 	int currKey = 0;
 	RecordID rid;
 	Status s;
@@ -300,25 +345,25 @@ Status BTIndexPage::FindSiblingForChild(PageID targetPid, PageID& siblingPid, bo
 	// if (GetLeftLink() == targetPid) {
 	// 	rightSibling = true;
 	// 	IndexEntry entry;
-	// 	memcpy(&entry, (IndexEntry *)(data + slots[0].offset), sizeof(IndexEntry));
+	// 	entry = GetEntry(0);
 	// 	siblingPid = entry.pid;
 	// }
 
-	for (int i = numOfSlots - 1; i >= 0; i--)
+	for (int i = numOfRecords - 1; i >= 0; i--)
 	{
 		PageID pageNo;
 		IndexEntry entry;
-		memcpy(&entry, (IndexEntry *)(data + slots[i].offset), sizeof(IndexEntry));
+		entry = GetEntry(i);
 		pageNo = entry.pid;
 		if (targetPid == pageNo) {
 			rightSibling = false;
-			if (i == numOfSlots - 1) {
+			if (i == numOfRecords - 1) {
 				IndexEntry entry;
-				memcpy(&entry, (IndexEntry *)(data + slots[i-1].offset), sizeof(IndexEntry));
+				entry = GetEntry(i-1);
 				siblingPid = entry.pid;
 			} else {
 				IndexEntry entry;
-				memcpy(&entry, (IndexEntry *)(data + slots[i+1].offset), sizeof(IndexEntry));
+				entry = GetEntry(i+1);
 				siblingPid = entry.pid;
 				rightSibling = true;
 			}
@@ -332,9 +377,9 @@ Status BTIndexPage::FindSiblingForChild(PageID targetPid, PageID& siblingPid, bo
 Status BTIndexPage::FindKey (int& key, int& entry)
 {
 	IndexEntry indexentry;
-	for (int i = numOfSlots - 1; i >= 0; i--)
+	for (int i = numOfRecords - 1; i >= 0; i--)
 	{
-		memcpy(&indexentry, (IndexEntry *)(data + slots[i].offset), sizeof(IndexEntry));
+		indexentry = GetEntry(i);
 		
 		if (KeyCmp(&key, &(indexentry.key)) >= 0)
 		{
@@ -347,17 +392,17 @@ Status BTIndexPage::FindKey (int& key, int& entry)
 
 Status BTIndexPage::GetLast (RecordID& rid, int key, PageID & pageNo)
 {
-	if (numOfSlots == 0) 
+	if (numOfRecords == 0) 
 	{
 		pageNo = INVALID_PAGE;
 		return DONE;
 	}
 
 	rid.pageNo = pid;
-	rid.slotNo = numOfSlots - 1;
+	rid.slotNo = numOfRecords - 1;
 
 	IndexEntry entry;
-	memcpy(&entry, (IndexEntry *)(data + slots[numOfSlots - 1].offset), sizeof(IndexEntry));
+	entry = GetEntry(numOfRecords - 1);
 	key = entry.key;
 	pageNo = entry.pid;
 	return OK;
@@ -365,9 +410,9 @@ Status BTIndexPage::GetLast (RecordID& rid, int key, PageID & pageNo)
 
 Status BTIndexPage::AdjustKey (int& newKey, int& oldKey)
 {
-	for (int i = numOfSlots -1; i >= 0; i--) {
+	for (int i = numOfRecords -1; i >= 0; i--) {
 		IndexEntry entry;
-		memcpy(&entry, (IndexEntry *)(data + slots[i].offset), sizeof(IndexEntry));
+		entry = GetEntry(i);
         if (KeyCmp(&oldKey, &(entry.key)) >= 0) {
 			newKey = entry.key; 
 			return OK;
@@ -378,23 +423,16 @@ Status BTIndexPage::AdjustKey (int& newKey, int& oldKey)
 
 Status BTIndexPage::FindPage(int key, PageID& pageNo, bool& leftMost)
 {
-	IndexEntry entry;
-	
-	for (int i = numOfSlots - 1; i >= 0; i--)
+	int i = UpperBound(key) - 1;
+	if (i >= 0)
 	{
-		memcpy(&entry, (IndexEntry *)(data + slots[i].offset), sizeof(IndexEntry));
-		
-		if (KeyCmp(&key, &(entry.key)) >= 0)
-		{
-			key = entry.key;
-			pid = entry.pid;
-			leftMost = false;
-			return OK;
-		}
+		pageNo = GetEntry(i).pid;
+		leftMost = false;
+		return OK;
 	}
 	
 	leftMost = true;
-	pid = GetLeftLink();
+	pageNo = GetLeftLink();
 	return OK;
 }
 
@@ -405,11 +443,11 @@ Status BTIndexPage::FindKeyWithPage(PageID targetPid, int& key, bool& leftMost)
 		return OK;
 	}
 
-	for (int i = numOfSlots - 1; i >= 0; i--)
+	for (int i = numOfRecords - 1; i >= 0; i--)
 	{
 		PageID pageNo;
 		IndexEntry entry;
-		memcpy(&entry, (IndexEntry *)(data + slots[i].offset), sizeof(IndexEntry));
+		entry = GetEntry(i);
 		key = entry.key;
 		pageNo = entry.pid;
 		if (targetPid == pageNo) {
@@ -423,11 +461,11 @@ Status BTIndexPage::FindKeyWithPage(PageID targetPid, int& key, bool& leftMost)
 
 Status BTIndexPage::UpdateKey(PageID targetPid,int key)
 {
-	for (int i = numOfSlots - 1; i >= 0; i--)
+	for (int i = numOfRecords - 1; i >= 0; i--)
 	{
 		PageID pageNo;
 		IndexEntry entry;
-		memcpy(&entry, (IndexEntry *)(data + slots[i].offset), sizeof(IndexEntry));
+		entry = GetEntry(i);
 		pageNo = entry.pid;
 		if (targetPid == pageNo) {
 			RecordID rid;
@@ -43,13 +43,13 @@ BTLeafPage::Insert(const int key, const RecordID dataRid, RecordID& pairRid)
 Status 
 BTLeafPage::Delete(const int key, const RecordID dataRid, RecordID& rid)
 {
-	// Scan through all the records in this page and find the
-	// matching pair (key, dataRid).
+	// Binary search for the first record with this key, then scan
+	// the run of equal keys for the matching pair (key, dataRid).
 
-	for (int i = numOfSlots - 1; i >= 0; i--)
+	for (int i = LowerBound(key); i < numOfRecords && KeyAt(i) == key; i++)
 	{
-		LeafEntry* entry = GetEntry(i); 
-		if (entry->rid == dataRid && entry->key == key)
+		LeafEntry entry = GetEntry(i);
+		if (entry.rid == dataRid)
 		{
 			// We delete it here.			
 			rid.pageNo = PageNo();
@@ -82,16 +82,15 @@ Status
 BTLeafPage::GetFirst(int& key, RecordID& dataRid, RecordID& rid)
 {
 	// Initialize the record id of the first (key, dataRid) pair.  The
-	// first record is always at slot position 0, since SortedPage always
-	// compact it's records.  We can also use HeapPage::FirstRecord here
-	// but it is not neccessary.
+	// first record is always at slot position 0, since SortedPage keeps
+	// its records in a dense array.
 
 	rid.pageNo = pid;
 	rid.slotNo = 0;
 
 	// If there are no record in this page, just return DONE.
 	
-	if (numOfSlots == 0)
+	if (numOfRecords == 0)
 	{
 		dataRid.pageNo = INVALID_PAGE;
 		dataRid.slotNo = INVALID_SLOT;
@@ -99,12 +98,11 @@ BTLeafPage::GetFirst(int& key, RecordID& dataRid, RecordID& rid)
 	}
 	
 	// Otherwise, we just copy the record into key and dataRid,
-	// and returned.  The record is located at offset slots[0].offset
-	// from the beginning of data area (pointed to by member data in 
-	// HeapPage)
+	// and returned.  The record is the first entry of the data area
+	// (pointed to by member data in SortedPage)
 
 	LeafEntry entry;
-	memcpy(&entry, GetEntry(0), sizeof(LeafEntry));
+	entry = GetEntry(0);
 	key = entry.key;
 	dataRid = entry.rid;
 	
@@ -131,7 +129,7 @@ BTLeafPage::GetNext(int& key, RecordID& dataRid, RecordID& rid)
 {
 	// If we are at the end of records, return DONE.
 
-	if (rid.slotNo + 1 >= numOfSlots)
+	if (rid.slotNo + 1 >= numOfRecords)
 	{
 		dataRid.pageNo = INVALID_PAGE;
 		dataRid.slotNo = INVALID_SLOT;
@@ -140,17 +138,16 @@ BTLeafPage::GetNext(int& key, RecordID& dataRid, RecordID& rid)
 
 	// Increment the slotNo in rid to point to the next record in this
 	// page.  We can do this for subclass of SorterPage since the records
-	// in a sorted page is always compact.  
+	// in a sorted page are always dense.
 	
 	rid.slotNo++;
 
 	// Otherwise, we just copy the record into key and dataRid,
-	// and returned.  The record is located at offset 
-	// slots[rid.slotNo].offset from the beginning of data area 
-	// (pointed to by member data in HeapPage)
+	// and returned.  The record is entry rid.slotNo of the data area
+	// (pointed to by member data in SortedPage)
 
 	LeafEntry entry;
-	memcpy(&entry, GetEntry(rid.slotNo), sizeof(LeafEntry));
+	entry = GetEntry(rid.slotNo);
 	key = entry.key;
 	dataRid = entry.rid;
 	
@@ -177,7 +174,7 @@ BTLeafPage::GetCurrent(int& key, RecordID& dataRid, RecordID rid)
 	// Check if the current record id is valid.  If not, return
 	// DONE.
 
-	if (rid.slotNo >= numOfSlots)
+	if (rid.slotNo >= numOfRecords)
 	{
 		dataRid.pageNo = INVALID_PAGE;
 		dataRid.slotNo = INVALID_SLOT;
@@ -185,12 +182,11 @@ BTLeafPage::GetCurrent(int& key, RecordID& dataRid, RecordID rid)
 	}
 
 	// If it's valid, we just copy the record into key and dataRid,
-	// and returned.  The record is located at offset 
-	// slots[rid.slotNo].offset from the beginning of data area 
-	// (pointed to by member data in HeapPage)
+	// and returned.  The record is entry rid.slotNo of the data area
+	// (pointed to by member data in SortedPage)
 
 	LeafEntry entry;
-	memcpy(&entry, GetEntry(rid.slotNo), sizeof(LeafEntry));
+	entry = GetEntry(rid.slotNo);
 	key = entry.key;
 	dataRid = entry.rid;
 	
@@ -201,9 +197,9 @@ Status
 BTLeafPage::GetLast (RecordID& rid, int& key, RecordID & dataRid)
 {
 	rid.pageNo = pid;
-	rid.slotNo = numOfSlots - 1;
+	rid.slotNo = numOfRecords - 1;
 	
-	if (numOfSlots == 0)
+	if (numOfRecords == 0)
 	{
 		dataRid.pageNo = INVALID_PAGE;
 		dataRid.slotNo = INVALID_SLOT;
@@ -212,7 +208,7 @@ BTLeafPage::GetLast (RecordID& rid, int& key, RecordID & dataRid)
 	
 	
 	LeafEntry entry;
-	memcpy(&entry, (LeafEntry *)(data + slots[numOfSlots - 1].offset), sizeof(IndexEntry));
+	entry = GetEntry(numOfRecords - 1);
 	key = entry.key;
 	dataRid = entry.rid;
 	return OK;
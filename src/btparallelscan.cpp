@@ -0,0 +1,212 @@
+#include "minirel.h"
+#include "bufmgr.h"
+#include "btfile.h"
+#include "btparallelscan.h"
+
+
+//-------------------------------------------------------------------
+// BTreeParallelScan::BTreeParallelScan
+//
+// Input   : ordered - return entries in key order if true
+// Output  : None
+// Purpose : Create an empty scan; BTreeFile adds the partitions.
+//-------------------------------------------------------------------
+
+BTreeParallelScan::BTreeParallelScan(bool ordered)
+{
+	this->ordered = ordered;
+	this->cancelled = false;
+	this->current = 0;
+}
+
+
+//-------------------------------------------------------------------
+// BTreeParallelScan::~BTreeParallelScan
+//
+// Input   : None
+// Output  : None
+// Purpose : Stop the workers, wait for them and release the cursors.
+//-------------------------------------------------------------------
+
+BTreeParallelScan::~BTreeParallelScan()
+{
+	{
+		std::unique_lock<std::mutex> lock(latch);
+		cancelled = true;
+	}
+	spaceReady.notify_all();
+
+	for (size_t i = 0; i < partitions.size(); i++)
+	{
+		if (partitions[i]->worker.joinable())
+			partitions[i]->worker.join();
+		delete partitions[i]->cursor;
+		delete partitions[i];
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BTreeParallelScan::AddPartition
+//
+// Input   : tree - the index being scanned
+//           lowKey, highKey - bounds of the sub-range, NULL for open
+// Output  : None
+// Return  : OK if a cursor was opened on the sub-range, FAIL otherwise.
+// Purpose : Add one key sub-range.  Partitions must be added in key
+//           order.
+//-------------------------------------------------------------------
+
+Status
+BTreeParallelScan::AddPartition(BTreeFile* tree, const int* lowKey, const int* highKey)
+{
+	Partition *part = new Partition();
+	part->hasLowKey = (lowKey != NULL);
+	part->hasHighKey = (highKey != NULL);
+	part->lowKey = part->hasLowKey ? *lowKey : 0;
+	part->highKey = part->hasHighKey ? *highKey : 0;
+	part->finished = false;
+	part->status = DONE;
+
+	// The cursor keeps pointers to its bounds, so point it at the
+	// copies held by the partition.
+	part->cursor = (BTreeFileScan *)tree->OpenScan(
+			part->hasLowKey ? &part->lowKey : NULL,
+			part->hasHighKey ? &part->highKey : NULL);
+	if (part->cursor == NULL)
+	{
+		delete part;
+		return FAIL;
+	}
+
+	partitions.push_back(part);
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BTreeParallelScan::Start
+//
+// Purpose : Start one worker thread per partition.
+//-------------------------------------------------------------------
+
+void
+BTreeParallelScan::Start()
+{
+	for (size_t i = 0; i < partitions.size(); i++)
+	{
+		partitions[i]->worker = std::thread(&BTreeParallelScan::RunPartition, this, partitions[i]);
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BTreeParallelScan::RunPartition
+//
+// Input   : part - the partition this worker reads
+// Purpose : Worker body.  Drain the partition's cursor into its
+//           buffer, waiting whenever the consumer falls behind.
+//-------------------------------------------------------------------
+
+void
+BTreeParallelScan::RunPartition(Partition* part)
+{
+	Status s;
+	ScanEntry entry;
+
+	while (true)
+	{
+		s = part->cursor->GetNext(entry.rid, entry.key);
+
+		std::unique_lock<std::mutex> lock(latch);
+		if (s == OK)
+		{
+			while (!cancelled && (int)part->entries.size() >= PARALLEL_SCAN_BUFFER)
+			{
+				spaceReady.wait(lock);
+			}
+			if (!cancelled)
+			{
+				part->entries.push_back(entry);
+				dataReady.notify_all();
+				continue;
+			}
+		}
+
+		// Out of entries, failed, or the scan is being torn down.
+		part->status = (s == OK || s == DONE) ? DONE : FAIL;
+		part->finished = true;
+		dataReady.notify_all();
+		return;
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BTreeParallelScan::GetNext
+//
+// Input   : None
+// Output  : rid - record id of the scanned record
+//           key - key of the scanned record
+// Return  : OK if successful, DONE if no more records to read, FAIL
+//           if a worker failed.
+//-------------------------------------------------------------------
+
+Status
+BTreeParallelScan::GetNext(RecordID& rid, int& key)
+{
+	std::unique_lock<std::mutex> lock(latch);
+
+	while (true)
+	{
+		bool allFinished = true;
+		int first = ordered ? current : 0;
+		int last = ordered ? current + 1 : (int)partitions.size();
+
+		for (int i = first; i < last && i < (int)partitions.size(); i++)
+		{
+			Partition *part = partitions[i];
+			if (!part->entries.empty())
+			{
+				rid = part->entries.front().rid;
+				key = part->entries.front().key;
+				part->entries.pop_front();
+				spaceReady.notify_all();
+				return OK;
+			}
+			if (!part->finished)
+			{
+				allFinished = false;
+			}
+			else if (part->status == FAIL)
+			{
+				return FAIL;
+			}
+		}
+
+		if (ordered && current < (int)partitions.size() && allFinished)
+		{
+			// This partition is drained, move on to the next one.
+			current++;
+			continue;
+		}
+		if (allFinished)
+			return DONE;
+
+		dataReady.wait(lock);
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BTreeParallelScan::DeleteCurrent
+//
+// Return  : FAIL; entries cannot be deleted through a parallel scan.
+//-------------------------------------------------------------------
+
+Status
+BTreeParallelScan::DeleteCurrent()
+{
+	cerr << "DeleteCurrent is not supported on a parallel scan" << endl;
+	return FAIL;
+}
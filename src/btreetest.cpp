@@ -9,26 +9,41 @@
 
 #include "bufmgr.h"
 #include "db.h"
+#include "log.h"
 #include "btfile.h"
+#include "heapfile.h"
+#include "heapfilescan.h"
+#include "concurrencytest.h"
+#include "recoverytest.h"
+#include "codectest.h"
 #include "btreetest.h"
 
 #define MAX_COMMAND_SIZE 1000
 
-Status BTreeTest::RunTests(istream& in) {
+extern int MINIBASE_RESTART_FLAG;
+
+Status BTreeTest::RunTests(istream& in, unsigned pageSize, const char* policy, double dirtyTarget,
+                           DBIOMode iomode, bool trackHeat) {
 
 	const char* dbname = "btdb";
 	const char* logname = "btlog";
 	const char* btfname = "BTreeIndex";
+	const char* hfname = "HeapTest";
+	int heapRecords = -1;	// records heaptest was run with
+	int failures = 0;
 
 	remove(dbname);
 	remove(logname);
 
 	Status status;
-	minibase_globals = new SystemDefs(status, dbname, logname, 1000, 500, 200);
+	minibase_globals = new SystemDefs(status, dbname, logname, 1000, 500, 200, policy, pageSize, iomode);
 	if (status != OK) {
 		minibase_errors.show_errors();
 		exit(1);
 	}
+	if (dirtyTarget >= 0)
+		MINIBASE_BM->SetDirtyTarget(dirtyTarget);
+	MINIBASE_BM->TrackHeat(trackHeat);
 	
 	BTreeFile* btf = createIndex(btfname);
 	if (btf == nullptr) {
@@ -48,6 +63,11 @@ Status BTreeTest::RunTests(istream& in) {
 			in >> low >> high;
 			scanHighLow(btf, low, high);
 		}
+		else if (!strcmp(command, "pscan")) {
+			int low, high, threads;
+			in >> low >> high >> threads;
+			parallelScanHighLow(btf, low, high, threads);
+		}
 		else if (!strcmp(command, "delete")) {
 			int low, high;
 			in >> low >> high;
@@ -62,7 +82,105 @@ Status BTreeTest::RunTests(istream& in) {
 			btf->Print();
 		}
 		else if (!strcmp(command, "stats")) {
+			// Walking the tree for the figures is not an access.
+			MINIBASE_BM->TrackHeat(false);
 			btf->DumpStatistics();
+			if (trackHeat) {
+				btf->TagPages();
+				MINIBASE_BM->PrintHotPages();
+			}
+			MINIBASE_BM->TrackHeat(trackHeat);
+		}
+		else if (!strcmp(command, "bufstats")) {
+			MINIBASE_BM->PrintStat();
+		}
+		else if (!strcmp(command, "logstats")) {
+			MINIBASE_LOG->PrintStat();
+		}
+		else if (!strcmp(command, "logcheck")) {
+			// Checkpoints keep the log within its size, whatever
+			// files are open.
+			MINIBASE_LOG->PrintStat();
+			if (MINIBASE_LOG->GetSize() > MINIBASE_LOG->GetMaxSize()) {
+				cout << "  Error: the log has outgrown its size" << endl;
+				failures++;
+			}
+		}
+		else if (!strcmp(command, "metrics")) {
+			MINIBASE_BM->WriteMetrics(cout);
+		}
+		else if (!strcmp(command, "verify")) {
+			btf->Verify();
+		}
+		else if (!strcmp(command, "checkpoint")) {
+			if (MINIBASE_LOG->Checkpoint() != OK)
+				cout << "Error: checkpoint failed" << endl;
+		}
+		else if (!strcmp(command, "savewarm")) {
+			char file[MAX_COMMAND_SIZE];
+			in >> file;
+			std::vector<PageID> upper;
+			btf->GetUpperPages(upper);
+			if (MINIBASE_BM->SaveWarmList(file, &upper) != OK)
+				cout << "Error: cannot save the warm list" << endl;
+		}
+		else if (!strcmp(command, "warmup")) {
+			char file[MAX_COMMAND_SIZE];
+			in >> file;
+			int pages;
+			long started = LatencyHistogram::Now();
+			if (MINIBASE_BM->WarmUp(file, &pages) != OK)
+				cout << "Error: cannot warm up from " << file << endl;
+			else
+				cout << "Warmed up " << pages << " pages in "
+				     << (LatencyHistogram::Now() - started) / 1000000.0 << " ms" << endl;
+		}
+		else if (!strcmp(command, "heaptest")) {
+			in >> heapRecords;
+			if (heapTest(hfname, heapRecords) != OK)
+				failures++;
+		}
+		else if (!strcmp(command, "heapcheck")) {
+			if (heapRecords < 0)
+				cout << "Error: heapcheck needs a heaptest first" << endl;
+			if (heapRecords < 0 || heapCheck(hfname, heapRecords) != OK)
+				failures++;
+		}
+		else if (!strcmp(command, "concurrency")) {
+			int threads, keys;
+			in >> threads >> keys;
+			ConcurrencyTest test;
+			if (test.Run(threads, keys) != OK)
+				failures++;
+		}
+		else if (!strcmp(command, "crashtest")) {
+			int rounds, threads;
+			in >> rounds >> threads;
+			RecoveryTest test(pageSize, policy, iomode);
+			if (test.Run(rounds, threads) != OK)
+				failures++;
+		}
+		else if (!strcmp(command, "warmtest")) {
+			int keys;
+			in >> keys;
+			RecoveryTest test(pageSize, policy, iomode);
+			if (test.WarmUp(keys) != OK)
+				failures++;
+		}
+		else if (!strcmp(command, "codectest")) {
+			int pages;
+			in >> pages;
+			CodecTest test;
+			if (test.Run(pages) != OK)
+				failures++;
+		}
+		else if (!strcmp(command, "restart")) {
+			btf = crashAndRestart(btf, dbname, logname, btfname, policy, iomode);
+			if (btf == nullptr)
+				exit(1);
+			if (dirtyTarget >= 0)
+				MINIBASE_BM->SetDirtyTarget(dirtyTarget);
+			MINIBASE_BM->TrackHeat(trackHeat);
 		}
 		else if (!strcmp(command, "quit")) {
 			break;
@@ -79,13 +197,13 @@ Status BTreeTest::RunTests(istream& in) {
 	remove(dbname);
 	remove(logname);
 
-	return OK;
+	return (failures == 0) ? OK : FAIL;
 }
 
 
 BTreeFile* BTreeTest::createIndex(const char* name) {
     cout << "Create B+tree." << endl;
-    cout << "  Page size=" << MINIBASE_PAGESIZE << " Max space=" << MAX_SPACE << endl;
+    cout << "  Page size=" << MINIBASE_DB->GetPageSize() << " Max space=" << SortedPage::DataSize() << endl;
 	
     Status status;
     BTreeFile* btf = new BTreeFile(status, name);
@@ -103,6 +221,28 @@ BTreeFile* BTreeTest::createIndex(const char* name) {
 }
 
 
+// Drop the pool without writing it back, as a crash would, and open
+// the database again, which redoes the log since its last checkpoint.
+BTreeFile* BTreeTest::crashAndRestart(BTreeFile* btf, const char* dbname, const char* logname,
+                                      const char* btfname, const char* policy, DBIOMode iomode) {
+	cout << "Crash and restart." << endl;
+	delete btf;
+	delete minibase_globals;
+
+	Status status;
+	MINIBASE_RESTART_FLAG = 1;
+	minibase_globals = new SystemDefs(status, dbname, logname, 0, 500, 200, policy, 0, iomode);
+	MINIBASE_RESTART_FLAG = 0;
+	if (status != OK) {
+		minibase_errors.show_errors();
+		cout << "  Error: cannot restart the database." << endl;
+		return nullptr;
+	}
+	MINIBASE_LOG->PrintStat();
+	return createIndex(btfname);
+}
+
+
 void BTreeTest::destroyIndex(BTreeFile* btf, const char* name) {
 	if (btf == nullptr) return;	
 	cout << "Destroy B+tree." << endl;
@@ -172,6 +312,39 @@ void BTreeTest::scanHighLow(BTreeFile* btf, int low, int high) {
 }
 
 
+void BTreeTest::parallelScanHighLow(BTreeFile* btf, int low, int high, int threads) {
+	cout << "Parallel scanning (" << low << " to " << high << ") with " << threads << " threads:" << endl;
+
+	int* plow = (low == -1 ? nullptr : &low);
+	int* phigh = (high == -1 ? nullptr : &high);
+
+	IndexFileScan* scan = btf->OpenParallelScan(plow, phigh, threads);
+	if (scan == nullptr) {
+		cout << "  Error: cannot open a scan." << endl;
+		minibase_errors.show_errors();
+		return;
+	}
+
+	RecordID rid;
+	int ikey, count = 0;
+	Status status = scan->GetNext(rid, ikey);
+	while (status == OK) {
+		count++;
+		cout << "  Scanned @[pg,slot]=[" << rid.pageNo << "," << rid.slotNo << "]";
+		cout << " key=" << ikey << endl;
+		status = scan->GetNext(rid, ikey);
+	}
+	delete scan;
+	cout << "  " << count << " records found." << endl;
+
+	if (status != DONE) {
+		minibase_errors.show_errors();
+		return;
+	}
+	cout << "  Success." << endl;
+}
+
+
 void BTreeTest::deleteHighLow(BTreeFile* btf, int low, int high) {
 	cout << "Deleting (" << low << "-" << high << "):" << endl;
 
@@ -257,3 +430,93 @@ void BTreeTest::deleteScanHighLow(BTreeFile* btf, int low, int high) {
     }
 	cout << "  Success." << endl;
 }
+
+
+// The record heaptest inserts as number i: i, then bytes that depend on
+// i and on whether it has been updated.  Its length is 8 to 107 bytes.
+static int heapRecord(int i, bool updated, char* rec) {
+	int len = 8 + i % 100;
+	memcpy(rec, &i, sizeof(int));
+	for (int j = sizeof(int); j < len; j++)
+		rec[j] = (char)((i * 7 + j) ^ (updated ? 0x5a : 0));
+	return len;
+}
+
+
+// Create heap file name afresh, insert records 0 to n - 1, delete every
+// third and update every fifth of the rest in place, then check it.
+Status BTreeTest::heapTest(const char* name, int n) {
+	cout << "Heap file test with " << n << " records." << endl;
+
+	Status status;
+	HeapFile* hf = new HeapFile(status, name);
+	if (status == OK && hf->GetNumOfRecords() > 0) {
+		status = hf->DestroyFile();
+		delete hf;
+		hf = new HeapFile(status, name);
+	}
+	if (status != OK) {
+		minibase_errors.show_errors();
+		cout << "  Error: cannot create heap file." << endl;
+		delete hf;
+		return FAIL;
+	}
+
+	std::vector<RecordID> rids(n);
+	char rec[MAX_SPACE];
+	for (int i = 0; i < n && status == OK; i++)
+		status = hf->InsertRecord(rec, heapRecord(i, false, rec), rids[i]);
+	for (int i = 0; i < n && status == OK; i += 3)
+		status = hf->DeleteRecord(rids[i]);
+	for (int i = 1; i < n && status == OK; i++) {
+		if (i % 3 != 0 && i % 5 == 0)
+			status = hf->UpdateRecord(rids[i], rec, heapRecord(i, true, rec));
+	}
+	delete hf;
+	if (status != OK) {
+		minibase_errors.show_errors();
+		cout << "  Error: heap file operation failed." << endl;
+		return FAIL;
+	}
+	return heapCheck(name, n);
+}
+
+
+// Check that heap file name holds exactly what heapTest(name, n) left,
+// by a scan and by its record count.
+Status BTreeTest::heapCheck(const char* name, int n) {
+	Status status;
+	HeapFile* hf = new HeapFile(status, name);
+	if (status != OK) {
+		minibase_errors.show_errors();
+		cout << "  Error: cannot open heap file." << endl;
+		delete hf;
+		return FAIL;
+	}
+
+	std::vector<bool> seen(n, false);
+	int expected = n - (n + 2) / 3;
+	int count = 0, errors = 0;
+	HeapFileScan* scan = hf->OpenScan(4);
+	RecordID rid;
+	char rec[MAX_SPACE], want[MAX_SPACE];
+	int len, i;
+	while ((status = scan->GetNext(rid, rec, len)) == OK) {
+		count++;
+		memcpy(&i, rec, sizeof(int));
+		if (i < 0 || i >= n || i % 3 == 0 || seen[i] ||
+		    len != heapRecord(i, i % 5 == 0, want) || memcmp(rec, want, len) != 0) {
+			errors++;
+			continue;
+		}
+		seen[i] = true;
+	}
+	delete scan;
+	if (status != DONE || count != expected || hf->GetNumOfRecords() != expected)
+		errors++;
+	delete hf;
+
+	cout << "  Heap file check: " << count << " of " << expected << " records, "
+	     << errors << " errors." << endl;
+	return (errors == 0) ? OK : FAIL;
+}
@@ -0,0 +1,268 @@
+#include "minirel.h"
+#include "bufmgr.h"
+#include "btindex.h"
+#include "bttraverse.h"
+
+
+//-------------------------------------------------------------------
+// CollectChildren
+//
+// Input   : node - the index node being visited
+//           index - the pinned page of that node
+// Output  : children - one entry per child pointer, left to right
+// Purpose : Turn the child pointers of an index node into the next
+//           level's work list, narrowing the key bounds with the
+//           separator keys on the way.
+//-------------------------------------------------------------------
+
+static void
+CollectChildren(const BTNodeInfo& node, BTIndexPage* index, std::vector<BTNodeInfo>& children)
+{
+	BTNodeInfo child = node;
+	child.level = node.level + 1;
+	child.pid = index->GetLeftLink();
+
+	RecordID curRid;
+	int key;
+	PageID curPageID;
+	Status s = index->GetFirst(key, curPageID, curRid);
+	while (s == OK)
+	{
+		// The child to the left of this separator ends at the separator.
+		child.hasHighKey = true;
+		child.highKey = key;
+		if (child.pid != INVALID_PAGE)
+			children.push_back(child);
+
+		child.hasLowKey = true;
+		child.lowKey = key;
+		child.hasHighKey = node.hasHighKey;
+		child.highKey = node.highKey;
+		child.pid = curPageID;
+
+		s = index->GetNext(key, curPageID, curRid);
+	}
+
+	if (child.pid != INVALID_PAGE)
+		children.push_back(child);
+}
+
+
+//-------------------------------------------------------------------
+// BTreeTraversal::BTreeTraversal
+//
+// Input   : numThreads - size of the thread pool, <= 0 for one per core
+//           batchSize - pages of a level pinned at a time
+// Output  : None
+// Purpose : Set up a traversal engine.
+//-------------------------------------------------------------------
+
+BTreeTraversal::BTreeTraversal(int numThreads, int batchSize)
+{
+	this->pool = new ThreadPool(numThreads);
+	this->batchSize = (batchSize > 0) ? batchSize : 1;
+}
+
+
+BTreeTraversal::~BTreeTraversal()
+{
+	delete pool;
+}
+
+
+//-------------------------------------------------------------------
+// BTreeTraversal::Run
+//
+// Input   : rootPid - root of the tree to walk
+//           visitor - called once per node, may be NULL
+//           freePages - free each page after visiting it
+// Output  : None
+// Return  : OK if every node was pinned and visited successfully,
+//           FAIL otherwise.
+// Purpose : Walk the tree level by level.  The coordinating thread
+//           pins batch k+1 of a level while the pool visits batch k.
+//-------------------------------------------------------------------
+
+Status
+BTreeTraversal::Run(PageID rootPid, BTreeVisitor* visitor, bool freePages)
+{
+	if (rootPid == INVALID_PAGE)
+		return OK;
+
+	// Keep the two batches in flight well inside the buffer pool.
+	int batch = (int)MINIBASE_BM->GetNumOfUnpinnedFrames() / 4;
+	if (batch > batchSize)
+		batch = batchSize;
+	if (batch < 1)
+		batch = 1;
+	BufferStrategy strategy(3 * batch);
+
+	BTNodeInfo root;
+	root.pid = rootPid;
+	root.level = 0;
+	root.position = 0;
+	root.hasLowKey = false;
+	root.hasHighKey = false;
+	root.lowKey = 0;
+	root.highKey = 0;
+
+	std::vector<BTNodeInfo> level(1, root);
+	Status result = OK;
+
+	for (int depth = 0; !level.empty(); depth++)
+	{
+		if (depth >= TRAVERSE_MAX_LEVELS)
+		{
+			cerr << "Traversal deeper than " << TRAVERSE_MAX_LEVELS << " levels, giving up" << endl;
+			return FAIL;
+		}
+
+		int n = (int)level.size();
+		std::vector<std::vector<BTNodeInfo> > children(n);
+		std::vector<SortedPage *> pages(n, (SortedPage *)NULL);
+		std::vector<Status> results(n, OK);
+
+		int first = 0;
+		int count = (batch < n) ? batch : n;
+		if (PinBatch(&level[0], count, &pages[0], &strategy) != OK)
+			return FAIL;
+
+		while (first < n)
+		{
+			// Split the pinned batch into one slice per worker.
+			int numThreads = pool->GetNumOfThreads();
+			int slice = (count + numThreads - 1) / numThreads;
+			for (int s = first; s < first + count; s += slice)
+			{
+				int len = (first + count - s < slice) ? first + count - s : slice;
+				BTNodeInfo *nodes = &level[s];
+				SortedPage **slicePages = &pages[s];
+				std::vector<BTNodeInfo> *sliceChildren = &children[s];
+				Status *sliceResults = &results[s];
+				pool->Submit([=]() {
+					VisitSlice(visitor, nodes, slicePages, len, sliceChildren, sliceResults);
+				});
+			}
+
+			// Prefetch the next batch while the workers are busy.
+			int next = first + count;
+			int nextCount = (batch < n - next) ? batch : n - next;
+			Status pinStatus = OK;
+			if (nextCount > 0)
+				pinStatus = PinBatch(&level[next], nextCount, &pages[next], &strategy);
+
+			pool->Wait();
+
+			if (ReleaseBatch(&level[first], count, freePages) != OK)
+				result = FAIL;
+			if (pinStatus != OK)
+				return FAIL;
+
+			first = next;
+			count = nextCount;
+		}
+
+		// The children, in order, make up the next level.
+		std::vector<BTNodeInfo> nextLevel;
+		for (int i = 0; i < n; i++)
+		{
+			if (results[i] != OK)
+				result = FAIL;
+			for (size_t j = 0; j < children[i].size(); j++)
+			{
+				nextLevel.push_back(children[i][j]);
+				nextLevel.back().position = (int)nextLevel.size() - 1;
+			}
+		}
+		level.swap(nextLevel);
+	}
+
+	return result;
+}
+
+
+//-------------------------------------------------------------------
+// BTreeTraversal::PinBatch
+//
+// Input   : nodes - the nodes to pin, n - how many
+//           strategy - the ring to read them through
+// Output  : pages - the pinned pages
+// Purpose : Prefetch the whole batch, so its reads are in flight
+//           together, then pin it page by page.
+// Return  : OK if all pages are pinned.  On FAIL nothing stays pinned.
+//-------------------------------------------------------------------
+
+Status
+BTreeTraversal::PinBatch(const BTNodeInfo* nodes, int n, SortedPage** pages,
+                         BufferStrategy* strategy)
+{
+	std::vector<PageID> pids(n);
+	for (int i = 0; i < n; i++)
+	{
+		pids[i] = nodes[i].pid;
+	}
+	MINIBASE_BM->Prefetch(&pids[0], n, strategy);
+
+	for (int i = 0; i < n; i++)
+	{
+		if (MINIBASE_BM->PinPage(nodes[i].pid, (Page *&)pages[i], false, strategy) != OK)
+		{
+			cerr << "Unable to pin page " << nodes[i].pid << endl;
+			for (int j = 0; j < i; j++)
+			{
+				MINIBASE_BM->UnpinPage(nodes[j].pid, CLEAN);
+			}
+			return FAIL;
+		}
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BTreeTraversal::ReleaseBatch
+//
+// Input   : nodes - the pinned nodes, n - how many
+//           freePages - free the pages instead of unpinning them
+// Return  : OK if every page was released, FAIL otherwise.
+//-------------------------------------------------------------------
+
+Status
+BTreeTraversal::ReleaseBatch(const BTNodeInfo* nodes, int n, bool freePages)
+{
+	Status result = OK;
+	for (int i = 0; i < n; i++)
+	{
+		Status s = freePages ? MINIBASE_BM->FreePage(nodes[i].pid)
+		                     : MINIBASE_BM->UnpinPage(nodes[i].pid, CLEAN);
+		if (s != OK)
+		{
+			cerr << "Unable to release page " << nodes[i].pid << endl;
+			result = FAIL;
+		}
+	}
+	return result;
+}
+
+
+//-------------------------------------------------------------------
+// BTreeTraversal::VisitSlice
+//
+// Purpose : Worker body.  Visit n pinned nodes and collect the child
+//           pointers of the index nodes among them.
+//-------------------------------------------------------------------
+
+void
+BTreeTraversal::VisitSlice(BTreeVisitor* visitor, const BTNodeInfo* nodes,
+		SortedPage** pages, int n, std::vector<BTNodeInfo>* children,
+		Status* results)
+{
+	for (int i = 0; i < n; i++)
+	{
+		results[i] = (visitor != NULL) ? visitor->Visit(nodes[i], pages[i]) : OK;
+		if (pages[i]->GetType() == INDEX_NODE)
+		{
+			CollectChildren(nodes[i], (BTIndexPage *)pages[i], children[i]);
+		}
+	}
+}
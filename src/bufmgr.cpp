@@ -0,0 +1,2000 @@
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <map>
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bufmgr.h"
+#include "log.h"
+
+
+static const unsigned WARM_MAGIC = 0x574d424d;		// "MBMW"
+
+// The warm list file: a header, then the entries.
+struct WarmListHeader {
+	unsigned magic;
+	unsigned pageSize;		// of the database the pages are from
+	unsigned count;			// entries
+	unsigned unused;
+};
+
+struct WarmListEntry {
+	PageID pid;
+	int    rank;			// a WarmRank
+};
+
+enum WarmRank {
+	WARM_FIRST,				// asked for first
+	WARM_REFERENCED,		// found referenced
+	WARM_OTHER
+};
+
+
+//-------------------------------------------------------------------
+// BufMgr::BufMgr
+//
+// Input   : bufSize - number of frames in the pool
+//           pageSize - size of the pages of the database the pool
+//                      will serve
+//           replacementPolicy - name of the replacement policy, see
+//                               Replacer::Create
+//           mapped - true to serve pages from the mapped database
+//                    instead
+// Purpose : Create a buffer pool of bufSize empty frames, with their
+//           pages in one arena, and start its background writer.  A
+//           mapped pool has neither.
+//-------------------------------------------------------------------
+
+BufMgr::BufMgr( unsigned int bufSize, int pageSize, const char* replacementPolicy,
+                bool mapped )
+{
+	this->mapped = mapped;
+	numOfFrames = mapped ? 0 : bufSize;
+	this->pageSize = pageSize;
+	numOfDirty = 0;
+	prefetching = 0;
+	lookahead = 0;
+	missesSinceSweep = 0;
+	stalled = false;
+	stopWriter = false;
+	checkpointWanted = false;
+	trackHeat = false;
+	frames = new Frame*[numOfFrames];
+	frameStore = NULL;
+	reads = NULL;
+	arena = NULL;
+	arenaSize = 0;
+	arenaMapped = false;
+	if (mapped)
+	{
+		pageTable = NULL;
+		replacer = NULL;
+		dirtyLimit = 0;
+		ResetStat();
+		return;
+	}
+
+	AllocateArena();
+	reads = new IORequest[numOfFrames];
+	void *store = NULL;
+	if (posix_memalign(&store, FRAME_ALIGN, numOfFrames * sizeof(Frame)) != 0)
+	{
+		throw std::bad_alloc();
+	}
+	frameStore = (Frame *)store;
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		Page *page = (Page *)(arena + (size_t)i * pageSize);
+		frames[i] = new (&frameStore[i]) Frame(page, &reads[i], &numOfDirty);
+	}
+	pageTable = new PageTable(numOfFrames);
+	replacer = Replacer::Create(replacementPolicy, numOfFrames, frames, pageTable);
+
+	SetDirtyTarget(BUF_DIRTY_TARGET);
+	lookahead = numOfFrames / 4 + 1;
+	ResetStat();
+	writer = std::thread(&BufMgr::WriterLoop, this);
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::~BufMgr
+//
+// Purpose : Free the pool once any prefetches have landed.  Pages are
+//           not written back; call FlushAllPages first to keep changes.
+//-------------------------------------------------------------------
+
+BufMgr::~BufMgr()
+{
+	{
+		std::lock_guard<std::mutex> guard(writerLatch);
+		stopWriter = true;
+	}
+	writerWake.notify_one();
+	if (writer.joinable())
+	{
+		writer.join();
+	}
+
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		frames[i]->WaitRead();
+		frames[i]->~Frame();
+	}
+	free(frameStore);
+	delete [] reads;
+	FreeArena();
+	delete [] frames;
+	delete replacer;
+	delete pageTable;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::AllocateArena
+//
+// Purpose : Allocate the frames' pages, zeroed, in one piece aligned
+//           to the system's page size, so every frame suits O_DIRECT.
+//           An arena of BUF_HUGE_PAGE or more is aligned to a huge page
+//           and asked to be backed by huge pages, so that sweeping the
+//           pool takes fewer TLB entries.
+//-------------------------------------------------------------------
+
+void BufMgr::AllocateArena()
+{
+	size_t align = (size_t)sysconf(_SC_PAGESIZE);
+	size_t need = (size_t)numOfFrames * pageSize;
+	if (need >= BUF_HUGE_PAGE)
+	{
+		align = BUF_HUGE_PAGE;
+	}
+	arenaSize = (need + align - 1) / align * align;
+
+	// Map an extra alignment's worth and trim it off both ends.
+	char *p = (char *)mmap(NULL, arenaSize + align, PROT_READ | PROT_WRITE,
+	                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p != MAP_FAILED)
+	{
+		arena = (char *)(((uintptr_t)p + align - 1) / align * align);
+		if (arena > p)
+		{
+			munmap(p, arena - p);
+		}
+		munmap(arena + arenaSize, p + align - arena);
+		if (align == BUF_HUGE_PAGE)
+		{
+			madvise(arena, arenaSize, MADV_HUGEPAGE);
+		}
+		arenaMapped = true;
+		return;
+	}
+
+	void *heap = NULL;
+	if (posix_memalign(&heap, align, arenaSize) != 0)
+	{
+		throw std::bad_alloc();
+	}
+	arena = (char *)heap;
+	memset(arena, 0, arenaSize);
+	arenaMapped = false;
+}
+
+
+void BufMgr::FreeArena()
+{
+	if (arenaMapped)
+	{
+		munmap(arena, arenaSize);
+	}
+	else
+	{
+		free(arena);
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::StatShardOf
+//
+// Return  : The statistics shard of the calling thread.
+//-------------------------------------------------------------------
+
+int BufMgr::StatShardOf()
+{
+	static thread_local int shard =
+		(int)(std::hash<std::thread::id>()(std::this_thread::get_id()) % BUF_STAT_SHARDS);
+	return shard;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::PinPage
+//
+// Input   : pid - the page to pin
+//           emptyPage - true if the page's old contents are not needed,
+//                       so it need not be read from disk
+//           strategy - the ring to read the page into on a miss, or
+//                      NULL to take a frame from the whole pool
+// Output  : page - the page in the pool
+// Purpose : Pin page pid, bringing it into the pool if it is not there.
+//           A page being read in is entered in the page table before
+//           its read starts, so other threads pinning it wait for that
+//           read rather than reading it again.  A mapped pool just
+//           hands out the page in the mapping, which always hits.
+// Return  : OK, or FAIL if the pool is full or the page cannot be read.
+//-------------------------------------------------------------------
+
+Status BufMgr::PinPage( PageID pid, Page*& page, bool emptyPage, BufferStrategy* strategy )
+{
+	long start = LatencyHistogram::Now();
+	StatShard& stat = stats[StatShardOf()];
+	stat.totalCall.fetch_add(1, std::memory_order_relaxed);
+	if (trackHeat)
+	{
+		CountHeat(pid, &PageHeat::pins);
+	}
+
+	if (mapped)
+	{
+		page = MINIBASE_DB->GetMappedPage(pid);
+		if (page == NULL)
+		{
+			cerr << "  Cannot read page " << pid << endl;
+			return FAIL;
+		}
+		stat.totalHit.fetch_add(1, std::memory_order_relaxed);
+		pinHitLatency.RecordSince(start);
+		return OK;
+	}
+
+	PageTable::Partition& part = pageTable->Of(pid);
+	int f;
+	{
+		std::lock_guard<std::mutex> guard(part.latch);
+		f = part.table->LookUp(pid);
+		if (f != INVALID_FRAME)
+		{
+			frames[f]->Pin();
+		}
+	}
+
+	if (f != INVALID_FRAME)
+	{
+		stat.totalHit.fetch_add(1, std::memory_order_relaxed);
+		replacer->PageHit(f);
+		Status s = WaitForRead(f, pid, page);
+		pinHitLatency.RecordSince(start);
+		return s;
+	}
+
+	// The victim is found with no partition latched, as evicting it
+	// latches the victim's own partition.
+	PageID evicted;
+	bool written;
+	f = (strategy != NULL) ? RingVictim(strategy, pid, &evicted, &written)
+	                       : replacer->PickVictim(pid, &evicted, &written);
+	if (f == INVALID_FRAME)
+	{
+		cerr << "   Buffer is full.\n";
+		return FAIL;
+	}
+	if (trackHeat)
+	{
+		CountEviction(evicted, written);
+	}
+	if (++missesSinceSweep == lookahead / 2 + 1)
+	{
+		writerWake.notify_one();
+	}
+
+	std::unique_lock<std::mutex> lock(part.latch);
+	int loaded = part.table->LookUp(pid);
+	if (loaded != INVALID_FRAME)
+	{
+		// Another thread brought the page in meanwhile.
+		frames[loaded]->Pin();
+		lock.unlock();
+		frames[f]->Unpin();
+		replacer->PageRemoved(f, INVALID_PAGE);
+		stat.totalHit.fetch_add(1, std::memory_order_relaxed);
+		replacer->PageHit(loaded);
+		Status s = WaitForRead(loaded, pid, page);
+		pinHitLatency.RecordSince(start);
+		return s;
+	}
+	if (trackHeat)
+	{
+		CountHeat(pid, &PageHeat::misses);
+	}
+
+	if (!emptyPage)
+	{
+		frames[f]->MarkRead(pid);
+	}
+	else
+	{
+		frames[f]->SetPageID(pid);
+	}
+	part.table->Insert(pid, f);
+	replacer->PageLoaded(f, pid);
+	lock.unlock();
+
+	// Submitting may wait for room among the reads in flight, whose
+	// completions can need the partition latch.
+	if (!emptyPage)
+	{
+		frames[f]->StartRead();
+	}
+	Status s = WaitForRead(f, pid, page);
+	pinMissLatency.RecordSince(start);
+	return s;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::RingVictim
+//
+// Input   : strategy - the ring
+//           pid - the page that is to be brought in
+// Output  : evicted, written - as for Replacer::PickVictim
+// Purpose : Take the ring's next frame back for pid, or, if it cannot
+//           be had, a victim from the whole pool to take its place.
+// Return  : The frame, empty and pinned once, or INVALID_FRAME if
+//           every frame is pinned.
+//-------------------------------------------------------------------
+
+int BufMgr::RingVictim( BufferStrategy* strategy, PageID pid, PageID* evicted, bool* written )
+{
+	int size = (int)strategy->ring.size();
+	if (size > (int)numOfFrames / 2)
+	{
+		size = (numOfFrames / 2 > 0) ? numOfFrames / 2 : 1;
+	}
+	BufferStrategy::Slot& slot = strategy->ring[strategy->next % size];
+	strategy->next = (strategy->next + 1) % size;
+
+	int f = INVALID_FRAME;
+	if (slot.frame != INVALID_FRAME)
+	{
+		f = replacer->Reuse(slot.frame, slot.pid, pid, evicted, written);
+	}
+	if (f == INVALID_FRAME)
+	{
+		f = replacer->PickVictim(pid, evicted, written);
+	}
+	slot.frame = f;
+	slot.pid = pid;
+	return f;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::WaitForRead
+//
+// Input   : f - the frame holding pid, pinned by the caller
+// Output  : page - the page in the pool
+// Purpose : Wait until the read bringing pid into f, if any, completes.
+//           If it failed the caller's pin is dropped.  A page being
+//           written back by the background writer is waited for too.
+// Return  : OK, or FAIL if the page cannot be read.
+//-------------------------------------------------------------------
+
+Status BufMgr::WaitForRead( int f, PageID pid, Page*& page )
+{
+	if (frames[f]->WaitRead() != OK)
+	{
+		ReadFailed(f, pid);
+		cerr << "  Cannot read page " << pid << endl;
+		return FAIL;
+	}
+	frames[f]->WaitWritten();
+	page = frames[f]->GetPage();
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::ReadFailed
+//
+// Input   : f - the frame that failed to read pid, pinned by the caller
+// Purpose : Drop the caller's pin on f.  The page leaves the page table
+//           at once, so the next pin tries the read again, and the last
+//           pin to go empties the frame.
+//-------------------------------------------------------------------
+
+void BufMgr::ReadFailed( int f, PageID pid )
+{
+	PageTable::Partition& part = pageTable->Of(pid);
+	std::lock_guard<std::mutex> guard(part.latch);
+
+	if (part.table->LookUp(pid) == f)
+	{
+		part.table->Delete(pid);
+	}
+	if (frames[f]->GetPinCount() == 1)
+	{
+		frames[f]->EmptyIt();
+		frames[f]->Unpin();
+		replacer->PageRemoved(f, pid);
+	}
+	else
+	{
+		frames[f]->Unpin();
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::Prefetch
+//
+// Input   : pids - pages about to be pinned, n - how many
+//           strategy - as for PinPage
+// Purpose : Start reading those of the pages that are not in the pool,
+//           without waiting for the reads, so that many are in flight
+//           at once.  A page being prefetched holds a pin until its
+//           read completes; to leave room for other pins, prefetches
+//           from all threads together hold at most half the pool.
+//           Pinning the pages later waits for their reads.  A mapped
+//           pool asks the system to read them ahead instead.
+// Return  : OK.  A page that cannot be prefetched is just skipped.
+//-------------------------------------------------------------------
+
+Status BufMgr::Prefetch( PageID* pids, int n, BufferStrategy* strategy )
+{
+	if (mapped)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			MINIBASE_DB->PrefetchMapped(pids[i], 1);
+		}
+		return OK;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		PageID pid = pids[i];
+		PageTable::Partition& part = pageTable->Of(pid);
+		{
+			std::lock_guard<std::mutex> guard(part.latch);
+			if (part.table->LookUp(pid) != INVALID_FRAME)
+			{
+				continue;
+			}
+		}
+
+		if (prefetching.fetch_add(1) >= (int)numOfFrames / 2)
+		{
+			prefetching--;
+			break;
+		}
+		PageID evicted;
+		bool written;
+		int f = (strategy != NULL) ? RingVictim(strategy, pid, &evicted, &written)
+		                           : replacer->PickVictim(pid, &evicted, &written);
+		if (f == INVALID_FRAME)
+		{
+			prefetching--;
+			break;
+		}
+		if (trackHeat)
+		{
+			CountEviction(evicted, written);
+		}
+
+		std::unique_lock<std::mutex> lock(part.latch);
+		if (part.table->LookUp(pid) != INVALID_FRAME)
+		{
+			lock.unlock();
+			frames[f]->Unpin();
+			replacer->PageRemoved(f, INVALID_PAGE);
+			prefetching--;
+			continue;
+		}
+
+		frames[f]->MarkRead(pid, [this, f, pid](IORequest* read) {
+			if (read->GetStatus() == OK)
+			{
+				frames[f]->Unpin();
+			}
+			else
+			{
+				ReadFailed(f, pid);
+			}
+			prefetching--;
+		});
+		part.table->Insert(pid, f);
+		replacer->PageLoaded(f, pid);
+		lock.unlock();
+
+		if (frames[f]->StartRead() != OK)
+		{
+			ReadFailed(f, pid);
+			prefetching--;
+		}
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::ReadOptimistic
+//
+// Input   : pid - the page to read
+// Output  : page - the page in the pool
+//           version - what Validate checks the page against
+// Purpose : Start an optimistic read of page pid: find its frame
+//           without the partition latch and note the frame's version,
+//           leaving the pin count alone.  The caller may read the page
+//           until it calls Validate, but must not trust what it read
+//           unless that succeeds, nor write to the page at all.  A
+//           mapped pool hands out the page in the mapping, which is
+//           always valid.
+// Return  : OK, or FAIL if the page is not in the pool or is pinned,
+//           being read in or about to be evicted; the caller pins it.
+//-------------------------------------------------------------------
+
+Status BufMgr::ReadOptimistic( PageID pid, const Page*& page, PageVersion& version )
+{
+	if (mapped)
+	{
+		page = MINIBASE_DB->GetMappedPage(pid);
+		version.frame = NULL;
+		version.version = 0;
+		return (page != NULL) ? OK : FAIL;
+	}
+
+	int f = pageTable->Of(pid).table->LookUpUnlatched(pid);
+	if (f < 0 || f >= (int)numOfFrames || !frames[f]->StartOptimistic(pid, version.version))
+	{
+		return FAIL;
+	}
+	stats[StatShardOf()].optimistic.fetch_add(1, std::memory_order_relaxed);
+	version.frame = frames[f];
+	page = frames[f]->GetPage();
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::Validate
+//
+// Input   : version - from a successful ReadOptimistic
+// Return  : true if the page has not changed, been evicted or been
+//           pinned since ReadOptimistic, so what was read of it since
+//           is good.
+//-------------------------------------------------------------------
+
+bool BufMgr::Validate( const PageVersion& version )
+{
+	if (version.frame == NULL || version.frame->Validate(version.version))
+	{
+		return true;
+	}
+	stats[StatShardOf()].invalid.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::UnpinPage
+//
+// Input   : pid - the page to unpin
+//           dirty - true if the caller changed the page
+// Return  : OK, or FAIL if the page is not in the pool or not pinned.
+//           A mapped pool does not count pins, so only fails for a page
+//           that does not exist.
+//-------------------------------------------------------------------
+
+Status BufMgr::UnpinPage( PageID pid, bool dirty )
+{
+	if (mapped)
+	{
+		if (MINIBASE_DB->GetMappedPage(pid) == NULL)
+		{
+			cerr << "   Page " << pid << " is not in the buffer\n";
+			return FAIL;
+		}
+		if (dirty)
+		{
+			std::lock_guard<std::mutex> guard(mapLatch);
+			mappedDirty.insert(std::make_pair(pid, (LSN)0));
+		}
+		return OK;
+	}
+
+	PageTable::Partition& part = pageTable->Of(pid);
+	{
+		std::lock_guard<std::mutex> guard(part.latch);
+
+		int f = part.table->LookUp(pid);
+		if (f == INVALID_FRAME)
+		{
+			cerr << "   Page " << pid << " is not in the buffer\n";
+			return FAIL;
+		}
+
+		// A count of exactly CLAIMED is a replacer's claim, not a pin.
+		int pins = frames[f]->GetPinCount();
+		if (pins == 0 || pins == Frame::CLAIMED)
+		{
+			cerr << "   Trying to unpin page " << pid << ", which is not pinned.\n";
+			return FAIL;
+		}
+
+		if (dirty)
+		{
+			frames[f]->DirtyIt();
+		}
+		frames[f]->Unpin();
+	}
+
+	if (dirty && numOfDirty > dirtyLimit)
+	{
+		Throttle();
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::Throttle
+//
+// Purpose : Slow down a thread that dirtied a page while the pool is
+//           over its dirty target: wake the writer and wait, for one
+//           writer interval at most, for it to get back under.  If the
+//           writer found nothing it could write, do not wait for it.
+//-------------------------------------------------------------------
+
+void BufMgr::Throttle()
+{
+	if (stalled)
+	{
+		return;
+	}
+
+	throttled++;
+	std::unique_lock<std::mutex> lock(writerLatch);
+	writerWake.notify_one();
+	cleanedUp.wait_for(lock, std::chrono::milliseconds(BUF_WRITER_INTERVAL),
+		[this]() { return numOfDirty <= dirtyLimit || stalled || stopWriter; });
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::WriterLoop
+//
+// Purpose : Background writer body.  Sweep whenever woken or every
+//           BUF_WRITER_INTERVAL ms, and take a checkpoint when the log
+//           asks for one, until the pool is destroyed.
+//-------------------------------------------------------------------
+
+void BufMgr::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(writerLatch);
+	while (!stopWriter)
+	{
+		writerWake.wait_for(lock, std::chrono::milliseconds(BUF_WRITER_INTERVAL));
+		if (stopWriter)
+		{
+			break;
+		}
+
+		lock.unlock();
+		Sweep();
+		lock.lock();
+		cleanedUp.notify_all();
+
+		if (checkpointWanted)
+		{
+			checkpointWanted = false;
+			lock.unlock();
+			MINIBASE_LOG->Checkpoint();
+			lock.lock();
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::RequestCheckpoint
+//
+// Purpose : Have the background writer take a checkpoint of the log
+//           as soon as it can.  A mapped pool has no writer, and takes
+//           checkpoints only when LogMgr::Checkpoint is called.
+//-------------------------------------------------------------------
+
+void BufMgr::RequestCheckpoint()
+{
+	if (mapped)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(writerLatch);
+		checkpointWanted = true;
+	}
+	writerWake.notify_one();
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::Sweep
+//
+// Purpose : Clean the dirty frames among the replacer's next victims.
+//           Then, if the pool is still over its dirty target, go on
+//           down the replacer's order, coldest first, until it is down
+//           to half the target, so that the threads dirtying pages are
+//           not throttled again at once.  Pages the replacer means to
+//           keep, which Clock does not even offer, are written last, as
+//           they would soon be dirtied again.
+//-------------------------------------------------------------------
+
+void BufMgr::Sweep()
+{
+	std::lock_guard<std::mutex> guard(sweepLatch);
+	std::vector<int> candidates;
+
+	missesSinceSweep = 0;
+	replacer->NextVictims(candidates, lookahead);
+	CleanFrames(candidates, false);
+
+	if (numOfDirty > dirtyLimit)
+	{
+		replacer->NextVictims(candidates, numOfFrames);
+		CleanFrames(candidates, true);
+	}
+	if (numOfDirty > dirtyLimit)
+	{
+		candidates.clear();
+		for (unsigned int i = 0; i < numOfFrames; i++)
+		{
+			if (frames[i]->IsDirty() && frames[i]->Evictable())
+			{
+				candidates.push_back(i);
+			}
+		}
+		CleanFrames(candidates, true);
+	}
+	stalled = numOfDirty > dirtyLimit;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::CleanFrames
+//
+// Input   : candidates - frames to write back if they are dirty
+//           toTarget - stop once the pool is down to half its dirty
+//                      target
+// Purpose : Write back the pages of those of the frames that are dirty
+//           and unpinned, ASYNC_IO_DEPTH at a time, and leave them in
+//           the pool, clean.  Each frame is claimed while it is written
+//           so it cannot be evicted from under the write, and marked
+//           as being written, so that pinners wait for it.
+// Return  : The number of pages written.
+//-------------------------------------------------------------------
+
+int BufMgr::CleanFrames( const std::vector<int>& candidates, bool toTarget )
+{
+	std::vector<int> claimed;
+	std::vector<bool> done;
+	int written = 0;
+
+	size_t next = 0;
+	while (next < candidates.size())
+	{
+		claimed.clear();
+		for (; next < candidates.size() && (int)claimed.size() < ASYNC_IO_DEPTH; next++)
+		{
+			if (toTarget && numOfDirty <= dirtyLimit / 2)
+			{
+				next = candidates.size();
+				break;
+			}
+			int f = candidates[next];
+			if (!frames[f]->IsDirty() || !frames[f]->TryClaim())
+			{
+				continue;
+			}
+			if (!frames[f]->IsValid() || !frames[f]->StartWriting())
+			{
+				frames[f]->Release();
+				continue;
+			}
+			if (!frames[f]->Clean())
+			{
+				frames[f]->EndWriting();
+				frames[f]->Release();
+				continue;
+			}
+			claimed.push_back(f);
+		}
+
+		WriteSorted(claimed, done);
+		for (size_t i = 0; i < claimed.size(); i++)
+		{
+			if (done[i])
+			{
+				// Claimed, the page cannot have changed since.
+				frames[claimed[i]]->ForgetRecLSN();
+				written++;
+				if (trackHeat)
+				{
+					CountHeat(frames[claimed[i]]->GetPageID(), &PageHeat::writes);
+				}
+			}
+			else
+			{
+				frames[claimed[i]]->DirtyIt();
+			}
+			frames[claimed[i]]->EndWriting();
+			frames[claimed[i]]->Release();
+		}
+	}
+
+	backgroundWrites += written;
+	return written;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::WriteSorted
+//
+// Input   : toWrite - frames whose pages are to be written back, held
+//                     so that they keep their pages
+// Output  : toWrite - the same frames, sorted by page
+//           written - for each of them, whether its page was written
+// Purpose : Write the pages in page order, each run of consecutive
+//           pages as one vectored write, with all the writes in flight
+//           together, so that a large flush is mostly sequential.  The
+//           log is first made durable up to the latest of their LSNs.
+//-------------------------------------------------------------------
+
+void BufMgr::WriteSorted( std::vector<int>& toWrite, std::vector<bool>& written )
+{
+	std::sort(toWrite.begin(), toWrite.end(), [this](int a, int b) {
+		return frames[a]->GetPageID() < frames[b]->GetPageID();
+	});
+
+	int n = (int)toWrite.size();
+	std::vector<Page*> pages(n);
+	std::vector<int> runs;			// where each run starts
+	LSN lsn = 0;
+	for (int i = 0; i < n; i++)
+	{
+		pages[i] = frames[toWrite[i]]->GetPage();
+		lsn = std::max(lsn, frames[toWrite[i]]->GetLSN());
+		if (i == 0 || i - runs.back() == ASYNC_IO_MAX_IOV ||
+		    frames[toWrite[i]]->GetPageID() != frames[toWrite[i - 1]]->GetPageID() + 1)
+		{
+			runs.push_back(i);
+		}
+	}
+	runs.push_back(n);
+
+	// The write-ahead rule, once for the lot.
+	if (lsn != 0 && MINIBASE_LOG != NULL && MINIBASE_LOG->Flush(lsn) != OK)
+	{
+		written.assign(n, false);
+		return;
+	}
+
+	int numOfRuns = (int)runs.size() - 1;
+	IORequest* writes = new IORequest[numOfRuns];
+	for (int r = 0; r < numOfRuns; r++)
+	{
+		MINIBASE_DB->WritePagesAsync(frames[toWrite[runs[r]]]->GetPageID(),
+		                             &pages[runs[r]], runs[r + 1] - runs[r], writes[r]);
+	}
+
+	written.assign(n, false);
+	for (int r = 0; r < numOfRuns; r++)
+	{
+		bool ok = (writes[r].Wait() == OK);
+		for (int i = runs[r]; i < runs[r + 1]; i++)
+		{
+			written[i] = ok;
+		}
+	}
+	delete [] writes;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::SetDirtyTarget
+//
+// Input   : ratio - the share of frames that may be dirty, 0 to 1
+// Purpose : Set the dirty target the background writer keeps to.
+//-------------------------------------------------------------------
+
+void BufMgr::SetDirtyTarget( double ratio )
+{
+	if (ratio < 0)
+	{
+		ratio = 0;
+	}
+	if (ratio > 1)
+	{
+		ratio = 1;
+	}
+	dirtyLimit = (int)(ratio * numOfFrames);
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::NewPage
+//
+// Input   : howMany - length of the run of pages to allocate
+// Output  : pid - the first page of the run
+//           firstPage - the first page, pinned
+// Return  : OK, or FAIL if the pages cannot be allocated or pinned.
+//-------------------------------------------------------------------
+
+Status BufMgr::NewPage( PageID& pid, Page*& firstPage, int howMany )
+{
+	if (MINIBASE_DB->AllocatePage(pid, howMany) != OK)
+	{
+		cerr << "  BufMgr :: Unable to allocate " << howMany << " pages\n";
+		return FAIL;
+	}
+
+	Status s = PinPage(pid, firstPage, true);
+	if (s != OK)
+	{
+		MINIBASE_DB->DeallocatePage(pid, howMany);
+	}
+	return s;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::FreePage
+//
+// Input   : pid - the page to free
+// Purpose : Deallocate page pid, dropping it from the pool.  The caller
+//           may hold one pin on it.
+// Return  : OK, or FAIL if it is pinned more than once.
+//-------------------------------------------------------------------
+
+Status BufMgr::FreePage( PageID pid )
+{
+	{
+		// A page reused later starts cold, and may have another owner.
+		HeatShard& shard = heat[(unsigned int)pid % BUF_STAT_SHARDS];
+		std::lock_guard<std::mutex> guard(shard.latch);
+		shard.pages.erase(pid);
+	}
+
+	// Nothing logged for the page is stamped on it any more.
+	if (MINIBASE_LOG != NULL)
+	{
+		MINIBASE_LOG->Forget(pid);
+	}
+
+	if (mapped)
+	{
+		{
+			std::lock_guard<std::mutex> guard(mapLatch);
+			mappedDirty.erase(pid);
+		}
+		return MINIBASE_DB->DeallocatePage(pid);
+	}
+
+	PageTable::Partition& part = pageTable->Of(pid);
+
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(part.latch);
+		int f = part.table->LookUp(pid);
+		if (f == INVALID_FRAME)
+		{
+			lock.unlock();
+			return MINIBASE_DB->DeallocatePage(pid, 1);
+		}
+
+		if (!frames[f]->ReadDone())
+		{
+			// A prefetch's pin is not the caller's to drop.
+			lock.unlock();
+			frames[f]->WaitRead();
+			continue;
+		}
+
+		int pins = frames[f]->GetPinCount();
+		if (pins >= Frame::CLAIMED)
+		{
+			// A replacer is about to evict the page; let it.
+			lock.unlock();
+			std::this_thread::yield();
+			continue;
+		}
+		if (pins > 1)
+		{
+			cerr << "   Free a page that is pinned more than once." << endl;
+			return FAIL;
+		}
+		if (pins == 0 && !frames[f]->TryClaim())
+		{
+			lock.unlock();
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Drop the page from the pool before deallocating it:
+		// deallocation pins space map pages, which may need this frame.
+		frames[f]->Free();
+		part.table->Delete(pid);
+		if (pins == 0)
+		{
+			frames[f]->Release();
+		}
+		else
+		{
+			frames[f]->Unpin();
+		}
+		replacer->PageRemoved(f, pid);
+		break;
+	}
+
+	return MINIBASE_DB->DeallocatePage(pid);
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::FrameOf
+//
+// Input   : page - a page in the pool
+// Return  : The frame page belongs to, or NULL if it is not one of the
+//           arena's, as in a mapped pool.
+//-------------------------------------------------------------------
+
+Frame* BufMgr::FrameOf( Page* page )
+{
+	char *p = (char *)page;
+	if (mapped || p < arena || p >= arena + (size_t)numOfFrames * pageSize)
+	{
+		return NULL;
+	}
+	return frames[(p - arena) / pageSize];
+}
+
+
+void BufMgr::HoldForLog( Page* page, PageID pid, LSN from )
+{
+	Frame *frame = FrameOf(page);
+	if (frame != NULL)
+	{
+		frame->Hold();
+		frame->SetRecLSN(from);
+	}
+	else if (mapped)
+	{
+		std::lock_guard<std::mutex> guard(mapLatch);
+		LSN& rec = mappedDirty[pid];
+		if (rec == 0 || from < rec)
+		{
+			rec = from;
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::ReleaseForLog
+//
+// Input   : page, pid - a page held with HoldForLog, and its id then
+//           lsn - the LSN of the group that changed it, or 0 to just
+//                 let it go
+//           stamp - where the page keeps its own LSN, or NULL
+// Purpose : Stamp the page, mark it dirty and let it be written.  The
+//           frame is held, so the page cannot have been evicted, only
+//           freed and perhaps reused.
+//-------------------------------------------------------------------
+
+void BufMgr::ReleaseForLog( Page* page, PageID pid, LSN lsn, LSN* stamp )
+{
+	Frame *frame = FrameOf(page);
+	if (frame == NULL)
+	{
+		if (lsn != 0 && stamp != NULL && *stamp < lsn)
+		{
+			*stamp = lsn;
+		}
+		return;
+	}
+
+	if (lsn != 0 && frame->HasPageID(pid))
+	{
+		if (stamp != NULL && *stamp < lsn)
+		{
+			*stamp = lsn;
+		}
+		frame->SetLSN(lsn);
+		frame->DirtyIt();
+	}
+	frame->Unhold();
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::GetDirtyPages
+//
+// Output  : dirty - the pages in the pool with logged changes not yet
+//                   written, and their recovery LSNs
+// Purpose : The dirty page table of a checkpoint.  It is taken without
+//           stopping anyone: a page changed by a group appended before
+//           the call has its recovery LSN set already, and one written
+//           meanwhile may still be listed, which only costs restart a
+//           little time.
+//-------------------------------------------------------------------
+
+void BufMgr::GetDirtyPages( std::vector< std::pair<PageID, LSN> >& dirty )
+{
+	dirty.clear();
+	if (mapped)
+	{
+		std::lock_guard<std::mutex> guard(mapLatch);
+		for (std::map<PageID, LSN>::iterator it = mappedDirty.begin(); it != mappedDirty.end(); ++it)
+		{
+			if (it->second != 0)
+			{
+				dirty.push_back(*it);
+			}
+		}
+		return;
+	}
+
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		LSN rec = frames[i]->GetRecLSN();
+		PageID pid = frames[i]->GetPageID();
+		if (rec != 0 && pid != INVALID_PAGE)
+		{
+			dirty.push_back(std::make_pair(pid, rec));
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::WriteOlderThan
+//
+// Input   : lsn - a recovery LSN
+// Purpose : Write back the unpinned pages changed first before lsn, as
+//           the background writer does, so that the log before lsn is
+//           no longer needed for them.  A mapped pool writes nothing.
+// Return  : The number of pages written.
+//-------------------------------------------------------------------
+
+int BufMgr::WriteOlderThan( LSN lsn )
+{
+	if (mapped)
+	{
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> guard(sweepLatch);
+	std::vector<int> candidates;
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		LSN rec = frames[i]->GetRecLSN();
+		if (rec != 0 && rec < lsn && frames[i]->Evictable())
+		{
+			candidates.push_back(i);
+		}
+	}
+	return CleanFrames(candidates, false);
+}
+
+
+bool BufMgr::RenewRecLSN( Page* page, PageID pid, LSN lsn )
+{
+	Frame *frame = FrameOf(page);
+	if (frame != NULL)
+	{
+		return frame->RenewRecLSN(lsn);
+	}
+	if (mapped)
+	{
+		std::lock_guard<std::mutex> guard(mapLatch);
+		std::map<PageID, LSN>::iterator it = mappedDirty.find(pid);
+		if (it != mappedDirty.end() && it->second != 0 && it->second < lsn)
+		{
+			it->second = lsn;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::FlushPage
+//
+// Input   : pid - the page to flush
+// Purpose : Write page pid back if it is dirty and drop it from the
+//           pool.  The partition stays unlatched during the write.  In
+//           a mapped pool the page stays mapped, as it may be pinned.
+// Return  : OK, or FAIL if the page is not in the pool, is pinned,
+//           before or during the write, or is held by an open log
+//           group.
+//-------------------------------------------------------------------
+
+Status BufMgr::FlushPage( PageID pid )
+{
+	if (mapped)
+	{
+		LSN recLSN;
+		{
+			std::lock_guard<std::mutex> guard(mapLatch);
+			std::map<PageID, LSN>::iterator it = mappedDirty.find(pid);
+			if (it == mappedDirty.end())
+			{
+				return OK;
+			}
+			recLSN = it->second;
+			mappedDirty.erase(it);
+		}
+		// Mapped pages keep no LSN of their own in the pool.
+		Status s = OK;
+		if (MINIBASE_LOG != NULL)
+		{
+			s = MINIBASE_LOG->FlushAll();
+		}
+		if (s == OK)
+		{
+			s = MINIBASE_DB->WritePage(pid, MINIBASE_DB->GetMappedPage(pid));
+		}
+		if (s != OK)
+		{
+			std::lock_guard<std::mutex> guard(mapLatch);
+			LSN& rec = mappedDirty[pid];
+			if (rec == 0 || (recLSN != 0 && recLSN < rec))
+			{
+				rec = recLSN;
+			}
+		}
+		else if (trackHeat)
+		{
+			CountHeat(pid, &PageHeat::writes);
+		}
+		return s;
+	}
+
+	PageTable::Partition& part = pageTable->Of(pid);
+
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(part.latch);
+		int f = part.table->LookUp(pid);
+		if (f == INVALID_FRAME)
+		{
+			cerr << "Error : Unable to find the page with page id " << pid << endl;
+			return FAIL;
+		}
+
+		int pins = frames[f]->GetPinCount();
+		if ((pins > 0 && pins < Frame::CLAIMED) || frames[f]->IsHeld())
+		{
+			return FAIL;
+		}
+		if (!frames[f]->TryClaim())
+		{
+			lock.unlock();
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Claimed, the frame cannot be evicted, and marked as being
+		// written it makes pinners wait for the write rather than
+		// change the page under it.  So the latch need not be held
+		// across the write, or the log flush the write-ahead rule may
+		// need first, as CleanFrames does not hold it either.
+		if (!frames[f]->StartWriting())
+		{
+			frames[f]->Release();
+			return FAIL;
+		}
+		Status s = OK;
+		bool dirty = frames[f]->Clean();
+		if (dirty)
+		{
+			lock.unlock();
+			LSN lsn = frames[f]->GetLSN();
+			if (lsn != 0 && MINIBASE_LOG != NULL)
+			{
+				s = MINIBASE_LOG->Flush(lsn);
+			}
+			if (s == OK)
+			{
+				s = MINIBASE_DB->WritePage(pid, frames[f]->GetPage());
+			}
+			lock.lock();
+			if (s == OK)
+			{
+				frames[f]->ForgetRecLSN();
+			}
+			else
+			{
+				frames[f]->DirtyIt();
+			}
+		}
+		frames[f]->EndWriting();
+		if (s == OK && dirty && trackHeat)
+		{
+			CountHeat(pid, &PageHeat::writes);
+		}
+
+		// A page pinned during the write stays, clean, in the pool.
+		if (s == OK && frames[f]->GetPinCount() != Frame::CLAIMED)
+		{
+			s = FAIL;
+		}
+		if (s == OK)
+		{
+			part.table->Delete(pid);
+			replacer->PageRemoved(f, pid);
+			frames[f]->EmptyIt();
+		}
+		frames[f]->Release();
+		return s;
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::FlushAllPages
+//
+// Purpose : Write back every dirty page and empty the pool, pinned
+//           pages included.  No other thread may be using the pool.
+//           The pages are written sorted and coalesced, see
+//           WriteSorted, and then the log is emptied.
+// Return  : OK, or FAIL if some page was still pinned or could not be
+//           written.
+//-------------------------------------------------------------------
+
+Status BufMgr::FlushAllPages()
+{
+	if (mapped)
+	{
+		Status s = FlushMapped();
+		if (s == OK && MINIBASE_LOG != NULL)
+		{
+			s = MINIBASE_LOG->Truncate();
+		}
+		return s;
+	}
+
+	std::unique_lock<std::mutex> sweep(sweepLatch);
+	Status s = OK;
+	std::vector<int> dirty;
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		frames[i]->WaitRead();
+		if (frames[i]->IsValid() && frames[i]->IsDirty())
+		{
+			dirty.push_back(i);
+		}
+	}
+
+	std::vector<bool> written;
+	std::vector<bool> failed(numOfFrames, false);
+	WriteSorted(dirty, written);
+	for (size_t i = 0; i < dirty.size(); i++)
+	{
+		failed[dirty[i]] = !written[i];
+		if (written[i] && trackHeat)
+		{
+			CountHeat(frames[dirty[i]]->GetPageID(), &PageHeat::writes);
+		}
+	}
+
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		if (frames[i]->IsValid())
+		{
+			PageID pid = frames[i]->GetPageID();
+			PageTable::Partition& part = pageTable->Of(pid);
+			std::lock_guard<std::mutex> guard(part.latch);
+
+			if (!frames[i]->NotPinned())
+			{
+				s = FAIL;
+			}
+			if (failed[i])
+			{
+				cerr << "  Cannot write page " << pid << endl;
+				s = FAIL;
+			}
+			else
+			{
+				frames[i]->EmptyIt();
+				frames[i]->DropPins();
+				part.table->Delete(pid);
+				replacer->PageRemoved(i, pid);
+			}
+		}
+	}
+
+	// Every page is written, pinned ones too, so the log is not needed.
+	// Truncating waits out a checkpoint, which sweeps.
+	sweep.unlock();
+	if (s == OK && MINIBASE_LOG != NULL)
+	{
+		s = MINIBASE_LOG->Truncate();
+	}
+	return s;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::FlushMapped
+//
+// Purpose : FlushAllPages for a mapped pool.  Write the changed pages,
+//           each run of consecutive pages at once, after the whole log,
+//           then drop their private copies from the mapping.
+// Return  : OK, or FAIL if some page could not be written.
+//-------------------------------------------------------------------
+
+Status BufMgr::FlushMapped()
+{
+	if (MINIBASE_LOG != NULL && MINIBASE_LOG->FlushAll() != OK)
+	{
+		return FAIL;
+	}
+
+	std::lock_guard<std::mutex> guard(mapLatch);
+	Status s = OK;
+	std::vector<Page*> pages;
+
+	std::map<PageID, LSN>::iterator it = mappedDirty.begin();
+	while (it != mappedDirty.end())
+	{
+		PageID start = it->first;
+		pages.clear();
+		std::map<PageID, LSN>::iterator end = it;
+		while (end != mappedDirty.end() && end->first == start + (PageID)pages.size())
+		{
+			pages.push_back(MINIBASE_DB->GetMappedPage(end->first));
+			++end;
+		}
+
+		if (MINIBASE_DB->WritePages(start, &pages[0], (int)pages.size()) != OK ||
+		    MINIBASE_DB->RemapPages(start, (int)pages.size()) != OK)
+		{
+			cerr << "  Cannot write pages " << start << " to "
+			     << start + (PageID)pages.size() - 1 << endl;
+			s = FAIL;
+			it = end;
+			continue;
+		}
+		if (trackHeat)
+		{
+			for (std::map<PageID, LSN>::iterator w = it; w != end; ++w)
+			{
+				CountHeat(w->first, &PageHeat::writes);
+			}
+		}
+		it = mappedDirty.erase(it, end);
+	}
+	return s;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::SaveWarmList
+//
+// Input   : path - the file to write
+//           first - pages to list first, or NULL
+// Purpose : List the pages in the pool, ranked, for WarmUp.  The list
+//           is written aside and renamed into place, so a crash leaves
+//           the old one or the new.
+// Return  : OK, or FAIL if the file cannot be written.
+//-------------------------------------------------------------------
+
+Status BufMgr::SaveWarmList( const char* path, const std::vector<PageID>* first )
+{
+	std::vector<WarmListEntry> entries;
+	if (first != NULL)
+	{
+		for (size_t i = 0; i < first->size(); i++)
+		{
+			WarmListEntry e = { (*first)[i], WARM_FIRST };
+			entries.push_back(e);
+		}
+	}
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		if (frames[i]->IsValid() && frames[i]->ReadDone())
+		{
+			WarmListEntry e = { frames[i]->GetPageID(),
+			                    frames[i]->IsReferenced() ? WARM_REFERENCED : WARM_OTHER };
+			entries.push_back(e);
+		}
+	}
+
+	WarmListHeader header;
+	header.magic = WARM_MAGIC;
+	header.pageSize = pageSize;
+	header.count = entries.size();
+	header.unused = 0;
+	std::string list((const char *)&header, sizeof(header));
+	if (!entries.empty())
+	{
+		list.append((const char *)&entries[0], entries.size() * sizeof(WarmListEntry));
+	}
+
+	std::string temp = std::string(path) + ".tmp";
+	int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+	{
+		cerr << "  Cannot create " << temp << endl;
+		return FAIL;
+	}
+	bool ok = ::write(fd, list.data(), list.size()) == (ssize_t)list.size() &&
+	          ::fsync(fd) == 0;
+	::close(fd);
+	if (!ok || ::rename(temp.c_str(), path) != 0)
+	{
+		cerr << "  Cannot write " << path << endl;
+		::unlink(temp.c_str());
+		return FAIL;
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::WarmUp
+//
+// Input   : path - a file written by SaveWarmList
+// Output  : numOfPages - pages read, if not NULL
+// Purpose : Read the pages listed back into the pool, best ranked
+//           first, skipping those already in it, into the free frames
+//           only, so that none of them evicts another.  The reads are
+//           prefetches, half a pool at a time, and are waited for.
+// Return  : OK, or FAIL if the file cannot be read or is not a warm
+//           list of this database's pages.
+//-------------------------------------------------------------------
+
+Status BufMgr::WarmUp( const char* path, int* numOfPages )
+{
+	if (numOfPages != NULL)
+	{
+		*numOfPages = 0;
+	}
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		cerr << "  Cannot open " << path << endl;
+		return FAIL;
+	}
+	WarmListHeader header;
+	std::vector<WarmListEntry> entries;
+	struct stat st;
+	bool ok = ::fstat(fd, &st) == 0 &&
+	          ::read(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+	          header.magic == WARM_MAGIC && (int)header.pageSize == pageSize;
+	if (ok)
+	{
+		// The count is checked against the file before anything is
+		// allocated for it, so a damaged list cannot ask for more.  No
+		// more pages are read in than the pool holds, or, mapped, than
+		// the database has; the pages asked for first head the list.
+		size_t listed = (st.st_size - sizeof(header)) / sizeof(WarmListEntry);
+		size_t most = mapped ? (size_t)MINIBASE_DB->GetNumOfPages() : numOfFrames;
+		ok = header.count <= listed;
+		entries.resize(ok ? std::min((size_t)header.count, most) : 0);
+		size_t bytes = entries.size() * sizeof(WarmListEntry);
+		ok = ok && (bytes == 0 || ::read(fd, &entries[0], bytes) == (ssize_t)bytes);
+	}
+	::close(fd);
+	if (!ok)
+	{
+		cerr << "  " << path << " is not a warm list of this database" << endl;
+		return FAIL;
+	}
+
+	// Best rank first, and a page listed twice only at its best.
+	std::sort(entries.begin(), entries.end(),
+	          [](const WarmListEntry& a, const WarmListEntry& b) {
+		return a.rank != b.rank ? a.rank < b.rank : a.pid < b.pid;
+	});
+	std::set<PageID> seen;
+	std::vector<PageID> pids;
+	unsigned int room = 0;
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		if (!frames[i]->IsValid())
+		{
+			room++;
+		}
+	}
+	for (size_t i = 0; i < entries.size() && (mapped || pids.size() < room); i++)
+	{
+		PageID pid = entries[i].pid;
+		if (pid < 0 || pid >= MINIBASE_DB->GetNumOfPages() || !seen.insert(pid).second)
+		{
+			continue;
+		}
+		if (!mapped)
+		{
+			PageTable::Partition& part = pageTable->Of(pid);
+			std::lock_guard<std::mutex> guard(part.latch);
+			if (part.table->LookUp(pid) != INVALID_FRAME)
+			{
+				continue;
+			}
+		}
+		pids.push_back(pid);
+	}
+
+	size_t batch = mapped ? pids.size() : std::max(1u, numOfFrames / 2);
+	for (size_t i = 0; i < pids.size(); i += batch)
+	{
+		int n = (int)std::min(batch, pids.size() - i);
+		Prefetch(&pids[i], n);
+		for (unsigned int f = 0; f < numOfFrames; f++)
+		{
+			frames[f]->WaitRead();
+		}
+	}
+	if (numOfPages != NULL)
+	{
+		*numOfPages = (int)pids.size();
+	}
+	return OK;
+}
+
+
+unsigned int BufMgr::GetNumOfFrames()
+{
+	return numOfFrames;
+}
+
+
+unsigned int BufMgr::GetNumOfUnpinnedFrames()
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < numOfFrames; i++)
+	{
+		if (frames[i]->NotPinned())
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::GetStat
+//
+// Output  : pinNo - number of pin requests since the last ResetStat
+//           missNo - how many of them missed the pool
+// Return  : OK
+//-------------------------------------------------------------------
+
+Status BufMgr::GetStat(long& pinNo, long& missNo)
+{
+	long hits = 0;
+	pinNo = 0;
+	for (int i = 0; i < BUF_STAT_SHARDS; i++)
+	{
+		pinNo += stats[i].totalCall;
+		hits += stats[i].totalHit;
+	}
+	missNo = pinNo - hits;
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::GetStat
+//
+// Output  : pinNo - number of pin requests since the last ResetStat
+//           missNo - how many of them missed the pool
+//           hitRatio - fraction of them that hit, 0 if there were none
+// Return  : OK
+//-------------------------------------------------------------------
+
+Status BufMgr::GetStat(long& pinNo, long& missNo, double& hitRatio)
+{
+	GetStat(pinNo, missNo);
+	hitRatio = (pinNo > 0) ? (double)(pinNo - missNo) / pinNo : 0;
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::GetOptimisticStat
+//
+// Output  : reads - optimistic reads started since the last ResetStat
+//           invalid - how many of them failed to validate
+//-------------------------------------------------------------------
+
+void BufMgr::GetOptimisticStat(long& reads, long& invalid)
+{
+	reads = 0;
+	invalid = 0;
+	for (int i = 0; i < BUF_STAT_SHARDS; i++)
+	{
+		reads += stats[i].optimistic;
+		invalid += stats[i].invalid;
+	}
+}
+
+
+void BufMgr::ResetStat()
+{
+	for (int i = 0; i < BUF_STAT_SHARDS; i++)
+	{
+		stats[i].totalCall = 0;
+		stats[i].totalHit = 0;
+		stats[i].optimistic = 0;
+		stats[i].invalid = 0;
+	}
+	backgroundWrites = 0;
+	throttled = 0;
+	pinHitLatency.Reset();
+	pinMissLatency.Reset();
+	for (int i = 0; i < BUF_STAT_SHARDS; i++)
+	{
+		std::lock_guard<std::mutex> guard(heat[i].latch);
+		heat[i].pages.clear();
+	}
+	if (replacer != NULL)
+	{
+		replacer->ResetStat();
+	}
+}
+
+
+void BufMgr::PrintStat()
+{
+	long pinNo, missNo;
+	double hitRatio;
+	GetStat(pinNo, missNo, hitRatio);
+
+	cout << "** Buffer Manager Statistics **" << endl;
+	cout << "Replacement Policy: " << GetReplacementPolicy() << endl;
+	cout << "Number of Pin Page Requests: " << pinNo << endl;
+	cout << "Number of Pin Page Request Misses: " << missNo << endl;
+	cout << "Hit Ratio: " << hitRatio << endl;
+	cout << "Pin Hit Latency p50/p99 (ns): " << pinHitLatency.GetPercentile(0.5)
+	     << " / " << pinHitLatency.GetPercentile(0.99) << endl;
+	cout << "Pin Miss Latency p50/p99 (ns): " << pinMissLatency.GetPercentile(0.5)
+	     << " / " << pinMissLatency.GetPercentile(0.99) << endl;
+	long optimistic, invalid;
+	GetOptimisticStat(optimistic, invalid);
+	cout << "Optimistic Reads: " << optimistic << ", " << invalid << " invalidated" << endl;
+	if (mapped)
+	{
+		std::lock_guard<std::mutex> guard(mapLatch);
+		cout << "Dirty Mapped Pages: " << mappedDirty.size() << endl;
+		return;
+	}
+	cout << "Dirty Frames: " << numOfDirty << " of " << numOfFrames << endl;
+	cout << "Evictions: " << replacer->GetEvictions() << endl;
+	cout << "Dirty Victims Written by Misses: " << replacer->GetDirtyVictims() << endl;
+	cout << "Pinned Frames Skipped: " << replacer->GetPinnedSkips() << endl;
+	cout << "Background Writes: " << backgroundWrites << endl;
+	cout << "Throttled Unpins: " << throttled << endl;
+	if (MINIBASE_DB != NULL && MINIBASE_DB->IsCompressed())
+	{
+		unsigned pages;
+		size_t bytes;
+		MINIBASE_DB->GetCompressedSize(pages, bytes);
+		cout << "Compressed Pages: " << pages << " in " << bytes << " bytes";
+		if (bytes > 0)
+			cout << ", ratio " << (double)pages * pageSize / bytes;
+		cout << endl;
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::WriteMetrics
+//
+// Input   : os - where to write
+// Purpose : Write a snapshot of the pool's statistics as one JSON
+//           object: the counts PrintStat prints, including optimistic
+//           reads and those invalidated, the replacer's
+//           evictions and pinned frames skipped, and the latency
+//           histograms of pins, victim searches and the database's
+//           reads and writes (see LatencyHistogram::WriteJSON), and
+//           the log's counts under "log" (see LogMgr::WriteJSON).  A
+//           mapped pool has no replacer, so those are zero.
+//-------------------------------------------------------------------
+
+void BufMgr::WriteMetrics( std::ostream& os )
+{
+	long pinNo, missNo;
+	double hitRatio;
+	GetStat(pinNo, missNo, hitRatio);
+	long optimistic, invalid;
+	GetOptimisticStat(optimistic, invalid);
+
+	static const LatencyHistogram none;
+	const LatencyHistogram& victim = mapped ? none : replacer->GetVictimLatency();
+
+	os << "{\"policy\":\"" << GetReplacementPolicy() << "\""
+	   << ",\"frames\":" << numOfFrames
+	   << ",\"page_size\":" << pageSize
+	   << ",\"pins\":" << pinNo
+	   << ",\"misses\":" << missNo
+	   << ",\"hit_ratio\":" << hitRatio
+	   << ",\"optimistic_reads\":" << optimistic
+	   << ",\"optimistic_invalid\":" << invalid
+	   << ",\"evictions\":" << (mapped ? 0 : replacer->GetEvictions())
+	   << ",\"dirty_evictions\":" << (mapped ? 0 : replacer->GetDirtyVictims())
+	   << ",\"pinned_skips\":" << (mapped ? 0 : replacer->GetPinnedSkips())
+	   << ",\"dirty_frames\":" << numOfDirty
+	   << ",\"background_writes\":" << backgroundWrites
+	   << ",\"throttled\":" << throttled
+	   << ",\"latency\":{\"pin_hit\":";
+	pinHitLatency.WriteJSON(os);
+	os << ",\"pin_miss\":";
+	pinMissLatency.WriteJSON(os);
+	os << ",\"victim\":";
+	victim.WriteJSON(os);
+	os << ",\"db_read\":";
+	MINIBASE_DB->GetReadLatency().WriteJSON(os);
+	os << ",\"db_write\":";
+	MINIBASE_DB->GetWriteLatency().WriteJSON(os);
+	os << "}";
+	if (MINIBASE_LOG != NULL)
+	{
+		os << ",\"log\":";
+		MINIBASE_LOG->WriteJSON(os);
+	}
+	os << "}" << endl;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::HeatOf
+//
+// Input   : shard - pid's heat shard, latched by the caller
+// Return  : pid's heat, zero if it had none.
+//-------------------------------------------------------------------
+
+BufMgr::PageHeat& BufMgr::HeatOf( HeatShard& shard, PageID pid )
+{
+	std::unordered_map<PageID, PageHeat>::iterator it = shard.pages.find(pid);
+	if (it != shard.pages.end())
+	{
+		return it->second;
+	}
+	PageHeat& h = shard.pages[pid];
+	h.pins = h.misses = h.evictions = h.writes = 0;
+	h.owner = NULL;
+	h.level = -1;
+	return h;
+}
+
+
+void BufMgr::CountHeat( PageID pid, long PageHeat::*counter )
+{
+	HeatShard& shard = heat[(unsigned int)pid % BUF_STAT_SHARDS];
+	std::lock_guard<std::mutex> guard(shard.latch);
+	HeatOf(shard, pid).*counter += 1;
+}
+
+
+void BufMgr::CountEviction( PageID evicted, bool written )
+{
+	if (evicted == INVALID_PAGE)
+	{
+		return;
+	}
+	CountHeat(evicted, &PageHeat::evictions);
+	if (written)
+	{
+		CountHeat(evicted, &PageHeat::writes);
+	}
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::SetPageOwner
+//
+// Input   : pid - a page
+//           file - the name of the file it belongs to
+//           level - its level in the file's tree, 0 for the root, or
+//                   -1 if it is not a tree node
+// Purpose : Attribute pid's accesses to file and level in the heat
+//           report.  The page keeps its owner until it is freed.
+//-------------------------------------------------------------------
+
+void BufMgr::SetPageOwner( PageID pid, const char* file, int level )
+{
+	const std::string* owner;
+	{
+		std::lock_guard<std::mutex> guard(ownersLatch);
+		owner = &*owners.insert(file).first;
+	}
+
+	HeatShard& shard = heat[(unsigned int)pid % BUF_STAT_SHARDS];
+	std::lock_guard<std::mutex> guard(shard.latch);
+	PageHeat& h = HeatOf(shard, pid);
+	h.owner = owner;
+	h.level = level;
+}
+
+
+//-------------------------------------------------------------------
+// BufMgr::PrintHotPages
+//
+// Input   : n - how many pages to list
+// Purpose : Print the n pages pinned most since the last ResetStat,
+//           with their misses, evictions and writes, and then the same
+//           counts summed over each owner and level.
+//-------------------------------------------------------------------
+
+void BufMgr::PrintHotPages( int n )
+{
+	std::vector< std::pair<PageID, PageHeat> > pages;
+	for (int i = 0; i < BUF_STAT_SHARDS; i++)
+	{
+		std::lock_guard<std::mutex> guard(heat[i].latch);
+		pages.insert(pages.end(), heat[i].pages.begin(), heat[i].pages.end());
+	}
+
+	std::sort(pages.begin(), pages.end(),
+	          [](const std::pair<PageID, PageHeat>& a, const std::pair<PageID, PageHeat>& b) {
+		if (a.second.pins != b.second.pins)
+			return a.second.pins > b.second.pins;
+		return a.first < b.first;
+	});
+
+	cout << "** Hot Pages **" << endl;
+	cout << "Page\tPins\tMisses\tEvicts\tWrites\tOwner" << endl;
+	for (int i = 0; i < n && i < (int)pages.size(); i++)
+	{
+		const PageHeat& h = pages[i].second;
+		cout << pages[i].first << "\t" << h.pins << "\t" << h.misses << "\t"
+		     << h.evictions << "\t" << h.writes << "\t"
+		     << (h.owner != NULL ? h.owner->c_str() : "-");
+		if (h.level >= 0)
+			cout << " level " << h.level;
+		cout << endl;
+	}
+
+	struct Totals {
+		int pages;
+		long pins, misses, evictions, writes;
+	};
+	std::map< std::pair<std::string, int>, Totals > totals;
+	for (size_t i = 0; i < pages.size(); i++)
+	{
+		const PageHeat& h = pages[i].second;
+		Totals& t = totals[std::make_pair(h.owner != NULL ? *h.owner : "-", h.level)];
+		t.pages++;
+		t.pins += h.pins;
+		t.misses += h.misses;
+		t.evictions += h.evictions;
+		t.writes += h.writes;
+	}
+
+	cout << "Owner\tLevel\tPages\tPins\tMisses\tEvicts\tWrites" << endl;
+	for (std::map< std::pair<std::string, int>, Totals >::iterator it = totals.begin();
+	     it != totals.end(); ++it)
+	{
+		const Totals& t = it->second;
+		cout << it->first.first << "\t";
+		if (it->first.second >= 0)
+			cout << it->first.second;
+		else
+			cout << "-";
+		cout << "\t" << t.pages << "\t" << t.pins << "\t" << t.misses << "\t"
+		     << t.evictions << "\t" << t.writes << endl;
+	}
+}
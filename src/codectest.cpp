@@ -0,0 +1,152 @@
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "pagecodec.h"
+#include "codectest.h"
+
+// The kinds of page Fill makes.
+enum {
+	CODEC_ZERO,			// a fresh page
+	CODEC_LEAF,			// ascending keys, then clustered record ids
+	CODEC_TEXT,			// a few words over and over
+	CODEC_SPARSE,		// zeroes with the odd random byte
+	CODEC_HALF,			// half random, half zeroes
+	CODEC_RANDOM,		// random bytes, which do not shrink
+	CODEC_KINDS
+};
+
+
+//-------------------------------------------------------------------
+// CodecTest::Run
+//
+// Input   : pages - pages to try at each page size
+// Return  : OK if every page came back, FAIL otherwise.
+//-------------------------------------------------------------------
+
+Status CodecTest::Run(int pages)
+{
+	cout << "Page codec test with " << pages << " pages of each size." << endl;
+	rng.seed(pages);
+
+	int errors = 0;
+	long tried = 0, shrunk = 0;
+	for (int pageSize = MINIBASE_MIN_PAGESIZE; pageSize <= MINIBASE_MAX_PAGESIZE; pageSize *= 2) {
+		std::vector<char> page(pageSize);
+		for (int i = 0; i < pages; i++) {
+			int kind = i % CODEC_KINDS;
+			bool shrank;
+			Fill(&page[0], pageSize, kind);
+			if (!RoundTrip(&page[0], pageSize, shrank) ||
+			    (kind == CODEC_RANDOM && shrank) || (kind == CODEC_ZERO && !shrank)) {
+				cout << "  Error: page " << i << " of " << pageSize << " bytes, kind "
+				     << kind << ", did not come back" << endl;
+				errors++;
+			}
+			tried++;
+			shrunk += shrank;
+		}
+	}
+
+	cout << "  Page codec test: " << shrunk << " of " << tried << " pages compressed, "
+	     << errors << " errors." << endl;
+	return (errors == 0) ? OK : FAIL;
+}
+
+
+//-------------------------------------------------------------------
+// CodecTest::Fill
+//
+// Input   : pageSize - bytes in the page
+//           kind - the kind of page to make
+// Output  : page - the page
+//-------------------------------------------------------------------
+
+void CodecTest::Fill(char* page, int pageSize, int kind)
+{
+	memset(page, 0, pageSize);
+	int words = pageSize / sizeof(int);
+	int* w = (int *)page;
+	switch (kind) {
+		case CODEC_LEAF: {
+			int n = words / 3;
+			int key = rng() % 1000;
+			for (int i = 0; i < n; i++) {
+				key += 1 + rng() % 3;
+				w[i] = key;
+				w[n + 2 * i] = key / 50;
+				w[n + 2 * i + 1] = key % 50;
+			}
+			break;
+		}
+		case CODEC_TEXT: {
+			static const char* text[] = { "heap ", "page ", "record ", "index ", "log " };
+			for (int at = 0; at < pageSize; ) {
+				const char* word = text[rng() % 5];
+				int len = strlen(word);
+				memcpy(page + at, word, std::min(len, pageSize - at));
+				at += len;
+			}
+			break;
+		}
+		case CODEC_SPARSE:
+			for (int i = 0; i < pageSize / 64; i++) {
+				page[rng() % pageSize] = (char)rng();
+			}
+			break;
+		case CODEC_HALF:
+			for (int i = 0; i < pageSize / 2; i++) {
+				page[i] = (char)rng();
+			}
+			break;
+		case CODEC_RANDOM:
+			for (int i = 0; i < words; i++) {
+				w[i] = (int)rng();
+			}
+			break;
+	}
+}
+
+
+//-------------------------------------------------------------------
+// CodecTest::RoundTrip
+//
+// Input   : page, pageSize - a page
+// Output  : shrank - whether it compressed
+// Return  : true if it came back exactly, or did not compress, and
+//           damaged copies of it compressed were handled.
+//-------------------------------------------------------------------
+
+bool CodecTest::RoundTrip(const char* page, int pageSize, bool& shrank)
+{
+	// Room past the page, marked, to catch a decompression that overruns.
+	const int guard = 64;
+	std::vector<char> packed(pageSize);
+	std::vector<char> back(pageSize + guard, (char)0xa5);
+
+	int len = PageCompress(page, pageSize, &packed[0]);
+	shrank = (len > 0);
+	if (len == 0) {
+		return true;
+	}
+	if (len >= pageSize || !PageDecompress(&packed[0], len, &back[0], pageSize) ||
+	    memcmp(page, &back[0], pageSize) != 0) {
+		return false;
+	}
+
+	// Cut short, it must be turned down, unless all that went was the
+	// closing token, which adds nothing to the page.
+	if (PageDecompress(&packed[0], len - 1 - rng() % len, &back[0], pageSize) &&
+	    memcmp(page, &back[0], pageSize) != 0) {
+		return false;
+	}
+	// Changed, it may decompress to something else, but within the page.
+	packed[rng() % len] ^= (char)(1 + rng() % 255);
+	PageDecompress(&packed[0], len, &back[0], pageSize);
+	for (int i = 0; i < guard; i++) {
+		if (back[pageSize + i] != (char)0xa5) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bufmgr.h"
+#include "db.h"
+#include "concurrencytest.h"
+
+
+//-------------------------------------------------------------------
+// ConcurrencyTest::Run
+//
+// Input   : nThreads - threads, each with a B+ tree of its own
+//           keys - keys each inserts
+// Return  : OK if no errors were found, FAIL otherwise.
+// Purpose : Run the test, see concurrencytest.h, then verify and
+//           destroy the trees.
+//-------------------------------------------------------------------
+
+Status ConcurrencyTest::Run(int nThreads, int keys)
+{
+	cout << "Concurrency test with " << nThreads << " threads of "
+	     << keys << " keys." << endl;
+	errors = 0;
+	inserting = nThreads;
+	done = false;
+	std::vector< std::atomic<PageID> > published(nThreads);
+	leaves.swap(published);
+	for (int t = 0; t < nThreads; t++) {
+		leaves[t] = INVALID_PAGE;
+	}
+
+	std::vector<BTreeFile*> files(nThreads, (BTreeFile *)NULL);
+	for (int t = 0; t < nThreads; t++) {
+		char name[32];
+		sprintf(name, "Concurrent%d", t);
+		Status status;
+		files[t] = new BTreeFile(status, name);
+		if (status != OK) {
+			cout << "  Error: cannot create index file " << name << endl;
+			errors++;
+		}
+	}
+
+	if (errors == 0) {
+		std::thread flusher(&ConcurrencyTest::Flusher, this);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < nThreads; t++) {
+			workers.push_back(std::thread(&ConcurrencyTest::Worker, this, t, keys, files[t]));
+		}
+		for (int t = 0; t < nThreads; t++) {
+			workers[t].join();
+		}
+		flusher.join();
+
+		for (int t = 0; t < nThreads; t++) {
+			if (files[t]->Verify() != OK) {
+				errors++;
+			}
+		}
+	}
+
+	for (int t = 0; t < nThreads; t++) {
+		if (files[t] != NULL && files[t]->DestroyFile() != OK) {
+			errors++;
+		}
+		delete files[t];
+	}
+
+	cout << "  Concurrency test: " << errors << " errors." << endl;
+	return (errors == 0) ? OK : FAIL;
+}
+
+
+//-------------------------------------------------------------------
+// ConcurrencyTest::Worker
+//
+// Input   : t - the thread's number
+//           keys - keys to insert
+//           btf - the thread's own tree, empty
+// Purpose : Insert the keys 0 to keys - 1 in a shuffled order, scanning
+//           the tree eight times along the way and handing the leaf of
+//           each key to the flusher, then, once it has stopped, delete
+//           the odd ones and scan it with a parallel scan.  Record id
+//           [key, t] goes with each key.
+//-------------------------------------------------------------------
+
+void ConcurrencyTest::Worker(int t, int keys, BTreeFile* btf)
+{
+	std::vector<int> order(keys);
+	for (int i = 0; i < keys; i++) {
+		order[i] = i;
+	}
+	std::mt19937 rng(t + 1);
+	std::shuffle(order.begin(), order.end(), rng);
+
+	std::vector<bool> present(keys, false);
+	int every = std::max(keys / 8, 1);
+	for (int i = 0; i < keys; i++) {
+		RecordID rid;
+		rid.pageNo = order[i];
+		rid.slotNo = t;
+		if (btf->Insert(order[i], rid) != OK) {
+			cout << "  Error: thread " << t << " cannot insert " << order[i] << endl;
+			errors++;
+			inserting--;
+			return;
+		}
+		present[order[i]] = true;
+		PageID leaf;
+		if (btf->Search(&order[i], leaf) == OK) {
+			leaves[t] = leaf;
+		}
+		if ((i + 1) % every == 0 && !Check(btf, t, present, i + 1, 0)) {
+			inserting--;
+			return;
+		}
+	}
+
+	// Deletes may free leaves, which the flusher must not be handed.
+	inserting--;
+	while (!done) {
+		std::this_thread::yield();
+	}
+
+	int count = keys;
+	for (int key = 1; key < keys; key += 2) {
+		RecordID rid;
+		rid.pageNo = key;
+		rid.slotNo = t;
+		if (btf->Delete(key, rid) != OK) {
+			cout << "  Error: thread " << t << " cannot delete " << key << endl;
+			errors++;
+			return;
+		}
+		present[key] = false;
+		count--;
+	}
+	Check(btf, t, present, count, 2);
+}
+
+
+//-------------------------------------------------------------------
+// ConcurrencyTest::Flusher
+//
+// Purpose : Until the workers are done inserting, flush each leaf they
+//           hand over, pinning it first so that it is in the pool.  A
+//           leaf pinned by its worker is left alone; the rest are
+//           written back and dropped from the pool while their worker
+//           may be about to pin them again.
+//-------------------------------------------------------------------
+
+void ConcurrencyTest::Flusher()
+{
+	while (inserting > 0) {
+		for (size_t t = 0; t < leaves.size(); t++) {
+			PageID pid = leaves[t].exchange(INVALID_PAGE);
+			Page *page;
+			if (pid != INVALID_PAGE && MINIBASE_BM->PinPage(pid, page) == OK) {
+				MINIBASE_BM->UnpinPage(pid, CLEAN);
+				MINIBASE_BM->FlushPage(pid);
+			}
+		}
+		std::this_thread::yield();
+	}
+	done = true;
+}
+
+
+//-------------------------------------------------------------------
+// ConcurrencyTest::Check
+//
+// Input   : btf, t - a thread's tree and number
+//           present - which keys are in the tree
+//           count - how many
+//           scanThreads - threads for a parallel scan, or 0 for a plain
+//                         one
+// Return  : true if a scan of the whole tree found the keys present, in
+//           order, each with its record id; false, counting an error,
+//           if not.
+//-------------------------------------------------------------------
+
+bool ConcurrencyTest::Check(BTreeFile* btf, int t, const std::vector<bool>& present,
+                            int count, int scanThreads)
+{
+	IndexFileScan* scan = (scanThreads > 0) ? btf->OpenParallelScan(NULL, NULL, scanThreads)
+	                                        : btf->OpenScan(NULL, NULL);
+	if (scan == NULL) {
+		cout << "  Error: thread " << t << " cannot open a scan" << endl;
+		errors++;
+		return false;
+	}
+
+	RecordID rid;
+	int key, prev = -1, found = 0;
+	bool ok = true;
+	Status status;
+	while ((status = scan->GetNext(rid, key)) == OK) {
+		if (key <= prev || key >= (int)present.size() || !present[key] ||
+		    rid.pageNo != key || rid.slotNo != t) {
+			ok = false;
+		}
+		prev = key;
+		found++;
+	}
+	delete scan;
+
+	if (!ok || status != DONE || found != count) {
+		cout << "  Error: thread " << t << " scanned " << found << " of "
+		     << count << " keys" << (ok ? "" : ", some wrong") << endl;
+		errors++;
+		return false;
+	}
+	return true;
+}
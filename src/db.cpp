@@ -0,0 +1,1278 @@
+/*
+ * The DB class
+ * $Id
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <iomanip>
+
+#include "db.h"
+#include "bufmgr.h"
+#include "log.h"
+#include "pagecodec.h"
+
+
+static const char* dbErrMsgs[] = {
+    "Database is full",
+    "Duplicate file entry",
+    "Unix error",
+    "bad page number",
+    "File IO error",
+    "File not found",
+    "File name too long",
+    "Negative run size",
+    "Bad page size",
+    "Access mode not allowed for the database",
+};
+
+static error_string_table dbTable( DBMGR, dbErrMsgs );
+
+  // The units a compressed page's slot takes.
+static unsigned pack_units( unsigned bytes )
+{
+    return (bytes + PACK_UNIT - 1) / PACK_UNIT;
+}
+
+
+// oooooooooooooooooooooooooooooooooooooo
+
+DB::DB( const char* fname, unsigned num_pgs, Status& status,
+        unsigned pg_size, DBIOMode mode )
+{
+    name = strcpy(new char[strlen(fname)+1],fname);
+    fd = -1;
+    aio = NULL;
+    map = NULL;
+    map_size = 0;
+    direct = false;
+    packed = ( mode == DB_COMPRESSED );
+    pack_end = 0;
+    pack_base = 0;
+    num_pages = (num_pgs > 2) ? num_pgs : 2;
+    page_size = pg_size;
+    bits_per_page = page_size * 8;
+
+    if ( !ValidPageSize(page_size) ) {
+        status = MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_SIZE );
+        return;
+    }
+
+    fd = ::open( name, O_RDWR | O_CREAT | O_TRUNC, 0666 );
+    if ( fd < 0 ) {
+        status = MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+        return;
+    }
+    aio = AsyncIO::Create();
+
+      // Make the file num_pages pages long, filled with zeroes; a
+      // compressed one just as long as its first page and page map,
+      // which says that no page has been written.
+    off_t size = (off_t)num_pages*page_size;
+    if ( packed ) {
+        pack_map.assign( num_pages, pack_entry() );
+        size = page_size + (off_t)num_pages*sizeof(pack_entry);
+        pack_base = (size + PACK_UNIT - 1) / PACK_UNIT * PACK_UNIT;
+    }
+    char zero = 0;
+    if ( ::pwrite(fd, &zero, 1, size - 1) != 1 ) {
+        status = MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+        return;
+    }
+
+    status = set_mode( mode );
+    if ( status != OK )
+        return;
+
+      // Make the buffer manager able to find us.
+    MINIBASE_DB = this;
+
+      // Initialize the first DB page.
+    Page* pg;
+    status = MINIBASE_BM->PinPage( 0, pg, true /*emptyPage*/ );
+    if ( status != OK ) {
+        status = MINIBASE_CHAIN_ERROR( DBMGR, status );
+        return;
+    }
+
+    first_page* fp = (first_page*) pg;
+    fp->num_db_pages = num_pages;
+    fp->page_size = page_size;
+    fp->compressed = packed;
+    init_dir_page( &fp->dir, sizeof(first_page) );
+
+    status = MINIBASE_BM->UnpinPage( 0, true /*dirty*/ );
+    if ( status != OK ) {
+        status = MINIBASE_CHAIN_ERROR( DBMGR, status );
+        return;
+    }
+
+      // Calculate how many pages are needed for the space map.  Reserve
+      // pages 0 and 1 and as many additional pages for the space map as
+      // are needed.
+    unsigned num_map_pages = (num_pages + bits_per_page - 1) / bits_per_page;
+    mark_free( 0, num_pages );
+
+    status = set_bits( 0, 1 + num_map_pages, 1 );
+    if ( status == OK )
+        status = load_directory();
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+DB::DB( const char* fname, Status& status, DBIOMode mode )
+{
+    name = strcpy(new char[strlen(fname)+1],fname);
+    fd = -1;
+    aio = NULL;
+    map = NULL;
+    map_size = 0;
+    direct = false;
+    packed = false;
+    pack_end = 0;
+    pack_base = 0;
+    num_pages = 1;      // Enough to read the first page; fixed up below.
+    page_size = 0;
+    bits_per_page = 0;
+
+    status = ReadPageSize( name, page_size );
+    if ( status != OK )
+        return;
+    bits_per_page = page_size * 8;
+
+    fd = ::open( name, O_RDWR );
+    if ( fd < 0 ) {
+        status = MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+        return;
+    }
+    aio = AsyncIO::Create();
+
+      // The first page says how the others are kept, so it is read
+      // before them, as it is; it is never compressed.
+    first_page fp;
+    if ( ::pread(fd, &fp, sizeof(fp), 0) != (ssize_t)sizeof(fp) ) {
+        status = MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+        return;
+    }
+    num_pages = fp.num_db_pages;
+    packed = ( fp.compressed != 0 );
+    if ( packed ) {
+        off_t size = page_size + (off_t)num_pages*sizeof(pack_entry);
+        pack_base = (size + PACK_UNIT - 1) / PACK_UNIT * PACK_UNIT;
+        status = load_pack_map();
+        if ( status != OK )
+            return;
+    }
+
+    status = set_mode( mode );
+    if ( status != OK )
+        return;
+
+      // Make the buffer manager able to find us.
+    MINIBASE_DB = this;
+
+    status = load_free_runs();
+    if ( status == OK )
+        status = load_directory();
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+DB::~DB()
+{
+      // Let any requests in flight finish before the file goes away.
+    delete aio;
+    if ( map != NULL )
+        ::munmap( map, map_size );
+    if ( fd >= 0 )
+        ::close( fd );
+    delete [] name;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::set_mode( DBIOMode mode )
+{
+      // Compressed pages are neither where the mapping would have them
+      // nor aligned for O_DIRECT.
+    if ( packed && mode == DB_MAPPED )
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_IO_MODE );
+    if ( packed )
+        return OK;
+    if ( mode == DB_MAPPED )
+        return map_file();
+    if ( mode == DB_DIRECT )
+        set_direct();
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::set_direct()
+{
+    int flags = ::fcntl( fd, F_GETFL );
+    if ( flags < 0 || ::fcntl(fd, F_SETFL, flags | O_DIRECT) < 0 )
+        return;
+
+      // The file system, or a page smaller than its blocks, may still
+      // refuse direct transfers.
+    void* buf;
+    if ( ::posix_memalign(&buf, page_size, page_size) == 0 ) {
+        direct = ( ::pread(fd, buf, page_size, 0) == (ssize_t)page_size );
+        ::free( buf );
+    }
+    if ( !direct )
+        ::fcntl( fd, F_SETFL, flags );
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+bool DB::IsDirect() const
+{
+    return direct;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::map_file()
+{
+    struct stat st;
+    if ( ::fstat(fd, &st) < 0 || st.st_size < (off_t)page_size )
+        return MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+
+    void* p = ::mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0 );
+    if ( p == MAP_FAILED )
+        return MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+
+    map = (char*)p;
+    map_size = st.st_size;
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+bool DB::IsMapped() const
+{
+    return map != NULL;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+bool DB::IsCompressed() const
+{
+    return packed;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::GetCompressedSize( unsigned& pages, size_t& bytes )
+{
+    std::lock_guard<std::mutex> guard( pack_latch );
+
+    pages = 0;
+    bytes = 0;
+    for ( size_t i = 0; i < pack_map.size(); ++i )
+        if ( pack_map[i].len > 0 ) {
+            ++pages;
+            bytes += (size_t)pack_units( pack_map[i].len )*PACK_UNIT;
+        }
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Page* DB::GetMappedPage( PageID pageno )
+{
+    if ( map == NULL || pageno < 0 || pageno >= (int)num_pages
+            || (size_t)(pageno + 1)*page_size > map_size )
+        return NULL;
+    return (Page*)(map + (size_t)pageno*page_size);
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::PrefetchMapped( PageID start, int n )
+{
+    if ( GetMappedPage(start) == NULL || GetMappedPage(start + n - 1) == NULL )
+        return;
+
+    size_t os_page = ::sysconf( _SC_PAGESIZE );
+    size_t from = (size_t)start*page_size / os_page * os_page;
+    ::madvise( map + from, (size_t)(start + n)*page_size - from, MADV_WILLNEED );
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::RemapPages( PageID start, int n )
+{
+    if ( GetMappedPage(start) == NULL || GetMappedPage(start + n - 1) == NULL )
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+
+      // Pages smaller than a memory page share it with their neighbours.
+    size_t os_page = ::sysconf( _SC_PAGESIZE );
+    size_t from = (size_t)start*page_size / os_page * os_page;
+    size_t to = ((size_t)(start + n)*page_size + os_page - 1) / os_page * os_page;
+    if ( to > map_size )
+        to = map_size;
+
+    if ( ::madvise(map + from, to - from, MADV_DONTNEED) < 0 )
+        return MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::Destroy()
+{
+    if ( ::unlink(name) < 0 )
+        return MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+bool DB::ValidPageSize( unsigned size )
+{
+    return size >= (unsigned)MINIBASE_MIN_PAGESIZE
+        && size <= (unsigned)MINIBASE_MAX_PAGESIZE
+        && (size & (size - 1)) == 0;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::ReadPageSize( const char* fname, unsigned& size )
+{
+    int fd = ::open( fname, O_RDONLY );
+    if ( fd < 0 )
+        return MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+
+    first_page fp;
+    ssize_t n = ::pread( fd, &fp, sizeof(fp), 0 );
+    ::close( fd );
+    if ( n != (ssize_t)sizeof(fp) )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    if ( !ValidPageSize(fp.page_size) )
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_SIZE );
+
+    size = fp.page_size;
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::ReadPage( PageID pageno, Page* pageptr )
+{
+    if ( pageno < 0 || pageno >= (int)num_pages )
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+    if ( packed && pageno > 0 )
+        return pack_read( pageno, pageptr );
+
+    long start = LatencyHistogram::Now();
+    ssize_t n = ::pread( fd, pageptr, page_size, (off_t)pageno*page_size );
+    read_latency.RecordSince( start );
+    if ( n != (ssize_t)page_size )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::WritePage( PageID pageno, Page* pageptr )
+{
+    if ( pageno < 0 || pageno >= (int)num_pages )
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+    if ( packed && pageno > 0 )
+        return pack_write( pageno, &pageptr, 1 );
+
+    long start = LatencyHistogram::Now();
+    ssize_t n = ::pwrite( fd, pageptr, page_size, (off_t)pageno*page_size );
+    write_latency.RecordSince( start );
+    if ( n != (ssize_t)page_size )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::WritePages( PageID start, Page** pages, int n )
+{
+    if ( start < 0 || n < 0 || start + n > (int)num_pages )
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+    if ( packed && n > 0 ) {
+          // The first page is kept where it is, as it is.
+        if ( start == 0 ) {
+            Status status = WritePage( 0, pages[0] );
+            if ( status != OK || n == 1 )
+                return status;
+            return pack_write( 1, pages + 1, n - 1 );
+        }
+        return pack_write( start, pages, n );
+    }
+
+    struct iovec iov[ASYNC_IO_MAX_IOV];
+    for ( int done = 0; done < n; ) {
+        int count = n - done;
+        if ( count > ASYNC_IO_MAX_IOV )
+            count = ASYNC_IO_MAX_IOV;
+        for ( int i = 0; i < count; i++ ) {
+            iov[i].iov_base = pages[done + i];
+            iov[i].iov_len = page_size;
+        }
+
+        long began = LatencyHistogram::Now();
+        ssize_t written = ::pwritev( fd, iov, count, (off_t)(start + done)*page_size );
+        write_latency.RecordSince( began );
+        if ( written != (ssize_t)count*page_size )
+            return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+        done += count;
+    }
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::Sync()
+{
+      // The page map lives in the same file as the slots.
+    if ( ::fdatasync(fd) != 0 )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::ReadPageAsync( PageID pageno, Page* pageptr, IORequest& req )
+{
+    if ( pageno < 0 || pageno >= (int)num_pages ) {
+        req.Abort();
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+    }
+    if ( packed && pageno > 0 )
+        return pack_read_async( pageno, pageptr, req );
+
+    if ( aio->Read(fd, (char*)pageptr, page_size, (off_t)pageno*page_size, req,
+                   &read_latency) != OK )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::WritePageAsync( PageID pageno, Page* pageptr, IORequest& req )
+{
+    if ( pageno < 0 || pageno >= (int)num_pages ) {
+        req.Abort();
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+    }
+    if ( packed && pageno > 0 )
+        return pack_write_async( pageno, &pageptr, 1, req );
+
+    if ( aio->Write(fd, (const char*)pageptr, page_size, (off_t)pageno*page_size, req,
+                    &write_latency) != OK )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::WritePagesAsync( PageID start, Page** pages, int n, IORequest& req )
+{
+    if ( start < 0 || n <= 0 || n > ASYNC_IO_MAX_IOV || start + n > (int)num_pages ) {
+        req.Abort();
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+    }
+    if ( packed && start > 0 )
+        return pack_write_async( start, pages, n, req );
+    if ( packed && n > 1 ) {
+          // The first page is kept where it is, as it is; the rest
+          // complete req.
+        Status status = WritePage( 0, pages[0] );
+        if ( status != OK ) {
+            req.Abort();
+            return status;
+        }
+        return pack_write_async( 1, pages + 1, n - 1, req );
+    }
+
+    struct iovec iov[ASYNC_IO_MAX_IOV];
+    for ( int i = 0; i < n; i++ ) {
+        iov[i].iov_base = pages[i];
+        iov[i].iov_len = page_size;
+    }
+
+    if ( aio->WriteV(fd, iov, n, (off_t)start*page_size, req, &write_latency) != OK )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+const char* DB::GetIOBackend()
+{
+    return aio->GetName();
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::ResetLatency()
+{
+    read_latency.Reset();
+    write_latency.Reset();
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::AllocatePage( PageID& start_page_num, int run_size_int )
+{
+    std::lock_guard<std::recursive_mutex> guard( latch );
+    LogGroup group( true /*separate*/ );
+
+    if ( run_size_int < 0 ) {
+        cerr << "Allocating a negative run of pages.\n";
+        return MINIBASE_FIRST_ERROR( DBMGR, NEG_RUN_SIZE );
+    }
+
+    unsigned run_size = run_size_int;
+
+      // The shortest free run that is long enough, the first such.
+    std::set< std::pair<unsigned, PageID> >::iterator fit =
+        free_by_size.lower_bound( std::make_pair(run_size, (PageID)0) );
+    if ( fit == free_by_size.end() )
+        return MINIBASE_FIRST_ERROR( DBMGR, DB_FULL );
+
+    start_page_num = fit->second;
+    return set_bits( start_page_num, run_size, 1 );
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::DeallocatePage( PageID start_page_num, int run_size )
+{
+    std::lock_guard<std::recursive_mutex> guard( latch );
+    LogGroup group( true /*separate*/ );
+
+    if ( run_size < 0 ) {
+        cerr << "Deallocating a negative run of pages.\n";
+        return MINIBASE_FIRST_ERROR( DBMGR, NEG_RUN_SIZE );
+    }
+
+    return set_bits( start_page_num, run_size, 0 );
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::Recovered()
+{
+    Status status = load_free_runs();
+    if ( status == OK )
+        status = load_directory();
+    return status;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::AddFileEntry( const char* fname, PageID start_page_num )
+{
+    std::lock_guard<std::recursive_mutex> guard( latch );
+    LogGroup group( true /*separate*/ );
+
+    if ( strlen(fname) >= MAX_NAME )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_NAME_TOO_LONG );
+    if ( start_page_num < 0 || start_page_num >= (int)num_pages )
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+
+      // Does the file already exist?
+    if ( find_file_entry(fname) != NULL )
+        return MINIBASE_FIRST_ERROR( DBMGR, DUPLICATE_ENTRY );
+
+      // Take the first free slot in the chain, adding a directory page at
+      // the end of the chain if every one is full.
+    Status status;
+    if ( dir_free.empty() ) {
+        status = add_dir_page();
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    }
+    unsigned index = dir_free.begin()->first;
+    int slot = dir_free.begin()->second;
+    PageID hpid = dir_pages[index];
+
+    Page* pg;
+    status = MINIBASE_BM->PinPage( hpid, pg );
+    if ( status != OK )
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    directory_page* dp = dir_page( hpid, pg );
+    dp->entries[slot].pagenum = start_page_num;
+    strcpy( dp->entries[slot].fname, fname );
+    log_change( hpid, pg, &dp->entries[slot], sizeof(file_entry) );
+
+    dir_free.erase( dir_free.begin() );
+    dir_slot entry = { index, slot, start_page_num };
+    dir_index[fname] = entry;
+
+    status = MINIBASE_BM->UnpinPage( hpid, true /*dirty*/ );
+    if ( status != OK )
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::DeleteFileEntry( const char* fname )
+{
+    std::lock_guard<std::recursive_mutex> guard( latch );
+    LogGroup group( true /*separate*/ );
+
+    const dir_slot* entry = find_file_entry( fname );
+    if ( entry == NULL )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_NOT_FOUND );
+    unsigned index = entry->index;
+    int slot = entry->slot;
+    PageID hpid = dir_pages[index];
+
+    Page* pg;
+    Status status = MINIBASE_BM->PinPage( hpid, pg );
+    if ( status != OK )
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    directory_page* dp = dir_page( hpid, pg );
+    dp->entries[slot].pagenum = INVALID_PAGE;
+    log_change( hpid, pg, &dp->entries[slot].pagenum, sizeof(PageID) );
+
+    dir_free.insert( std::make_pair(index, slot) );
+    dir_index.erase( fname );
+
+    status = MINIBASE_BM->UnpinPage( hpid, true /*dirty*/ );
+    if ( status != OK )
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::GetFileEntry( const char* fname, PageID& start_page )
+{
+    std::lock_guard<std::recursive_mutex> guard( latch );
+
+      // Callers probe for files this way, so a missing one is not an
+      // error worth posting.
+    const dir_slot* entry = find_file_entry( fname );
+    if ( entry == NULL )
+        return FAIL;
+
+    start_page = entry->start_page;
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+const char* DB::GetName() const
+{
+    return name;
+}
+
+int DB::GetNumOfPages() const
+{
+    return num_pages;
+}
+
+int DB::GetPageSize() const
+{
+    return page_size;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::dump_space_map()
+{
+    unsigned num_map_pages = (num_pages + bits_per_page - 1) / bits_per_page;
+    unsigned bit_number = 0;
+
+    cout << "num_map_pages = " << num_map_pages << endl;
+    cout << "num_pages = " << num_pages << endl;
+
+    for ( unsigned i = 0; i < num_map_pages; ++i ) {
+        PageID pgid = 1 + i;
+        Page* pg;
+        Status status = MINIBASE_BM->PinPage( pgid, pg );
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+
+        const unsigned char* map = (const unsigned char*) pg;
+        unsigned num_bits_this_page = num_pages - i*bits_per_page;
+        if ( num_bits_this_page > bits_per_page )
+            num_bits_this_page = bits_per_page;
+
+        for ( unsigned bit = 0; bit < num_bits_this_page; ++bit, ++bit_number ) {
+            if ( bit_number % 64 == 0 )
+                cout << endl << "Page num is " << setw(8) << bit_number << ": ";
+            else if ( bit_number % 8 == 0 )
+                cout << ' ';
+            cout << ((map[bit / 8] & (1 << (bit % 8))) ? 1 : 0);
+        }
+
+        status = MINIBASE_BM->UnpinPage( pgid );
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    }
+    cout << endl;
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::set_bits( PageID start_page, unsigned run_size, int bit )
+{
+    if ( start_page < 0 || start_page + run_size > num_pages )
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+
+    if ( run_size == 0 )
+        return OK;
+
+      // Pages being allocated leave the free runs at once, and pages
+      // being freed join them only once the map says so; a failure part
+      // way loses track of some free pages rather than handing out
+      // pages in use.
+    if ( bit )
+        mark_used( start_page, run_size );
+
+      // Locate the run within the space map.
+    unsigned first_map_page = start_page / bits_per_page + 1;
+    unsigned last_map_page = (start_page + run_size - 1) / bits_per_page + 1;
+    unsigned page = start_page;
+    unsigned end = start_page + run_size;
+
+    for ( unsigned pgid = first_map_page; pgid <= last_map_page; ++pgid ) {
+        Page* pg;
+        Status status = MINIBASE_BM->PinPage( pgid, pg );
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+
+        unsigned char* map = (unsigned char*) pg;
+        unsigned page_end = pgid * bits_per_page;
+        if ( page_end > end )
+            page_end = end;
+        unsigned first_byte = (page % bits_per_page) / 8;
+        unsigned last_byte = ((page_end - 1) % bits_per_page) / 8;
+
+        for ( ; page < page_end; ++page ) {
+            unsigned offset = page % bits_per_page;
+            if ( bit )
+                map[offset / 8] |= (1 << (offset % 8));
+            else
+                map[offset / 8] &= ~(1 << (offset % 8));
+        }
+        log_change( pgid, pg, map + first_byte, last_byte - first_byte + 1 );
+
+        status = MINIBASE_BM->UnpinPage( pgid, true /*dirty*/ );
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    }
+
+    if ( !bit )
+        mark_free( start_page, run_size );
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::load_free_runs()
+{
+    std::lock_guard<std::recursive_mutex> guard( latch );
+
+    free_runs.clear();
+    free_by_size.clear();
+
+    unsigned num_map_pages = (num_pages + bits_per_page - 1) / bits_per_page;
+    unsigned run_start = 0, run_length = 0;
+
+    for ( unsigned i = 0; i < num_map_pages; ++i ) {
+        PageID pgid = 1 + i;
+        Page* pg;
+        Status status = MINIBASE_BM->PinPage( pgid, pg );
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+
+        const unsigned char* map = (const unsigned char*) pg;
+        unsigned num_bits_this_page = num_pages - i*bits_per_page;
+        if ( num_bits_this_page > bits_per_page )
+            num_bits_this_page = bits_per_page;
+
+        for ( unsigned bit = 0; bit < num_bits_this_page; ++bit ) {
+            if ( map[bit / 8] & (1 << (bit % 8)) ) {
+                if ( run_length > 0 )
+                    mark_free( run_start, run_length );
+                run_start = i*bits_per_page + bit + 1;
+                run_length = 0;
+            } else
+                ++run_length;
+        }
+
+        status = MINIBASE_BM->UnpinPage( pgid );
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    }
+    if ( run_length > 0 )
+        mark_free( run_start, run_length );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::mark_used( PageID start, unsigned run_size )
+{
+    PageID end = start + run_size;
+
+      // Start from the run holding start, if there is one.
+    std::map<PageID, unsigned>::iterator it = free_runs.upper_bound( start );
+    if ( it != free_runs.begin() ) {
+        --it;
+        if ( it->first + (PageID)it->second <= start )
+            ++it;
+    }
+
+    while ( it != free_runs.end() && it->first < end ) {
+        PageID run_start = it->first;
+        PageID run_end = run_start + it->second;
+        free_by_size.erase( std::make_pair(it->second, run_start) );
+        free_runs.erase( it++ );
+
+          // Keep whatever part of the run lies outside the pages used.
+        if ( run_start < start ) {
+            free_runs[run_start] = start - run_start;
+            free_by_size.insert( std::make_pair((unsigned)(start - run_start), run_start) );
+        }
+        if ( run_end > end ) {
+            it = free_runs.insert( std::make_pair(end, (unsigned)(run_end - end)) ).first;
+            free_by_size.insert( std::make_pair((unsigned)(run_end - end), end) );
+            ++it;
+        }
+    }
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::mark_free( PageID start, unsigned run_size )
+{
+      // Pages already free are not counted twice.
+    mark_used( start, run_size );
+
+    PageID end = start + run_size;
+    std::map<PageID, unsigned>::iterator next = free_runs.lower_bound( end );
+    if ( next != free_runs.end() && next->first == end ) {
+        end += next->second;
+        free_by_size.erase( std::make_pair(next->second, next->first) );
+        free_runs.erase( next );
+    }
+
+    std::map<PageID, unsigned>::iterator prev = free_runs.lower_bound( start );
+    if ( prev != free_runs.begin() ) {
+        --prev;
+        if ( prev->first + (PageID)prev->second == start ) {
+            start = prev->first;
+            free_by_size.erase( std::make_pair(prev->second, prev->first) );
+            free_runs.erase( prev );
+        }
+    }
+
+    free_runs[start] = end - start;
+    free_by_size.insert( std::make_pair((unsigned)(end - start), start) );
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::init_dir_page( directory_page* dp, unsigned used_bytes )
+{
+    dp->next_page = INVALID_PAGE;
+    dp->num_entries = 1 + (page_size - used_bytes) / sizeof(file_entry);
+
+    for ( unsigned index=0; index < dp->num_entries; ++index )
+        dp->entries[index].pagenum = INVALID_PAGE;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::log_change( PageID pgid, Page* pg, const void* at, unsigned len )
+{
+      // The database is created before there is a log.
+    if ( MINIBASE_LOG != NULL )
+        MINIBASE_LOG->LogBytes( pgid, pg, at, len );
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+DB::directory_page* DB::dir_page( PageID pgid, Page* pg )
+{
+    return (pgid == 0) ? &((first_page*)pg)->dir : (directory_page*)pg;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::load_directory()
+{
+    std::lock_guard<std::recursive_mutex> guard( latch );
+
+    dir_index.clear();
+    dir_pages.clear();
+    dir_free.clear();
+
+    PageID nexthpid = 0;
+    while ( nexthpid != INVALID_PAGE ) {
+        PageID curpid = nexthpid;
+        Page* pg;
+        Status status = MINIBASE_BM->PinPage( curpid, pg );
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+        directory_page* dp = dir_page( curpid, pg );
+
+        unsigned index = dir_pages.size();
+        dir_pages.push_back( curpid );
+        for ( unsigned i = 0; i < dp->num_entries; ++i )
+            if ( dp->entries[i].pagenum == INVALID_PAGE )
+                dir_free.insert( std::make_pair(index, (int)i) );
+            else {
+                dir_slot entry = { index, (int)i, dp->entries[i].pagenum };
+                dir_index[dp->entries[i].fname] = entry;
+            }
+        nexthpid = dp->next_page;
+
+        status = MINIBASE_BM->UnpinPage( curpid );
+        if ( status != OK )
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    }
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::add_dir_page()
+{
+    PageID lastpid = dir_pages.back();
+    PageID newpid;
+    Status status = AllocatePage( newpid );
+    if ( status != OK )
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+
+    Page* pg;
+    status = MINIBASE_BM->PinPage( lastpid, pg );
+    if ( status != OK )
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    directory_page* dp = dir_page( lastpid, pg );
+    dp->next_page = newpid;
+    log_change( lastpid, pg, &dp->next_page, sizeof(dp->next_page) );
+
+    Page* newpg;
+    status = MINIBASE_BM->PinPage( newpid, newpg, true /*emptyPage*/ );
+    if ( status != OK ) {
+        MINIBASE_BM->UnpinPage( lastpid, true /*dirty*/ );
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    }
+    directory_page* newdp = (directory_page*)newpg;
+    init_dir_page( newdp, sizeof(directory_page) );
+    log_change( newpid, newpg, newpg, page_size );
+
+    unsigned index = dir_pages.size();
+    dir_pages.push_back( newpid );
+    for ( unsigned i = 0; i < newdp->num_entries; ++i )
+        dir_free.insert( std::make_pair(index, (int)i) );
+
+    status = MINIBASE_BM->UnpinPage( newpid, true /*dirty*/ );
+    Status laststatus = MINIBASE_BM->UnpinPage( lastpid, true /*dirty*/ );
+    if ( status == OK )
+        status = laststatus;
+    if ( status != OK )
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+const DB::dir_slot* DB::find_file_entry( const char* fname )
+{
+    std::unordered_map<std::string, dir_slot>::const_iterator it =
+        dir_index.find( fname );
+    return (it == dir_index.end()) ? NULL : &it->second;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::load_pack_map()
+{
+    std::lock_guard<std::mutex> guard( pack_latch );
+
+    pack_map.assign( num_pages, pack_entry() );
+    size_t bytes = num_pages*sizeof(pack_entry);
+    if ( ::pread(fd, &pack_map[0], bytes, page_size) != (ssize_t)bytes )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+      // The free units are the gaps between the slots.
+    std::vector< std::pair<unsigned, unsigned> > slots;
+    for ( unsigned i = 1; i < num_pages; ++i )
+        if ( pack_map[i].len > 0 )
+            slots.push_back( std::make_pair(pack_map[i].unit,
+                                            pack_units(pack_map[i].len)) );
+    std::sort( slots.begin(), slots.end() );
+
+    pack_free.clear();
+    pack_free_by_size.clear();
+    pack_end = 0;
+    for ( size_t i = 0; i < slots.size(); ++i ) {
+        if ( slots[i].first > pack_end )
+            pack_release( pack_end, slots[i].first - pack_end );
+        pack_end = std::max( pack_end, slots[i].first + slots[i].second );
+    }
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+unsigned DB::pack_take( unsigned units )
+{
+      // The shortest free run that is long enough, else the end.
+    std::set< std::pair<unsigned, unsigned> >::iterator fit =
+        pack_free_by_size.lower_bound( std::make_pair(units, 0u) );
+    if ( fit == pack_free_by_size.end() ) {
+        pack_end += units;
+        return pack_end - units;
+    }
+
+    unsigned unit = fit->second;
+    unsigned length = fit->first;
+    pack_free_by_size.erase( fit );
+    pack_free.erase( unit );
+    if ( length > units ) {
+        pack_free[unit + units] = length - units;
+        pack_free_by_size.insert( std::make_pair(length - units, unit + units) );
+    }
+    return unit;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+void DB::pack_release( unsigned unit, unsigned units )
+{
+    unsigned end = unit + units;
+    std::map<unsigned, unsigned>::iterator next = pack_free.find( end );
+    if ( next != pack_free.end() ) {
+        end += next->second;
+        pack_free_by_size.erase( std::make_pair(next->second, next->first) );
+        pack_free.erase( next );
+    }
+
+    std::map<unsigned, unsigned>::iterator prev = pack_free.lower_bound( unit );
+    if ( prev != pack_free.begin() ) {
+        --prev;
+        if ( prev->first + prev->second == unit ) {
+            unit = prev->first;
+            pack_free_by_size.erase( std::make_pair(prev->second, prev->first) );
+            pack_free.erase( prev );
+        }
+    }
+
+      // A run at the end just shortens the area.
+    if ( end == pack_end ) {
+        pack_end = unit;
+        return;
+    }
+    pack_free[unit] = end - unit;
+    pack_free_by_size.insert( std::make_pair(end - unit, unit) );
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+unsigned DB::pack_pages( Page** pages, int n, char* buf, unsigned* lens )
+{
+    unsigned at = 0;
+    for ( int i = 0; i < n; ++i ) {
+        char* slot = buf + (size_t)at*PACK_UNIT;
+        int len = PageCompress( (const char*)pages[i], page_size, slot );
+        if ( len == 0 ) {
+            memcpy( slot, pages[i], page_size );
+            len = page_size;
+        }
+
+          // Whatever is left of the last unit is written too.
+        unsigned units = pack_units( len );
+        memset( slot + len, 0, (size_t)units*PACK_UNIT - len );
+        lens[i] = len;
+        at += units;
+    }
+    return at;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+bool DB::pack_commit( PageID start, int n, unsigned unit, const unsigned* lens,
+                      bool whole )
+{
+    std::lock_guard<std::mutex> guard( pack_latch );
+
+    std::vector<pack_entry> entries( n );
+    unsigned units = 0;
+    for ( int i = 0; i < n; ++i ) {
+        entries[i].unit = unit + units;
+        entries[i].len = lens[i];
+        units += pack_units( lens[i] );
+    }
+
+      // The map is written before the old slots can be taken again, so
+      // that it never points at a slot holding another page.
+    if ( whole ) {
+        size_t bytes = n*sizeof(pack_entry);
+        whole = ( ::pwrite(fd, &entries[0], bytes,
+                           page_size + (off_t)start*sizeof(pack_entry))
+                  == (ssize_t)bytes );
+    }
+    if ( !whole ) {
+        pack_release( unit, units );
+        return false;
+    }
+
+    for ( int i = 0; i < n; ++i ) {
+        pack_entry& old = pack_map[start + i];
+        if ( old.len > 0 )
+            pack_release( old.unit, pack_units(old.len) );
+        old = entries[i];
+    }
+    return true;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::pack_read( PageID pageno, Page* pageptr )
+{
+    pack_entry slot;
+    {
+        std::lock_guard<std::mutex> guard( pack_latch );
+        slot = pack_map[pageno];
+    }
+    if ( slot.len == 0 ) {
+        memset( (char*)pageptr, 0, page_size );
+        return OK;
+    }
+
+    off_t at = pack_base + (off_t)slot.unit*PACK_UNIT;
+    std::vector<char> buf( slot.len );
+    char* into = ( slot.len == page_size ) ? (char*)pageptr : &buf[0];
+
+    long start = LatencyHistogram::Now();
+    ssize_t n = ::pread( fd, into, slot.len, at );
+    read_latency.RecordSince( start );
+    if ( n != (ssize_t)slot.len )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+    if ( into != (char*)pageptr
+            && !PageDecompress(into, slot.len, (char*)pageptr, page_size) )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::pack_write( PageID start, Page** pages, int n )
+{
+    std::vector<char> buf( (size_t)n*pack_units(page_size)*PACK_UNIT );
+    std::vector<unsigned> lens( n );
+    unsigned units = pack_pages( pages, n, &buf[0], &lens[0] );
+
+    unsigned unit;
+    {
+        std::lock_guard<std::mutex> guard( pack_latch );
+        unit = pack_take( units );
+    }
+
+    size_t bytes = (size_t)units*PACK_UNIT;
+    long began = LatencyHistogram::Now();
+    ssize_t written = ::pwrite( fd, &buf[0], bytes, pack_base + (off_t)unit*PACK_UNIT );
+    write_latency.RecordSince( began );
+    if ( !pack_commit(start, n, unit, &lens[0], written == (ssize_t)bytes) )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::pack_read_async( PageID pageno, Page* pageptr, IORequest& req )
+{
+    pack_entry slot;
+    {
+        std::lock_guard<std::mutex> guard( pack_latch );
+        slot = pack_map[pageno];
+    }
+    off_t at = pack_base + (off_t)slot.unit*PACK_UNIT;
+    unsigned size = page_size;
+    Status status;
+
+      // A page never written reads as zeroes, with a read of nothing to
+      // complete req; one kept as it is is read straight in.
+    if ( slot.len == 0 )
+        status = aio->Read( fd, (char*)pageptr, 0, 0, req, &read_latency,
+                            [pageptr, size]( bool whole ) {
+                                memset( (char*)pageptr, 0, size );
+                                return whole;
+                            } );
+    else if ( slot.len == page_size )
+        status = aio->Read( fd, (char*)pageptr, page_size, at, req, &read_latency );
+    else {
+        char* buf = new char[slot.len];
+        unsigned len = slot.len;
+        status = aio->Read( fd, buf, len, at, req, &read_latency,
+                            [buf, len, pageptr, size]( bool whole ) {
+                                whole = whole && PageDecompress( buf, len,
+                                                                 (char*)pageptr, size );
+                                delete [] buf;
+                                return whole;
+                            } );
+        if ( status != OK )
+            delete [] buf;
+    }
+
+    if ( status != OK )
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+    return OK;
+}
+
+// oooooooooooooooooooooooooooooooooooooo
+
+Status DB::pack_write_async( PageID start, Page** pages, int n, IORequest& req )
+{
+    char* buf = new char[(size_t)n*pack_units(page_size)*PACK_UNIT];
+    std::vector<unsigned> lens( n );
+    unsigned units = pack_pages( pages, n, buf, &lens[0] );
+
+    unsigned unit;
+    {
+        std::lock_guard<std::mutex> guard( pack_latch );
+        unit = pack_take( units );
+    }
+
+      // The map is pointed at the new slots on the I/O thread, once
+      // they are written.
+    if ( aio->Write(fd, buf, (size_t)units*PACK_UNIT, pack_base + (off_t)unit*PACK_UNIT,
+                    req, &write_latency,
+                    [this, start, n, unit, lens, buf]( bool whole ) {
+                        delete [] buf;
+                        return pack_commit( start, n, unit, &lens[0], whole );
+                    }) != OK ) {
+        delete [] buf;
+        pack_commit( start, n, unit, &lens[0], false );
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+    }
+
+    return OK;
+}
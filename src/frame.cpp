@@ -0,0 +1,433 @@
+#include <thread>
+#include "frame.h"
+#include "db.h"
+
+
+//-------------------------------------------------------------------
+// Frame::Frame
+//
+// Input   : data - the buffer for the frame's page, owned by the pool
+//           io - the request for the frame's reads, owned by the pool
+//           dirtyCount - counter of the pool's dirty frames, kept up
+//                        to date by the frame, or NULL
+// Purpose : Create an empty frame.
+//-------------------------------------------------------------------
+
+Frame::Frame(Page *data, IORequest *io, std::atomic<int> *dirtyCount)
+{
+	this->data = data;
+	this->io = io;
+	this->dirtyCount = dirtyCount;
+	pid = INVALID_PAGE;
+	pinCount = 0;
+	dirty = false;
+	referenced = false;
+	writing = false;
+	version = 0;
+	holds = 0;
+	lsn = 0;
+	recLSN = 0;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::Changed
+//
+// Purpose : Move to a new version ahead of a change to the page, so
+//           that optimistic readers of the old one fail to validate.
+//           The fence keeps the change from being seen before the new
+//           version is.
+//-------------------------------------------------------------------
+
+void Frame::Changed()
+{
+	version++;
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+
+void Frame::Pin()
+{
+	if (pinCount++ == 0)
+	{
+		Changed();
+	}
+}
+
+
+//-------------------------------------------------------------------
+// Frame::Unpin
+//
+// Purpose : Drop one pin.  A page whose last pin goes away is marked
+//           referenced, so the clock passes over it once.
+//-------------------------------------------------------------------
+
+void Frame::Unpin()
+{
+	if (--pinCount == 0)
+	{
+		referenced = true;
+	}
+}
+
+
+//-------------------------------------------------------------------
+// Frame::EmptyIt
+//
+// Purpose : Forget the page held by this frame.  The pin count is left
+//           alone; it belongs to whoever holds the frame.
+//-------------------------------------------------------------------
+
+void Frame::EmptyIt()
+{
+	Changed();
+	pid = INVALID_PAGE;
+	lsn = 0;
+	recLSN = 0;
+	Clean();
+}
+
+
+void Frame::DirtyIt()
+{
+	if (!dirty.exchange(true) && dirtyCount != NULL)
+	{
+		(*dirtyCount)++;
+	}
+}
+
+
+//-------------------------------------------------------------------
+// Frame::Clean
+//
+// Purpose : Mark the page clean, as it is about to be written back.
+// Return  : true if it was dirty.
+//-------------------------------------------------------------------
+
+bool Frame::Clean()
+{
+	if (dirty.exchange(false))
+	{
+		if (dirtyCount != NULL)
+		{
+			(*dirtyCount)--;
+		}
+		return true;
+	}
+	return false;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::SetPageID
+//
+// Input   : p - a page whose old contents are not needed
+// Purpose : Take page p without reading it.  A failed read left over
+//           from the frame's previous page is forgotten.
+//-------------------------------------------------------------------
+
+void Frame::SetPageID(PageID p)
+{
+	Changed();
+	pid = p;
+	lsn = 0;
+	recLSN = 0;
+	io->Reset();
+}
+
+
+bool Frame::IsDirty()
+{
+	return dirty;
+}
+
+
+bool Frame::IsValid()
+{
+	return pid != INVALID_PAGE;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::Write
+//
+// Purpose : Write the page back to disk if it is dirty, once the log
+//           is durable up to its LSN, and empty the frame.
+// Return  : OK, or the error from LogMgr::Flush or DB::WritePage.
+//-------------------------------------------------------------------
+
+Status Frame::Write()
+{
+	if (dirty)
+	{
+		if (lsn != 0 && MINIBASE_LOG != NULL && MINIBASE_LOG->Flush(lsn) != OK)
+		{
+			return FAIL;
+		}
+		Status s = MINIBASE_DB->WritePage(pid, data);
+		if (s != OK)
+		{
+			return s;
+		}
+	}
+	EmptyIt();
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::MarkRead
+//
+// Input   : p - the page to read
+//           callback - run on the I/O thread when the read completes
+// Purpose : Take page p and mark its read in flight, ahead of
+//           StartRead, so the frame can be entered in the page table.
+//-------------------------------------------------------------------
+
+void Frame::MarkRead(PageID p, std::function<void(IORequest*)> callback)
+{
+	Changed();
+	pid = p;
+	lsn = 0;
+	recLSN = 0;
+	io->Start();
+	io->callback = callback;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::StartRead
+//
+// Purpose : Start reading the page marked by MarkRead from disk.
+// Return  : OK, or FAIL if the read cannot be started; the read is
+//           then complete, failed, and its callback has not run.
+//-------------------------------------------------------------------
+
+Status Frame::StartRead()
+{
+	if (MINIBASE_DB->ReadPageAsync(pid, data, *io) != OK)
+	{
+		cerr << "Warning : Frame::StartRead cannot read page " << pid << endl;
+		return FAIL;
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::Free
+//
+// Purpose : Empty this frame of a page that is about to be deallocated,
+//           discarding its contents.
+//-------------------------------------------------------------------
+
+void Frame::Free()
+{
+	EmptyIt();
+	referenced = false;
+}
+
+
+bool Frame::NotPinned()
+{
+	return pinCount == 0;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::TryClaim
+//
+// Return  : true if the frame was unpinned, unclaimed and not held and
+//           is now claimed by the caller.  A page is held only while it
+//           is pinned, so once the claim is in no hold can be taken.
+//-------------------------------------------------------------------
+
+bool Frame::TryClaim()
+{
+	int expected = 0;
+	if (!pinCount.compare_exchange_strong(expected, CLAIMED))
+	{
+		return false;
+	}
+	if (holds != 0)
+	{
+		Release();
+		return false;
+	}
+	Changed();
+	return true;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::SetLSN
+//
+// Input   : l - the LSN of a group that changed the page
+// Purpose : Raise the page's LSN to l.
+//-------------------------------------------------------------------
+
+void Frame::SetLSN(LSN l)
+{
+	LSN old = lsn;
+	while (old < l && !lsn.compare_exchange_weak(old, l))
+	{
+	}
+}
+
+
+//-------------------------------------------------------------------
+// Frame::SetRecLSN
+//
+// Input   : l - where the log was when a group began to change the page
+// Purpose : Lower the page's recovery LSN to l, or set it if the page
+//           had no logged change unwritten.
+//-------------------------------------------------------------------
+
+void Frame::SetRecLSN(LSN l)
+{
+	LSN old = recLSN;
+	while ((old == 0 || l < old) && !recLSN.compare_exchange_weak(old, l))
+	{
+	}
+}
+
+
+//-------------------------------------------------------------------
+// Frame::RenewRecLSN
+//
+// Input   : l - an LSN the log is past, for a group about to log the
+//               whole page
+// Purpose : Move the page's recovery LSN on to l, if it is older.  It
+//           goes straight from one to the other, so that a checkpoint
+//           never finds it unset.
+// Return  : true if it was moved.
+//-------------------------------------------------------------------
+
+bool Frame::RenewRecLSN(LSN l)
+{
+	LSN old = recLSN;
+	while (old != 0 && old < l)
+	{
+		if (recLSN.compare_exchange_weak(old, l))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::StartOptimistic
+//
+// Input   : p - the page the caller expects the frame to hold
+// Output  : v - the version to validate against
+// Return  : true if the frame holds p unpinned, so the page can be read
+//           until Validate(v); false if the caller must pin it.  The
+//           page is marked referenced, as a pin would leave it, but
+//           only if it is not already, so readers share the line.
+//-------------------------------------------------------------------
+
+bool Frame::StartOptimistic(PageID p, unsigned int& v)
+{
+	v = version;
+	if (pinCount != 0 || pid != p)
+	{
+		return false;
+	}
+	if (!referenced.load(std::memory_order_relaxed))
+	{
+		referenced = true;
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::Validate
+//
+// Input   : v - from StartOptimistic
+// Return  : true if the page read since is the one StartOptimistic
+//           found, unchanged.
+//-------------------------------------------------------------------
+
+bool Frame::Validate(unsigned int v)
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return version.load(std::memory_order_relaxed) == v;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::StartWriting
+//
+// Purpose : Mark a frame claimed by the caller as being written back.
+//           Both the mark and a pin are sequentially consistent, so
+//           either a pin taken meanwhile shows up here or the pinner
+//           sees the mark.
+// Return  : true if the frame is still unpinned, so the page can be
+//           written; false, with the mark removed, if not.
+//-------------------------------------------------------------------
+
+bool Frame::StartWriting()
+{
+	writing = true;
+	if (pinCount != CLAIMED)
+	{
+		writing = false;
+		return false;
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------
+// Frame::WaitWritten
+//
+// Purpose : Wait, as a new pinner, for a write in progress to finish
+//           before the page is used.  Writes are short, so just yield.
+//-------------------------------------------------------------------
+
+void Frame::WaitWritten()
+{
+	while (writing)
+	{
+		std::this_thread::yield();
+	}
+}
+
+
+bool Frame::HasPageID(PageID p)
+{
+	return pid == p;
+}
+
+
+PageID Frame::GetPageID()
+{
+	return pid;
+}
+
+
+Page *Frame::GetPage()
+{
+	return data;
+}
+
+
+void Frame::UnsetReferenced()
+{
+	referenced = false;
+}
+
+
+bool Frame::IsReferenced()
+{
+	return referenced;
+}
+
+
+bool Frame::IsVictim()
+{
+	return !referenced && Evictable();
+}
@@ -0,0 +1,239 @@
+#include "hash.h"
+
+
+HashTable::HashTable(int capacity)
+{
+	unsigned int size = 16;
+	while (size < 2 * (unsigned int)capacity)
+	{
+		size *= 2;
+	}
+	mask = size - 1;
+	slots = new Entry[size];
+	EmptyIt();
+}
+
+
+HashTable::~HashTable()
+{
+	delete [] slots;
+	for (size_t i = 0; i < outgrown.size(); i++)
+	{
+		delete [] outgrown[i];
+	}
+}
+
+
+//-------------------------------------------------------------------
+// HashTable::Home
+//
+// Input   : pid - a page id
+//           m - the mask of the slots probed
+// Return  : The slot pid's probe starts at.  Page ids are dense, so
+//           they are scattered by a multiplicative hash; masking them
+//           directly would put the pages of a scan into one long run
+//           that every missing page would have to probe to its end.
+//-------------------------------------------------------------------
+
+unsigned int HashTable::Home(PageID pid, unsigned int m)
+{
+	return ((unsigned int)pid * 2654435769u >> 16) & m;
+}
+
+
+//-------------------------------------------------------------------
+// HashTable::Grow
+//
+// Purpose : Double the number of slots and reinsert every entry.  The
+//           new slots are in place before the new mask, which unlatched
+//           readers take first, so they never probe past the slots they
+//           find; the old slots are kept for readers still in them.
+//-------------------------------------------------------------------
+
+void HashTable::Grow()
+{
+	Entry *old = slots.load(std::memory_order_relaxed);
+	unsigned int oldSize = mask.load(std::memory_order_relaxed) + 1;
+
+	Entry *grown = new Entry[2 * oldSize];
+	for (unsigned int i = 0; i < 2 * oldSize; i++)
+	{
+		grown[i].pid.store(INVALID_PAGE, std::memory_order_relaxed);
+		grown[i].frameNo.store(INVALID_FRAME, std::memory_order_relaxed);
+	}
+	slots.store(grown, std::memory_order_release);
+	mask.store(2 * oldSize - 1, std::memory_order_release);
+	count = 0;
+
+	for (unsigned int i = 0; i < oldSize; i++)
+	{
+		PageID pid = old[i].pid.load(std::memory_order_relaxed);
+		if (pid != INVALID_PAGE)
+		{
+			Insert(pid, old[i].frameNo.load(std::memory_order_relaxed));
+		}
+	}
+	outgrown.push_back(old);
+}
+
+
+//-------------------------------------------------------------------
+// HashTable::Insert
+//
+// Input   : pid - a page not in the table, frameNo - its frame
+// Purpose : Add the entry.  The frame is stored before the page, so an
+//           unlatched reader that finds the page finds a frame number.
+//-------------------------------------------------------------------
+
+void HashTable::Insert(PageID pid, int frameNo)
+{
+	unsigned int m = mask.load(std::memory_order_relaxed);
+	if (2 * (count + 1) > m + 1)
+	{
+		Grow();
+		m = mask.load(std::memory_order_relaxed);
+	}
+
+	Entry *s = slots.load(std::memory_order_relaxed);
+	unsigned int i = Home(pid, m);
+	while (s[i].pid.load(std::memory_order_relaxed) != INVALID_PAGE)
+	{
+		i = (i + 1) & m;
+	}
+	s[i].frameNo.store(frameNo, std::memory_order_relaxed);
+	s[i].pid.store(pid, std::memory_order_release);
+	count++;
+}
+
+
+//-------------------------------------------------------------------
+// HashTable::Delete
+//
+// Input   : pid - the page to remove
+// Purpose : Empty pid's slot, then move back any later entry of the
+//           probe run that could not otherwise be found past the hole.
+// Return  : OK, or FAIL if pid is not in the table.
+//-------------------------------------------------------------------
+
+Status HashTable::Delete(PageID pid)
+{
+	unsigned int m = mask.load(std::memory_order_relaxed);
+	Entry *s = slots.load(std::memory_order_relaxed);
+
+	unsigned int i = Home(pid, m);
+	while (s[i].pid.load(std::memory_order_relaxed) != pid)
+	{
+		if (s[i].pid.load(std::memory_order_relaxed) == INVALID_PAGE)
+		{
+			return FAIL;
+		}
+		i = (i + 1) & m;
+	}
+
+	unsigned int hole = i;
+	PageID moving;
+	for (unsigned int j = (i + 1) & m;
+	     (moving = s[j].pid.load(std::memory_order_relaxed)) != INVALID_PAGE;
+	     j = (j + 1) & m)
+	{
+		// The entry at j may fill the hole if its home is not in the
+		// cyclic range (hole, j].
+		unsigned int home = Home(moving, m);
+		if (((j - home) & m) >= ((j - hole) & m))
+		{
+			s[hole].frameNo.store(s[j].frameNo.load(std::memory_order_relaxed),
+			                      std::memory_order_relaxed);
+			s[hole].pid.store(moving, std::memory_order_release);
+			hole = j;
+		}
+	}
+	s[hole].pid.store(INVALID_PAGE, std::memory_order_relaxed);
+	count--;
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// HashTable::LookUp
+//
+// Input   : pid - the page to look for
+// Return  : The frame holding pid, or INVALID_FRAME.
+//-------------------------------------------------------------------
+
+int HashTable::LookUp(PageID pid)
+{
+	unsigned int m = mask.load(std::memory_order_relaxed);
+	Entry *s = slots.load(std::memory_order_relaxed);
+
+	PageID found;
+	for (unsigned int i = Home(pid, m);
+	     (found = s[i].pid.load(std::memory_order_relaxed)) != INVALID_PAGE;
+	     i = (i + 1) & m)
+	{
+		if (found == pid)
+		{
+			return s[i].frameNo.load(std::memory_order_relaxed);
+		}
+	}
+	return INVALID_FRAME;
+}
+
+
+int HashTable::LookUpUnlatched(PageID pid)
+{
+	unsigned int m = mask.load(std::memory_order_acquire);
+	Entry *s = slots.load(std::memory_order_acquire);
+
+	PageID found;
+	for (unsigned int i = Home(pid, m), probed = 0;
+	     probed <= m && (found = s[i].pid.load(std::memory_order_acquire)) != INVALID_PAGE;
+	     i = (i + 1) & m, probed++)
+	{
+		if (found == pid)
+		{
+			return s[i].frameNo.load(std::memory_order_relaxed);
+		}
+	}
+	return INVALID_FRAME;
+}
+
+
+void HashTable::EmptyIt()
+{
+	unsigned int m = mask.load(std::memory_order_relaxed);
+	Entry *s = slots.load(std::memory_order_relaxed);
+
+	for (unsigned int i = 0; i <= m; i++)
+	{
+		s[i].pid.store(INVALID_PAGE, std::memory_order_relaxed);
+		s[i].frameNo.store(INVALID_FRAME, std::memory_order_relaxed);
+	}
+	count = 0;
+}
+
+
+//-------------------------------------------------------------------
+// PageTable::PageTable
+//
+// Input   : numOfFrames - size of the buffer pool
+// Purpose : Create the partitions, each with room for a fair share of
+//           the pool and then some; a partition that gets more pages
+//           than that grows.
+//-------------------------------------------------------------------
+
+PageTable::PageTable(int numOfFrames)
+{
+	for (int i = 0; i < PAGE_TABLE_PARTITIONS; i++)
+	{
+		partitions[i].table = new HashTable(2 * numOfFrames / PAGE_TABLE_PARTITIONS + 1);
+	}
+}
+
+
+PageTable::~PageTable()
+{
+	for (int i = 0; i < PAGE_TABLE_PARTITIONS; i++)
+	{
+		delete partitions[i].table;
+	}
+}
@@ -0,0 +1,676 @@
+#include <string.h>
+
+#include "bufmgr.h"
+#include "db.h"
+#include "heapfile.h"
+#include "heapfilescan.h"
+#include "log.h"
+
+
+//-------------------------------------------------------------------
+// HeapFile::HeapFile
+//
+// Input   : filename - name of the heap file
+// Output  : returnStatus - OK if the file was opened or created
+// Purpose : Open the heap file with this name, creating it if it does
+//           not exist, and load its free-space map.
+//-------------------------------------------------------------------
+
+HeapFile::HeapFile(Status& returnStatus, const char* filename)
+{
+	fileName = strcpy(new char[strlen(filename) + 1], filename);
+	header = NULL;
+	lastFSMPage = INVALID_PAGE;
+	returnStatus = OK;
+
+	std::lock_guard<std::mutex> idle(headerLatch);
+	LogGroup group;
+	Page *headerPage;
+	if (MINIBASE_DB->GetFileEntry(filename, headerID) != OK) {
+		// File does not exist, so create it with an empty map page.
+		PageID fsmID;
+		Page *fsmPage;
+
+		if (MINIBASE_BM->NewPage(headerID, headerPage) != OK) {
+			cerr << "Fail to allocate a new page" << endl;
+			headerID = INVALID_PAGE;
+			returnStatus = FAIL;
+			return;
+		}
+		if (MINIBASE_BM->NewPage(fsmID, fsmPage) != OK) {
+			cerr << "Fail to allocate a new page" << endl;
+			MINIBASE_BM->FreePage(headerID);
+			headerID = INVALID_PAGE;
+			returnStatus = FAIL;
+			return;
+		}
+
+		FreeSpaceMapPage *fsm = (FreeSpaceMapPage *)fsmPage;
+		fsm->nextPage = INVALID_PAGE;
+		fsm->numOfEntries = 0;
+		Logged(fsmID, fsm, fsm, sizeof(*fsm));
+		MINIBASE_BM->UnpinPage(fsmID, DIRTY);
+
+		header = (HeapFileHeaderPage *)headerPage;
+		header->firstPage = INVALID_PAGE;
+		header->lastPage = INVALID_PAGE;
+		header->fsmPage = fsmID;
+		header->numOfRecords = 0;
+		Logged(headerID, header, header, sizeof(*header));
+
+		if (MINIBASE_DB->AddFileEntry(filename, headerID) != OK) {
+			cerr << "Fail to create the file" << endl;
+			MINIBASE_BM->FreePage(fsmID);
+			MINIBASE_BM->FreePage(headerID);
+			headerID = INVALID_PAGE;
+			header = NULL;
+			returnStatus = FAIL;
+			return;
+		}
+		lastFSMPage = fsmID;
+		KeepHeader();
+		return;
+	}
+
+	if (MINIBASE_BM->PinPage(headerID, headerPage) != OK) {
+		cerr << "Fail to pin the page" << endl;
+		headerID = INVALID_PAGE;
+		returnStatus = FAIL;
+		return;
+	}
+	header = (HeapFileHeaderPage *)headerPage;
+
+	returnStatus = LoadFreeSpaceMap();
+	if (returnStatus == OK) {
+		KeepHeader();
+	}
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::~HeapFile
+//
+// Input   : None
+// Output  : None
+// Purpose : Close the file.  The header stays pinned while the file
+//           is open and is written back here.
+//-------------------------------------------------------------------
+
+HeapFile::~HeapFile()
+{
+	delete [] fileName;
+
+	if (headerID != INVALID_PAGE) {
+		if (MINIBASE_LOG != NULL) {
+			MINIBASE_LOG->Unkeep(headerID);
+		}
+		if (MINIBASE_BM->UnpinPage(headerID, DIRTY) != OK) {
+			cerr << "Deconstruction: Fail to unpin the page" << endl;
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::DestroyFile
+//
+// Input   : None
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Free every data page, map page and the header, and remove
+//           the file from the database directory.
+//-------------------------------------------------------------------
+
+Status HeapFile::DestroyFile()
+{
+	if (MINIBASE_LOG != NULL) {
+		MINIBASE_LOG->Unkeep(headerID);
+	}
+	LogGroup group;
+	PageID pid = header->firstPage;
+	while (pid != INVALID_PAGE) {
+		HeapPage *page;
+		PIN(pid, page);
+		PageID next = page->GetNextPage();
+		FREEPAGE(pid);
+		pid = next;
+	}
+
+	pid = header->fsmPage;
+	while (pid != INVALID_PAGE) {
+		FreeSpaceMapPage *fsm;
+		PIN(pid, fsm);
+		PageID next = fsm->nextPage;
+		FREEPAGE(pid);
+		pid = next;
+	}
+
+	FREEPAGE(headerID);
+	headerID = INVALID_PAGE;
+	header = NULL;
+	pageInfo.clear();
+	for (int i = 0; i < FSM_BINS; i++) {
+		bins[i].clear();
+	}
+	unusedEntries.clear();
+
+	if (MINIBASE_DB->DeleteFileEntry(fileName) != OK) {
+		cerr << "Fail to delete the file entry" << endl;
+		return FAIL;
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::InsertRecord
+//
+// Input   : recPtr - the record
+//           recLen - its length in bytes
+// Output  : rid - record id of the inserted record
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Insert a record on a page the free-space map says has
+//           room for it, adding a data page if none has.
+//-------------------------------------------------------------------
+
+Status HeapFile::InsertRecord(char* recPtr, int recLen, RecordID& rid)
+{
+	if (recLen <= 0 || recLen > HeapPage::DataSize()) {
+		cerr << "Record of length " << recLen << " does not fit on a page" << endl;
+		return FAIL;
+	}
+
+	std::lock_guard<std::mutex> idle(headerLatch);
+	LogGroup group;
+	RefreshHeader();
+
+	PageID pid;
+	if (FindPage(recLen, pid) != OK) {
+		return FAIL;
+	}
+
+	HeapPage *page;
+	PIN(pid, page);
+	if (page->InsertRecord(recPtr, recLen, rid) != OK) {
+		// The map is kept exact, so this means it is corrupt.
+		cerr << "Free-space map is wrong about page " << pid << endl;
+		UNPIN(pid, CLEAN);
+		return FAIL;
+	}
+	int freeSpace = page->AvailableSpace();
+	UNPIN(pid, DIRTY);
+
+	header->numOfRecords++;
+	Logged(headerID, header, &header->numOfRecords, sizeof(int));
+	return SetFreeSpace(pid, freeSpace);
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::DeleteRecord
+//
+// Input   : rid - record id of the record to delete
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Delete a record.  Its slot is reused by a later insert on
+//           the same page; a page left empty is freed.
+//-------------------------------------------------------------------
+
+Status HeapFile::DeleteRecord(const RecordID& rid)
+{
+	if (pageInfo.find(rid.pageNo) == pageInfo.end()) {
+		cerr << "Page " << rid.pageNo << " is not in this file" << endl;
+		return FAIL;
+	}
+
+	std::lock_guard<std::mutex> idle(headerLatch);
+	LogGroup group;
+	RefreshHeader();
+
+	HeapPage *page;
+	PIN(rid.pageNo, page);
+	if (page->DeleteRecord(rid) != OK) {
+		UNPIN(rid.pageNo, CLEAN);
+		return FAIL;
+	}
+	header->numOfRecords--;
+	Logged(headerID, header, &header->numOfRecords, sizeof(int));
+
+	if (page->IsEmpty()) {
+		return RemoveDataPage(rid.pageNo, page);
+	}
+
+	int freeSpace = page->AvailableSpace();
+	UNPIN(rid.pageNo, DIRTY);
+	return SetFreeSpace(rid.pageNo, freeSpace);
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::UpdateRecord
+//
+// Input   : rid - record id of the record to update
+//           recPtr - the new contents
+//           recLen - length of the new contents, which must equal the
+//                    length of the record
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Overwrite a record in place.
+//-------------------------------------------------------------------
+
+Status HeapFile::UpdateRecord(const RecordID& rid, char* recPtr, int recLen)
+{
+	if (pageInfo.find(rid.pageNo) == pageInfo.end()) {
+		cerr << "Page " << rid.pageNo << " is not in this file" << endl;
+		return FAIL;
+	}
+
+	LogGroup group;
+	HeapPage *page;
+	char *oldPtr;
+	int oldLen;
+	PIN(rid.pageNo, page);
+	if (page->ReturnRecord(rid, oldPtr, oldLen) != OK || oldLen != recLen) {
+		UNPIN(rid.pageNo, CLEAN);
+		return FAIL;
+	}
+	memcpy(oldPtr, recPtr, recLen);
+	page->Logged(oldPtr, recLen);
+	UNPIN(rid.pageNo, DIRTY);
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::GetRecord
+//
+// Input   : rid - record id of the record
+// Output  : recPtr - a copy of the record
+//           recLen - its length
+// Return  : OK if successful, FAIL otherwise.
+//-------------------------------------------------------------------
+
+Status HeapFile::GetRecord(const RecordID& rid, char* recPtr, int& recLen)
+{
+	if (pageInfo.find(rid.pageNo) == pageInfo.end()) {
+		cerr << "Page " << rid.pageNo << " is not in this file" << endl;
+		return FAIL;
+	}
+
+	HeapPage *page;
+	PIN(rid.pageNo, page);
+	Status s = page->GetRecord(rid, recPtr, recLen);
+	UNPIN(rid.pageNo, CLEAN);
+	return s;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::OpenScan
+//
+// Input   : batchSize - number of data pages to pin at a time
+// Output  : None
+// Return  : A scan over every record of the file.
+//-------------------------------------------------------------------
+
+HeapFileScan* HeapFile::OpenScan(int batchSize)
+{
+	return new HeapFileScan(this, batchSize > 0 ? batchSize : 1);
+}
+
+
+int HeapFile::GetNumOfRecords()
+{
+	return header->numOfRecords;
+}
+
+
+int HeapFile::GetNumOfPages()
+{
+	return pageInfo.size();
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::FSMCapacity
+//
+// Return  : Number of entries a free-space map page holds at the page
+//           size of the open database.
+//-------------------------------------------------------------------
+
+int HeapFile::FSMCapacity()
+{
+	return (MINIBASE_DB->GetPageSize() - sizeof(FreeSpaceMapPage)) / sizeof(FSMEntry) + 1;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::Logged
+//
+// Input   : pid, page - a header or map page of the file, pinned
+//           p, len - bytes of it just changed
+// Purpose : Log the change, if there is a log.
+//-------------------------------------------------------------------
+
+void HeapFile::Logged(PageID pid, void* page, const void* p, int len)
+{
+	if (MINIBASE_LOG != NULL) {
+		MINIBASE_LOG->LogBytes(pid, (Page *)page, p, len);
+	}
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::RefreshHeader
+//
+// Purpose : Log the header whole if it has been dirty since before the
+//           log's last checkpoint: it stays pinned while the file is
+//           open, so the pool never writes it.
+//-------------------------------------------------------------------
+
+void HeapFile::RefreshHeader()
+{
+	if (MINIBASE_LOG != NULL) {
+		MINIBASE_LOG->Refresh(headerID, (Page *)header, sizeof(*header));
+	}
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::KeepHeader
+//
+// Purpose : Have checkpoints refresh the header while the file is open
+//           and idle, so that an idle file does not hold the log back.
+//-------------------------------------------------------------------
+
+void HeapFile::KeepHeader()
+{
+	if (MINIBASE_LOG != NULL) {
+		MINIBASE_LOG->Keep(headerID, (Page *)header, sizeof(*header), &headerLatch);
+	}
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::BinOf
+//
+// Input   : freeSpace - free bytes on a data page
+// Return  : The bin the page belongs in.  Every page in bin b has at
+//           least b * HeapPage::DataSize() / FSM_BINS bytes free.
+//-------------------------------------------------------------------
+
+int HeapFile::BinOf(int freeSpace)
+{
+	if (freeSpace <= 0) {
+		return 0;
+	}
+	int bin = (int)((long)freeSpace * FSM_BINS / HeapPage::DataSize());
+	return (bin < FSM_BINS) ? bin : FSM_BINS - 1;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::LoadFreeSpaceMap
+//
+// Input   : None
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Read the map pages and put every data page in its bin.
+//-------------------------------------------------------------------
+
+Status HeapFile::LoadFreeSpaceMap()
+{
+	PageID fsmID = header->fsmPage;
+	while (fsmID != INVALID_PAGE) {
+		FreeSpaceMapPage *fsm;
+		PIN(fsmID, fsm);
+		for (int i = 0; i < fsm->numOfEntries; i++) {
+			FSMEntry& entry = fsm->entries[i];
+			if (entry.pid == INVALID_PAGE) {
+				FSMSlot slot = { fsmID, i };
+				unusedEntries.push_back(slot);
+				continue;
+			}
+			PageInfo info;
+			info.fsmPage = fsmID;
+			info.entry = i;
+			info.freeSpace = entry.freeSpace;
+			BinInsert(entry.pid, info);
+			pageInfo[entry.pid] = info;
+		}
+		lastFSMPage = fsmID;
+		PageID next = fsm->nextPage;
+		UNPIN(fsmID, CLEAN);
+		fsmID = next;
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::FindPage
+//
+// Input   : recLen - length of the record to be inserted
+// Output  : pid - a data page with at least recLen bytes free
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Take the most recently binned page of the first bin that
+//           is certain to have room.  The bin below may also hold pages
+//           with room; its last page is checked as well, since that
+//           costs no I/O.  If no page has room, add one.
+//-------------------------------------------------------------------
+
+Status HeapFile::FindPage(int recLen, PageID& pid)
+{
+	int dataSize = HeapPage::DataSize();
+	int first = (int)(((long)recLen * FSM_BINS + dataSize - 1) / dataSize);
+
+	if (first > 0 && first <= FSM_BINS && !bins[first - 1].empty()) {
+		PageID candidate = bins[first - 1].back();
+		if (pageInfo[candidate].freeSpace >= recLen) {
+			pid = candidate;
+			return OK;
+		}
+	}
+
+	for (int b = first; b < FSM_BINS; b++) {
+		if (!bins[b].empty()) {
+			pid = bins[b].back();
+			return OK;
+		}
+	}
+
+	return AddDataPage(pid);
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::AddDataPage
+//
+// Input   : None
+// Output  : pid - the new, empty data page
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Append a data page to the list and give it a map entry,
+//           reusing a freed entry or extending the map.
+//-------------------------------------------------------------------
+
+Status HeapFile::AddDataPage(PageID& pid)
+{
+	HeapPage *page;
+	NEWPAGE(pid, page);
+	page->Init(pid);
+	page->SetPrevPage(header->lastPage);
+	int freeSpace = page->AvailableSpace();
+	UNPIN(pid, DIRTY);
+
+	if (header->lastPage != INVALID_PAGE) {
+		HeapPage *last;
+		PIN(header->lastPage, last);
+		last->SetNextPage(pid);
+		UNPIN(header->lastPage, DIRTY);
+	} else {
+		header->firstPage = pid;
+	}
+	header->lastPage = pid;
+	Logged(headerID, header, header, 2 * sizeof(PageID));
+
+	// Find a map entry for the page.
+	FSMSlot slot;
+	if (!unusedEntries.empty()) {
+		slot = unusedEntries.back();
+		unusedEntries.pop_back();
+	} else {
+		FreeSpaceMapPage *fsm;
+		PIN(lastFSMPage, fsm);
+		if (fsm->numOfEntries == FSMCapacity()) {
+			PageID newID;
+			FreeSpaceMapPage *newFsm;
+			if (MINIBASE_BM->NewPage(newID, (Page *&)newFsm) != OK) {
+				cerr << "Unable to allocate new page " << newID << endl;
+				UNPIN(lastFSMPage, CLEAN);
+				return FAIL;
+			}
+			newFsm->nextPage = INVALID_PAGE;
+			newFsm->numOfEntries = 0;
+			Logged(newID, newFsm, newFsm, sizeof(*newFsm));
+			fsm->nextPage = newID;
+			Logged(lastFSMPage, fsm, &fsm->nextPage, sizeof(PageID));
+			UNPIN(lastFSMPage, DIRTY);
+			lastFSMPage = newID;
+			fsm = newFsm;
+		}
+		slot.fsmPage = lastFSMPage;
+		slot.entry = fsm->numOfEntries++;
+		Logged(lastFSMPage, fsm, &fsm->numOfEntries, sizeof(int));
+		UNPIN(lastFSMPage, DIRTY);
+	}
+
+	PageInfo info;
+	info.fsmPage = slot.fsmPage;
+	info.entry = slot.entry;
+	info.freeSpace = freeSpace;
+	BinInsert(pid, info);
+	pageInfo[pid] = info;
+
+	return SetFSMEntry(slot, pid, freeSpace);
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::RemoveDataPage
+//
+// Input   : pid - an empty data page, pinned by the caller
+//           page - the page
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Unlink the page from the list, free it and release its map
+//           entry.
+//-------------------------------------------------------------------
+
+Status HeapFile::RemoveDataPage(PageID pid, HeapPage* page)
+{
+	PageID prev = page->GetPrevPage();
+	PageID next = page->GetNextPage();
+
+	if (prev != INVALID_PAGE) {
+		HeapPage *prevPage;
+		PIN(prev, prevPage);
+		prevPage->SetNextPage(next);
+		UNPIN(prev, DIRTY);
+	} else {
+		header->firstPage = next;
+	}
+
+	if (next != INVALID_PAGE) {
+		HeapPage *nextPage;
+		PIN(next, nextPage);
+		nextPage->SetPrevPage(prev);
+		UNPIN(next, DIRTY);
+	} else {
+		header->lastPage = prev;
+	}
+	Logged(headerID, header, header, 2 * sizeof(PageID));
+
+	FREEPAGE(pid);
+
+	PageInfo& info = pageInfo[pid];
+	FSMSlot slot = { info.fsmPage, info.entry };
+	BinRemove(info);
+	pageInfo.erase(pid);
+	unusedEntries.push_back(slot);
+
+	return SetFSMEntry(slot, INVALID_PAGE, 0);
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::SetFreeSpace
+//
+// Input   : pid - a data page of this file
+//           freeSpace - its free space after a change
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Record a data page's new free space in the map, moving it
+//           to another bin if need be.
+//-------------------------------------------------------------------
+
+Status HeapFile::SetFreeSpace(PageID pid, int freeSpace)
+{
+	PageInfo& info = pageInfo[pid];
+	if (BinOf(freeSpace) != info.bin) {
+		BinRemove(info);
+		info.freeSpace = freeSpace;
+		BinInsert(pid, info);
+	} else {
+		info.freeSpace = freeSpace;
+	}
+
+	FSMSlot slot = { info.fsmPage, info.entry };
+	return SetFSMEntry(slot, pid, freeSpace);
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::SetFSMEntry
+//
+// Input   : slot - a map entry
+//           pid, freeSpace - its new contents
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+//-------------------------------------------------------------------
+
+Status HeapFile::SetFSMEntry(const FSMSlot& slot, PageID pid, int freeSpace)
+{
+	FreeSpaceMapPage *fsm;
+	PIN(slot.fsmPage, fsm);
+	fsm->entries[slot.entry].pid = pid;
+	fsm->entries[slot.entry].freeSpace = freeSpace;
+	Logged(slot.fsmPage, fsm, &fsm->entries[slot.entry], sizeof(FSMEntry));
+	UNPIN(slot.fsmPage, DIRTY);
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFile::BinInsert, HeapFile::BinRemove
+//
+// Purpose : Add a page to the bin for info.freeSpace, or take it out
+//           of its bin.  Removal swaps the last page of the bin into
+//           the hole, so both are O(1).
+//-------------------------------------------------------------------
+
+void HeapFile::BinInsert(PageID pid, PageInfo& info)
+{
+	info.bin = BinOf(info.freeSpace);
+	info.binPos = bins[info.bin].size();
+	bins[info.bin].push_back(pid);
+}
+
+
+void HeapFile::BinRemove(PageInfo& info)
+{
+	std::vector<PageID>& bin = bins[info.bin];
+	PageID moved = bin.back();
+	bin[info.binPos] = moved;
+	pageInfo[moved].binPos = info.binPos;
+	bin.pop_back();
+}
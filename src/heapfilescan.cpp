@@ -0,0 +1,141 @@
+#include "bufmgr.h"
+#include "heapfile.h"
+#include "heapfilescan.h"
+
+
+//-------------------------------------------------------------------
+// HeapFileScan::HeapFileScan
+//
+// Input   : file - the file to scan
+//           batchSize - number of data pages to pin at a time
+// Purpose : Set up a scan positioned before the first record.
+//-------------------------------------------------------------------
+
+HeapFileScan::HeapFileScan(HeapFile* file, int batchSize)
+	: strategy(2 * batchSize)
+{
+	this->file = file;
+	this->batchSize = batchSize;
+	curPage = 0;
+	scanStarted = false;
+	scanFinished = false;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFileScan::~HeapFileScan
+//
+// Input   : None
+// Output  : None
+// Purpose : Release the pages still pinned by the scan.
+//-------------------------------------------------------------------
+
+HeapFileScan::~HeapFileScan()
+{
+	UnpinBatch();
+}
+
+
+//-------------------------------------------------------------------
+// HeapFileScan::GetNext
+//
+// Input   : None
+// Output  : rid - record id of the next record
+//           recPtr - a copy of the record
+//           recLen - its length
+// Return  : OK if a record is returned, DONE if there are no more,
+//           FAIL on error.
+//-------------------------------------------------------------------
+
+Status HeapFileScan::GetNext(RecordID& rid, char* recPtr, int& recLen)
+{
+	if (scanFinished) {
+		return DONE;
+	}
+
+	Status s;
+	if (!scanStarted) {
+		scanStarted = true;
+		if (PinBatch(file->header->firstPage) != OK) {
+			scanFinished = true;
+			return FAIL;
+		}
+		s = batchPages.empty() ? DONE : batchPages[0]->FirstRecord(curRid);
+	} else {
+		s = batchPages[curPage]->NextRecord(curRid, curRid);
+	}
+
+	// Move on through the batch, and then to the next batch, until a
+	// page with a record turns up.
+	while (s == DONE) {
+		if (batchPages.empty()) {
+			scanFinished = true;
+			return DONE;
+		}
+		if (++curPage == (int)batchPages.size()) {
+			PageID next = batchPages.back()->GetNextPage();
+			if (UnpinBatch() != OK || PinBatch(next) != OK) {
+				scanFinished = true;
+				return FAIL;
+			}
+			if (batchPages.empty()) {
+				scanFinished = true;
+				return DONE;
+			}
+		}
+		s = batchPages[curPage]->FirstRecord(curRid);
+	}
+	if (s != OK) {
+		return FAIL;
+	}
+
+	rid = curRid;
+	return batchPages[curPage]->GetRecord(curRid, recPtr, recLen);
+}
+
+
+//-------------------------------------------------------------------
+// HeapFileScan::PinBatch
+//
+// Input   : first - the first data page of the batch, or INVALID_PAGE
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+// Purpose : Pin up to batchSize data pages following the page list
+//           from first.  An empty batch means the end of the file.
+//-------------------------------------------------------------------
+
+Status HeapFileScan::PinBatch(PageID first)
+{
+	curPage = 0;
+	PageID pid = first;
+	while (pid != INVALID_PAGE && (int)batchIDs.size() < batchSize) {
+		HeapPage *page;
+		PIN_USING(pid, page, &strategy);
+		batchIDs.push_back(pid);
+		batchPages.push_back(page);
+		pid = page->GetNextPage();
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// HeapFileScan::UnpinBatch
+//
+// Input   : None
+// Output  : None
+// Return  : OK if successful, FAIL otherwise.
+//-------------------------------------------------------------------
+
+Status HeapFileScan::UnpinBatch()
+{
+	Status s = OK;
+	for (size_t i = 0; i < batchIDs.size(); i++) {
+		if (MINIBASE_BM->UnpinPage(batchIDs[i], CLEAN) != OK) {
+			s = FAIL;
+		}
+	}
+	batchIDs.clear();
+	batchPages.clear();
+	return s;
+}
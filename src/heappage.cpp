@@ -5,6 +5,7 @@
 #include "heappage.h"
 #include "bufmgr.h"
 #include "db.h"
+#include "log.h"
 
 
 //------------------------------------------------------------------
@@ -19,20 +20,45 @@ void HeapPage::Init(PageID pageNo)
 	pid = pageNo;
 	prevPage = INVALID_PAGE;
 	nextPage = INVALID_PAGE;
-	fillPtr = sizeof(data); 					// fill data from the end of the page
-	freeSpace = sizeof(data) + sizeof(Slot); 	// add sizeof(Slot) as numOfSlots == 0
+	fillPtr = DataSize(); 						// fill data from the end of the page
+	freeSpace = DataSize() + sizeof(Slot); 	// add sizeof(Slot) as numOfSlots == 0
 	numOfSlots = 0;
-	SLOT_SET_EMPTY(slots[0]);
+	SLOT_SET_EMPTY(Slots()[0]);
+	Logged(this, (char *)&Slots()[1] - (char *)this);
+}
+
+
+void HeapPage::Logged(const void* p, int len)
+{
+	if (MINIBASE_LOG != NULL)
+	{
+		MINIBASE_LOG->LogBytes(pid, (Page *)this, p, len);
+	}
+}
+
+//------------------------------------------------------------------
+// HeapPage::DataSize
+//
+// Input     : None
+// Output    : None
+// Return    : Size of the data area of a page of the open database.
+//------------------------------------------------------------------
+
+int HeapPage::DataSize()
+{
+	return MINIBASE_DB->GetPageSize() - (MAX_SPACE - HEAPPAGE_DATA_SIZE);
 }
 
 void HeapPage::SetNextPage(PageID pageNo)
 {
 	nextPage = pageNo;
+	Logged(&nextPage, sizeof(nextPage));
 }
 
 void HeapPage::SetPrevPage(PageID pageNo)
 {
 	prevPage = pageNo;
+	Logged(&prevPage, sizeof(prevPage));
 }
 
 PageID HeapPage::GetNextPage()
@@ -74,7 +100,7 @@ Status HeapPage::InsertRecord(char *recPtr, int length, RecordID& rid)
 	int sid;
 	for (sid = 0; sid < numOfSlots; sid++)
 	{
-		if (SLOT_IS_EMPTY(slots[sid]))
+		if (SLOT_IS_EMPTY(Slots()[sid]))
 		{
 			// Found an empty slot. Use it.
 			break;
@@ -88,11 +114,16 @@ Status HeapPage::InsertRecord(char *recPtr, int length, RecordID& rid)
 		freeSpace -= sizeof(Slot);
 	}
 
-	SLOT_FILL(slots[sid], fillPtr, length);
+	SLOT_FILL(Slots()[sid], fillPtr, length);
 
 	// Next, copy the record into the data area.
 	memcpy(&data[fillPtr], recPtr, length);
 
+	// numOfSlots, fillPtr and freeSpace, the slot and the record.
+	Logged(&numOfSlots, 3 * sizeof(int));
+	Logged(&Slots()[sid], sizeof(Slot));
+	Logged(&data[fillPtr], length);
+
 	// Output the record id
 	rid.pageNo = pid;
 	rid.slotNo = sid;
@@ -126,7 +157,7 @@ Status HeapPage::DeleteRecord(const RecordID& rid)
 		return FAIL;
 	}
 
-	if (SLOT_IS_EMPTY(slots[rid.slotNo]))
+	if (SLOT_IS_EMPTY(Slots()[rid.slotNo]))
 	{
 		cerr << "Slot " << rid.slotNo << " is empty." << endl;
 		return FAIL;
@@ -134,8 +165,8 @@ Status HeapPage::DeleteRecord(const RecordID& rid)
 
 	// ASSERT : rid is valid.
 
-	short offset = slots[rid.slotNo].offset;
-	short length = slots[rid.slotNo].length;
+	int offset = Slots()[rid.slotNo].offset;
+	int length = Slots()[rid.slotNo].length;
 
 	if (rid.slotNo == numOfSlots - 1)
 	{
@@ -145,7 +176,7 @@ Status HeapPage::DeleteRecord(const RecordID& rid)
 		numOfSlots--;
 		freeSpace += sizeof(Slot);
 
-		while (numOfSlots > 0 && SLOT_IS_EMPTY(slots[numOfSlots - 1]))
+		while (numOfSlots > 0 && SLOT_IS_EMPTY(Slots()[numOfSlots - 1]))
 		{
 			numOfSlots--;
 			freeSpace += sizeof(Slot);
@@ -153,7 +184,7 @@ Status HeapPage::DeleteRecord(const RecordID& rid)
 	}
 	else
 	{
-		SLOT_SET_EMPTY(slots[rid.slotNo]);
+		SLOT_SET_EMPTY(Slots()[rid.slotNo]);
 	}
 
 	if (fillPtr < offset) {
@@ -164,15 +195,22 @@ Status HeapPage::DeleteRecord(const RecordID& rid)
 		// Update the slots directory.
 		for (int i = 0; i < numOfSlots; i++)
 		{
-			if (!SLOT_IS_EMPTY(slots[i]) && slots[i].offset < offset)
+			if (!SLOT_IS_EMPTY(Slots()[i]) && Slots()[i].offset < offset)
 			{
-				slots[i].offset += length;
+				Slots()[i].offset += length;
 			}
 		}
+		Logged(&data[fillPtr + length], offset - fillPtr);
+		Logged(Slots(), numOfSlots * sizeof(Slot));
+	}
+	else if (rid.slotNo < numOfSlots)
+	{
+		Logged(&Slots()[rid.slotNo], sizeof(Slot));
 	}
 
 	freeSpace += length;
 	fillPtr += length;
+	Logged(&numOfSlots, 3 * sizeof(int));
 
 	return OK;
 }
@@ -191,7 +229,7 @@ Status HeapPage::FirstRecord(RecordID& rid)
 {
 	for (int i = 0; i < numOfSlots; i++)
 	{
-		if (!SLOT_IS_EMPTY(slots[i]))
+		if (!SLOT_IS_EMPTY(Slots()[i]))
 		{
 			rid.slotNo = i;
 			rid.pageNo = pid;
@@ -231,7 +269,7 @@ Status HeapPage::NextRecord(RecordID curRid, RecordID& nextRid)
 	// scanning
 	for (int i = curRid.slotNo + 1; i < numOfSlots; i++)
 	{
-		if (!SLOT_IS_EMPTY(slots[i]))
+		if (!SLOT_IS_EMPTY(Slots()[i]))
 		{
 			nextRid.slotNo = i;
 			nextRid.pageNo = pid;
@@ -268,14 +306,14 @@ Status HeapPage::GetRecord(RecordID rid, char *recPtr, int& length)
 		return FAIL;
 	}
 
-	if (SLOT_IS_EMPTY(slots[rid.slotNo]))
+	if (SLOT_IS_EMPTY(Slots()[rid.slotNo]))
 	{
 		cerr << "Slot " << rid.slotNo << " is empty." << endl;
 		return FAIL;
 	}
 
-	length = slots[rid.slotNo].length;
-	memcpy(recPtr, &data[slots[rid.slotNo].offset], length);
+	length = Slots()[rid.slotNo].length;
+	memcpy(recPtr, &data[Slots()[rid.slotNo].offset], length);
 
 	return OK;
 }
@@ -306,14 +344,14 @@ Status HeapPage::ReturnRecord(RecordID rid, char*& recPtr, int& length)
 		return FAIL;
 	}
 
-	if (SLOT_IS_EMPTY(slots[rid.slotNo]))
+	if (SLOT_IS_EMPTY(Slots()[rid.slotNo]))
 	{
 		cerr << "Slot " << rid.slotNo << " is empty." << endl;
 		return FAIL;
 	}
 
-	length = slots[rid.slotNo].length;
-	recPtr = &data[slots[rid.slotNo].offset];
+	length = Slots()[rid.slotNo].length;
+	recPtr = &data[Slots()[rid.slotNo].offset];
 
 	return OK;
 }
@@ -332,7 +370,7 @@ int HeapPage::AvailableSpace(void)
 {
 	for (int i = 0; i < numOfSlots; i++)
 	{
-		if (SLOT_IS_EMPTY(slots[i]))
+		if (SLOT_IS_EMPTY(Slots()[i]))
 			return freeSpace;
 	}
 
@@ -372,7 +410,7 @@ int HeapPage::GetNumOfRecords()
 	int sum = 0;
 	for (int i = 0; i < numOfSlots; i++)
 	{
-		if (!(SLOT_IS_EMPTY(slots[i])))
+		if (!(SLOT_IS_EMPTY(Slots()[i])))
 		{
 			sum++;
 		}
@@ -394,15 +432,17 @@ void HeapPage::CompactSlotDir()
 {
 	int j = 0;
 	for (int i = 0; i < numOfSlots; i++) {
-		if (!SLOT_IS_EMPTY(slots[i])) {
+		if (!SLOT_IS_EMPTY(Slots()[i])) {
 			if (j < i) {
-				SLOT_FILL(slots[j], slots[i].offset, slots[i].length);
-				SLOT_SET_EMPTY(slots[i]);
+				SLOT_FILL(Slots()[j], Slots()[i].offset, Slots()[i].length);
+				SLOT_SET_EMPTY(Slots()[i]);
 			}
 			j++;
 		}
 	}
 
 	freeSpace += sizeof(Slot) * (numOfSlots-j);
+	Logged(Slots(), numOfSlots * sizeof(Slot));
 	numOfSlots = j;
+	Logged(&numOfSlots, 3 * sizeof(int));
 }
@@ -0,0 +1,226 @@
+#include <limits.h>
+
+#include "keysearch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KEYSEARCH_X86
+#include <immintrin.h>
+#endif
+
+
+//-------------------------------------------------------------------
+// CountLessScalar, CountLessSSE2, CountLessAVX2
+//
+// Input   : keys - array of n sorted keys
+//           key - the key to compare against
+// Return  : Number of keys in keys[0..n) that are < key.
+//-------------------------------------------------------------------
+
+static int CountLessScalar(const int* keys, int n, int key)
+{
+	int count = 0;
+	for (int i = 0; i < n; i++)
+	{
+		count += (keys[i] < key);
+	}
+	return count;
+}
+
+#ifdef KEYSEARCH_X86
+
+__attribute__((target("sse2")))
+static int CountLessSSE2(const int* keys, int n, int key)
+{
+	// A true compare is -1 in its lane, so subtracting the compare
+	// results keeps a per-lane count; add the lanes up at the end.
+	__m128i probe = _mm_set1_epi32(key);
+	__m128i counts = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)(keys + i));
+		counts = _mm_sub_epi32(counts, _mm_cmpgt_epi32(probe, block));
+	}
+	counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(1, 0, 3, 2)));
+	counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(counts) + CountLessScalar(keys + i, n - i, key);
+}
+
+__attribute__((target("avx2")))
+static int CountLessAVX2(const int* keys, int n, int key)
+{
+	__m256i probe = _mm256_set1_epi32(key);
+	__m256i counts = _mm256_setzero_si256();
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i *)(keys + i));
+		counts = _mm256_sub_epi32(counts, _mm256_cmpgt_epi32(probe, block));
+	}
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(half) + CountLessScalar(keys + i, n - i, key);
+}
+
+#endif
+
+
+//
+// The active kernel.  Binary search narrows [low, high) until it is no
+// wider than window keys, then countLess finishes the job; a window of
+// a few vectors is cheaper to sweep than to keep halving, and it has no
+// unpredictable branches.  The scalar kernel has a zero window, i.e. a
+// plain binary search.
+//
+
+typedef int (*CountLessFunc)(const int* keys, int n, int key);
+
+static KeySearchKernel kernel = KEYSEARCH_SCALAR;
+static CountLessFunc countLess = CountLessScalar;
+static int window = 0;
+
+
+//-------------------------------------------------------------------
+// KernelSupported
+//
+// Input   : k - a kernel
+// Return  : true if this CPU can run k.
+//-------------------------------------------------------------------
+
+static bool KernelSupported(KeySearchKernel k)
+{
+	switch (k)
+	{
+	case KEYSEARCH_SCALAR:
+		return true;
+#ifdef KEYSEARCH_X86
+	case KEYSEARCH_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case KEYSEARCH_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+
+//-------------------------------------------------------------------
+// KeySearchSetKernel
+//
+// Input   : k - the kernel to use
+// Return  : true if k is now in use, false if the CPU lacks support
+//           for it.
+// Purpose : Switch kernels.  Not synchronized; call it before any
+//           thread starts searching.
+//-------------------------------------------------------------------
+
+bool KeySearchSetKernel(KeySearchKernel k)
+{
+	if (!KernelSupported(k))
+	{
+		return false;
+	}
+
+	switch (k)
+	{
+#ifdef KEYSEARCH_X86
+	case KEYSEARCH_SSE2:
+		countLess = CountLessSSE2;
+		window = 8;
+		break;
+	case KEYSEARCH_AVX2:
+		countLess = CountLessAVX2;
+		window = 16;
+		break;
+#endif
+	default:
+		countLess = CountLessScalar;
+		window = 0;
+		break;
+	}
+	kernel = k;
+	return true;
+}
+
+
+//-------------------------------------------------------------------
+// PickBestKernel
+//
+// Purpose : Select the widest kernel the CPU supports.  Runs once
+//           during static initialization.
+//-------------------------------------------------------------------
+
+static bool PickBestKernel()
+{
+	return KeySearchSetKernel(KEYSEARCH_AVX2) ||
+		KeySearchSetKernel(KEYSEARCH_SSE2) ||
+		KeySearchSetKernel(KEYSEARCH_SCALAR);
+}
+
+static bool kernelPicked = PickBestKernel();
+
+
+KeySearchKernel KeySearchGetKernel()
+{
+	return kernel;
+}
+
+
+const char* KeySearchKernelName(KeySearchKernel k)
+{
+	switch (k)
+	{
+	case KEYSEARCH_SSE2:
+		return "sse2";
+	case KEYSEARCH_AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+
+//-------------------------------------------------------------------
+// KeySearchLowerBound
+//
+// Input   : keys - array of n sorted keys
+//           key - the key to look for
+// Return  : Index of the first key >= key, or n if there is none.
+//-------------------------------------------------------------------
+
+int KeySearchLowerBound(const int* keys, int n, int key)
+{
+	int low = 0, high = n;
+	while (high - low > window)
+	{
+		int mid = (low + high) / 2;
+		if (keys[mid] < key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low + countLess(keys + low, high - low, key);
+}
+
+
+//-------------------------------------------------------------------
+// KeySearchUpperBound
+//
+// Input   : keys - array of n sorted keys
+//           key - the key to look for
+// Return  : Index of the first key > key, or n if there is none.
+//-------------------------------------------------------------------
+
+int KeySearchUpperBound(const int* keys, int n, int key)
+{
+	// The first key > key is the first key >= key + 1.
+	if (key == INT_MAX)
+	{
+		return n;
+	}
+	return KeySearchLowerBound(keys, n, key + 1);
+}
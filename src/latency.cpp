@@ -0,0 +1,173 @@
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "latency.h"
+
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+
+long LatencyHistogram::Now()
+{
+	return (long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//-------------------------------------------------------------------
+// LatencyHistogram::Record
+//
+// Input   : ns - how long the operation took
+// Purpose : Count it in its bucket, on the calling thread's shard.
+//-------------------------------------------------------------------
+
+void LatencyHistogram::Record(long ns)
+{
+	static thread_local int shard =
+		(int)(std::hash<std::thread::id>()(std::this_thread::get_id()) % LATENCY_SHARDS);
+	Shard& s = shards[shard];
+
+	if (ns < 0)
+		ns = 0;
+	int bucket = 0;
+	for (unsigned long v = (unsigned long)ns >> 1; v != 0 && bucket < LATENCY_BUCKETS - 1; v >>= 1)
+	{
+		bucket++;
+	}
+
+	s.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	s.count.fetch_add(1, std::memory_order_relaxed);
+	s.total.fetch_add(ns, std::memory_order_relaxed);
+	long max = s.max.load(std::memory_order_relaxed);
+	while (ns > max && !s.max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+	{
+	}
+}
+
+
+void LatencyHistogram::Reset()
+{
+	for (int i = 0; i < LATENCY_SHARDS; i++)
+	{
+		for (int b = 0; b < LATENCY_BUCKETS; b++)
+		{
+			shards[i].buckets[b] = 0;
+		}
+		shards[i].count = 0;
+		shards[i].total = 0;
+		shards[i].max = 0;
+	}
+}
+
+
+long LatencyHistogram::GetCount() const
+{
+	long n = 0;
+	for (int i = 0; i < LATENCY_SHARDS; i++)
+	{
+		n += shards[i].count;
+	}
+	return n;
+}
+
+
+double LatencyHistogram::GetMean() const
+{
+	long n = 0, total = 0;
+	for (int i = 0; i < LATENCY_SHARDS; i++)
+	{
+		n += shards[i].count;
+		total += shards[i].total;
+	}
+	return n ? (double)total / n : 0;
+}
+
+
+long LatencyHistogram::GetMax() const
+{
+	long max = 0;
+	for (int i = 0; i < LATENCY_SHARDS; i++)
+	{
+		if (shards[i].max > max)
+			max = shards[i].max;
+	}
+	return max;
+}
+
+
+//-------------------------------------------------------------------
+// LatencyHistogram::GetPercentile
+//
+// Input   : p - a fraction, 0 to 1
+// Return  : The upper bound, in ns, of the bucket holding the
+//           operation at fraction p of the count, no more than the
+//           longest seen; 0 if none were recorded.
+//-------------------------------------------------------------------
+
+long LatencyHistogram::GetPercentile(double p) const
+{
+	long counts[LATENCY_BUCKETS];
+	long n = 0;
+	for (int b = 0; b < LATENCY_BUCKETS; b++)
+	{
+		counts[b] = 0;
+		for (int i = 0; i < LATENCY_SHARDS; i++)
+		{
+			counts[b] += shards[i].buckets[b];
+		}
+		n += counts[b];
+	}
+	if (n == 0)
+		return 0;
+
+	long rank = (long)(p * n + 0.5);
+	if (rank < 1)
+		rank = 1;
+	long seen = 0;
+	long max = GetMax();
+	for (int b = 0; b < LATENCY_BUCKETS; b++)
+	{
+		seen += counts[b];
+		if (seen >= rank)
+		{
+			long bound = (2L << b) - 1;
+			return bound < max ? bound : max;
+		}
+	}
+	return max;
+}
+
+
+void LatencyHistogram::WriteJSON(std::ostream& os) const
+{
+	long counts[LATENCY_BUCKETS];
+	int used = 0;
+	for (int b = 0; b < LATENCY_BUCKETS; b++)
+	{
+		counts[b] = 0;
+		for (int i = 0; i < LATENCY_SHARDS; i++)
+		{
+			counts[b] += shards[i].buckets[b];
+		}
+		if (counts[b] != 0)
+			used = b + 1;
+	}
+
+	os << "{\"count\":" << GetCount()
+	   << ",\"mean_ns\":" << (long)GetMean()
+	   << ",\"p50_ns\":" << GetPercentile(0.5)
+	   << ",\"p90_ns\":" << GetPercentile(0.9)
+	   << ",\"p99_ns\":" << GetPercentile(0.99)
+	   << ",\"p999_ns\":" << GetPercentile(0.999)
+	   << ",\"max_ns\":" << GetMax()
+	   << ",\"buckets\":[";
+	for (int b = 0; b < used; b++)
+	{
+		os << (b ? "," : "") << counts[b];
+	}
+	os << "]}";
+}
@@ -0,0 +1,1003 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+
+#include "log.h"
+#include "bufmgr.h"
+#include "sortedpage.h"
+
+
+static const unsigned LOG_MAGIC = 0x474c424d;		// "MBLG"
+
+// The start of the log file, padded to LOG_HEADER_SIZE.
+struct LogFileHeader {
+	unsigned magic;
+	unsigned unused;
+	LSN      start;			// LSN of the first byte after the header
+	LSN      checkpoint;	// LSN of the last checkpoint, or 0
+	LSN      redo;			// the log is needed from here on
+};
+
+thread_local std::vector<LogMgr::Group> LogMgr::groups;
+
+
+//-------------------------------------------------------------------
+// WriteAll
+//
+// Input   : fd - the file, data, len - what to write, offset - where
+// Return  : true if all of it was written.
+//-------------------------------------------------------------------
+
+static bool WriteAll(int fd, const char* data, size_t len, off_t offset)
+{
+	while (len > 0)
+	{
+		ssize_t n = ::pwrite(fd, data, len, offset);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		data += n;
+		len -= n;
+		offset += n;
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::LogMgr
+//
+// Input   : name - the log file
+//           maxSize - bytes the log may grow to between checkpoints
+//           create - true to start a new log even if the file exists
+// Output  : status - OK, or FAIL if the log cannot be opened or created
+// Purpose : Open the log, synchronous, cutting any torn group off its
+//           end, or create an empty one.
+//-------------------------------------------------------------------
+
+LogMgr::LogMgr( const char* name, long maxSize, bool create, Status& status )
+{
+	this->name = strcpy(new char[strlen(name) + 1], name);
+	this->maxSize = maxSize;
+	fd = -1;
+	start = redo = checkpointBegin = flushed = durable = end = LOG_HEADER_SIZE;
+	checkpoint = 0;
+	checkpointing = false;
+	writing = false;
+	failed = false;
+	synchronous = true;
+	redoRecords = redoApplied = redoTime = 0;
+	ResetStat();
+	status = Open(create);
+}
+
+
+LogMgr::~LogMgr()
+{
+	if (fd >= 0)
+	{
+		FlushAll();
+		::close(fd);
+	}
+	delete [] name;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Open
+//
+// Input   : create - true to start a new log whatever is there
+// Return  : OK, or FAIL if the file cannot be opened or is not a log.
+//-------------------------------------------------------------------
+
+Status LogMgr::Open( bool create )
+{
+	if (!create)
+	{
+		fd = ::open(name, O_RDWR);
+		if (fd < 0 && errno != ENOENT)
+		{
+			cerr << "  Cannot open log " << name << endl;
+			return FAIL;
+		}
+	}
+
+	if (fd < 0)
+	{
+		fd = ::open(name, O_RDWR | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0)
+		{
+			cerr << "  Cannot create log " << name << endl;
+			return FAIL;
+		}
+		start = LOG_HEADER_SIZE;
+		redo = checkpointBegin = flushed = durable = end = start;
+		checkpoint = 0;
+		return WriteHeader();
+	}
+
+	LogFileHeader header;
+	if (::pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+	    header.magic != LOG_MAGIC || header.start < LOG_HEADER_SIZE ||
+	    header.redo < header.start ||
+	    (header.checkpoint != 0 && header.checkpoint < header.redo))
+	{
+		cerr << "  " << name << " is not a log" << endl;
+		return FAIL;
+	}
+	start = header.start;
+	redo = checkpointBegin = header.redo;
+	checkpoint = header.checkpoint;
+
+	LSN tail;
+	if (Recover(tail) != OK)
+	{
+		return FAIL;
+	}
+	flushed = durable = end = tail;
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::WriteHeader
+//
+// Purpose : Write the file header, with the current start, checkpoint
+//           and redo point, and make it durable.
+// Return  : OK, or FAIL if it cannot be written.
+//-------------------------------------------------------------------
+
+Status LogMgr::WriteHeader()
+{
+	char block[LOG_HEADER_SIZE];
+	memset(block, 0, sizeof(block));
+	LogFileHeader header;
+	header.magic = LOG_MAGIC;
+	header.unused = 0;
+	header.start = start;
+	header.checkpoint = checkpoint;
+	header.redo = redo;
+	memcpy(block, &header, sizeof(header));
+
+	if (!WriteAll(fd, block, sizeof(block), 0) || ::fdatasync(fd) != 0)
+	{
+		cerr << "  Cannot write the header of log " << name << endl;
+		return FAIL;
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Recover
+//
+// Output  : tail - the LSN past the last whole group
+// Purpose : Check the groups in the file from the redo point, and cut
+//           off whatever follows the last one whose records are all
+//           there and match its LOG_END.
+// Return  : OK, or FAIL if the file cannot be read or cut.
+//-------------------------------------------------------------------
+
+Status LogMgr::Recover( LSN& tail )
+{
+	off_t size = ::lseek(fd, 0, SEEK_END);
+	off_t from = Offset(redo);
+	std::string log(size > from ? size - from : 0, '\0');
+	if (!log.empty() &&
+	    ::pread(fd, &log[0], log.size(), from) != (ssize_t)log.size())
+	{
+		cerr << "  Cannot read log " << name << endl;
+		return FAIL;
+	}
+
+	size_t group = 0;			// where the group being checked starts
+	size_t pos = 0;
+	while (pos + sizeof(LogRecordHeader) <= log.size())
+	{
+		LogRecordHeader header;
+		memcpy(&header, &log[pos], sizeof(header));
+		if (header.length < sizeof(header) || pos + header.length > log.size())
+		{
+			break;
+		}
+
+		if (header.type == LOG_END)
+		{
+			LogEnd e;
+			if (header.length != sizeof(header) + sizeof(e))
+			{
+				break;
+			}
+			memcpy(&e, &log[pos + sizeof(header)], sizeof(e));
+			if (e.groupStart != redo + (LSN)group || e.length != pos - group ||
+			    e.checksum != Checksum(&log[group], e.length))
+			{
+				break;
+			}
+			group = pos + header.length;
+		}
+		pos += header.length;
+	}
+
+	tail = redo + (LSN)group;
+	if (group < log.size() && ::ftruncate(fd, Offset(tail)) != 0)
+	{
+		cerr << "  Cannot cut the torn end off log " << name << endl;
+		return FAIL;
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::BeginGroup
+//
+// Input   : separate - true for a group of its own even inside another
+// Purpose : Open a group on the calling thread; groups opened inside
+//           it are part of it, unless separate.
+//-------------------------------------------------------------------
+
+void LogMgr::BeginGroup( bool separate )
+{
+	if (separate || groups.empty())
+	{
+		groups.push_back(Group());
+		groups.back().depth = 0;
+		groups.back().count = 0;
+		groups.back().from = 0;
+	}
+	groups.back().depth++;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::EndGroup
+//
+// Purpose : Close the calling thread's innermost group, and commit it
+//           if it was the outermost BeginGroup of it.
+//-------------------------------------------------------------------
+
+void LogMgr::EndGroup()
+{
+	Group& group = groups.back();
+	if (--group.depth > 0)
+	{
+		return;
+	}
+	Commit(group, groups.size() == 1);
+	groups.pop_back();
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Log
+//
+// Input   : type - what was done
+//           pid, page - the page it was done to, and where it is in
+//                       the pool; page is NULL if none was changed
+//           stamp - where the page keeps its LSN, or NULL
+//           body, length - the record's own data
+// Purpose : Add a record to the calling thread's group, holding the
+//           page in the pool until the group is appended.
+//-------------------------------------------------------------------
+
+void LogMgr::Log( LogRecordType type, PageID pid, Page* page, LSN* stamp,
+                  const void* body, int length )
+{
+	if (groups.empty())
+	{
+		BeginGroup();
+		Log(type, pid, page, stamp, body, length);
+		EndGroup();
+		return;
+	}
+
+	Group& group = groups.back();
+	AddRecord(group, type, pid, body, length);
+
+	if (page == NULL)
+	{
+		return;
+	}
+	for (size_t i = 0; i < group.held.size(); i++)
+	{
+		if (group.held[i].page == page && group.held[i].pid == pid)
+		{
+			if (stamp != NULL)
+			{
+				group.held[i].stamp = stamp;
+			}
+			return;
+		}
+	}
+	if (group.from == 0)
+	{
+		group.from = GetEndLSN();
+	}
+	MINIBASE_BM->HoldForLog(page, pid, group.from);
+	Held held = { page, pid, stamp };
+	group.held.push_back(held);
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::AddRecord
+//
+// Purpose : Add a record of type for page pid, with length bytes of
+//           body, to group.
+//-------------------------------------------------------------------
+
+void LogMgr::AddRecord( Group& group, LogRecordType type, PageID pid,
+                        const void* body, int length )
+{
+	LogRecordHeader header;
+	header.length = (unsigned short)(sizeof(header) + length);
+	header.type = (unsigned char)type;
+	header.unused = 0;
+	header.pid = pid;
+	group.records.append((const char *)&header, sizeof(header));
+	if (length > 0)
+	{
+		group.records.append((const char *)body, length);
+	}
+	group.count++;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::LogBytes
+//
+// Input   : pid, page - the page changed, as for Log
+//           at, len - the bytes changed, within page
+// Purpose : Log the bytes' new values, in records of LOG_MAX_BYTES at
+//           most, all in one group.
+//-------------------------------------------------------------------
+
+void LogMgr::LogBytes( PageID pid, Page* page, const void* at, int len )
+{
+	const char* from = (const char *)at;
+	std::string body;
+
+	BeginGroup();
+	do
+	{
+		int n = (len < LOG_MAX_BYTES) ? len : LOG_MAX_BYTES;
+		int offset = (int)(from - (const char *)page);
+		body.assign((const char *)&offset, sizeof(offset));
+		body.append(from, n);
+		Log(LOG_BYTES, pid, page, NULL, body.data(), (int)body.size());
+		from += n;
+		len -= n;
+	} while (len > 0);
+	EndGroup();
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Refresh
+//
+// Input   : pid, page - a page pinned by the caller
+//           len - how much of it to log
+// Purpose : Log the page whole if its recovery LSN is older than where
+//           the last checkpoint began, which the next checkpoint would
+//           otherwise have to keep the log for.  Its recovery LSN moves
+//           on to there: the groups before had all changed the page
+//           by then, and what is logged now has their changes, as no
+//           other group is changing it.
+//-------------------------------------------------------------------
+
+void LogMgr::Refresh( PageID pid, Page* page, int len )
+{
+	if (MINIBASE_BM->RenewRecLSN(page, pid, checkpointBegin))
+	{
+		LogBytes(pid, page, page, len);
+	}
+}
+
+
+void LogMgr::Keep( PageID pid, Page* page, int len, std::mutex* latch )
+{
+	std::lock_guard<std::mutex> guard(keptLatch);
+	Kept k = { page, len, latch };
+	kept[pid] = k;
+}
+
+
+void LogMgr::Unkeep( PageID pid )
+{
+	std::lock_guard<std::mutex> guard(keptLatch);
+	kept.erase(pid);
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::RefreshKept
+//
+// Purpose : Refresh each kept page whose file is idle, in a group of
+//           its own.  A file busy meanwhile refreshes the page itself
+//           as its operations begin, so only idle files need this.
+//           The file's latch is only tried: its holder may be waiting
+//           for the pool, and so for the checkpoint.
+//-------------------------------------------------------------------
+
+void LogMgr::RefreshKept()
+{
+	std::lock_guard<std::mutex> guard(keptLatch);
+	for (std::map<PageID, Kept>::iterator it = kept.begin(); it != kept.end(); ++it)
+	{
+		if (it->second.latch->try_lock())
+		{
+			BeginGroup(true);
+			Refresh(it->first, it->second.page, it->second.len);
+			EndGroup();
+			it->second.latch->unlock();
+		}
+	}
+}
+
+
+void LogMgr::Forget( PageID pid )
+{
+	for (size_t g = 0; g < groups.size(); g++)
+	{
+		std::vector<Held>& held = groups[g].held;
+		for (size_t i = 0; i < held.size(); )
+		{
+			if (held[i].pid == pid)
+			{
+				MINIBASE_BM->ReleaseForLog(held[i].page, pid, 0, NULL);
+				held.erase(held.begin() + i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Commit
+//
+// Input   : group - a group just closed
+//           wait - true to wait, if the log is synchronous, for the
+//                  group to be durable
+// Purpose : Append the group and its LOG_END to the log, in one piece,
+//           stamp and release the pages it held, and write the log if
+//           asked to or if enough is waiting.  Ask for a checkpoint if
+//           the log has grown enough since the last.
+// Return  : The LSN the group was appended at, or 0 if it was empty.
+//-------------------------------------------------------------------
+
+LSN LogMgr::Commit( Group& group, bool wait )
+{
+	if (group.records.empty())
+	{
+		return 0;
+	}
+
+	LogRecordHeader header;
+	header.length = sizeof(header) + sizeof(LogEnd);
+	header.type = LOG_END;
+	header.unused = 0;
+	header.pid = INVALID_PAGE;
+	LogEnd e;
+	e.length = (unsigned)group.records.size();
+	e.checksum = Checksum(group.records.data(), group.records.size());
+
+	LSN commit;
+	bool full, due;
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		e.groupStart = end;
+		buffer.append(group.records);
+		buffer.append((const char *)&header, sizeof(header));
+		buffer.append((const char *)&e, sizeof(e));
+		end += group.records.size() + sizeof(header) + sizeof(e);
+		commit = end;
+		full = buffer.size() >= (size_t)LOG_BUFFER_SIZE;
+		due = !checkpointing && maxSize > 0 && end - checkpointBegin >= maxSize / LOG_CHECKPOINTS;
+		if (due)
+		{
+			checkpointing = true;
+		}
+	}
+	numOfGroups++;
+	numOfRecords += group.count;
+	numOfBytes += group.records.size() + sizeof(header) + sizeof(e);
+
+	for (size_t i = 0; i < group.held.size(); i++)
+	{
+		MINIBASE_BM->ReleaseForLog(group.held[i].page, group.held[i].pid, commit,
+		                           group.held[i].stamp);
+	}
+	if (due)
+	{
+		MINIBASE_BM->RequestCheckpoint();
+	}
+
+	if ((wait && synchronous) || full)
+	{
+		Flush(commit);
+	}
+	return e.groupStart;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Flush
+//
+// Input   : lsn - how far the log must be durable
+// Purpose : Wait until the log is durable up to lsn.  If no thread is
+//           writing the log, write all that is appended and wait for
+//           the disk; otherwise wait for the thread that is, and write
+//           next if that was not far enough.  Threads committing while
+//           one writes are all covered by the next write.
+// Return  : OK, or FAIL if the log cannot be written.
+//-------------------------------------------------------------------
+
+Status LogMgr::Flush( LSN lsn )
+{
+	std::unique_lock<std::mutex> lock(latch);
+	if (lsn > end)
+	{
+		lsn = end;
+	}
+
+	while (durable < lsn)
+	{
+		if (failed)
+		{
+			return FAIL;
+		}
+		if (writing)
+		{
+			written.wait(lock);
+			continue;
+		}
+
+		writing = true;
+		std::string out;
+		out.swap(buffer);
+		off_t offset = Offset(flushed);
+		LSN to = end;
+		flushed = end;
+		lock.unlock();
+
+		long started = LatencyHistogram::Now();
+		bool ok = WriteAll(fd, out.data(), out.size(), offset) && ::fdatasync(fd) == 0;
+		writeLatency.RecordSince(started);
+		numOfWrites++;
+		out.clear();
+
+		lock.lock();
+		writing = false;
+		if (ok)
+		{
+			durable = to;
+		}
+		else
+		{
+			cerr << "  Cannot write log " << name << endl;
+			failed = true;
+		}
+		if (buffer.empty())
+		{
+			buffer.swap(out);		// keep the space for the next appends
+		}
+		written.notify_all();
+	}
+	return OK;
+}
+
+
+Status LogMgr::FlushAll()
+{
+	return Flush(GetEndLSN());
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Truncate
+//
+// Purpose : Empty the log, keeping its LSNs growing.  The new start
+//           goes in the header before the file is cut: were the file
+//           cut first, a crash could leave the old start, and LSNs
+//           below those stamped on the pages.  Records left behind the
+//           new header do not match their LOG_ENDs, so a crash in
+//           between loses nothing.
+// Return  : OK, or FAIL if the log cannot be written or cut.
+//-------------------------------------------------------------------
+
+Status LogMgr::Truncate()
+{
+	std::lock_guard<std::mutex> one(checkpointLatch);
+	if (FlushAll() != OK)
+	{
+		return FAIL;
+	}
+
+	std::lock_guard<std::mutex> guard(latch);
+	start = redo = checkpointBegin = end;
+	checkpoint = 0;
+	if (WriteHeader() != OK || ::ftruncate(fd, LOG_HEADER_SIZE) != 0)
+	{
+		cerr << "  Cannot truncate log " << name << endl;
+		failed = true;
+		return FAIL;
+	}
+	return OK;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Checkpoint
+//
+// Purpose : Write the unpinned pages dirty since the last checkpoint
+//           began, and log the kept ones of idle files again, then
+//           log the dirty page table, make it and the database durable
+//           and point the file header at it.  The redo point moves on
+//           to the oldest recovery LSN in the table, or to where this
+//           checkpoint began, and the space of the log before it is
+//           given back.  Groups go on being committed throughout.
+// Return  : OK, or FAIL if the log cannot be written or the database
+//           synced.
+//-------------------------------------------------------------------
+
+Status LogMgr::Checkpoint()
+{
+	std::lock_guard<std::mutex> one(checkpointLatch);
+	LSN old;
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		checkpointing = true;
+		old = checkpointBegin;
+	}
+	checkpointWrites += MINIBASE_BM->WriteOlderThan(old);
+	RefreshKept();
+
+	// A group appended before begin set the recovery LSNs of its pages
+	// before it was appended, so the table has them all.
+	LSN begin = GetEndLSN();
+	std::vector< std::pair<PageID, LSN> > dirty;
+	MINIBASE_BM->GetDirtyPages(dirty);
+	LSN from = begin;
+
+	Group group;
+	group.depth = 0;
+	group.count = 0;
+	group.from = 0;
+	size_t i = 0;
+	std::string body;
+	do
+	{
+		body.assign((const char *)&begin, sizeof(begin));
+		for (; i < dirty.size() && body.size() + sizeof(LogDirtyPage) <= (size_t)LOG_MAX_BYTES; i++)
+		{
+			LogDirtyPage page = { dirty[i].first, dirty[i].second };
+			body.append((const char *)&page, sizeof(page));
+			if (page.recLSN < from)
+			{
+				from = page.recLSN;
+			}
+		}
+		AddRecord(group, LOG_CHECKPOINT, INVALID_PAGE, body.data(), (int)body.size());
+	} while (i < dirty.size());
+
+	LSN at = Commit(group, false);
+	Status s = FlushAll();
+	if (s == OK)
+	{
+		// The pool's writes only reached the system's cache.
+		s = MINIBASE_DB->Sync();
+	}
+	if (s == OK)
+	{
+		{
+			std::lock_guard<std::mutex> guard(latch);
+			checkpoint = at;
+			redo = from;
+			checkpointBegin = begin;
+		}
+		s = WriteHeader();
+	}
+	if (s == OK)
+	{
+		// Only once the header no longer points before it.
+		off_t cut = Offset(from) - LOG_HEADER_SIZE;
+		if (cut > 0)
+		{
+			::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, LOG_HEADER_SIZE, cut);
+		}
+		numOfCheckpoints++;
+	}
+
+	std::lock_guard<std::mutex> guard(latch);
+	checkpointing = false;
+	return s;
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Restart
+//
+// Purpose : Redo the groups from the redo point on, see log.h.  The
+//           pages are changed in the pool, stamped and held as they
+//           were when the groups were first committed, but nothing is
+//           logged.
+// Return  : OK, or FAIL if the log cannot be read or a page pinned.
+//-------------------------------------------------------------------
+
+Status LogMgr::Restart()
+{
+	long started = LatencyHistogram::Now();
+	redoRecords = redoApplied = 0;
+
+	std::string log(end - redo, '\0');
+	if (!log.empty() &&
+	    ::pread(fd, &log[0], log.size(), Offset(redo)) != (ssize_t)log.size())
+	{
+		cerr << "  Cannot read log " << name << endl;
+		return FAIL;
+	}
+
+	// The last checkpoint's dirty page table, and where it began.  Pages
+	// not in it were clean then, so only what was logged for them since
+	// is needed.
+	std::map<PageID, LSN> dirty;
+	LSN begin = redo;
+	for (size_t pos = checkpoint != 0 ? (size_t)(checkpoint - redo) : log.size();
+	     pos + sizeof(LogRecordHeader) <= log.size(); )
+	{
+		LogRecordHeader header;
+		memcpy(&header, &log[pos], sizeof(header));
+		if (header.type != LOG_CHECKPOINT)
+		{
+			break;
+		}
+		const char* body = &log[pos + sizeof(header)];
+		memcpy(&begin, body, sizeof(begin));
+		for (size_t at = sizeof(begin); at + sizeof(LogDirtyPage) <= header.length - sizeof(header);
+		     at += sizeof(LogDirtyPage))
+		{
+			LogDirtyPage page;
+			memcpy(&page, body + at, sizeof(page));
+			dirty[page.pid] = page.recLSN;
+		}
+		pos += header.length;
+	}
+
+	// A page changed by a group, pinned until the group is done with.
+	struct Redone {
+		Page  *page;
+		PageID pid;
+		LSN   *stamp;
+		bool   changed;
+	};
+	std::vector<Redone> pages;
+
+	size_t pos = 0;
+	while (pos < log.size())
+	{
+		// The group's records, up to its LOG_END, all there as Recover
+		// has checked.
+		LSN groupStart = redo + (LSN)pos;
+		size_t last = pos;
+		LogRecordHeader header;
+		while (true)
+		{
+			memcpy(&header, &log[last], sizeof(header));
+			if (header.type == LOG_END)
+			{
+				break;
+			}
+			last += header.length;
+		}
+		LSN commit = redo + (LSN)(last + header.length);
+
+		pages.clear();
+		for (; pos < last; pos += header.length)
+		{
+			memcpy(&header, &log[pos], sizeof(header));
+			const char* body = &log[pos + sizeof(header)];
+			int length = header.length - sizeof(header);
+			if (header.type == LOG_CHECKPOINT)
+			{
+				continue;
+			}
+			redoRecords++;
+
+			std::map<PageID, LSN>::iterator it = dirty.find(header.pid);
+			if (it == dirty.end())
+			{
+				if (groupStart < begin)
+				{
+					continue;
+				}
+				it = dirty.insert(std::make_pair(header.pid, groupStart)).first;
+			}
+			else if (groupStart < it->second)
+			{
+				continue;
+			}
+
+			size_t p = 0;
+			while (p < pages.size() && pages[p].pid != header.pid)
+			{
+				p++;
+			}
+			if (p == pages.size())
+			{
+				Redone page = { NULL, header.pid, NULL, false };
+				if (MINIBASE_BM->PinPage(header.pid, page.page) != OK)
+				{
+					cerr << "  Cannot redo page " << header.pid << endl;
+					for (p = 0; p < pages.size(); p++)
+					{
+						if (pages[p].changed)
+							MINIBASE_BM->ReleaseForLog(pages[p].page, pages[p].pid, 0, NULL);
+						MINIBASE_BM->UnpinPage(pages[p].pid, pages[p].changed);
+					}
+					return FAIL;
+				}
+				pages.push_back(page);
+			}
+
+			bool applied = false;
+			if (header.type == LOG_BYTES)
+			{
+				int offset;
+				memcpy(&offset, body, sizeof(offset));
+				int n = length - (int)sizeof(offset);
+				if (offset >= 0 && n >= 0 && offset + n <= MINIBASE_BM->GetPageSize())
+				{
+					memcpy((char *)pages[p].page + offset, body + sizeof(offset), n);
+					applied = true;
+				}
+			}
+			else
+			{
+				applied = ((SortedPage *)pages[p].page)->Redo(header, body, commit, pages[p].stamp);
+			}
+
+			if (applied)
+			{
+				redoApplied++;
+				if (!pages[p].changed)
+				{
+					MINIBASE_BM->HoldForLog(pages[p].page, pages[p].pid, groupStart);
+					pages[p].changed = true;
+				}
+			}
+		}
+
+		for (size_t p = 0; p < pages.size(); p++)
+		{
+			if (pages[p].changed)
+			{
+				MINIBASE_BM->ReleaseForLog(pages[p].page, pages[p].pid, commit, pages[p].stamp);
+			}
+			MINIBASE_BM->UnpinPage(pages[p].pid, pages[p].changed);
+		}
+		pos = last + sizeof(LogRecordHeader) + sizeof(LogEnd);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		checkpointBegin = begin;
+	}
+	redoTime = LatencyHistogram::Now() - started;
+	return OK;
+}
+
+
+void LogMgr::SetSynchronous( bool on )
+{
+	synchronous = on;
+}
+
+
+LSN LogMgr::GetEndLSN()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	return end;
+}
+
+
+LSN LogMgr::GetDurableLSN()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	return durable;
+}
+
+
+LSN LogMgr::GetRedoLSN()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	return redo;
+}
+
+
+long LogMgr::GetSize()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	return end - redo;
+}
+
+
+void LogMgr::ResetStat()
+{
+	numOfGroups = 0;
+	numOfRecords = 0;
+	numOfBytes = 0;
+	numOfWrites = 0;
+	writeLatency.Reset();
+	numOfCheckpoints = 0;
+	checkpointWrites = 0;
+}
+
+
+void LogMgr::PrintStat()
+{
+	long groups = numOfGroups, writes = numOfWrites;
+
+	cout << "** Log Statistics **" << endl;
+	cout << "Commit: " << (synchronous ? "synchronous" : "asynchronous") << endl;
+	cout << "Groups Committed: " << groups << endl;
+	cout << "Records Logged: " << numOfRecords << " in " << numOfBytes << " bytes" << endl;
+	cout << "Log Writes: " << writes << ", " << (writes ? (double)groups / writes : 0)
+	     << " groups per write" << endl;
+	cout << "Log Write Latency p50/p99 (ns): " << writeLatency.GetPercentile(0.5)
+	     << " / " << writeLatency.GetPercentile(0.99) << endl;
+	cout << "Checkpoints: " << numOfCheckpoints << ", " << checkpointWrites
+	     << " pages written for them" << endl;
+	cout << "Log Size: " << GetSize() << " of " << maxSize << " bytes from LSN "
+	     << GetRedoLSN() << endl;
+	cout << "Restart: " << redoApplied << " of " << redoRecords << " records redone in "
+	     << redoTime / 1000000.0 << " ms" << endl;
+}
+
+
+void LogMgr::WriteJSON( std::ostream& os )
+{
+	os << "{\"synchronous\":" << (synchronous ? "true" : "false")
+	   << ",\"groups\":" << numOfGroups
+	   << ",\"records\":" << numOfRecords
+	   << ",\"bytes\":" << numOfBytes
+	   << ",\"writes\":" << numOfWrites
+	   << ",\"size\":" << GetSize()
+	   << ",\"checkpoints\":" << numOfCheckpoints
+	   << ",\"checkpoint_writes\":" << checkpointWrites
+	   << ",\"restart\":{\"records\":" << redoRecords
+	   << ",\"redone\":" << redoApplied
+	   << ",\"ns\":" << redoTime << "}"
+	   << ",\"write\":";
+	writeLatency.WriteJSON(os);
+	os << "}";
+}
+
+
+//-------------------------------------------------------------------
+// LogMgr::Checksum
+//
+// Return  : The 32-bit FNV-1a hash of the len bytes at data.
+//-------------------------------------------------------------------
+
+unsigned LogMgr::Checksum( const char* data, size_t len )
+{
+	unsigned h = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= (unsigned char)data[i];
+		h *= 16777619u;
+	}
+	return h;
+}
@@ -2,8 +2,10 @@
  * INFR11011 Minibase project
  */
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 
+#include "bufmgr.h"
 #include "btreetest.h"
 
 int MINIBASE_RESTART_FLAG = 0;
@@ -13,32 +15,99 @@ int main(int argc, char *argv[]) {
 	cout << "Execute 'btree ?' for info" << endl << endl;
 
 	BTreeTest btt;
+	unsigned pageSize = MINIBASE_PAGESIZE;
+	const char* policy = "Clock";
+	double dirtyTarget = -1;
+	DBIOMode iomode = DB_BUFFERED;
+	bool trackHeat = false;
+	int arg = 1;
+
+	while (argc >= arg + 1 && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-m") == 0 || strcmp(argv[arg], "-o") == 0
+		    || strcmp(argv[arg], "-z") == 0) {
+			iomode = (argv[arg][1] == 'm') ? DB_MAPPED
+			       : (argv[arg][1] == 'o') ? DB_DIRECT : DB_COMPRESSED;
+			arg++;
+			continue;
+		}
+		if (strcmp(argv[arg], "-t") == 0) {
+			trackHeat = true;
+			arg++;
+			continue;
+		}
+		if (argc < arg + 2)
+			break;
+		if (strcmp(argv[arg], "-p") == 0)
+			pageSize = atoi(argv[arg + 1]);
+		else if (strcmp(argv[arg], "-r") == 0)
+			policy = argv[arg + 1];
+		else if (strcmp(argv[arg], "-d") == 0)
+			dirtyTarget = atof(argv[arg + 1]);
+		else
+			break;
+		arg += 2;
+	}
 	
-	if (argc == 1) {
-		btt.RunTests(cin);
+	if (argc == arg) {
+		return (btt.RunTests(cin, pageSize, policy, dirtyTarget, iomode, trackHeat) == OK) ? 0 : 1;
 	}
-	else if (argc == 2 && argv[1][0] != '?') {
+	else if (argc == arg + 1 && argv[arg][0] != '?') {
 		ifstream is;
-		is.open(argv[1], ios::in);
+		is.open(argv[arg], ios::in);
 		if (!is.is_open()) {
-			cout << "Error: Failed to open " << argv[1] << endl;
+			cout << "Error: Failed to open " << argv[arg] << endl;
 			return 1;
 		}
-		btt.RunTests(is);
+		Status status = btt.RunTests(is, pageSize, policy, dirtyTarget, iomode, trackHeat);
 		is.close();
+		return (status == OK) ? 0 : 1;
 	}
 	else {
-		cout << "Syntax: btree [command_file]" << endl;
-		cout << "If no file, commands read from stdin" << endl << endl;
+		cout << "Syntax: btree [-p page_size] [-r policy] [-d dirty_target] [-m | -o | -z] [-t] [command_file]" << endl;
+		cout << "If no file, commands read from stdin" << endl;
+		cout << "page_size is a power of two from " << MINIBASE_MIN_PAGESIZE
+			<< " to " << MINIBASE_MAX_PAGESIZE << " bytes, default "
+			<< MINIBASE_PAGESIZE << endl;
+		cout << "policy is the buffer replacement policy: Clock (default), LRU,"
+			<< endl << "LRU-K or LRU-<k>, 2Q or ARC" << endl;
+		cout << "dirty_target is the share of buffer frames the background writer"
+			<< endl << "lets be dirty, from 0 to 1, default " << BUF_DIRTY_TARGET << endl;
+		cout << "-m maps the database into memory instead of using a buffer pool" << endl;
+		cout << "-o reads and writes the database with O_DIRECT, bypassing the" << endl
+			<< "system's page cache" << endl;
+		cout << "-z compresses the database's pages on disk; 'bufstats' reports how" << endl
+			<< "much room they take" << endl;
+		cout << "-t counts each page's accesses, and 'stats' reports the hottest" << endl
+			<< "pages and the accesses by file and tree level" << endl << endl;
 
 		cout << "Commands should be of the form:" << endl;
 		cout << "insert <low> <high>" << endl;
 		cout << "scan <low> <high>" << endl;
+		cout << "pscan <low> <high> <threads>" << endl;
 		cout << "delete <low> <high>" << endl;
 		cout << "print" << endl;
 		cout << "stats" << endl;
+		cout << "bufstats" << endl;
+		cout << "logstats" << endl;
+		cout << "logcheck (fails if the log has outgrown its size)" << endl;
+		cout << "metrics" << endl;
+		cout << "verify" << endl;
+		cout << "savewarm <file> (lists the pages in the buffer pool)" << endl;
+		cout << "warmup <file> (reads the pages listed back in)" << endl;
+		cout << "checkpoint" << endl;
+		cout << "restart (drops the buffer pool unwritten and restarts from the log)" << endl;
+		cout << "heaptest <n> (inserts, deletes, updates and scans n heap file records)" << endl;
+		cout << "heapcheck (checks the heap file heaptest left, e.g. after a restart)" << endl;
+		cout << "concurrency <threads> <keys> (each thread inserts into, scans and" << endl
+			<< "  deletes from a tree of its own, while pages are flushed at random)" << endl;
+		cout << "crashtest <rounds> <threads> (kills a process changing trees of its own" << endl
+			<< "  and checks them after restart, on a database of its own)" << endl;
+		cout << "warmtest <keys> (saves a warm list, reopens a database of its own," << endl
+			<< "  warms it up and scans it, and tries damaged lists)" << endl;
+		cout << "codectest <pages> (compresses and decompresses pages of each size)" << endl;
 		cout << "quit" << endl;
 		cout << "Note that (<low>==-1)=>min and (<high>==-1)=>max" << endl;
+		cout << "The exit status is 1 if a test command found errors" << endl;
 
 		return 1;
 	}
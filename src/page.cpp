@@ -0,0 +1,11 @@
+#include "page.h"
+
+
+Page::Page()
+{
+}
+
+
+Page::~Page()
+{
+}
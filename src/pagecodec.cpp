@@ -0,0 +1,197 @@
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "pagecodec.h"
+
+static const int MIN_MATCH = 4;
+static const int MAX_OFFSET = 65535;
+static const int HASH_BITS = 12;
+
+
+static uint32_t Load32(const unsigned char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+
+static int Hash(uint32_t v)
+{
+	return (int)((v * 2654435761u) >> (32 - HASH_BITS));
+}
+
+
+//-------------------------------------------------------------------
+// Emit
+//
+// Input   : lit, litLen - the literal bytes of a sequence
+//           offset, matchLen - its copy, or matchLen 0 for the last
+//                              sequence, which has none
+// Output  : op - advanced past the sequence
+// Purpose : Write a sequence: a token holding both lengths up to 15,
+//           the rest of each in bytes of 255 and a last smaller one,
+//           the literals, and the copy's offset, two bytes.
+// Return  : false if it does not fit before end.
+//-------------------------------------------------------------------
+
+static bool Emit(const unsigned char* lit, int litLen, int offset, int matchLen,
+                 unsigned char*& op, unsigned char* end)
+{
+	int m = matchLen > 0 ? matchLen - MIN_MATCH : 0;
+	if (op + 1 + litLen / 255 + 1 + litLen + 2 + m / 255 + 1 > end)
+	{
+		return false;
+	}
+
+	*op++ = (unsigned char)(((litLen < 15 ? litLen : 15) << 4) | (m < 15 ? m : 15));
+	if (litLen >= 15)
+	{
+		int rest = litLen - 15;
+		for (; rest >= 255; rest -= 255)
+			*op++ = 255;
+		*op++ = (unsigned char)rest;
+	}
+	memcpy(op, lit, litLen);
+	op += litLen;
+
+	if (matchLen > 0)
+	{
+		*op++ = (unsigned char)(offset & 0xff);
+		*op++ = (unsigned char)(offset >> 8);
+		if (m >= 15)
+		{
+			int rest = m - 15;
+			for (; rest >= 255; rest -= 255)
+				*op++ = 255;
+			*op++ = (unsigned char)rest;
+		}
+	}
+	return true;
+}
+
+
+int PageCompress(const char* page, int pageSize, char* out)
+{
+	// The words' differences.
+	std::vector<unsigned char> delta(pageSize);
+	uint32_t prev = 0;
+	for (int i = 0; i + 4 <= pageSize; i += 4)
+	{
+		uint32_t w = Load32((const unsigned char *)page + i);
+		uint32_t d = w - prev;
+		memcpy(&delta[i], &d, sizeof(d));
+		prev = w;
+	}
+
+	const unsigned char* src = &delta[0];
+	unsigned char* op = (unsigned char *)out;
+	unsigned char* end = op + pageSize - 1;
+	int table[1 << HASH_BITS];
+	for (int i = 0; i < (1 << HASH_BITS); i++)
+		table[i] = -1;
+
+	int ip = 0, anchor = 0;
+	while (ip + MIN_MATCH <= pageSize)
+	{
+		int h = Hash(Load32(src + ip));
+		int ref = table[h];
+		table[h] = ip;
+		if (ref < 0 || ip - ref > MAX_OFFSET || Load32(src + ref) != Load32(src + ip))
+		{
+			ip++;
+			continue;
+		}
+
+		int len = MIN_MATCH;
+		while (ip + len < pageSize && src[ref + len] == src[ip + len])
+			len++;
+		if (!Emit(src + anchor, ip - anchor, ip - ref, len, op, end))
+		{
+			return 0;
+		}
+		ip += len;
+		anchor = ip;
+	}
+	if (!Emit(src + anchor, pageSize - anchor, 0, 0, op, end))
+	{
+		return 0;
+	}
+	return (int)(op - (unsigned char *)out);
+}
+
+
+bool PageDecompress(const char* in, int len, char* page, int pageSize)
+{
+	const unsigned char* ip = (const unsigned char *)in;
+	const unsigned char* end = ip + len;
+	unsigned char* dst = (unsigned char *)page;
+	int op = 0;
+
+	while (ip < end)
+	{
+		int token = *ip++;
+		int litLen = token >> 4;
+		if (litLen == 15)
+		{
+			int b;
+			do {
+				if (ip >= end)
+					return false;
+				b = *ip++;
+				litLen += b;
+			} while (b == 255);
+		}
+		if (litLen > end - ip || litLen > pageSize - op)
+		{
+			return false;
+		}
+		memcpy(dst + op, ip, litLen);
+		ip += litLen;
+		op += litLen;
+		if (ip == end)
+		{
+			break;
+		}
+
+		if (end - ip < 2)
+		{
+			return false;
+		}
+		int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		int matchLen = (token & 15) + MIN_MATCH;
+		if ((token & 15) == 15)
+		{
+			int b;
+			do {
+				if (ip >= end)
+					return false;
+				b = *ip++;
+				matchLen += b;
+			} while (b == 255);
+		}
+		if (offset == 0 || offset > op || matchLen > pageSize - op)
+		{
+			return false;
+		}
+		// Byte by byte, as the copy may overlap what it writes.
+		for (int i = 0; i < matchLen; i++, op++)
+			dst[op] = dst[op - offset];
+	}
+	if (op != pageSize)
+	{
+		return false;
+	}
+
+	// Undo the differences.
+	uint32_t prev = 0;
+	for (int i = 0; i + 4 <= pageSize; i += 4)
+	{
+		uint32_t w = Load32(dst + i) + prev;
+		memcpy(dst + i, &w, sizeof(w));
+		prev = w;
+	}
+	return true;
+}
@@ -0,0 +1,455 @@
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "bufmgr.h"
+#include "db.h"
+#include "recoverytest.h"
+
+extern int MINIBASE_RESTART_FLAG;
+
+static const char* CRASH_DB = "crashdb";
+static const char* CRASH_LOG = "crashlog";
+static const int CRASH_DB_PAGES = 2000;
+static const int CRASH_LOG_SIZE = 150;		// small, so checkpoints are frequent
+static const int CRASH_FRAMES = 60;			// small, so pages are written often
+static const int CRASH_KEYS = 3000;			// keys each tree draws from
+
+static const char* WARM_DB = "warmdb";
+static const char* WARM_LOG = "warmlog";
+static const char* WARM_LIST = "warmlist";
+static const char* WARM_DAMAGED = "warmlist.bad";
+static const int WARM_FRAMES = 200;
+
+// Where SaveWarmList puts the count in its header, and where the
+// entries, each starting with a page id, begin.
+static const int WARM_COUNT_AT = 2 * sizeof(unsigned);
+static const int WARM_ENTRIES_AT = 4 * sizeof(unsigned);
+static const int WARM_ENTRY_SIZE = sizeof(PageID) + sizeof(int);
+
+
+RecoveryTest::RecoveryTest(unsigned pageSize, const char* policy, DBIOMode iomode)
+{
+	this->pageSize = pageSize;
+	this->policy = policy;
+	this->iomode = iomode;
+}
+
+
+//-------------------------------------------------------------------
+// RecoveryTest::Run
+//
+// Input   : rounds - children to kill
+//           nThreads - trees, each changed by a thread of its own
+// Return  : OK if no child found an error, FAIL otherwise.
+// Purpose : Run the test, see recoverytest.h.  A child is killed 30 to
+//           430 ms after it is ready, at a point that depends on
+//           rounds alone.  The database is removed afterwards.
+//-------------------------------------------------------------------
+
+Status RecoveryTest::Run(int rounds, int nThreads)
+{
+	cout << "Crash test of " << rounds << " rounds with " << nThreads << " threads." << endl;
+	remove(CRASH_DB);
+	remove(CRASH_LOG);
+
+	model.assign(nThreads, std::set<int>());
+	Message none = { 0, 0, DONE, 0 };
+	pending.assign(nThreads, none);
+
+	std::mt19937 rng(rounds);
+	long messages = 0;
+	int errors = 0;
+	for (int r = 0; r <= rounds && errors == 0; r++) {
+		bool last = (r == rounds);
+		int fds[2];
+		if (pipe(fds) != 0) {
+			cout << "  Error: cannot make a pipe" << endl;
+			return FAIL;
+		}
+
+		cout.flush();
+		pid_t child = fork();
+		if (child < 0) {
+			cout << "  Error: cannot fork" << endl;
+			close(fds[0]);
+			close(fds[1]);
+			return FAIL;
+		}
+		if (child == 0) {
+			close(fds[0]);
+			_exit(Child(r, last, fds[1]));
+		}
+		close(fds[1]);
+
+		int delay = 30 + rng() % 400;
+		std::thread killer;
+		Message m;
+		while (read(fds[0], &m, sizeof(m)) == sizeof(m)) {
+			messages++;
+			if (m.kind == READY) {
+				killer = std::thread([child, delay]() {
+					usleep(delay * 1000);
+					kill(child, SIGKILL);
+				});
+				continue;
+			}
+			pending[m.t] = m;
+			if (m.kind == DONE && m.insert) {
+				model[m.t].insert(m.key);
+			} else if (m.kind == DONE) {
+				model[m.t].erase(m.key);
+			}
+		}
+		close(fds[0]);
+		if (killer.joinable()) {
+			killer.join();
+		}
+
+		int status;
+		waitpid(child, &status, 0);
+		bool killed = WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+		bool passed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		if (last ? !passed : !killed) {
+			cout << "  Error: round " << r << " failed" << endl;
+			errors++;
+		}
+	}
+
+	size_t keys = 0;
+	for (int t = 0; t < nThreads; t++) {
+		keys += model[t].size();
+	}
+	cout << "  Crash test: " << messages << " messages, " << keys << " keys, "
+	     << errors << " errors." << endl;
+
+	remove(CRASH_DB);
+	remove(CRASH_LOG);
+	return (errors == 0) ? OK : FAIL;
+}
+
+
+//-------------------------------------------------------------------
+// RecoveryTest::Child
+//
+// Input   : round - 0 to create the database, else to restart it
+//           last - only check the database, then close it
+//           fd - the pipe to the parent
+// Return  : The child's exit status: 0 if the last child found the
+//           database as it should be, 2 if a child did not, 3 if it
+//           could not open it.  Other children never return.
+//-------------------------------------------------------------------
+
+int RecoveryTest::Child(int round, bool last, int fd)
+{
+	Status status;
+	MINIBASE_RESTART_FLAG = (round > 0);
+	minibase_globals = new SystemDefs(status, CRASH_DB, CRASH_LOG,
+	                                  (round > 0) ? 0 : CRASH_DB_PAGES, CRASH_LOG_SIZE,
+	                                  CRASH_FRAMES, policy, pageSize, iomode);
+	MINIBASE_RESTART_FLAG = 0;
+	if (status != OK) {
+		minibase_errors.show_errors();
+		cout << "  Error: cannot open the database in round " << round << endl;
+		return 3;
+	}
+
+	int n = model.size();
+	std::vector<BTreeFile*> files(n);
+	for (int t = 0; t < n; t++) {
+		char name[32];
+		sprintf(name, "Crash%d", t);
+		files[t] = new BTreeFile(status, name);
+		if (status != OK) {
+			cout << "  Error: cannot open index file " << name << endl;
+			return 3;
+		}
+	}
+
+	std::vector< std::set<int> > keys(n);
+	if (Check(files, keys, fd) != 0) {
+		cout << "  Error: round " << round << " found the trees changed" << endl;
+		return 2;
+	}
+	if (last) {
+		for (int t = 0; t < n; t++) {
+			delete files[t];
+		}
+		delete minibase_globals;
+		return 0;
+	}
+
+	Message ready = { 0, 0, READY, 0 };
+	write(fd, &ready, sizeof(ready));
+	std::vector<std::thread> workers;
+	for (int t = 0; t < n; t++) {
+		workers.push_back(std::thread(&RecoveryTest::Work, this, t, files[t], keys[t], round, fd));
+	}
+	for (int t = 0; t < n; t++) {
+		workers[t].join();
+	}
+	return 0;
+}
+
+
+//-------------------------------------------------------------------
+// RecoveryTest::Check
+//
+// Input   : files - the trees, just opened
+//           fd - the pipe to the parent
+// Output  : keys - the keys each tree has
+// Return  : The number of errors found.
+// Purpose : Verify each tree and scan it, checking it has the keys the
+//           parent knows of, in order, each with record id [key, t].
+//           Whether an operation in flight at the crash happened is
+//           told to the parent.
+//-------------------------------------------------------------------
+
+int RecoveryTest::Check(std::vector<BTreeFile*>& files, std::vector< std::set<int> >& keys, int fd)
+{
+	int errors = 0;
+	for (size_t t = 0; t < files.size(); t++) {
+		if (files[t]->Verify() != OK) {
+			errors++;
+		}
+
+		IndexFileScan* scan = files[t]->OpenScan(NULL, NULL);
+		if (scan == NULL) {
+			errors++;
+			continue;
+		}
+		RecordID rid;
+		int key, prev = -1;
+		while (scan->GetNext(rid, key) == OK) {
+			if (key <= prev || rid.pageNo != key || rid.slotNo != (int)t) {
+				errors++;
+			}
+			keys[t].insert(key);
+			prev = key;
+		}
+		delete scan;
+
+		std::set<int> expected = model[t];
+		Message m = pending[t];
+		if (m.kind == INTENT) {
+			m.kind = DONE;
+			m.insert = keys[t].count(m.key);
+			if (m.insert) {
+				expected.insert(m.key);
+			} else {
+				expected.erase(m.key);
+			}
+			write(fd, &m, sizeof(m));
+		}
+		if (keys[t] != expected) {
+			cout << "  Error: tree " << t << " has " << keys[t].size() << " keys, not "
+			     << expected.size() << endl;
+			errors++;
+		}
+	}
+	return errors;
+}
+
+
+//-------------------------------------------------------------------
+// RecoveryTest::Work
+//
+// Input   : t, btf - a thread's number and tree
+//           keys - the keys in the tree
+//           round, fd - the child's round and pipe to the parent
+// Purpose : Insert a random key the tree does not have, or delete one
+//           it has, telling the parent before and after each, until
+//           killed.  A failed operation ends the child.
+//-------------------------------------------------------------------
+
+void RecoveryTest::Work(int t, BTreeFile* btf, std::set<int> keys, int round, int fd)
+{
+	std::mt19937 rng(round * 100 + t);
+	while (true) {
+		Message m = { t, (int)(rng() % CRASH_KEYS), INTENT, 0 };
+		m.insert = !keys.count(m.key);
+		write(fd, &m, sizeof(m));
+
+		RecordID rid;
+		rid.pageNo = m.key;
+		rid.slotNo = t;
+		Status status = m.insert ? btf->Insert(m.key, rid) : btf->Delete(m.key, rid);
+		if (status != OK) {
+			minibase_errors.show_errors();
+			cout << "  Error: tree " << t << " cannot " << (m.insert ? "insert " : "delete ")
+			     << m.key << endl;
+			_exit(4);
+		}
+		if (m.insert) {
+			keys.insert(m.key);
+		} else {
+			keys.erase(m.key);
+		}
+
+		m.kind = DONE;
+		write(fd, &m, sizeof(m));
+	}
+}
+
+
+//-------------------------------------------------------------------
+// RecoveryTest::WarmUp
+//
+// Input   : keys - keys in the tree
+// Return  : OK if the child found no error, FAIL otherwise.
+// Purpose : Run the warm-up test, see recoverytest.h, in a child, and
+//           remove its files afterwards.
+//-------------------------------------------------------------------
+
+Status RecoveryTest::WarmUp(int keys)
+{
+	cout << "Warm-up test with " << keys << " keys." << endl;
+	remove(WARM_DB);
+	remove(WARM_LOG);
+	remove(WARM_LIST);
+
+	cout.flush();
+	pid_t child = fork();
+	if (child < 0) {
+		cout << "  Error: cannot fork" << endl;
+		return FAIL;
+	}
+	if (child == 0) {
+		_exit(WarmChild(keys));
+	}
+	int status;
+	waitpid(child, &status, 0);
+
+	remove(WARM_DB);
+	remove(WARM_LOG);
+	remove(WARM_LIST);
+	remove(WARM_DAMAGED);
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? OK : FAIL;
+}
+
+
+//-------------------------------------------------------------------
+// RecoveryTest::WarmChild
+//
+// Input   : keys - keys in the tree
+// Return  : The child's exit status: 0 if no error was found, 2 if
+//           one was, 3 if the database could not be built.
+//-------------------------------------------------------------------
+
+int RecoveryTest::WarmChild(int keys)
+{
+	Status status;
+	minibase_globals = new SystemDefs(status, WARM_DB, WARM_LOG, CRASH_DB_PAGES, CRASH_LOG_SIZE,
+	                                  WARM_FRAMES, policy, pageSize, iomode);
+	BTreeFile* btf = (status == OK) ? new BTreeFile(status, "Warm") : NULL;
+	for (int key = 0; key < keys && status == OK; key++) {
+		RecordID rid;
+		rid.pageNo = key;
+		rid.slotNo = 0;
+		status = btf->Insert(key, rid);
+	}
+	std::vector<PageID> upper;
+	if (status == OK) {
+		btf->GetUpperPages(upper);
+		status = MINIBASE_BM->SaveWarmList(WARM_LIST, &upper);
+	}
+	if (status != OK) {
+		minibase_errors.show_errors();
+		cout << "  Error: cannot build the database" << endl;
+		return 3;
+	}
+	delete btf;
+	delete minibase_globals;
+
+	// Open it again, warm the pool up and scan the whole tree.
+	int errors = 0;
+	minibase_globals = new SystemDefs(status, WARM_DB, WARM_LOG, 0, CRASH_LOG_SIZE,
+	                                  WARM_FRAMES, policy, pageSize, iomode);
+	if (status != OK) {
+		minibase_errors.show_errors();
+		cout << "  Error: cannot open the database again" << endl;
+		return 3;
+	}
+	int pages;
+	if (MINIBASE_BM->WarmUp(WARM_LIST, &pages) != OK || pages == 0) {
+		cout << "  Error: the pool was not warmed up" << endl;
+		errors++;
+	}
+	MINIBASE_BM->ResetStat();
+	btf = new BTreeFile(status, "Warm");
+	IndexFileScan* scan = (status == OK) ? btf->OpenScan(NULL, NULL) : NULL;
+	int found = 0;
+	RecordID rid;
+	int key;
+	while (scan != NULL && scan->GetNext(rid, key) == OK) {
+		if (key != found++) {
+			errors++;
+		}
+	}
+	delete scan;
+	long pins, misses;
+	MINIBASE_BM->GetStat(pins, misses);
+	if (found != keys || (!MINIBASE_BM->IsMapped() && misses != 0)) {
+		cout << "  Error: the scan found " << found << " of " << keys << " keys and missed "
+		     << misses << " times" << endl;
+		errors++;
+	}
+
+	// Damage the list.  It must be turned down if it claims more
+	// entries than it has, however many, and pages past the end of the
+	// database must be skipped.
+	std::ifstream in(WARM_LIST, std::ios::binary);
+	std::stringstream saved;
+	saved << in.rdbuf();
+	std::string list = saved.str();
+	unsigned count = 0;
+	if (list.size() >= (size_t)WARM_ENTRIES_AT) {
+		memcpy(&count, &list[WARM_COUNT_AT], sizeof(count));
+	}
+	if (count == 0 || WarmDamaged(list, count + 1, false) != -1 ||
+	    WarmDamaged(list, 0xffffffff, false) != -1 || WarmDamaged(list, count, true) != 0) {
+		cout << "  Error: a damaged warm list was used" << endl;
+		errors++;
+	}
+
+	delete btf;
+	delete minibase_globals;
+	cout << "  Warm-up test: " << pages << " pages warmed up, " << misses << " misses, "
+	     << errors << " errors." << endl;
+	return (errors == 0) ? 0 : 2;
+}
+
+
+//-------------------------------------------------------------------
+// RecoveryTest::WarmDamaged
+//
+// Input   : list - a warm list as SaveWarmList wrote it
+//           count - the count to give it
+//           pastEnd - whether to move its pages past the end of the
+//                     database
+// Return  : The pages warmed up from the damaged list, or -1 if it was
+//           turned down.
+//-------------------------------------------------------------------
+
+int RecoveryTest::WarmDamaged(const std::string& list, unsigned count, bool pastEnd)
+{
+	std::string damaged = list;
+	memcpy(&damaged[WARM_COUNT_AT], &count, sizeof(count));
+	for (size_t at = WARM_ENTRIES_AT; pastEnd && at < damaged.size(); at += WARM_ENTRY_SIZE) {
+		PageID pid = MINIBASE_DB->GetNumOfPages() + (int)at;
+		memcpy(&damaged[at], &pid, sizeof(pid));
+	}
+
+	std::ofstream out(WARM_DAMAGED, std::ios::binary | std::ios::trunc);
+	out.write(damaged.data(), damaged.size());
+	out.close();
+
+	int pages;
+	return (MINIBASE_BM->WarmUp(WARM_DAMAGED, &pages) == OK) ? pages : -1;
+}
@@ -0,0 +1,1027 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <algorithm>
+#include <thread>
+
+#include "replacer.h"
+
+
+FrameList::FrameList(int numOfFrames)
+	: prev(numOfFrames, INVALID_FRAME), next(numOfFrames, INVALID_FRAME),
+	  member(numOfFrames, false)
+{
+	head = INVALID_FRAME;
+	tail = INVALID_FRAME;
+	size = 0;
+}
+
+
+void FrameList::PushBack(int frameNo)
+{
+	prev[frameNo] = tail;
+	next[frameNo] = INVALID_FRAME;
+	if (tail != INVALID_FRAME)
+	{
+		next[tail] = frameNo;
+	}
+	else
+	{
+		head = frameNo;
+	}
+	tail = frameNo;
+	member[frameNo] = true;
+	size++;
+}
+
+
+void FrameList::Remove(int frameNo)
+{
+	if (!member[frameNo])
+	{
+		return;
+	}
+
+	if (prev[frameNo] != INVALID_FRAME)
+	{
+		next[prev[frameNo]] = next[frameNo];
+	}
+	else
+	{
+		head = next[frameNo];
+	}
+
+	if (next[frameNo] != INVALID_FRAME)
+	{
+		prev[next[frameNo]] = prev[frameNo];
+	}
+	else
+	{
+		tail = prev[frameNo];
+	}
+	member[frameNo] = false;
+	size--;
+}
+
+
+void GhostList::PushBack(PageID pid)
+{
+	if (Contains(pid))
+	{
+		return;
+	}
+	order.push_back(pid);
+	where[pid] = --order.end();
+}
+
+
+bool GhostList::Remove(PageID pid)
+{
+	std::unordered_map<PageID, std::list<PageID>::iterator>::iterator it = where.find(pid);
+	if (it == where.end())
+	{
+		return false;
+	}
+	order.erase(it->second);
+	where.erase(it);
+	return true;
+}
+
+
+void GhostList::PopFront()
+{
+	if (!order.empty())
+	{
+		where.erase(order.front());
+		order.pop_front();
+	}
+}
+
+
+Replacer::Replacer(int bufSize, Frame **bufFrames, PageTable *table, bool lockFree)
+	: freeFrames(bufSize)
+{
+	numOfFrames = bufSize;
+	frames = bufFrames;
+	pageTable = table;
+	this->lockFree = lockFree;
+	ResetStat();
+	for (int i = 0; i < numOfFrames; i++)
+	{
+		freeFrames.PushBack(i);
+	}
+	numOfFree = numOfFrames;
+}
+
+
+Replacer::~Replacer()
+{
+}
+
+
+void Replacer::ResetStat()
+{
+	dirtyVictims = 0;
+	evictions = 0;
+	pinnedSkips = 0;
+	victimLatency.Reset();
+}
+
+
+//-------------------------------------------------------------------
+// Replacer::TakeFreeFrame
+//
+// Return  : An empty frame, pinned once for the caller, or
+//           INVALID_FRAME if there are none.
+//-------------------------------------------------------------------
+
+int Replacer::TakeFreeFrame()
+{
+	if (numOfFree == 0)
+	{
+		return INVALID_FRAME;
+	}
+
+	int f;
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		if (freeFrames.Size() == 0)
+		{
+			return INVALID_FRAME;
+		}
+		f = freeFrames.Front();
+		freeFrames.Remove(f);
+		numOfFree--;
+	}
+
+	// A clock sweep may hold a passing claim on it.
+	while (!frames[f]->TryClaim())
+	{
+		std::this_thread::yield();
+	}
+	frames[f]->ClaimToPin();
+	return f;
+}
+
+
+//-------------------------------------------------------------------
+// Replacer::PickVictim
+//
+// Input   : pid - the page that is to be brought in
+// Output  : evicted - the page evicted from the frame, or INVALID_PAGE
+//           written - whether that page was dirty and written back
+// Purpose : Find a frame for pid: an empty one if there is one, or
+//           else the policy's choice.  The victim is claimed, and then
+//           checked again under its page table partition's latch: if
+//           it was pinned in the meantime another is chosen, otherwise
+//           its page is written back and dropped from the page table.
+//           The time to find the victim, not to write it, is recorded
+//           in victimLatency.
+// Return  : The frame, empty and pinned once for the caller, or
+//           INVALID_FRAME if every frame is pinned.
+//-------------------------------------------------------------------
+
+int Replacer::PickVictim(PageID pid, PageID* evicted, bool* written)
+{
+	bool told = false;		// the policy has seen the miss
+	long start = LatencyHistogram::Now();
+
+	if (evicted != NULL)
+		*evicted = INVALID_PAGE;
+	if (written != NULL)
+		*written = false;
+
+	while (true)
+	{
+		int f = TakeFreeFrame();
+		if (f != INVALID_FRAME)
+		{
+			if (!told && !lockFree)
+			{
+				std::lock_guard<std::mutex> guard(latch);
+				Miss(pid);
+			}
+			victimLatency.RecordSince(start);
+			return f;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(latch, std::defer_lock);
+			if (!lockFree)
+			{
+				lock.lock();
+			}
+			if (!told)
+			{
+				Miss(pid);
+				told = true;
+			}
+			f = ChooseVictim(pid);
+		}
+		if (f == INVALID_FRAME)
+		{
+			victimLatency.RecordSince(start);
+			return INVALID_FRAME;
+		}
+		if (!frames[f]->TryClaim())
+		{
+			pinnedSkips++;
+			continue;
+		}
+
+		switch (Evict(f, INVALID_PAGE, start, evicted, written))
+		{
+		case EVICTED:
+			return f;
+		case EVICT_FAILED:
+			return INVALID_FRAME;
+		default:
+			continue;
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------
+// Replacer::Evict
+//
+// Input   : f - a frame claimed by the caller
+//           expected - the page f should hold, or INVALID_PAGE for any
+//           start - when the victim search started
+// Output  : evicted, written - as for PickVictim
+// Purpose : Evict the page in f, writing it back if it is dirty, and
+//           turn the claim into the caller's pin.  Checked under the
+//           page's partition latch, in case the frame was pinned or
+//           emptied since it was claimed.
+// Return  : EVICTED; EVICT_LOST if the frame could not be had, with
+//           the claim dropped; EVICT_FAILED if the page could not be
+//           written.
+//-------------------------------------------------------------------
+
+int Replacer::Evict(int f, PageID expected, long start, PageID* evicted, bool* written)
+{
+	// A frame whose page is being freed or flushed is empty until
+	// PageRemoved puts it on the free list.
+	PageID victim = frames[f]->GetPageID();
+	if (victim == INVALID_PAGE || (expected != INVALID_PAGE && victim != expected))
+	{
+		frames[f]->Release();
+		std::this_thread::yield();
+		return EVICT_LOST;
+	}
+
+	{
+		PageTable::Partition& part = pageTable->Of(victim);
+		std::lock_guard<std::mutex> guard(part.latch);
+		if (frames[f]->GetPinCount() != Frame::CLAIMED || !frames[f]->HasPageID(victim))
+		{
+			frames[f]->Release();
+			pinnedSkips++;
+			return EVICT_LOST;
+		}
+		victimLatency.RecordSince(start);
+		evictions++;
+		bool dirty = frames[f]->IsDirty();
+		if (dirty)
+		{
+			dirtyVictims++;
+		}
+		if (frames[f]->Write() != OK)
+		{
+			frames[f]->Release();
+			return EVICT_FAILED;
+		}
+		part.table->Delete(victim);
+		if (evicted != NULL)
+			*evicted = victim;
+		if (written != NULL)
+			*written = dirty;
+
+		// Still under the partition latch, so the page cannot come
+		// back before the policy hears that it left.
+		std::unique_lock<std::mutex> lock(latch, std::defer_lock);
+		if (!lockFree)
+		{
+			lock.lock();
+		}
+		Evicted(f, victim);
+	}
+	frames[f]->ClaimToPin();
+	return EVICTED;
+}
+
+
+//-------------------------------------------------------------------
+// Replacer::Reuse
+//
+// Input   : f - a frame the caller loaded page old into earlier
+//           pid - the page that is to be brought in
+// Output  : evicted, written - as for PickVictim
+// Purpose : Take frame f back for pid, evicting old, rather than
+//           asking the policy for a victim.  This is how a
+//           BufferStrategy keeps a large scan in its own few frames.
+// Return  : f, empty and pinned once for the caller, or INVALID_FRAME
+//           if f is pinned or no longer holds old.
+//-------------------------------------------------------------------
+
+int Replacer::Reuse(int f, PageID old, PageID pid, PageID* evicted, bool* written)
+{
+	long start = LatencyHistogram::Now();
+
+	if (evicted != NULL)
+		*evicted = INVALID_PAGE;
+	if (written != NULL)
+		*written = false;
+
+	if (!frames[f]->HasPageID(old) || !frames[f]->TryClaim())
+	{
+		return INVALID_FRAME;
+	}
+	if (Evict(f, old, start, evicted, written) != EVICTED)
+	{
+		return INVALID_FRAME;
+	}
+	if (!lockFree)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		Miss(pid);
+	}
+	return f;
+}
+
+
+//-------------------------------------------------------------------
+// Replacer::NextVictims
+//
+// Input   : n - how many frames to look at
+// Output  : victims - up to n unpinned frames, those the policy would
+//                     evict first, in order
+// Purpose : Look ahead of PickVictim without changing anything.
+//-------------------------------------------------------------------
+
+void Replacer::NextVictims(std::vector<int>& victims, int n)
+{
+	victims.clear();
+	std::unique_lock<std::mutex> lock(latch, std::defer_lock);
+	if (!lockFree)
+	{
+		lock.lock();
+	}
+	Upcoming(victims, n);
+}
+
+
+//-------------------------------------------------------------------
+// Replacer::Unpinned
+//
+// Input   : list - frames in eviction order, n - how many to take
+// Output  : victims - the first unpinned frames of list, appended up
+//                     to n in all
+//-------------------------------------------------------------------
+
+void Replacer::Unpinned(FrameList& list, std::vector<int>& victims, int n)
+{
+	for (int f = list.Front(); f != INVALID_FRAME && (int)victims.size() < n; f = list.Next(f))
+	{
+		if (frames[f]->Evictable())
+		{
+			victims.push_back(f);
+		}
+	}
+}
+
+
+void Replacer::PageLoaded(int frameNo, PageID pid)
+{
+	if (!lockFree)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		Loaded(frameNo, pid);
+	}
+}
+
+
+void Replacer::PageHit(int frameNo)
+{
+	if (!lockFree)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		Hit(frameNo);
+	}
+}
+
+
+//-------------------------------------------------------------------
+// Replacer::PageRemoved
+//
+// Input   : frameNo - a frame that has just been emptied and unpinned
+//           pid - the page it held
+// Purpose : Take the frame out of the policy's lists and make it free.
+//-------------------------------------------------------------------
+
+void Replacer::PageRemoved(int frameNo, PageID pid)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	Forget(frameNo, pid);
+	if (!freeFrames.Contains(frameNo))
+	{
+		freeFrames.PushBack(frameNo);
+		numOfFree++;
+	}
+}
+
+
+Replacer* Replacer::Create(const char* policy, int bufSize,
+                           Frame **frames, PageTable *pageTable)
+{
+	if (policy == NULL || strcasecmp(policy, "Clock") == 0)
+	{
+		return new Clock(bufSize, frames, pageTable);
+	}
+	if (strcasecmp(policy, "LRU") == 0)
+	{
+		return new LRU(bufSize, frames, pageTable);
+	}
+	if (strncasecmp(policy, "LRU-", 4) == 0)
+	{
+		int k = atoi(policy + 4);
+		return new LRUK(bufSize, frames, pageTable, (k > 0) ? k : 2);
+	}
+	if (strcasecmp(policy, "2Q") == 0)
+	{
+		return new TwoQ(bufSize, frames, pageTable);
+	}
+	if (strcasecmp(policy, "ARC") == 0)
+	{
+		return new ARC(bufSize, frames, pageTable);
+	}
+
+	cerr << "Unknown replacement policy " << policy << ", using Clock" << endl;
+	return new Clock(bufSize, frames, pageTable);
+}
+
+
+Clock::Clock(int bufSize, Frame **bufFrames, PageTable *table)
+	: Replacer(bufSize, bufFrames, table, true)
+{
+	hand = 0;
+}
+
+
+Clock::~Clock()
+{
+}
+
+
+//-------------------------------------------------------------------
+// Clock::ChooseVictim
+//
+// Purpose : Sweep the clock hand over the frames, clearing reference
+//           bits, until an unpinned and unreferenced frame comes up.
+// Return  : The victim frame, or INVALID_FRAME if every frame is
+//           pinned.
+//-------------------------------------------------------------------
+
+int Clock::ChooseVictim(PageID pid)
+{
+	for (int i = 0; i < 2 * numOfFrames; i++)
+	{
+		int current = hand++ % numOfFrames;
+		Frame *f = frames[current];
+		if (f->ClearReferenced())
+		{
+			continue;
+		}
+		if (f->Evictable())
+		{
+			return current;
+		}
+		pinnedSkips++;
+	}
+	return INVALID_FRAME;
+}
+
+
+//-------------------------------------------------------------------
+// Clock::Upcoming
+//
+// Purpose : The unpinned, unreferenced frames among the next n the hand
+//           will pass.
+//-------------------------------------------------------------------
+
+void Clock::Upcoming(std::vector<int>& victims, int n)
+{
+	unsigned int start = hand;
+	for (int i = 0; i < n && i < numOfFrames; i++)
+	{
+		int current = (start + i) % numOfFrames;
+		if (frames[current]->IsVictim())
+		{
+			victims.push_back(current);
+		}
+	}
+}
+
+
+LRU::LRU(int bufSize, Frame **bufFrames, PageTable *table)
+	: Replacer(bufSize, bufFrames, table), lru(bufSize)
+{
+}
+
+
+int LRU::ChooseVictim(PageID pid)
+{
+	for (int f = lru.Front(); f != INVALID_FRAME; f = lru.Next(f))
+	{
+		if (frames[f]->Evictable())
+		{
+			return f;
+		}
+		pinnedSkips++;
+	}
+	return INVALID_FRAME;
+}
+
+
+void LRU::Forget(int frameNo, PageID pid)
+{
+	lru.Remove(frameNo);
+}
+
+
+LRUK::LRUK(int bufSize, Frame **bufFrames, PageTable *table, int k)
+	: Replacer(bufSize, bufFrames, table)
+{
+	this->k = k;
+	now = 0;
+	snprintf(name, sizeof(name), "LRU-%d", k);
+}
+
+
+//-------------------------------------------------------------------
+// LRUK::Touch
+//
+// Input   : pid - a page being accessed
+// Return  : Its history, with this access recorded.
+//-------------------------------------------------------------------
+
+LRUK::History& LRUK::Touch(PageID pid)
+{
+	History& h = history[pid];
+	if (h.times.empty())
+	{
+		h.times.assign(k, 0);
+		h.count = 0;
+		h.next = 0;
+	}
+	h.times[h.next] = ++now;
+	h.next = (h.next + 1) % k;
+	if (h.count < k)
+	{
+		h.count++;
+	}
+	return h;
+}
+
+
+//-------------------------------------------------------------------
+// LRUK::Prune
+//
+// Purpose : Once the history holds more than three pools' worth of
+//           pages, drop the evicted pages least recently used until
+//           it holds two.
+//-------------------------------------------------------------------
+
+void LRUK::Prune()
+{
+	if ((int)history.size() <= 3 * numOfFrames)
+	{
+		return;
+	}
+
+	std::vector<std::pair<long, PageID> > gone;
+	for (std::unordered_map<PageID, History>::iterator it = history.begin();
+	     it != history.end(); ++it)
+	{
+		if (!it->second.resident)
+		{
+			History& h = it->second;
+			gone.push_back(std::make_pair(h.times[(h.next + k - 1) % k], it->first));
+		}
+	}
+
+	size_t drop = history.size() - 2 * numOfFrames;
+	if (drop > gone.size())
+	{
+		drop = gone.size();
+	}
+	std::nth_element(gone.begin(), gone.begin() + drop, gone.end());
+	for (size_t i = 0; i < drop; i++)
+	{
+		history.erase(gone[i].second);
+	}
+}
+
+
+void LRUK::Loaded(int frameNo, PageID pid)
+{
+	Touch(pid).resident = true;
+}
+
+
+void LRUK::Hit(int frameNo)
+{
+	Touch(frames[frameNo]->GetPageID());
+}
+
+
+//-------------------------------------------------------------------
+// LRUK::ChooseVictim
+//
+// Return  : The unpinned frame with the oldest K-th most recent access,
+//           where pages with fewer than K accesses come first in order
+//           of last access, or INVALID_FRAME if all are pinned.
+//-------------------------------------------------------------------
+
+int LRUK::ChooseVictim(PageID pid)
+{
+	int victim = INVALID_FRAME;
+	bool victimShort = false;
+	long victimTime = LONG_MAX;
+
+	for (int f = 0; f < numOfFrames; f++)
+	{
+		bool isShort;
+		long time;
+		if (!Age(f, isShort, time))
+		{
+			if (!frames[f]->Evictable())
+			{
+				pinnedSkips++;
+			}
+			continue;
+		}
+
+		if (victim == INVALID_FRAME || (isShort && !victimShort) ||
+		    (isShort == victimShort && time < victimTime))
+		{
+			victim = f;
+			victimShort = isShort;
+			victimTime = time;
+		}
+	}
+	return victim;
+}
+
+
+//-------------------------------------------------------------------
+// LRUK::Age
+//
+// Input   : frameNo - a frame
+// Output  : isShort - the page has fewer than K accesses
+//           time - its K-th most recent access, or its last if short
+// Return  : false if the frame is pinned or holds no page with a
+//           history, so it cannot be a victim.
+//-------------------------------------------------------------------
+
+bool LRUK::Age(int frameNo, bool& isShort, long& time)
+{
+	if (!frames[frameNo]->Evictable())
+	{
+		return false;
+	}
+
+	// A frame may be between pages, with no history yet.
+	std::unordered_map<PageID, History>::iterator it = history.find(frames[frameNo]->GetPageID());
+	if (it == history.end() || !it->second.resident)
+	{
+		return false;
+	}
+	History& h = it->second;
+	isShort = h.count < k;
+	// next is the oldest of K entries, or one past the last of fewer.
+	time = isShort ? h.times[(h.next + k - 1) % k] : h.times[h.next];
+	return true;
+}
+
+
+//-------------------------------------------------------------------
+// LRUK::Upcoming
+//
+// Purpose : The n unpinned frames ChooseVictim would pick first, short
+//           histories first, oldest first.
+//-------------------------------------------------------------------
+
+void LRUK::Upcoming(std::vector<int>& victims, int n)
+{
+	std::vector<std::pair<std::pair<int, long>, int> > ages;
+	for (int f = 0; f < numOfFrames; f++)
+	{
+		bool isShort;
+		long time;
+		if (Age(f, isShort, time))
+		{
+			ages.push_back(std::make_pair(std::make_pair(isShort ? 0 : 1, time), f));
+		}
+	}
+
+	if ((int)ages.size() > n)
+	{
+		std::partial_sort(ages.begin(), ages.begin() + n, ages.end());
+		ages.resize(n);
+	}
+	else
+	{
+		std::sort(ages.begin(), ages.end());
+	}
+	for (size_t i = 0; i < ages.size(); i++)
+	{
+		victims.push_back(ages[i].second);
+	}
+}
+
+
+void LRUK::Evicted(int frameNo, PageID pid)
+{
+	history[pid].resident = false;
+	Prune();
+}
+
+
+void LRUK::Forget(int frameNo, PageID pid)
+{
+	// The page has left the pool without being evicted, so its history
+	// says nothing about the policy's choices.
+	history.erase(pid);
+}
+
+
+TwoQ::TwoQ(int bufSize, Frame **bufFrames, PageTable *table)
+	: Replacer(bufSize, bufFrames, table), a1in(bufSize), am(bufSize)
+{
+	kin = (bufSize / 4 > 0) ? bufSize / 4 : 1;
+	kout = (bufSize / 2 > 0) ? bufSize / 2 : 1;
+}
+
+
+int TwoQ::FirstUnpinned(FrameList& list)
+{
+	for (int f = list.Front(); f != INVALID_FRAME; f = list.Next(f))
+	{
+		if (frames[f]->Evictable())
+		{
+			return f;
+		}
+		pinnedSkips++;
+	}
+	return INVALID_FRAME;
+}
+
+
+void TwoQ::Loaded(int frameNo, PageID pid)
+{
+	if (a1out.Remove(pid))
+	{
+		am.PushBack(frameNo);
+	}
+	else
+	{
+		a1in.PushBack(frameNo);
+	}
+}
+
+
+void TwoQ::Hit(int frameNo)
+{
+	// A hit in A1in is most likely the same burst of use, so it stays
+	// put; only Am is kept in LRU order.
+	if (am.Contains(frameNo))
+	{
+		am.MoveToBack(frameNo);
+	}
+}
+
+
+//-------------------------------------------------------------------
+// TwoQ::ChooseVictim
+//
+// Return  : The oldest unpinned frame of A1in if A1in is over its
+//           share, else the least recently used unpinned frame of Am,
+//           else any unpinned frame of A1in.
+//-------------------------------------------------------------------
+
+int TwoQ::ChooseVictim(PageID pid)
+{
+	int f = INVALID_FRAME;
+	if (a1in.Size() > kin)
+	{
+		f = FirstUnpinned(a1in);
+	}
+	if (f == INVALID_FRAME)
+	{
+		f = FirstUnpinned(am);
+	}
+	if (f == INVALID_FRAME)
+	{
+		f = FirstUnpinned(a1in);
+	}
+	return f;
+}
+
+
+//-------------------------------------------------------------------
+// TwoQ::Upcoming
+//
+// Purpose : The unpinned frames in the order ChooseVictim takes them:
+//           A1in's while it is over its share, then Am's, then A1in's.
+//-------------------------------------------------------------------
+
+void TwoQ::Upcoming(std::vector<int>& victims, int n)
+{
+	if (a1in.Size() > kin)
+	{
+		Unpinned(a1in, victims, n);
+		Unpinned(am, victims, n);
+	}
+	else
+	{
+		Unpinned(am, victims, n);
+		Unpinned(a1in, victims, n);
+	}
+}
+
+
+void TwoQ::Evicted(int frameNo, PageID pid)
+{
+	if (a1in.Contains(frameNo))
+	{
+		a1in.Remove(frameNo);
+		a1out.PushBack(pid);
+		if (a1out.Size() > kout)
+		{
+			a1out.PopFront();
+		}
+	}
+	else
+	{
+		am.Remove(frameNo);
+	}
+}
+
+
+void TwoQ::Forget(int frameNo, PageID pid)
+{
+	a1in.Remove(frameNo);
+	am.Remove(frameNo);
+}
+
+
+ARC::ARC(int bufSize, Frame **bufFrames, PageTable *table)
+	: Replacer(bufSize, bufFrames, table), t1(bufSize), t2(bufSize)
+{
+	p = 0;
+	missInB2 = false;
+}
+
+
+int ARC::FirstUnpinned(FrameList& list)
+{
+	for (int f = list.Front(); f != INVALID_FRAME; f = list.Next(f))
+	{
+		if (frames[f]->Evictable())
+		{
+			return f;
+		}
+		pinnedSkips++;
+	}
+	return INVALID_FRAME;
+}
+
+
+//-------------------------------------------------------------------
+// ARC::Miss
+//
+// Input   : pid - the page that missed
+// Purpose : Adapt p.  A hit in ghost list B1 grows T1's target, one in
+//           B2 shrinks it, by the ratio of the ghost list sizes.
+//-------------------------------------------------------------------
+
+void ARC::Miss(PageID pid)
+{
+	missInB2 = false;
+	if (b1.Contains(pid))
+	{
+		int delta = (b2.Size() > b1.Size()) ? b2.Size() / b1.Size() : 1;
+		p = (p + delta < numOfFrames) ? p + delta : numOfFrames;
+	}
+	else if (b2.Contains(pid))
+	{
+		int delta = (b1.Size() > b2.Size()) ? b1.Size() / b2.Size() : 1;
+		p = (p - delta > 0) ? p - delta : 0;
+		missInB2 = true;
+	}
+}
+
+
+//-------------------------------------------------------------------
+// ARC::ChooseVictim
+//
+// Return  : The least recently used unpinned frame of T1 if T1 is over
+//           its target, else of T2; failing that, of the other list.
+//-------------------------------------------------------------------
+
+int ARC::ChooseVictim(PageID pid)
+{
+	int size = t1.Size();
+	bool fromT1 = size > 0 && (size > p || (missInB2 && size == p));
+
+	int f = FirstUnpinned(fromT1 ? t1 : t2);
+	if (f == INVALID_FRAME)
+	{
+		f = FirstUnpinned(fromT1 ? t2 : t1);
+	}
+	return f;
+}
+
+
+//-------------------------------------------------------------------
+// ARC::Upcoming
+//
+// Purpose : The unpinned frames of the list ChooseVictim is taking from
+//           now, then those of the other.
+//-------------------------------------------------------------------
+
+void ARC::Upcoming(std::vector<int>& victims, int n)
+{
+	bool fromT1 = t1.Size() > 0 && t1.Size() >= p;
+	Unpinned(fromT1 ? t1 : t2, victims, n);
+	Unpinned(fromT1 ? t2 : t1, victims, n);
+}
+
+
+void ARC::Evicted(int frameNo, PageID pid)
+{
+	if (t1.Contains(frameNo))
+	{
+		t1.Remove(frameNo);
+		b1.PushBack(pid);
+	}
+	else
+	{
+		t2.Remove(frameNo);
+		b2.PushBack(pid);
+	}
+}
+
+
+void ARC::Loaded(int frameNo, PageID pid)
+{
+	if (b1.Remove(pid) || b2.Remove(pid))
+	{
+		t2.PushBack(frameNo);
+	}
+	else
+	{
+		t1.PushBack(frameNo);
+	}
+
+	// Keep T1+B1 within one pool and the whole directory within two.
+	while (t1.Size() + b1.Size() > numOfFrames && b1.Size() > 0)
+	{
+		b1.PopFront();
+	}
+	while (t1.Size() + t2.Size() + b1.Size() + b2.Size() > 2 * numOfFrames)
+	{
+		if (b2.Size() > 0)
+		{
+			b2.PopFront();
+		}
+		else
+		{
+			b1.PopFront();
+		}
+	}
+}
+
+
+void ARC::Hit(int frameNo)
+{
+	if (t1.Contains(frameNo))
+	{
+		t1.Remove(frameNo);
+	}
+	else
+	{
+		t2.Remove(frameNo);
+	}
+	t2.PushBack(frameNo);
+}
+
+
+void ARC::Forget(int frameNo, PageID pid)
+{
+	t1.Remove(frameNo);
+	t2.Remove(frameNo);
+}
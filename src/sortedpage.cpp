@@ -3,98 +3,285 @@
 *
 */
 
+#include <string.h>
+
 #include "sortedpage.h"
 #include "btindex.h"
 #include "btleaf.h"
+#include "db.h"
+
+
+//-------------------------------------------------------------------
+// SortedPage::Init
+//
+// Input   : pageNo - page id of this page
+// Output  : None
+// Purpose : Initialize an empty node.  The caller sets the type
+//           before inserting anything.
+//-------------------------------------------------------------------
+
+void SortedPage::Init(PageID pageNo)
+{
+	Reset(pageNo);
+	Logged(LOG_NODE_INIT);
+}
+
+
+void SortedPage::Reset(PageID pageNo)
+{
+	lsn = 0;
+	pid = pageNo;
+	prevPage = INVALID_PAGE;
+	nextPage = INVALID_PAGE;
+	numOfRecords = 0;
+	type = LEAF_NODE;
+	capacity = DataSize() / EntrySize();
+}
+
+
+//-------------------------------------------------------------------
+// SortedPage::Logged
+//
+// Input   : type - the change just made to this node
+//           body, length - the record's data, see LogRecordType
+// Purpose : Log the change, if there is a log.
+//-------------------------------------------------------------------
+
+void SortedPage::Logged(LogRecordType type, const void* body, int length)
+{
+	if (MINIBASE_LOG != NULL)
+	{
+		MINIBASE_LOG->Log(type, pid, (Page *)this, &lsn, body, length);
+	}
+}
+
+
+void SortedPage::SetNextPage(PageID pageNo)
+{
+	nextPage = pageNo;
+	Logged(LOG_NODE_NEXT, &pageNo, sizeof(pageNo));
+}
+
+
+void SortedPage::SetPrevPage(PageID pageNo)
+{
+	prevPage = pageNo;
+	Logged(LOG_NODE_PREV, &pageNo, sizeof(pageNo));
+}
+
+
+void SortedPage::SetType(short t)
+{
+	Retype(t);
+	Logged(LOG_NODE_TYPE, &t, sizeof(t));
+}
+
+
+void SortedPage::Retype(short t)
+{
+	type = t;
+	capacity = DataSize() / EntrySize();
+}
+
+
+//-------------------------------------------------------------------
+// SortedPage::DataSize
+//
+// Input   : None
+// Output  : None
+// Purpose : Find the size of the data area of a node, which depends
+//           on the page size of the open database.
+// Return  : The size in bytes.
+//-------------------------------------------------------------------
+
+int SortedPage::DataSize()
+{
+	return MINIBASE_DB->GetPageSize() - (MAX_SPACE - SORTEDPAGE_DATA_SIZE);
+}
+
 
 //-------------------------------------------------------------------
 // SortedPage::InsertRecord
 //
 // Input   : recPtr  - pointer to the record to be inserted
-//           recLen  - length of the record
+//           recLen  - length of the record, must be the entry size
+//                     of this node type
 // Output  : rid - record id of the inserted record
-// Precond : There is enough space on this page to accomodate this
-//           record.  The records on this page is sorted and the
-//           slots directory is compact.
-// Postcond: The records on this page is still sorted and the
-//           slots directory is compact.
+// Precond : The records on this page are sorted.
+// Postcond: The records on this page are still sorted.  A record
+//           goes after any records with an equal key.
 // Purpose : Insert the record into this page.
 // Return  : OK if insertion is done, FAIL otherwise.
 //-------------------------------------------------------------------
 
 Status SortedPage::InsertRecord(char * recPtr, int recLen, RecordID& rid)
 {
-	// ASSERTIONS:
-	// - the slot directory is compressed -> inserts will occur at the end
-	// - slotCnt gives the number of slots used
-	
-	// general plan:
-	//    1. Insert the record into the page,
-	//       which is then not necessarily any more sorted
-	//    2. Sort the page by rearranging the slots (insertion sort)
-	
-	Status status = HeapPage::InsertRecord(recPtr, recLen, rid);
-	if (status != OK) 
+	if (recLen != EntrySize() || AvailableSpace() < recLen)
 	{
 		return FAIL;
 	}
-	
-	// performs a simple insertion sort
-	int i;
-	for (i = numOfSlots - 1; i > 0; i--) 
-	{
-		int *x = (int *)(data + slots[i].offset);
-		int *y = (int *)(data + slots[i - 1].offset);
-		
-		if (*x < *y)
-		{
-			// switch slots
-			Slot tmpSlot;
-			tmpSlot = slots[i];
-			slots[i] = slots[i - 1];
-			slots[i - 1] = tmpSlot;
-		}
-		else
-		{
-			// end insertion sort
-			break;
-		}
-	}
-	
-	// ASSERTIONS:
-	// - record keys increase with increasing slot number (starting at slot 0)
-	// - slot directory compacted
-	
-	rid.slotNo = i;
-		
+
+	int slot = Put(recPtr);
+	Logged(LOG_NODE_INSERT, recPtr, recLen);
+
+	rid.pageNo = pid;
+	rid.slotNo = slot;
+
 	return OK;
 }
 
 
+//-------------------------------------------------------------------
+// SortedPage::Put
+//
+// Input   : recPtr - a record of the entry size, which fits
+// Purpose : InsertRecord, without the checks or the log.
+// Return  : The slot the record went to.
+//-------------------------------------------------------------------
+
+int SortedPage::Put(const char* recPtr)
+{
+	// The record is a key followed by its payload.  Find the insert
+	// position from the key and open a gap there in both arrays.
+	int key;
+	memcpy(&key, recPtr, sizeof(int));
+	int slot = UpperBound(key);
+	int moved = numOfRecords - slot;
+	int size = PayloadSize();
+
+	memmove(Keys() + slot + 1, Keys() + slot, moved * sizeof(int));
+	memmove(PayloadAt(slot + 1), PayloadAt(slot), moved * size);
+	Keys()[slot] = key;
+	memcpy(PayloadAt(slot), recPtr + sizeof(int), size);
+	numOfRecords++;
+	return slot;
+}
+
+
 //-------------------------------------------------------------------
 // SortedPage::DeleteRecord
 //
 // Input   : rid - record id of the record to be deleted.
 // Output  : None
-// Postcond: The slots directory is compact.
-// Purpose : Delete a record from this page, and compact the slot
-//           directory.
+// Postcond: The records after rid move down one slot.
+// Purpose : Delete a record from this page.
 // Return  : OK is deletion is successfull.  FAIL otherwise.
 //-------------------------------------------------------------------
 
 Status SortedPage::DeleteRecord(const RecordID& rid)
 {
-	Status status = HeapPage::DeleteRecord(rid);	
-	if (status != OK) 
+	if (rid.pageNo != pid)
 	{
+		cerr << "Invalid Page No " << rid.pageNo << endl;
 		return FAIL;
 	}
 
-	HeapPage::CompactSlotDir();
-	
-	// ASSERTIONS:
-	// - slot directory is compacted
+	if (rid.slotNo >= numOfRecords || rid.slotNo < 0)
+	{
+		cerr << "Invalid Slot No " << rid.slotNo << endl;
+		return FAIL;
+	}
+
+	int slot = rid.slotNo;
+	Remove(slot);
+	Logged(LOG_NODE_DELETE, &slot, sizeof(slot));
 
 	return OK;
 }
 
+
+void SortedPage::Remove(int slot)
+{
+	int moved = numOfRecords - slot - 1;
+	memmove(Keys() + slot, Keys() + slot + 1, moved * sizeof(int));
+	memmove(PayloadAt(slot), PayloadAt(slot + 1), moved * PayloadSize());
+	numOfRecords--;
+}
+
+
+//-------------------------------------------------------------------
+// SortedPage::IsSane
+//
+// Return  : true if the header is one a node could have, so that a
+//           change can be redone on the page without running off it.
+//-------------------------------------------------------------------
+
+bool SortedPage::IsSane()
+{
+	return (type == INDEX_NODE || type == LEAF_NODE) &&
+	       capacity == DataSize() / EntrySize() &&
+	       numOfRecords >= 0 && numOfRecords <= capacity;
+}
+
+
+//-------------------------------------------------------------------
+// SortedPage::Redo
+//
+// Input   : record, body - a logged change to this page
+//           commit - the LSN of the group it was logged in
+// Output  : stamp - where the page keeps its LSN, if the change was
+//                   redone
+// Purpose : Make the change again, without logging it, if the page
+//           does not have it: if the page's LSN is older than commit.
+//           A node whose header makes no sense is left alone, as the
+//           page has been something else since; LOG_NODE_INIT is
+//           always redone, as it does not depend on what was there,
+//           and everything logged for the page after it is redone too.
+//           The caller stamps the page once the whole group is redone.
+// Return  : true if the change was redone.
+//-------------------------------------------------------------------
+
+bool SortedPage::Redo(const LogRecordHeader& record, const char* body, LSN commit, LSN*& stamp)
+{
+	int length = record.length - sizeof(record);
+
+	if (record.type == LOG_NODE_INIT)
+	{
+		Reset(record.pid);
+		stamp = &lsn;
+		return true;
+	}
+	if (commit <= lsn || !IsSane())
+	{
+		return false;
+	}
+
+	switch (record.type)
+	{
+		case LOG_NODE_TYPE:
+		{
+			short t;
+			memcpy(&t, body, sizeof(t));
+			Retype(t);
+			break;
+		}
+		case LOG_NODE_NEXT:
+			memcpy(&nextPage, body, sizeof(PageID));
+			break;
+		case LOG_NODE_PREV:
+			memcpy(&prevPage, body, sizeof(PageID));
+			break;
+		case LOG_NODE_INSERT:
+			if (length != EntrySize() || numOfRecords >= capacity)
+			{
+				return false;
+			}
+			Put(body);
+			break;
+		case LOG_NODE_DELETE:
+		{
+			int slot;
+			memcpy(&slot, body, sizeof(slot));
+			if (slot < 0 || slot >= numOfRecords)
+			{
+				return false;
+			}
+			Remove(slot);
+			break;
+		}
+		default:
+			return false;
+	}
+	stamp = &lsn;
+	return true;
+}
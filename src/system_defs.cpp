@@ -0,0 +1,147 @@
+/////////////////////////////////////////////////////////////////
+//
+// filename : system_defs.cpp
+//
+// System startup: creates the buffer manager and opens or creates
+// the database.
+//
+/////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#include "minirel.h"
+#include "bufmgr.h"
+#include "db.h"
+#include "log.h"
+
+
+extern int MINIBASE_RESTART_FLAG;
+
+SystemDefs* minibase_globals;
+
+
+SystemDefs::SystemDefs( Status& status, const char* dbname, unsigned dbpages,
+                        unsigned bufpoolsize, const char* replacement_policy,
+                        unsigned pagesize, DBIOMode iomode )
+{
+    char* logname = new char[strlen(dbname) + 5];
+    sprintf( logname, "%s-log", dbname );
+    unsigned maxlogsize = dbpages ? 3*dbpages : 500;
+
+    init( status, dbname, logname, dbpages, maxlogsize,
+          bufpoolsize ? bufpoolsize : NUMBUF,
+          replacement_policy ? replacement_policy : "Clock", pagesize, iomode );
+    delete [] logname;
+}
+
+
+SystemDefs::SystemDefs( Status& status, const char* dbname,
+                        const char* logname, unsigned dbpages,
+                        unsigned maxlogsize, unsigned bufpoolsize,
+                        const char* replacement_policy, unsigned pagesize,
+                        DBIOMode iomode )
+{
+    init( status, dbname, logname, dbpages, maxlogsize,
+          bufpoolsize ? bufpoolsize : NUMBUF,
+          replacement_policy ? replacement_policy : "Clock", pagesize, iomode );
+}
+
+
+void SystemDefs::init( Status& status, const char* dbname, const char* logname,
+                       unsigned dbpages, unsigned maxlogsize,
+                       unsigned bufpoolsize, const char* replacement_policy,
+                       unsigned pagesize, DBIOMode iomode )
+{
+    status = OK;
+    GlobalBufMgr = 0;
+    GlobalDB = 0;
+    GlobalLogMgr = 0;
+    GlobalCatalogPtr = 0;
+    GlobalDBName = 0;
+    GlobalLogName = 0;
+    minibase_globals = this;
+
+    bool opening = MINIBASE_RESTART_FLAG || dbpages == 0;
+
+      // The pool's frames are as big as the database's pages, so find
+      // the page size before creating it: an existing database records
+      // its own, a new one takes the one asked for.
+    if ( opening ) {
+        status = DB::ReadPageSize( dbname, pagesize );
+        if ( status != OK ) {
+            cerr << "Error opening Database " << dbname << endl;
+            minibase_errors.show_errors();
+            return;
+        }
+    } else if ( pagesize == 0 )
+        pagesize = MINIBASE_PAGESIZE;
+
+    GlobalBufMgr = new BufMgr( bufpoolsize, pagesize, replacement_policy,
+                               iomode == DB_MAPPED );
+
+    GlobalDBName = strcpy( new char[strlen(dbname)+1], dbname );
+    GlobalLogName = strcpy( new char[strlen(logname)+1], logname );
+
+    if ( opening ) {
+        GlobalDB = new DB( dbname, status, iomode );
+        if ( status != OK ) {
+            cerr << "Error opening Database " << dbname << endl;
+            minibase_errors.show_errors();
+            return;
+        }
+    } else {
+        GlobalDB = new DB( dbname, dbpages, status, pagesize, iomode );
+        if ( status != OK ) {
+            cerr << "Error creating Database " << dbname << endl;
+            minibase_errors.show_errors();
+            return;
+        }
+
+        status = GlobalBufMgr->FlushAllPages();
+        if ( status != OK ) {
+            cerr << "Error flushing buffer pool pages" << endl;
+            minibase_errors.show_errors();
+            return;
+        }
+    }
+
+      // A new database starts a new log; an existing one keeps its own.
+    GlobalLogMgr = new LogMgr( logname, (long)maxlogsize * pagesize, !opening,
+                               status );
+    if ( status != OK ) {
+        cerr << "Error opening log " << logname << endl;
+        return;
+    }
+
+      // What was logged and not written before the database was last
+      // closed, or crashed, is redone from the log's last checkpoint.
+    if ( opening ) {
+        status = GlobalLogMgr->Restart();
+        if ( status == OK )
+            status = GlobalDB->Recovered();
+        if ( status != OK ) {
+            cerr << "Error restarting Database " << dbname << endl;
+            minibase_errors.show_errors();
+            return;
+        }
+    }
+}
+
+
+SystemDefs::~SystemDefs()
+{
+    delete GlobalBufMgr;
+    delete GlobalLogMgr;
+    GlobalLogMgr = 0;
+    delete [] GlobalDBName;
+    delete [] GlobalLogName;
+    delete GlobalDB;
+}
+
+
+ostream& operator<<( ostream& out, const struct RecordID rid )
+{
+    out << "[" << rid.pageNo << "/" << rid.slotNo << "]";
+    return out;
+}
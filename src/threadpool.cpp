@@ -0,0 +1,116 @@
+#include "threadpool.h"
+
+
+//-------------------------------------------------------------------
+// ThreadPool::ThreadPool
+//
+// Input   : numThreads - number of workers, <= 0 for one per core
+// Output  : None
+// Purpose : Start the worker threads.
+//-------------------------------------------------------------------
+
+ThreadPool::ThreadPool(int numThreads)
+{
+	numOfPending = 0;
+	stopping = false;
+
+	if (numThreads <= 0)
+	{
+		numThreads = (int)std::thread::hardware_concurrency();
+		if (numThreads <= 0)
+			numThreads = 1;
+	}
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+}
+
+
+//-------------------------------------------------------------------
+// ThreadPool::~ThreadPool
+//
+// Input   : None
+// Output  : None
+// Purpose : Let the queued tasks drain, then join all workers.
+//-------------------------------------------------------------------
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(latch);
+		stopping = true;
+	}
+	taskReady.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+
+//-------------------------------------------------------------------
+// ThreadPool::Submit
+//
+// Input   : task - the work to run on a worker thread
+// Output  : None
+// Purpose : Queue a task.
+//-------------------------------------------------------------------
+
+void ThreadPool::Submit(const std::function<void()>& task)
+{
+	{
+		std::unique_lock<std::mutex> lock(latch);
+		tasks.push(task);
+		numOfPending++;
+	}
+	taskReady.notify_one();
+}
+
+
+//-------------------------------------------------------------------
+// ThreadPool::Wait
+//
+// Input   : None
+// Output  : None
+// Purpose : Block until all submitted tasks have completed.
+//-------------------------------------------------------------------
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(latch);
+	while (numOfPending > 0)
+	{
+		allDone.wait(lock);
+	}
+}
+
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(latch);
+			while (!stopping && tasks.empty())
+			{
+				taskReady.wait(lock);
+			}
+			if (tasks.empty())
+				return;
+			task = tasks.front();
+			tasks.pop();
+		}
+
+		task();
+
+		std::unique_lock<std::mutex> lock(latch);
+		if (--numOfPending == 0)
+		{
+			allDone.notify_all();
+		}
+	}
+}